@@ -0,0 +1,55 @@
+#include "arena.h"
+
+namespace
+{
+constexpr size_t kAlignment = alignof(std::max_align_t) < 8 ? 8 : alignof(std::max_align_t);
+}
+
+/**
+ * @brief Allocates a new block of the given size.
+ *
+ * The caller holds the mutex.
+ *
+ * @param bytes Block size.
+ * @return Start of the block.
+ */
+char *Arena::newBlock(size_t bytes)
+{
+    blocks.emplace_back(new char[bytes]);
+    usage.fetch_add(bytes + sizeof(std::unique_ptr<char[]>), std::memory_order_relaxed);
+    return blocks.back().get();
+}
+
+/**
+ * @brief Allocates memory aligned for pointers and 64-bit integers.
+ *
+ * Blocks come from operator new[] and are therefore suitably aligned; every
+ * allocation is rounded up to the alignment so the bump pointer stays aligned.
+ *
+ * @param bytes Number of bytes, greater than zero.
+ * @return The memory, valid until the arena is destroyed.
+ */
+char *Arena::allocate(size_t bytes)
+{
+    bytes = (bytes + kAlignment - 1) & ~(kAlignment - 1);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bytes <= remaining)
+    {
+        char *result = current;
+        current += bytes;
+        remaining -= bytes;
+        return result;
+    }
+    if (bytes > MEMTABLE_ARENA_BLOCK_SIZE / 4)
+    {
+        // Keep the rest of the current block for later small requests
+        return newBlock(bytes);
+    }
+
+    current = newBlock(MEMTABLE_ARENA_BLOCK_SIZE);
+    char *result = current;
+    current += bytes;
+    remaining = MEMTABLE_ARENA_BLOCK_SIZE - bytes;
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "config.h"
+
+/**
+ * @file arena.h
+ * @brief Bump-pointer allocator whose memory is released all at once.
+ */
+
+/**
+ * @brief Allocates memory from large blocks and frees it only on destruction.
+ *
+ * Allocation bumps a pointer within the current block of
+ * MEMTABLE_ARENA_BLOCK_SIZE bytes and starts a new block when it runs out,
+ * so the many small allocations of a memtable cost neither allocator calls
+ * nor per-object headers. Requests larger than a quarter of a block get a
+ * block of their own, keeping the waste at the end of a block small. The
+ * arena may be used by several threads at once; a short critical section
+ * guards the bump pointer.
+ */
+class Arena
+{
+private:
+    std::mutex mutex;
+    char *current = nullptr; ///< Next free byte of the current block
+    size_t remaining = 0;    ///< Free bytes left in the current block
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::atomic<size_t> usage{0};
+
+    /**
+     * @brief Allocates a new block of the given size.
+     * @param bytes Block size.
+     * @return Start of the block.
+     */
+    char *newBlock(size_t bytes);
+
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * @brief Allocates memory aligned for pointers and 64-bit integers.
+     * @param bytes Number of bytes, greater than zero.
+     * @return The memory, valid until the arena is destroyed.
+     */
+    char *allocate(size_t bytes);
+
+    /**
+     * @brief Total size of the blocks held by the arena.
+     */
+    size_t memoryUsage() const { return usage.load(std::memory_order_relaxed); }
+};
+
+#endif // ARENA_H
@@ -0,0 +1,247 @@
+#include "block.h"
+#include "coding.h"
+#include <algorithm>
+
+/**
+ * @brief Constructs an empty block builder.
+ */
+BlockBuilder::BlockBuilder()
+{
+    restarts.push_back(0);
+}
+
+/**
+ * @brief Appends an entry, sharing the key prefix with the previous entry
+ *        unless a restart point is due.
+ *
+ * @param key Key of the entry (greater than the previous key).
+ * @param value Value of the entry.
+ */
+void BlockBuilder::add(std::string_view key, std::string_view value)
+{
+    size_t shared = 0;
+    if (counter < SSTABLE_RESTART_INTERVAL)
+    {
+        size_t limit = std::min(lastKey.size(), key.size());
+        while (shared < limit && lastKey[shared] == key[shared])
+        {
+            ++shared;
+        }
+    }
+    else
+    {
+        restarts.push_back((uint32_t)buffer.size());
+        counter = 0;
+    }
+
+    size_t unshared = key.size() - shared;
+    putVarint32(buffer, (uint32_t)shared);
+    putVarint32(buffer, (uint32_t)unshared);
+    putVarint32(buffer, (uint32_t)value.size());
+    buffer.append(key.data() + shared, unshared);
+    buffer.append(value.data(), value.size());
+
+    lastKey.resize(shared);
+    lastKey.append(key.data() + shared, unshared);
+    ++counter;
+    ++entries;
+}
+
+/**
+ * @brief Appends the restart array and returns the block contents.
+ * @return Finished block contents.
+ */
+std::string_view BlockBuilder::finish()
+{
+    if (!finished)
+    {
+        for (uint32_t restart : restarts)
+        {
+            putFixed32(buffer, restart);
+        }
+        putFixed32(buffer, (uint32_t)restarts.size());
+        finished = true;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Clears the builder for the next block.
+ */
+void BlockBuilder::reset()
+{
+    buffer.clear();
+    restarts.clear();
+    restarts.push_back(0);
+    lastKey.clear();
+    counter = 0;
+    entries = 0;
+    finished = false;
+}
+
+/**
+ * @brief Size the block would have if finished now.
+ * @return Size in bytes.
+ */
+size_t BlockBuilder::currentSizeEstimate() const
+{
+    return buffer.size() + restarts.size() * sizeof(uint32_t) + sizeof(uint32_t);
+}
+
+/**
+ * @brief Attaches to block contents and validates the restart array.
+ * @param contents Block contents (without the on-disk trailer).
+ * @return False if the block is malformed.
+ */
+bool BlockReader::init(std::string_view contents)
+{
+    data = contents;
+    numRestarts = 0;
+    restartOffset = 0;
+    if (contents.size() < sizeof(uint32_t))
+    {
+        return false;
+    }
+
+    uint32_t count = decodeFixed32(contents.data() + contents.size() - sizeof(uint32_t));
+    size_t maxRestarts = (contents.size() - sizeof(uint32_t)) / sizeof(uint32_t);
+    if (count == 0 || count > maxRestarts)
+    {
+        return false;
+    }
+
+    numRestarts = count;
+    restartOffset = contents.size() - (1 + (size_t)count) * sizeof(uint32_t);
+    return true;
+}
+
+/**
+ * @brief Looks up a key.
+ * @param key Key to find.
+ * @param value Receives the value if found.
+ * @return True if the key is present.
+ */
+bool BlockReader::get(std::string_view key, std::string &value) const
+{
+    Iterator it = iterator();
+    it.seek(key);
+    if (it.valid() && it.key() == key)
+    {
+        value.assign(it.value().data(), it.value().size());
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes the entry at nextOffset into the current position.
+ * @return False at the end of the block or on corruption.
+ */
+bool BlockReader::Iterator::parseNext()
+{
+    isValid = false;
+    if (block == nullptr || nextOffset >= block->restartOffset)
+    {
+        return false;
+    }
+
+    const char *p = block->data.data() + nextOffset;
+    const char *limit = block->data.data() + block->restartOffset;
+    uint32_t shared = 0, unshared = 0, valueLength = 0;
+    if (!getVarint32(p, limit, shared) || !getVarint32(p, limit, unshared) || !getVarint32(p, limit, valueLength) ||
+        shared > currentKey.size() || (size_t)(limit - p) < (size_t)unshared + valueLength)
+    {
+        corrupt = true;
+        return false;
+    }
+
+    currentKey.resize(shared);
+    currentKey.append(p, unshared);
+    currentValue = std::string_view(p + unshared, valueLength);
+    current = nextOffset;
+    nextOffset = (size_t)(p + unshared + valueLength - block->data.data());
+    isValid = true;
+    return true;
+}
+
+/**
+ * @brief Positions before the entry of a restart point.
+ * @param index Restart point index.
+ */
+void BlockReader::Iterator::seekToRestart(uint32_t index)
+{
+    currentKey.clear();
+    isValid = false;
+    nextOffset = decodeFixed32(block->data.data() + block->restartOffset + (size_t)index * sizeof(uint32_t));
+}
+
+/**
+ * @brief Positions at the first entry.
+ */
+void BlockReader::Iterator::seekToFirst()
+{
+    if (block == nullptr || block->numRestarts == 0)
+    {
+        isValid = false;
+        return;
+    }
+    seekToRestart(0);
+    parseNext();
+}
+
+/**
+ * @brief Positions at the first entry with key >= target.
+ *
+ * Binary-searches the restart points (whose keys are stored in full) for the
+ * last one below the target, then scans forward within its interval.
+ *
+ * @param target Key to seek to.
+ */
+void BlockReader::Iterator::seek(std::string_view target)
+{
+    if (block == nullptr || block->numRestarts == 0)
+    {
+        isValid = false;
+        return;
+    }
+
+    const char *base = block->data.data();
+    const char *limit = base + block->restartOffset;
+    uint32_t left = 0;
+    uint32_t right = block->numRestarts - 1;
+    while (left < right)
+    {
+        uint32_t mid = left + (right - left + 1) / 2;
+        uint32_t offset = decodeFixed32(limit + (size_t)mid * sizeof(uint32_t));
+        const char *p = base + offset;
+        uint32_t shared = 0, unshared = 0, valueLength = 0;
+        if (offset >= block->restartOffset || !getVarint32(p, limit, shared) || !getVarint32(p, limit, unshared) ||
+            !getVarint32(p, limit, valueLength) || shared != 0 || (size_t)(limit - p) < unshared)
+        {
+            corrupt = true;
+            isValid = false;
+            return;
+        }
+
+        if (std::string_view(p, unshared) < target)
+            left = mid;
+        else
+            right = mid - 1;
+    }
+
+    seekToRestart(left);
+    while (parseNext() && std::string_view(currentKey) < target)
+    {
+    }
+}
+
+/**
+ * @brief Advances to the next entry.
+ */
+void BlockReader::Iterator::next()
+{
+    if (isValid)
+    {
+        parseNext();
+    }
+}
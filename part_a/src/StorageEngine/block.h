@@ -0,0 +1,155 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.h"
+
+/**
+ * @file block.h
+ * @brief Sorted key-value blocks with prefix-compressed keys and restart points.
+ */
+
+/**
+ * @brief Builds one block of sorted entries.
+ *
+ * Each entry is stored as
+ *
+ *     shared key bytes (varint) | unshared key bytes (varint) | value length (varint)
+ *     | unshared key suffix | value
+ *
+ * where "shared" is the length of the prefix the key has in common with the
+ * previous key. Every SSTABLE_RESTART_INTERVAL entries the full key is stored
+ * (a restart point); the offsets of all restart points follow the entries as
+ * fixed32 values, followed by their count. Lookups binary-search the restart
+ * points and then scan at most one interval.
+ */
+class BlockBuilder
+{
+private:
+    std::string buffer;
+    std::vector<uint32_t> restarts;
+    std::string lastKey;
+    int counter = 0;
+    size_t entries = 0;
+    bool finished = false;
+
+public:
+    BlockBuilder();
+
+    /**
+     * @brief Appends an entry; keys must be added in strictly increasing order.
+     * @param key Key of the entry.
+     * @param value Value of the entry.
+     */
+    void add(std::string_view key, std::string_view value);
+
+    /**
+     * @brief Appends the restart array and returns the block contents.
+     *
+     * The returned view stays valid until reset() or the next add().
+     */
+    std::string_view finish();
+
+    /**
+     * @brief Clears the builder for the next block.
+     */
+    void reset();
+
+    /**
+     * @brief Size the block would have if finished now.
+     */
+    size_t currentSizeEstimate() const;
+
+    /**
+     * @brief True if no entry was added since the last reset().
+     */
+    bool empty() const { return entries == 0; }
+
+    /**
+     * @brief Last key added.
+     */
+    const std::string &lastAddedKey() const { return lastKey; }
+};
+
+/**
+ * @brief Read-only view of a block produced by BlockBuilder.
+ *
+ * The view does not own the block's bytes; they must outlive the reader and
+ * its iterators.
+ */
+class BlockReader
+{
+private:
+    std::string_view data;     ///< Entries followed by the restart array
+    size_t restartOffset = 0;  ///< Start of the restart array
+    uint32_t numRestarts = 0;
+
+public:
+    /**
+     * @brief Cursor over the entries of a block in key order.
+     */
+    class Iterator
+    {
+    private:
+        const BlockReader *block = nullptr;
+        size_t current = 0;      ///< Offset of the current entry
+        size_t nextOffset = 0;   ///< Offset of the entry after the current one
+        std::string currentKey;
+        std::string_view currentValue;
+        bool isValid = false;
+        bool corrupt = false;
+
+        bool parseNext();
+        void seekToRestart(uint32_t index);
+
+    public:
+        Iterator() = default;
+        explicit Iterator(const BlockReader *reader) : block(reader) {}
+
+        bool valid() const { return isValid; }
+        bool corrupted() const { return corrupt; }
+        const std::string &key() const { return currentKey; }
+        std::string_view value() const { return currentValue; }
+
+        /**
+         * @brief Positions at the first entry.
+         */
+        void seekToFirst();
+
+        /**
+         * @brief Positions at the first entry with key >= target.
+         * @param target Key to seek to.
+         */
+        void seek(std::string_view target);
+
+        /**
+         * @brief Advances to the next entry.
+         */
+        void next();
+    };
+
+    /**
+     * @brief Attaches to block contents.
+     * @param contents Block contents (without the on-disk trailer).
+     * @return False if the restart array is malformed.
+     */
+    bool init(std::string_view contents);
+
+    /**
+     * @brief Returns an iterator over the block, not yet positioned.
+     */
+    Iterator iterator() const { return Iterator(this); }
+
+    /**
+     * @brief Looks up a key.
+     * @param key Key to find.
+     * @param value Receives the value if found.
+     * @return True if the key is present.
+     */
+    bool get(std::string_view key, std::string &value) const;
+};
+
+#endif // BLOCK_H
@@ -0,0 +1,260 @@
+#include "block_cache.h"
+
+/**
+ * @brief Mixes a block key into a hash; the top bits pick the shard.
+ * @param key Block key.
+ * @return Hash value.
+ */
+size_t BlockCache::KeyHash::operator()(const Key &key) const
+{
+    uint64_t h = key.id * 0x9e3779b97f4a7c15ULL ^ key.offset;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+/**
+ * @brief Frees the entries still held by the shard.
+ *
+ * Handles must not outlive the cache.
+ */
+BlockCache::Shard::~Shard()
+{
+    for (auto &slot : table)
+    {
+        delete slot.second;
+    }
+}
+
+/**
+ * @brief Drops a handle's pin; the last pin puts the entry on the LRU list,
+ *        or frees it if it was already removed from the table.
+ * @param entry Pinned entry.
+ */
+void BlockCache::Shard::release(Entry *entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--entry->refs > 0)
+    {
+        return;
+    }
+
+    if (entry->inCache)
+    {
+        entry->lruPosition = lru.insert(lru.end(), entry);
+        evict();
+    }
+    else
+    {
+        delete entry;
+    }
+}
+
+/**
+ * @brief Removes an entry from the table; it is freed now if unpinned, or
+ *        by its last handle otherwise.
+ * @param entry Cached entry. Caller holds the mutex.
+ */
+void BlockCache::Shard::unlink(Entry *entry)
+{
+    table.erase(Key{entry->id, entry->offset});
+    entry->inCache = false;
+    usage -= entry->charge();
+    if (entry->refs == 0)
+    {
+        lru.erase(entry->lruPosition);
+        delete entry;
+    }
+}
+
+/**
+ * @brief Evicts least recently used unpinned entries until the shard fits
+ *        its capacity. Caller holds the mutex.
+ */
+void BlockCache::Shard::evict()
+{
+    while (usage > capacity && !lru.empty())
+    {
+        unlink(lru.front());
+    }
+}
+
+/**
+ * @brief Creates a cache.
+ * @param capacity Total bytes of cached blocks (including bookkeeping).
+ * @param shardBits Log2 of the number of shards.
+ */
+BlockCache::BlockCache(size_t capacity, unsigned shardBits)
+    : shards(new Shard[(size_t)1 << shardBits]), shardBits(shardBits)
+{
+    size_t count = (size_t)1 << shardBits;
+    for (size_t i = 0; i < count; ++i)
+    {
+        shards[i].capacity = (capacity + count - 1) / count;
+    }
+}
+
+/**
+ * @brief Picks the shard of a block from the top bits of its hash.
+ * @param id Cache id of the table.
+ * @param offset Offset of the block.
+ * @return The shard.
+ */
+BlockCache::Shard &BlockCache::shardFor(uint64_t id, uint64_t offset) const
+{
+    uint64_t h = KeyHash()(Key{id, offset});
+    return shards[shardBits == 0 ? 0 : (size_t)(h >> (64 - shardBits))];
+}
+
+/**
+ * @brief Looks up and pins a block, counting a hit or a miss.
+ * @param id Cache id of the table.
+ * @param offset Offset of the block in the table file.
+ * @return A handle, empty if the block is not cached.
+ */
+BlockCache::Handle BlockCache::lookup(uint64_t id, uint64_t offset)
+{
+    Shard &shard = shardFor(id, offset);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.table.find(Key{id, offset});
+    if (it == shard.table.end())
+    {
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        return Handle();
+    }
+
+    Entry *entry = it->second;
+    if (entry->refs++ == 0)
+    {
+        shard.lru.erase(entry->lruPosition);
+    }
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+    return Handle(&shard, entry);
+}
+
+/**
+ * @brief Inserts and pins a block, replacing any cached copy.
+ *
+ * A copy inserted concurrently by another reader of the same block is
+ * replaced; handles on it stay valid.
+ *
+ * @param id Cache id of the table.
+ * @param offset Offset of the block in the table file.
+ * @param contents Block contents.
+ * @return A handle on the inserted block.
+ */
+BlockCache::Handle BlockCache::insert(uint64_t id, uint64_t offset, std::string &&contents)
+{
+    Entry *entry = new Entry;
+    entry->id = id;
+    entry->offset = offset;
+    entry->contents = std::move(contents);
+    entry->refs = 1;
+    entry->inCache = true;
+
+    Shard &shard = shardFor(id, offset);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.table.find(Key{id, offset});
+    if (it != shard.table.end())
+    {
+        shard.unlink(it->second);
+    }
+    shard.table.emplace(Key{id, offset}, entry);
+    shard.usage += entry->charge();
+    shard.evict();
+    return Handle(&shard, entry);
+}
+
+/**
+ * @brief Number of lookups that found their block.
+ * @return Sum over all shards.
+ */
+uint64_t BlockCache::hits() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < ((size_t)1 << shardBits); ++i)
+    {
+        total += shards[i].hits.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * @brief Number of lookups that did not find their block.
+ * @return Sum over all shards.
+ */
+uint64_t BlockCache::misses() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < ((size_t)1 << shardBits); ++i)
+    {
+        total += shards[i].misses.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+/**
+ * @brief Bytes currently charged to the cache, pinned blocks included.
+ * @return Sum over all shards.
+ */
+size_t BlockCache::usage() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < ((size_t)1 << shardBits); ++i)
+    {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        total += shards[i].usage;
+    }
+    return total;
+}
+
+/**
+ * @brief Configured capacity in bytes.
+ * @return Sum of the shard capacities.
+ */
+size_t BlockCache::capacity() const
+{
+    return shards[0].capacity << shardBits;
+}
+
+/**
+ * @brief Takes over another handle's pin.
+ * @param other Handle left empty.
+ */
+BlockCache::Handle::Handle(Handle &&other) noexcept : shard(other.shard), entry(other.entry)
+{
+    other.shard = nullptr;
+    other.entry = nullptr;
+}
+
+/**
+ * @brief Releases the current pin and takes over another handle's pin.
+ * @param other Handle left empty.
+ * @return This handle.
+ */
+BlockCache::Handle &BlockCache::Handle::operator=(Handle &&other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        shard = other.shard;
+        entry = other.entry;
+        other.shard = nullptr;
+        other.entry = nullptr;
+    }
+    return *this;
+}
+
+/**
+ * @brief Releases the pin early.
+ */
+void BlockCache::Handle::reset()
+{
+    if (entry != nullptr)
+    {
+        shard->release(entry);
+        shard = nullptr;
+        entry = nullptr;
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "config.h"
+
+/**
+ * @file block_cache.h
+ * @brief Capacity-bounded cache of SSTable blocks shared by all tables.
+ */
+
+/**
+ * @brief Sharded LRU cache of verified SSTable data blocks.
+ *
+ * Blocks are identified by the cache id of their table (see newId()) and
+ * their offset in the file. The id space is split into 2^shardBits shards,
+ * each with its own lock, hash table and LRU list, so concurrent readers
+ * rarely contend. A lookup or insert returns a Handle that pins the block:
+ * pinned blocks are never evicted and stay valid until the handle is
+ * released, even if the block is replaced or the cache shrinks meanwhile.
+ * Only unpinned blocks sit on the LRU list, and the least recently released
+ * one is evicted first once a shard exceeds its share of the capacity.
+ */
+class BlockCache
+{
+private:
+    /**
+     * @brief Cached block.
+     */
+    struct Entry
+    {
+        uint64_t id = 0;
+        uint64_t offset = 0;
+        std::string contents;
+        uint32_t refs = 0;                 ///< Number of live handles
+        bool inCache = false;              ///< Still reachable through the hash table
+        std::list<Entry *>::iterator lruPosition;
+
+        size_t charge() const { return contents.size() + sizeof(Entry); }
+    };
+
+    /**
+     * @brief Key of a block: table id and block offset.
+     */
+    struct Key
+    {
+        uint64_t id;
+        uint64_t offset;
+
+        bool operator==(const Key &other) const { return id == other.id && offset == other.offset; }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const;
+    };
+
+    /**
+     * @brief Independently locked part of the cache.
+     */
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<Key, Entry *, KeyHash> table;
+        std::list<Entry *> lru; ///< Unpinned entries, least recently used first
+        size_t usage = 0;
+        size_t capacity = 0;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+
+        ~Shard();
+
+        void release(Entry *entry);
+        void evict();
+        void unlink(Entry *entry);
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    unsigned shardBits;
+    std::atomic<uint64_t> nextId{1};
+
+    Shard &shardFor(uint64_t id, uint64_t offset) const;
+
+public:
+    /**
+     * @brief Pin on a cached block; releases the pin when destroyed.
+     */
+    class Handle
+    {
+    private:
+        Shard *shard = nullptr;
+        Entry *entry = nullptr;
+
+        friend class BlockCache;
+        Handle(Shard *s, Entry *e) : shard(s), entry(e) {}
+
+    public:
+        Handle() = default;
+        Handle(Handle &&other) noexcept;
+        Handle &operator=(Handle &&other) noexcept;
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+        ~Handle() { reset(); }
+
+        /**
+         * @brief True if the handle pins a block.
+         */
+        explicit operator bool() const { return entry != nullptr; }
+
+        /**
+         * @brief Contents of the pinned block.
+         */
+        std::string_view contents() const { return entry->contents; }
+
+        /**
+         * @brief Releases the pin early.
+         */
+        void reset();
+    };
+
+    /**
+     * @brief Creates a cache.
+     * @param capacity Total bytes of cached blocks (including bookkeeping).
+     * @param shardBits Log2 of the number of shards.
+     */
+    explicit BlockCache(size_t capacity = BLOCK_CACHE_CAPACITY, unsigned shardBits = BLOCK_CACHE_SHARD_BITS);
+
+    BlockCache(const BlockCache &) = delete;
+    BlockCache &operator=(const BlockCache &) = delete;
+
+    /**
+     * @brief Returns a fresh id for a table's blocks; ids are never reused.
+     */
+    uint64_t newId() { return nextId.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Looks up and pins a block, counting a hit or a miss.
+     * @param id Cache id of the table.
+     * @param offset Offset of the block in the table file.
+     * @return A handle, empty if the block is not cached.
+     */
+    Handle lookup(uint64_t id, uint64_t offset);
+
+    /**
+     * @brief Inserts and pins a block, replacing any cached copy.
+     * @param id Cache id of the table.
+     * @param offset Offset of the block in the table file.
+     * @param contents Block contents.
+     * @return A handle on the inserted block.
+     */
+    Handle insert(uint64_t id, uint64_t offset, std::string &&contents);
+
+    /**
+     * @brief Number of lookups that found their block.
+     */
+    uint64_t hits() const;
+
+    /**
+     * @brief Number of lookups that did not find their block.
+     */
+    uint64_t misses() const;
+
+    /**
+     * @brief Bytes currently charged to the cache, pinned blocks included.
+     */
+    size_t usage() const;
+
+    /**
+     * @brief Configured capacity in bytes.
+     */
+    size_t capacity() const;
+};
+
+#endif // BLOCK_CACHE_H
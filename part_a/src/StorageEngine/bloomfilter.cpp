@@ -1,57 +1,204 @@
 #include "bloomfilter.h"
-#include <functional>
+#include "coding.h"
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 /**
- * @brief Computes a hash value for a given key using a seed.
+ * @brief Hashes a key.
  *
- * This function applies a hash function to a given string key and
- * mixes it with a seed to generate different hash values.
- *
- * @param key The input string to be hashed.
- * @param seed An integer seed to vary the hash output.
- * @return A size_t hash value.
+ * @param key The key to be hashed.
+ * @return A 64-bit hash value.
  */
-inline size_t hash(const std::string &key, int seed)
+uint64_t BloomFilter::hashKey(std::string_view key)
 {
-    std::hash<std::string> hasher;
-    return hasher(key) ^ (seed * 0x5bd1e995);
+    return hash64(key.data(), key.size());
 }
 
 /**
- * @brief Adds a key to the Bloom filter.
+ * @brief Block of a hash: maps its upper 32 bits onto [0, numBlocks) without a division.
+ */
+static inline uint32_t blockIndex(uint64_t hash, uint32_t numBlocks)
+{
+    return (uint32_t)(((hash >> 32) * numBlocks) >> 32);
+}
+
+/**
+ * @brief Sets the probe bits of a hash in a 512-bit mask.
  *
- * This function computes multiple hash values for the given key
- * and sets the corresponding bits in the bit array.
+ * Probe i sits at the top nine bits of a + i * b, where a is the lower half
+ * of the hash and b an odd stride derived from the upper half.
  *
- * @param key The string key to be added to the filter.
+ * @param hash Key hash.
+ * @param numProbes Number of probes.
+ * @param mask Receives the bits; must start out zero.
  */
-void BloomFilter::add(const std::string &key)
+static inline void probeMask(uint64_t hash, int numProbes, uint64_t mask[8])
 {
-    for (int i = 0; i < BLOOM_HASH_COUNT; ++i)
+    uint32_t a = (uint32_t)hash;
+    uint32_t b = ((uint32_t)(hash >> 32) * 0x9e3779b9u) | 1;
+    for (int i = 0; i < numProbes; ++i)
     {
-        size_t hashValue = hash(key, i) % BLOOM_FILTER_SIZE;
-        bitArray.set(hashValue);
+        uint32_t bit = a >> 23;
+        mask[bit >> 6] |= 1ULL << (bit & 63);
+        a += b;
     }
 }
 
 /**
- * @brief Checks if a key might be in the Bloom filter.
+ * @brief Records a key for the filter built by serialize().
+ *
+ * Only the key's hash is kept, so the key need not outlive the call.
  *
- * This function computes multiple hash values for the given key
- * and checks whether all the corresponding bits are set in the bit array.
- * If all bits are set, the key might be present; otherwise, it is definitely not present.
+ * @param key The string key to be added to the filter.
+ */
+void BloomFilter::add(std::string_view key)
+{
+    pending.push_back(hashKey(key));
+}
+
+/**
+ * @brief Checks if a key might be in the Bloom filter.
  *
  * @param key The string key to be checked.
  * @return True if the key might be present, false if it is definitely not present.
  */
-bool BloomFilter::mightContain(const std::string &key) const
+bool BloomFilter::mightContain(std::string_view key) const
 {
-    for (int i = 0; i < BLOOM_HASH_COUNT; ++i)
+    return !blocks || matches(hashKey(key));
+}
+
+/**
+ * @brief Checks a batch of keys at once.
+ *
+ * The first pass hashes every key and prefetches its block; the second tests
+ * the blocks, which by then are in flight or already cached.
+ *
+ * @param keys Keys to check.
+ * @param results Receives, per key, 1 if it might be present and 0 if not.
+ */
+void BloomFilter::mightContain(const std::vector<std::string_view> &keys, std::vector<char> &results) const
+{
+    results.assign(keys.size(), 1);
+    if (!blocks)
+    {
+        return;
+    }
+
+    std::vector<uint64_t> hashes(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        hashes[i] = hashKey(keys[i]);
+        __builtin_prefetch(&blocks[blockIndex(hashes[i], numBlocks)]);
+    }
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        results[i] = matches(hashes[i]);
+    }
+}
+
+/**
+ * @brief Tests the probes of a hash against its block.
+ *
+ * The probe bits are gathered into a mask of the block first, so the test is
+ * a branch-free comparison of one cache line (two 256-bit operations where
+ * AVX2 is available).
+ *
+ * @param hash Key hash.
+ * @return True if every probe bit is set.
+ */
+bool BloomFilter::matches(uint64_t hash) const
+{
+    const CacheLine &line = blocks[blockIndex(hash, numBlocks)];
+    alignas(32) uint64_t mask[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    probeMask(hash, numProbes, mask);
+
+#if defined(__AVX2__)
+    __m256i lowWords = _mm256_load_si256((const __m256i *)line.words);
+    __m256i highWords = _mm256_load_si256((const __m256i *)(line.words + 4));
+    __m256i lowMask = _mm256_load_si256((const __m256i *)mask);
+    __m256i highMask = _mm256_load_si256((const __m256i *)(mask + 4));
+    // testc is 1 if every bit of the mask is set in the words
+    return _mm256_testc_si256(lowWords, lowMask) & _mm256_testc_si256(highWords, highMask);
+#else
+    uint64_t missing = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        missing |= mask[i] & ~line.words[i];
+    }
+    return missing == 0;
+#endif
+}
+
+/**
+ * @brief Builds the filter of the added keys.
+ *
+ * The filter gets BLOOM_BITS_PER_KEY bits per key in whole blocks, and
+ * about ln 2 probes per bit per key, rounded down since blocking makes some
+ * blocks denser than the average.
+ *
+ * @return The blocks as little-endian words, followed by the number of probes.
+ */
+std::string BloomFilter::serialize() const
+{
+    uint64_t bits = std::max<uint64_t>(pending.size() * BLOOM_BITS_PER_KEY, 1);
+    uint32_t count = (uint32_t)((bits + 511) / 512);
+    int probes = std::min(std::max((int)(BLOOM_BITS_PER_KEY * 0.69), 1), 16);
+
+    std::vector<CacheLine> lines(count);
+    for (CacheLine &line : lines)
+    {
+        std::fill(line.words, line.words + 8, 0);
+    }
+    for (uint64_t hash : pending)
+    {
+        probeMask(hash, probes, lines[blockIndex(hash, count)].words);
+    }
+
+    std::string data;
+    data.reserve((size_t)count * sizeof(CacheLine) + 1);
+    for (const CacheLine &line : lines)
+    {
+        for (uint64_t word : line.words)
+        {
+            putFixed64(data, word);
+        }
+    }
+    data.push_back((char)probes);
+    return data;
+}
+
+/**
+ * @brief Loads a filter produced by serialize().
+ *
+ * The blocks are copied into cache-line-aligned memory.
+ *
+ * @param data Serialized filter.
+ * @return False if the size or the number of probes is invalid.
+ */
+bool BloomFilter::deserialize(std::string_view data)
+{
+    if (data.size() < sizeof(CacheLine) + 1 || (data.size() - 1) % sizeof(CacheLine) != 0)
+    {
+        return false;
+    }
+    int probes = (unsigned char)data.back();
+    if (probes < 1 || probes > 30)
+    {
+        return false;
+    }
+
+    numBlocks = (uint32_t)((data.size() - 1) / sizeof(CacheLine));
+    numProbes = probes;
+    blocks.reset(new CacheLine[numBlocks]);
+    const char *p = data.data();
+    for (uint32_t i = 0; i < numBlocks; ++i)
     {
-        size_t hashValue = hash(key, i) % BLOOM_FILTER_SIZE;
-        if (!bitArray.test(hashValue))
+        for (uint64_t &word : blocks[i].words)
         {
-            return false;
+            word = decodeFixed64(p);
+            p += 8;
         }
     }
     return true;
@@ -1,55 +1,109 @@
 #ifndef BLOOM_FILTER_H
 #define BLOOM_FILTER_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <bitset>
+#include <string_view>
+#include <vector>
 #include "config.h"
 
 /**
- * @brief Computes a hash value for a given key using a seed.
- *
- * This function generates a hash value by applying a hash function to
- * the input key and modifying it with a seed value.
- *
- * @param key The string key to be hashed.
- * @param seed An integer seed to vary the hash output.
- * @return A size_t hash value.
+ * @file bloomfilter.h
+ * @brief Cache-line-blocked Bloom filter stored in SSTable filter blocks.
  */
-inline size_t hash(const std::string &key, int seed);
 
 /**
  * @brief Bloom Filter implementation for probabilistic membership testing.
  *
- * The Bloom Filter uses multiple hash functions to store elements in a bit array.
- * It allows fast membership queries with a possibility of false positives but no false negatives.
+ * The filter is split into 512-bit blocks, each the size and alignment of a
+ * cache line. A key is hashed once to 64 bits: the upper half selects its
+ * block and the lower half derives, by double hashing, the positions of its
+ * probes within that block. A negative lookup therefore touches a single
+ * cache line, whatever the number of probes.
+ *
+ * The filter is sized when it is serialized: keys are recorded as hashes by
+ * add(), and serialize() allocates BLOOM_BITS_PER_KEY bits per key, rounded
+ * up to whole blocks, with the number of probes that minimizes the false
+ * positive rate for that density. It allows fast membership queries with a
+ * possibility of false positives but no false negatives.
  */
 class BloomFilter
 {
 private:
-    std::bitset<BLOOM_FILTER_SIZE> bitArray;
+    /**
+     * @brief One block of the filter.
+     */
+    struct alignas(64) CacheLine
+    {
+        uint64_t words[8];
+    };
+
+    std::vector<uint64_t> pending;        ///< Hashes of the keys added so far
+    std::unique_ptr<CacheLine[]> blocks;  ///< Loaded filter, or nullptr to match every key
+    uint32_t numBlocks = 0;
+    int numProbes = 0;
+
+    /**
+     * @brief Hashes a key.
+     */
+    static uint64_t hashKey(std::string_view key);
+
+    /**
+     * @brief Tests the probes of a hash against its block of a loaded filter.
+     */
+    bool matches(uint64_t hash) const;
 
 public:
     /**
-     * @brief Adds a key to the Bloom filter.
-     *
-     * This function hashes the given key multiple times and sets the corresponding
-     * bits in the bit array.
+     * @brief Records a key for the filter built by serialize().
      *
      * @param key The string key to be added.
      */
-    void add(const std::string &key);
+    void add(std::string_view key);
 
     /**
      * @brief Checks if a key might be present in the Bloom filter.
      *
-     * This function hashes the key and checks whether all the corresponding
-     * bits are set in the bit array. If all bits are set, the key might be present;
-     * otherwise, it is definitely not present.
+     * All probes of the key lie in one block; the key might be present only
+     * if all of them are set. A filter that was never loaded contains every key.
      *
      * @param key The string key to be checked.
      * @return True if the key might be present, false if it is definitely not present.
      */
-    bool mightContain(const std::string &key) const;
+    bool mightContain(std::string_view key) const;
+
+    /**
+     * @brief Checks a batch of keys at once.
+     *
+     * All keys are hashed and their blocks prefetched before the first block
+     * is tested, so the cache misses of the batch overlap instead of being
+     * paid one after the other.
+     *
+     * @param keys Keys to check.
+     * @param results Receives, per key, 1 if it might be present and 0 if not.
+     */
+    void mightContain(const std::vector<std::string_view> &keys, std::vector<char> &results) const;
+
+    /**
+     * @brief Builds the filter of the added keys for storage in an SSTable filter block.
+     *
+     * @return The blocks as little-endian words, followed by the number of probes.
+     */
+    std::string serialize() const;
+
+    /**
+     * @brief Loads a filter produced by serialize().
+     *
+     * @param data Serialized filter.
+     * @return False if the data is not a valid filter.
+     */
+    bool deserialize(std::string_view data);
+
+    /**
+     * @brief Heap memory held by the filter.
+     */
+    size_t memoryUsage() const { return numBlocks * sizeof(CacheLine) + pending.capacity() * sizeof(uint64_t); }
 };
 
 #endif // BLOOM_FILTER_H
@@ -0,0 +1,126 @@
+#include "coding.h"
+
+/**
+ * @brief Lookup table for CRC-32C (reflected polynomial 0x82F63B78).
+ */
+struct Crc32cTable
+{
+    uint32_t entries[256];
+
+    Crc32cTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+            entries[i] = c;
+        }
+    }
+};
+
+static const Crc32cTable CRC32C_TABLE;
+
+/**
+ * @brief Computes the CRC-32C checksum of a byte range.
+ *
+ * @param data Bytes to checksum.
+ * @param len Number of bytes.
+ * @param seed Checksum of preceding bytes when extending a checksum (0 to start).
+ * @return Checksum.
+ */
+uint32_t crc32c(const char *data, size_t len, uint32_t seed)
+{
+    uint32_t crc = seed ^ 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i)
+        crc = CRC32C_TABLE.entries[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * @brief Multiplies two 64-bit values and folds the 128-bit product.
+ */
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+    __uint128_t product = (__uint128_t)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/**
+ * @brief Reads 1 to 3 bytes as one integer (first, middle and last byte).
+ */
+static inline uint64_t readSmall(const char *p, size_t len)
+{
+    return ((uint64_t)(unsigned char)p[0] << 16) | ((uint64_t)(unsigned char)p[len >> 1] << 8) |
+           (uint64_t)(unsigned char)p[len - 1];
+}
+
+/**
+ * @brief Computes a fast, well-mixed 64-bit hash of a byte range.
+ *
+ * Follows the construction of wyhash: input words are combined pairwise by
+ * 64x64->128-bit multiplications, which mix every input bit into the whole
+ * result in a few cycles. Inputs are read in little-endian order so that
+ * hashes stored on disk (e.g. in Bloom filters) do not depend on the host.
+ *
+ * @param data Bytes to hash.
+ * @param len Number of bytes.
+ * @param seed Value selecting an independent hash function.
+ * @return Hash.
+ */
+uint64_t hash64(const char *data, size_t len, uint64_t seed)
+{
+    static const uint64_t secret[4] = {0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL,
+                                       0x589965cc75374cc3ULL};
+    const char *p = data;
+    seed ^= mix(seed ^ secret[0], secret[1]);
+    uint64_t a, b;
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            size_t shift = (len >> 3) << 2;
+            a = ((uint64_t)decodeFixed32(p) << 32) | decodeFixed32(p + shift);
+            b = ((uint64_t)decodeFixed32(p + len - 4) << 32) | decodeFixed32(p + len - 4 - shift);
+        }
+        else if (len > 0)
+        {
+            a = readSmall(p, len);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        size_t remaining = len;
+        if (remaining > 48)
+        {
+            uint64_t seed1 = seed, seed2 = seed;
+            do
+            {
+                seed = mix(decodeFixed64(p) ^ secret[1], decodeFixed64(p + 8) ^ seed);
+                seed1 = mix(decodeFixed64(p + 16) ^ secret[2], decodeFixed64(p + 24) ^ seed1);
+                seed2 = mix(decodeFixed64(p + 32) ^ secret[3], decodeFixed64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16)
+        {
+            seed = mix(decodeFixed64(p) ^ secret[1], decodeFixed64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = decodeFixed64(p + remaining - 16);
+        b = decodeFixed64(p + remaining - 8);
+    }
+
+    __uint128_t product = (__uint128_t)(a ^ secret[1]) * (b ^ seed);
+    a = (uint64_t)product;
+    b = (uint64_t)(product >> 64);
+    return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
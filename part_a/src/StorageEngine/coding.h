@@ -0,0 +1,168 @@
+#ifndef CODING_H
+#define CODING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @file coding.h
+ * @brief Little-endian fixed-width and varint encodings, CRC-32C and a 64-bit
+ *        hash, shared by the on-disk formats (write-ahead log, SSTables).
+ */
+
+/**
+ * @brief Stores a 32-bit value in little-endian order.
+ */
+inline void encodeFixed32(char *dst, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        dst[i] = (char)((value >> (8 * i)) & 0xFF);
+}
+
+/**
+ * @brief Stores a 64-bit value in little-endian order.
+ */
+inline void encodeFixed64(char *dst, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        dst[i] = (char)((value >> (8 * i)) & 0xFF);
+}
+
+/**
+ * @brief Loads a little-endian 32-bit value.
+ */
+inline uint32_t decodeFixed32(const char *src)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+        value |= (uint32_t)(unsigned char)src[i] << (8 * i);
+    return value;
+}
+
+/**
+ * @brief Loads a little-endian 64-bit value.
+ */
+inline uint64_t decodeFixed64(const char *src)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i)
+        value |= (uint64_t)(unsigned char)src[i] << (8 * i);
+    return value;
+}
+
+/**
+ * @brief Appends a little-endian 32-bit value.
+ */
+inline void putFixed32(std::string &dst, uint32_t value)
+{
+    char buf[4];
+    encodeFixed32(buf, value);
+    dst.append(buf, 4);
+}
+
+/**
+ * @brief Appends a little-endian 64-bit value.
+ */
+inline void putFixed64(std::string &dst, uint64_t value)
+{
+    char buf[8];
+    encodeFixed64(buf, value);
+    dst.append(buf, 8);
+}
+
+/**
+ * @brief Appends a varint (7 bits per byte, high bit set on all but the last byte).
+ */
+inline void putVarint64(std::string &dst, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        dst.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    dst.push_back((char)value);
+}
+
+/**
+ * @brief Appends a 32-bit varint.
+ */
+inline void putVarint32(std::string &dst, uint32_t value)
+{
+    putVarint64(dst, value);
+}
+
+/**
+ * @brief Decodes a varint and advances the cursor past it.
+ * @param p Cursor.
+ * @param end End of the readable range.
+ * @param value Receives the value.
+ * @return False if the input is truncated or malformed.
+ */
+inline bool getVarint64(const char *&p, const char *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift <= 63 && p < end; shift += 7)
+    {
+        uint64_t byte = (unsigned char)*p++;
+        value |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes a 32-bit varint and advances the cursor past it.
+ */
+inline bool getVarint32(const char *&p, const char *end, uint32_t &value)
+{
+    uint64_t wide = 0;
+    if (!getVarint64(p, end, wide) || wide > UINT32_MAX)
+        return false;
+    value = (uint32_t)wide;
+    return true;
+}
+
+/**
+ * @brief Appends a varint length followed by the bytes.
+ */
+inline void putLengthPrefixed(std::string &dst, std::string_view value)
+{
+    putVarint32(dst, (uint32_t)value.size());
+    dst.append(value.data(), value.size());
+}
+
+/**
+ * @brief Decodes a varint-length-prefixed byte string.
+ */
+inline bool getLengthPrefixed(const char *&p, const char *end, std::string_view &value)
+{
+    uint32_t length = 0;
+    if (!getVarint32(p, end, length) || length > (size_t)(end - p))
+        return false;
+    value = std::string_view(p, length);
+    p += length;
+    return true;
+}
+
+/**
+ * @brief Computes the CRC-32C (Castagnoli) checksum of a byte range.
+ * @param data Bytes to checksum.
+ * @param len Number of bytes.
+ * @param seed Checksum of preceding bytes when extending a checksum (0 to start).
+ * @return Checksum.
+ */
+uint32_t crc32c(const char *data, size_t len, uint32_t seed = 0);
+
+/**
+ * @brief Computes a fast, well-mixed 64-bit hash of a byte range.
+ * @param data Bytes to hash.
+ * @param len Number of bytes.
+ * @param seed Value selecting an independent hash function.
+ * @return Hash, identical on every platform.
+ */
+uint64_t hash64(const char *data, size_t len, uint64_t seed = 0);
+
+#endif // CODING_H
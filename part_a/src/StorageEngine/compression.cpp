@@ -0,0 +1,377 @@
+#include "compression.h"
+#include "coding.h"
+#include "config.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/**
+ * @brief Largest uncompressed block accepted, bounding the buffer a corrupt size can request.
+ */
+static const uint32_t MAX_UNCOMPRESSED_BLOCK_SIZE = 256 * 1024 * 1024;
+
+/**
+ * @brief Codec storing blocks as they are.
+ */
+class NoCompressionCodec : public BlockCodec
+{
+public:
+    BlockType type() const override { return BLOCK_UNCOMPRESSED; }
+    const char *name() const override { return "none"; }
+
+    bool compress(std::string_view input, std::string &output) const override
+    {
+        output.append(input.data(), input.size());
+        return true;
+    }
+
+    bool uncompress(std::string_view input, char *output, size_t size) const override
+    {
+        if (input.size() != size)
+        {
+            return false;
+        }
+        std::memcpy(output, input.data(), size);
+        return true;
+    }
+};
+
+/**
+ * @brief Built-in LZ77 codec favouring speed over ratio.
+ *
+ * The compressed form is a list of sequences, each a token byte, literals
+ * and a match:
+ *
+ *     token (literal length << 4 | match length - 4) | [length bytes] | literals | offset (2) | [length bytes]
+ *
+ * A length nibble of 15 is continued by bytes added to it, up to and
+ * including the first byte below 255. The last sequence has literals only
+ * and ends the input. Matches are found through a table of the last position
+ * of every 4-byte hash, within the previous 64 KiB.
+ */
+class LzCodec : public BlockCodec
+{
+private:
+    static constexpr int kHashBits = 12;
+    static constexpr size_t kMinMatch = 4;
+    static constexpr size_t kMaxOffset = 65535;
+
+    static uint32_t load32(const char *p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t hash(uint32_t value) { return (value * 2654435761u) >> (32 - kHashBits); }
+
+    /**
+     * @brief Appends the continuation bytes of a length beyond its nibble.
+     */
+    static void putLength(std::string &output, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            output.push_back((char)255);
+        }
+        output.push_back((char)length);
+    }
+
+    /**
+     * @brief Reads the continuation bytes of a length.
+     * @return False if the input ends first.
+     */
+    static bool getLength(const uint8_t *&p, const uint8_t *end, size_t &length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (p >= end)
+            {
+                return false;
+            }
+            byte = *p++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    /**
+     * @brief Appends a sequence; a match length of zero marks the last one.
+     */
+    static void putSequence(std::string &output, const char *literals, size_t literalLength, size_t offset,
+                            size_t matchLength)
+    {
+        size_t matchCode = matchLength > 0 ? matchLength - kMinMatch : 0;
+        output.push_back((char)((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15)));
+        if (literalLength >= 15)
+        {
+            putLength(output, literalLength - 15);
+        }
+        output.append(literals, literalLength);
+        if (matchLength > 0)
+        {
+            output.push_back((char)(offset & 0xff));
+            output.push_back((char)(offset >> 8));
+            if (matchCode >= 15)
+            {
+                putLength(output, matchCode - 15);
+            }
+        }
+    }
+
+public:
+    BlockType type() const override { return BLOCK_LZ; }
+    const char *name() const override { return "lz"; }
+
+    bool compress(std::string_view input, std::string &output) const override
+    {
+        const char *base = input.data();
+        const char *end = base + input.size();
+        const char *anchor = base;
+        uint32_t table[1 << kHashBits] = {};
+
+        for (const char *p = base; p + kMinMatch <= end;)
+        {
+            uint32_t value = load32(p);
+            uint32_t &slot = table[hash(value)];
+            const char *candidate = base + slot;
+            slot = (uint32_t)(p - base);
+            if (candidate >= p || (size_t)(p - candidate) > kMaxOffset || load32(candidate) != value)
+            {
+                ++p;
+                continue;
+            }
+
+            const char *matchEnd = p + kMinMatch;
+            const char *source = candidate + kMinMatch;
+            while (matchEnd < end && *matchEnd == *source)
+            {
+                ++matchEnd;
+                ++source;
+            }
+            putSequence(output, anchor, (size_t)(p - anchor), (size_t)(p - candidate), (size_t)(matchEnd - p));
+            p = anchor = matchEnd;
+        }
+        putSequence(output, anchor, (size_t)(end - anchor), 0, 0);
+        return true;
+    }
+
+    bool uncompress(std::string_view input, char *output, size_t size) const override
+    {
+        const uint8_t *p = (const uint8_t *)input.data();
+        const uint8_t *end = p + input.size();
+        char *out = output;
+        char *outEnd = output + size;
+
+        while (p < end)
+        {
+            uint8_t token = *p++;
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !getLength(p, end, literalLength))
+            {
+                return false;
+            }
+            if (literalLength > (size_t)(end - p) || literalLength > (size_t)(outEnd - out))
+            {
+                return false;
+            }
+            std::memcpy(out, p, literalLength);
+            out += literalLength;
+            p += literalLength;
+            if (p == end)
+            {
+                break;
+            }
+
+            if (end - p < 2)
+            {
+                return false;
+            }
+            size_t offset = (size_t)p[0] | ((size_t)p[1] << 8);
+            p += 2;
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !getLength(p, end, matchLength))
+            {
+                return false;
+            }
+            matchLength += kMinMatch;
+            if (offset == 0 || offset > (size_t)(out - output) || matchLength > (size_t)(outEnd - out))
+            {
+                return false;
+            }
+            // Byte by byte: the match may overlap the bytes it produces
+            const char *source = out - offset;
+            for (size_t i = 0; i < matchLength; ++i)
+            {
+                out[i] = source[i];
+            }
+            out += matchLength;
+        }
+        return out == outEnd;
+    }
+};
+
+#ifdef HAVE_LZ4
+/**
+ * @brief LZ4 block compression from the system library.
+ */
+class Lz4Codec : public BlockCodec
+{
+public:
+    BlockType type() const override { return BLOCK_LZ4; }
+    const char *name() const override { return "lz4"; }
+
+    bool compress(std::string_view input, std::string &output) const override
+    {
+        size_t start = output.size();
+        int bound = LZ4_compressBound((int)input.size());
+        output.resize(start + (size_t)bound);
+        int length = LZ4_compress_default(input.data(), &output[start], (int)input.size(), bound);
+        output.resize(start + (size_t)std::max(length, 0));
+        return length > 0;
+    }
+
+    bool uncompress(std::string_view input, char *output, size_t size) const override
+    {
+        return LZ4_decompress_safe(input.data(), output, (int)input.size(), (int)size) == (int)size;
+    }
+};
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Zstandard compression from the system library, at ZSTD_COMPRESSION_LEVEL.
+ */
+class ZstdCodec : public BlockCodec
+{
+public:
+    BlockType type() const override { return BLOCK_ZSTD; }
+    const char *name() const override { return "zstd"; }
+
+    bool compress(std::string_view input, std::string &output) const override
+    {
+        size_t start = output.size();
+        output.resize(start + ZSTD_compressBound(input.size()));
+        size_t length = ZSTD_compress(&output[start], output.size() - start, input.data(), input.size(),
+                                      ZSTD_COMPRESSION_LEVEL);
+        if (ZSTD_isError(length))
+        {
+            output.resize(start);
+            return false;
+        }
+        output.resize(start + length);
+        return true;
+    }
+
+    bool uncompress(std::string_view input, char *output, size_t size) const override
+    {
+        size_t length = ZSTD_decompress(output, size, input.data(), input.size());
+        return !ZSTD_isError(length) && length == size;
+    }
+};
+#endif
+
+/**
+ * @brief Returns the codec of a block type.
+ * @param type Type read from a block trailer.
+ * @return The codec, or nullptr if it is unknown or not built in.
+ */
+const BlockCodec *findBlockCodec(BlockType type)
+{
+    static const NoCompressionCodec none;
+    static const LzCodec lz;
+#ifdef HAVE_LZ4
+    static const Lz4Codec lz4;
+#endif
+#ifdef HAVE_ZSTD
+    static const ZstdCodec zstd;
+#endif
+
+    switch (type)
+    {
+    case BLOCK_UNCOMPRESSED:
+        return &none;
+    case BLOCK_LZ:
+        return &lz;
+#ifdef HAVE_LZ4
+    case BLOCK_LZ4:
+        return &lz4;
+#endif
+#ifdef HAVE_ZSTD
+    case BLOCK_ZSTD:
+        return &zstd;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * @brief Returns a codec by name.
+ * @param name "none", "lz", "lz4" or "zstd".
+ * @return The codec, or nullptr if it is unknown or not built in.
+ */
+const BlockCodec *findBlockCodec(std::string_view name)
+{
+    for (BlockType type : {BLOCK_UNCOMPRESSED, BLOCK_LZ, BLOCK_LZ4, BLOCK_ZSTD})
+    {
+        const BlockCodec *codec = findBlockCodec(type);
+        if (codec != nullptr && name == codec->name())
+        {
+            return codec;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Compresses a block as stored in a table file.
+ *
+ * The stored form is the uncompressed size (varint32) followed by the
+ * codec's output. Compression that saves less than an eighth of the block
+ * is not worth its decoding cost on every read, so such blocks are reported
+ * as better stored uncompressed.
+ *
+ * @param codec Codec to use.
+ * @param contents Block contents.
+ * @param output Receives the stored form.
+ * @return False if the block is better stored uncompressed.
+ */
+bool compressBlock(const BlockCodec &codec, std::string_view contents, std::string &output)
+{
+    output.clear();
+    if (codec.type() == BLOCK_UNCOMPRESSED || contents.size() > MAX_UNCOMPRESSED_BLOCK_SIZE)
+    {
+        return false;
+    }
+    putVarint32(output, (uint32_t)contents.size());
+    return codec.compress(contents, output) && output.size() < contents.size() - contents.size() / 8;
+}
+
+/**
+ * @brief Restores a block stored by compressBlock().
+ * @param type Type read from the block trailer.
+ * @param stored Stored bytes of the block.
+ * @param output Receives the contents.
+ * @return False if the block is corrupt or its codec is not built in.
+ */
+bool uncompressBlock(BlockType type, std::string_view stored, std::string &output)
+{
+    const BlockCodec *codec = findBlockCodec(type);
+    const char *p = stored.data();
+    const char *end = p + stored.size();
+    uint32_t size = 0;
+    if (codec == nullptr || !getVarint32(p, end, size) || size > MAX_UNCOMPRESSED_BLOCK_SIZE)
+    {
+        return false;
+    }
+    output.resize(size);
+    return codec->uncompress(std::string_view(p, (size_t)(end - p)), &output[0], size);
+}
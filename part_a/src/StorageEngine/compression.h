@@ -0,0 +1,88 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include "table_format.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @file compression.h
+ * @brief Codecs compressing the blocks of SSTable files.
+ */
+
+/**
+ * @brief Compression algorithm for SSTable blocks.
+ *
+ * Every codec is identified by the BlockType recorded in the trailer of the
+ * blocks it compresses, so each block names the codec needed to read it and
+ * tables written with different codecs can coexist. The built-in "lz" codec
+ * is always available; "lz4" and "zstd" are available when the tree is built
+ * against the system libraries (HAVE_LZ4, HAVE_ZSTD).
+ */
+class BlockCodec
+{
+public:
+    virtual ~BlockCodec() = default;
+
+    /**
+     * @brief Block type recorded for blocks compressed by this codec.
+     */
+    virtual BlockType type() const = 0;
+
+    /**
+     * @brief Name of the codec, as accepted by findBlockCodec().
+     */
+    virtual const char *name() const = 0;
+
+    /**
+     * @brief Compresses a block.
+     * @param input Block contents.
+     * @param output Receives the compressed bytes, appended to its contents.
+     * @return False if the codec failed.
+     */
+    virtual bool compress(std::string_view input, std::string &output) const = 0;
+
+    /**
+     * @brief Restores the contents of a block.
+     * @param input Compressed bytes.
+     * @param output Buffer of size bytes receiving the contents.
+     * @param size Size of the uncompressed contents.
+     * @return False if the input is corrupt.
+     */
+    virtual bool uncompress(std::string_view input, char *output, size_t size) const = 0;
+};
+
+/**
+ * @brief Returns the codec of a block type.
+ * @param type Type read from a block trailer.
+ * @return The codec, or nullptr if it is unknown or not built in.
+ */
+const BlockCodec *findBlockCodec(BlockType type);
+
+/**
+ * @brief Returns a codec by name ("none", "lz", "lz4" or "zstd").
+ * @param name Name of the codec.
+ * @return The codec, or nullptr if it is unknown or not built in.
+ */
+const BlockCodec *findBlockCodec(std::string_view name);
+
+/**
+ * @brief Compresses a block as stored in a table file.
+ * @param codec Codec to use.
+ * @param contents Block contents.
+ * @param output Receives the uncompressed size followed by the compressed bytes.
+ * @return False if the block is better stored uncompressed.
+ */
+bool compressBlock(const BlockCodec &codec, std::string_view contents, std::string &output);
+
+/**
+ * @brief Restores a block stored by compressBlock().
+ * @param type Type read from the block trailer.
+ * @param stored Stored bytes of the block.
+ * @param output Receives the contents.
+ * @return False if the block is corrupt or its codec is not built in.
+ */
+bool uncompressBlock(BlockType type, std::string_view stored, std::string &output);
+
+#endif // COMPRESSION_H
@@ -11,19 +11,134 @@
  */
 #define MAX_MEMTABLE_SIZE 10000
 
+/**
+ * @brief Size in bytes of the blocks a memtable allocates its entries from.
+ */
+#define MEMTABLE_ARENA_BLOCK_SIZE (64 * 1024)
+
 /**
  * @brief Maximum number of key-value pairs stored in each SSTable.
  */
 #define MAX_SSTABLE_SIZE 10000
 
 /**
- * @brief Size of the Bloom filter's bit array.
+ * @brief Target size in bytes of an SSTable data block.
+ */
+#define SSTABLE_BLOCK_SIZE 4096
+
+/**
+ * @brief Number of entries between restart points (full keys) in an SSTable block.
+ */
+#define SSTABLE_RESTART_INTERVAL 16
+
+/**
+ * @brief Set to 1 to verify the checksum of every SSTable data block read by a
+ *        lookup (index and filter blocks are always verified when a table is opened).
+ */
+#define SSTABLE_VERIFY_READS 0
+
+/**
+ * @brief Block compression of tables above SSTABLE_DEEP_LEVEL: "none", "lz", "lz4" or "zstd".
+ *        A codec that is not built in falls back to the built-in "lz".
+ */
+#define SSTABLE_COMPRESSION "lz4"
+
+/**
+ * @brief First level whose tables are compressed with SSTABLE_DEEP_COMPRESSION.
+ */
+#define SSTABLE_DEEP_LEVEL 2
+
+/**
+ * @brief Block compression of tables on SSTABLE_DEEP_LEVEL and below, which hold
+ *        most of the data and are rewritten least often.
+ */
+#define SSTABLE_DEEP_COMPRESSION "zstd"
+
+/**
+ * @brief Compression level of the "zstd" codec.
+ */
+#define ZSTD_COMPRESSION_LEVEL 3
+
+/**
+ * @brief Number of full memtables that may wait for their flush before writes stall.
+ */
+#define MAX_IMMUTABLE_MEMTABLES 2
+
+/**
+ * @brief Size in bytes up to which the leader of the write queue merges waiting writes into its log record.
+ */
+#define MAX_WRITE_GROUP_BYTES (1024 * 1024)
+
+/**
+ * @brief Number of cache-line-sized reader counters, spread over threads, of a read epoch.
+ */
+#define READ_EPOCH_SLOTS 16
+
+/**
+ * @brief Number of levels of the LSM tree.
+ */
+#define LSM_NUM_LEVELS 7
+
+/**
+ * @brief Number of level-0 tables that triggers a compaction into level 1.
+ */
+#define L0_COMPACTION_TRIGGER 4
+
+/**
+ * @brief Size budget in bytes of level 1; deeper levels are compacted once they exceed theirs.
+ */
+#define LEVEL1_MAX_BYTES (10ULL * 1024 * 1024)
+
+/**
+ * @brief Growth factor of the size budget from one level to the next.
+ */
+#define LEVEL_SIZE_MULTIPLIER 10
+
+/**
+ * @brief Size in bytes at which compaction starts a new output table.
+ */
+#define COMPACTION_TARGET_FILE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Period in milliseconds at which the idle compaction thread looks for tables holding expired values.
+ */
+#define EXPIRY_CHECK_INTERVAL_MS 1000
+
+/**
+ * @brief Time in milliseconds a value must have been expired before its table is rewritten to drop it,
+ *        which bounds how often a table holding expiring values is rewritten.
+ */
+#define EXPIRED_TABLE_REWRITE_DELAY_MS (60 * 1000)
+
+/**
+ * @brief Default capacity in bytes of the SSTable block cache.
+ */
+#define BLOCK_CACHE_CAPACITY (64 * 1024 * 1024)
+
+/**
+ * @brief Log2 of the number of independently locked block cache shards.
+ */
+#define BLOCK_CACHE_SHARD_BITS 4
+
+/**
+ * @brief Bloom filter bits per key of an SSTable (about 1% false positives at 10).
+ */
+#define BLOOM_BITS_PER_KEY 10
+
+/**
+ * @brief Name of the single write-ahead log of earlier versions; it is
+ *        replayed before the numbered logs (wal_N.log) used now.
+ */
+#define WAL_FILE_NAME "wal.log"
+
+/**
+ * @brief Name of the manifest file listing the live SSTables of an LSM tree.
  */
-#define BLOOM_FILTER_SIZE 200000
+#define MANIFEST_FILE_NAME "MANIFEST"
 
 /**
- * @brief Number of hash functions used in the Bloom filter.
+ * @brief Default period in milliseconds between write-ahead log syncs in interval mode.
  */
-#define BLOOM_HASH_COUNT 9
+#define WAL_SYNC_INTERVAL_MS 100
 
 #endif // CONFIG_H
@@ -0,0 +1,182 @@
+#ifndef ENTRY_FORMAT_H
+#define ENTRY_FORMAT_H
+
+#include "coding.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file entry_format.h
+ * @brief Typed, sequenced entries stored in memtables and SSTables, and range deletions.
+ */
+
+/**
+ * @brief Position of a write in the order of all writes to an LSM tree.
+ */
+using SequenceNumber = uint64_t;
+
+/**
+ * @brief Sequence number at which every write is visible.
+ */
+constexpr SequenceNumber MAX_SEQUENCE_NUMBER = UINT64_MAX;
+
+/**
+ * @brief Kind of write an entry records.
+ */
+enum ValueType : uint8_t
+{
+    TYPE_DELETION = 0,      ///< Tombstone of a key
+    TYPE_VALUE = 1,         ///< Value of a key
+    TYPE_EXPIRING_VALUE = 2 ///< Value of a key that is deleted at an expiry time
+};
+
+/**
+ * @brief Decoded entry; the value points into the encoded entry.
+ *
+ * The value a memtable or table stores for a key is encoded as
+ *
+ *     type (1) | sequence (varint64) | [expiry (varint64)] | value (rest of the entry, empty for deletions)
+ *
+ * so deletions are told apart from values of any content, and merges and
+ * range deletions can compare the age of entries from different sources.
+ * Only expiring values store an expiry time, in milliseconds since the epoch.
+ */
+struct ParsedEntry
+{
+    ValueType type = TYPE_VALUE;
+    SequenceNumber sequence = 0;
+    uint64_t expiresAt = 0; ///< Expiry time of expiring values, 0 otherwise
+    std::string_view value;
+};
+
+/**
+ * @brief Current wall-clock time in milliseconds since the epoch, the unit of expiry times.
+ */
+inline uint64_t currentTimeMillis()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Appends an encoded entry.
+ * @param dst Buffer to append to.
+ * @param type Kind of write.
+ * @param sequence Sequence number of the write.
+ * @param value Value written (empty for deletions).
+ * @param expiresAt Expiry time of an expiring value.
+ */
+inline void encodeEntry(std::string &dst, ValueType type, SequenceNumber sequence, std::string_view value,
+                        uint64_t expiresAt = 0)
+{
+    dst.push_back((char)type);
+    putVarint64(dst, sequence);
+    if (type == TYPE_EXPIRING_VALUE)
+    {
+        putVarint64(dst, expiresAt);
+    }
+    dst.append(value.data(), value.size());
+}
+
+/**
+ * @brief Decodes an entry.
+ * @param entry Encoded entry.
+ * @param parsed Receives the fields.
+ * @return False if the entry is malformed.
+ */
+inline bool parseEntry(std::string_view entry, ParsedEntry &parsed)
+{
+    const char *p = entry.data();
+    const char *end = p + entry.size();
+    if (p == end || (uint8_t)*p > TYPE_EXPIRING_VALUE)
+    {
+        return false;
+    }
+    parsed.type = (ValueType)(uint8_t)*p++;
+    parsed.expiresAt = 0;
+    if (!getVarint64(p, end, parsed.sequence) ||
+        (parsed.type == TYPE_EXPIRING_VALUE && !getVarint64(p, end, parsed.expiresAt)))
+    {
+        return false;
+    }
+    parsed.value = std::string_view(p, (size_t)(end - p));
+    return true;
+}
+
+/**
+ * @brief True if an entry holds no value at a time: it is a deletion or has expired.
+ * @param entry Decoded entry.
+ * @param now Current time in milliseconds since the epoch.
+ */
+inline bool isDeadEntry(const ParsedEntry &entry, uint64_t now)
+{
+    return entry.type == TYPE_DELETION || (entry.type == TYPE_EXPIRING_VALUE && entry.expiresAt <= now);
+}
+
+/**
+ * @brief Appends the entry of a value stored by a table written before entries were typed.
+ *
+ * Such tables store raw values and mark deletions with the value "DELETED";
+ * their entries are older than any sequence number handed out since.
+ *
+ * @param dst Buffer to append to.
+ * @param value Raw value read from the table.
+ */
+inline void encodeLegacyEntry(std::string &dst, std::string_view value)
+{
+    if (value == "DELETED")
+    {
+        encodeEntry(dst, TYPE_DELETION, 0, std::string_view());
+    }
+    else
+    {
+        encodeEntry(dst, TYPE_VALUE, 0, value);
+    }
+}
+
+/**
+ * @brief Deletion of every key in [start, end) written before it.
+ */
+struct RangeTombstone
+{
+    std::string start;           ///< First deleted key
+    std::string end;             ///< Key at which the range ends (exclusive)
+    SequenceNumber sequence = 0; ///< Sequence number of the deletion
+
+    /**
+     * @brief True if the deletion hides an entry of a key from a reader.
+     * @param key Key of the entry.
+     * @param entrySequence Sequence number of the entry.
+     * @param readSequence Sequence number the reader reads at.
+     */
+    bool covers(std::string_view key, SequenceNumber entrySequence, SequenceNumber readSequence) const
+    {
+        return sequence > entrySequence && sequence <= readSequence && key >= start && key < end;
+    }
+};
+
+/**
+ * @brief True if one of several range deletions hides an entry from a reader.
+ * @param tombstones Range deletions to check.
+ * @param key Key of the entry.
+ * @param entrySequence Sequence number of the entry.
+ * @param readSequence Sequence number the reader reads at.
+ */
+inline bool isRangeDeleted(const std::vector<RangeTombstone> &tombstones, std::string_view key,
+                           SequenceNumber entrySequence, SequenceNumber readSequence)
+{
+    for (const RangeTombstone &tombstone : tombstones)
+    {
+        if (tombstone.covers(key, entrySequence, readSequence))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // ENTRY_FORMAT_H
@@ -0,0 +1,59 @@
+#ifndef ITERATOR_H
+#define ITERATOR_H
+
+#include <string_view>
+
+/**
+ * @file iterator.h
+ * @brief Common interface of cursors over sorted key-value sources.
+ */
+
+/**
+ * @brief Cursor over key-value entries in increasing key order.
+ *
+ * The views returned by key() and value() stay valid until the cursor is
+ * moved or destroyed.
+ */
+class KeyValueIterator
+{
+public:
+    virtual ~KeyValueIterator() = default;
+
+    /**
+     * @brief True if the cursor is positioned at an entry.
+     */
+    virtual bool valid() const = 0;
+
+    /**
+     * @brief Positions at the first entry.
+     */
+    virtual void seekToFirst() = 0;
+
+    /**
+     * @brief Positions at the first entry with key >= target.
+     * @param target Key to seek to.
+     */
+    virtual void seek(std::string_view target) = 0;
+
+    /**
+     * @brief Advances to the next entry.
+     */
+    virtual void next() = 0;
+
+    /**
+     * @brief Key of the current entry.
+     */
+    virtual std::string_view key() const = 0;
+
+    /**
+     * @brief Value of the current entry.
+     */
+    virtual std::string_view value() const = 0;
+
+    /**
+     * @brief True if iteration stopped because the source is corrupt.
+     */
+    virtual bool corrupted() const { return false; }
+};
+
+#endif // ITERATOR_H
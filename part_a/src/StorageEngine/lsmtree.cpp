@@ -1,25 +1,181 @@
 #include "lsmtree.h"
+#include "sstable.h"
+#include "table_builder.h"
+#include "merging_iterator.h"
+#include "compression.h"
 #include <iostream>
 #include <filesystem>
-
-/**
- * @brief Directory to store SSTable files.
- */
-const std::string SSTABLE_DIRECTORY = "sstabledata";
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
 
 /**
  * @brief Constructs an LSMTree instance with a specified SSTable directory.
  *
- * Ensures the directory path ends with a separator for consistency.
+ * Ensures the directory path ends with a separator for consistency. Each
+ * LSMTree instance owns its directory, so several trees (e.g. server shards)
+ * can coexist as long as their directories differ.
+ *
+ * Startup restores the previous state of the directory: the SSTables listed
+ * in the manifest are reopened, then writes logged after the last flush are
+ * replayed from the write-ahead logs and flushed, and a new log is started.
  *
- * @param directory The directory where SSTables will be stored.
+ * @param directory The directory where SSTables and the write-ahead log are stored.
+ * @param walSyncMode When logged writes are synced to disk.
+ * @param walSyncIntervalMs Sync period for WalSyncMode::INTERVAL.
+ * @param blockCache Block cache to share, or nullptr for a private one.
  */
-LSMTree::LSMTree(const std::string &directory) : sstableDirectory(directory)
+LSMTree::LSMTree(const std::string &directory, WalSyncMode walSyncMode, unsigned walSyncIntervalMs,
+                 std::shared_ptr<BlockCache> blockCache)
+    : cache(std::move(blockCache)), sstableDirectory(directory)
 {
+    if (!cache)
+    {
+        cache = std::make_shared<BlockCache>();
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        publishReadState();
+    }
+
     if (!sstableDirectory.empty() && sstableDirectory.back() != '/')
     {
         sstableDirectory += '/';
     }
+
+    if (!createSStableDirectory())
+    {
+        std::cerr << "Cannot create directory " << sstableDirectory << "; writes will not be logged" << std::endl;
+        return;
+    }
+
+    openTables();
+
+    size_t replayed = recoverLogs();
+    if (replayed > 0)
+    {
+        std::cout << "Recovered " << replayed << " write(s) from " << sstableDirectory << std::endl;
+    }
+
+    wal.open(sstableDirectory + Manifest::logFileName(logNumber), walSyncMode, walSyncIntervalMs);
+
+    flushThread = std::thread(&LSMTree::flushLoop, this);
+    compactionThread = std::thread(&LSMTree::compactionLoop, this);
+    scheduleCompaction();
+}
+
+/**
+ * @brief Flushes the frozen memtables and stops the background threads.
+ *
+ * The active memtable stays in its log and is recovered by the next start.
+ * A running compaction notices the stop between entries, abandons its
+ * partial output and leaves the table set unchanged.
+ */
+LSMTree::~LSMTree()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        std::lock_guard<std::mutex> compactionLock(compactionMutex);
+        stopping = true;
+    }
+    flushCondition.notify_all();
+    compactionCondition.notify_all();
+    if (flushThread.joinable())
+    {
+        flushThread.join();
+    }
+    if (compactionThread.joinable())
+    {
+        compactionThread.join();
+    }
+    delete readState.load();
+}
+
+/**
+ * @brief Replays the logs of a previous run and flushes their writes.
+ *
+ * Logs older than the manifest's log number were flushed before and are
+ * deleted unread; the remaining ones (and the single log of earlier versions)
+ * are replayed in order into one memtable, which is written to level 0. The
+ * manifest then names the log the tree starts appending to, and the replayed
+ * logs are deleted.
+ *
+ * @return Number of replayed records.
+ */
+size_t LSMTree::recoverLogs()
+{
+    std::vector<std::pair<uint64_t, std::string>> logs;
+    std::error_code ec;
+    if (std::filesystem::exists(sstableDirectory + WAL_FILE_NAME, ec))
+    {
+        logs.emplace_back(0, sstableDirectory + WAL_FILE_NAME);
+    }
+    for (const auto &entry : std::filesystem::directory_iterator(sstableDirectory, ec))
+    {
+        std::string name = entry.path().filename().string();
+        unsigned long long number = 0;
+        char extra = 0;
+        if (std::sscanf(name.c_str(), "wal_%llu.log%c", &number, &extra) == 1 && name == Manifest::logFileName(number))
+        {
+            logs.emplace_back(number, entry.path().string());
+        }
+    }
+    std::sort(logs.begin(), logs.end());
+
+    size_t replayed = 0;
+    for (const auto &log : logs)
+    {
+        if (log.second != sstableDirectory + WAL_FILE_NAME && log.first < manifest.logNumber)
+        {
+            continue;
+        }
+        replayed += WriteAheadLog::replay(log.second, [this](WriteAheadLog::RecordType type, std::string &&key, std::string &&value)
+                                          {
+                                              if (type == WriteAheadLog::RECORD_BATCH)
+                                              {
+                                                  applyBatch(value);
+                                                  return;
+                                              }
+                                              if (type == WriteAheadLog::RECORD_DELETE)
+                                              {
+                                                  apply(key, TYPE_DELETION, std::string_view());
+                                                  return;
+                                              }
+                                              apply(key, TYPE_VALUE, value); });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        logNumber = manifest.nextTableNumber++;
+    }
+    if (!memtable->empty() && !flushMemTable(*memtable, logNumber))
+    {
+        // Keep the logs; the writes are replayed again by the next start
+        std::cerr << "Failed to flush recovered writes; they stay in memory" << std::endl;
+        return replayed;
+    }
+    if (memtable->empty())
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        manifest.logNumber = logNumber;
+        manifest.tables = currentVersion()->tableMetas();
+        manifest.save(sstableDirectory);
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        memtable = std::make_shared<MemTable>();
+        publishReadState();
+    }
+
+    for (const auto &log : logs)
+    {
+        std::filesystem::remove(log.second, ec);
+    }
+    return replayed;
 }
 
 /**
@@ -31,9 +187,9 @@ bool LSMTree::createSStableDirectory()
 {
     try
     {
-        if (!std::filesystem::exists(SSTABLE_DIRECTORY))
+        if (!sstableDirectory.empty() && !std::filesystem::exists(sstableDirectory))
         {
-            return std::filesystem::create_directories(SSTABLE_DIRECTORY);
+            return std::filesystem::create_directories(sstableDirectory);
         }
         return true;
     }
@@ -50,143 +206,1540 @@ bool LSMTree::createSStableDirectory()
 }
 
 /**
- * @brief Inserts a key-value pair into the LSM Tree.
- *
- * If the memtable reaches its maximum size, it is flushed to an SSTable.
+ * @brief Reads the manifest and opens the live SSTables.
  *
- * @param key The key to insert.
- * @param value The corresponding value.
+ * Tables are independent, so they are loaded by a pool of threads (one per
+ * hardware thread) and then arranged in their levels. Tables whose file
+ * cannot be read are dropped from the manifest, and table files the manifest
+ * does not list (output of an interrupted flush or compaction) are deleted.
+ * Sequence numbers resume after the last one written to a table.
  */
-void LSMTree::set(const std::string &key, const std::string &value)
+void LSMTree::openTables()
 {
-    memtable[key] = value;
+    bool rewrite = false;
+    if (!manifest.load(sstableDirectory))
+    {
+        // No manifest: adopt the tables of an older version of the directory
+        manifest = Manifest();
+        try
+        {
+            for (const auto &entry : std::filesystem::directory_iterator(sstableDirectory))
+            {
+                std::string name = entry.path().filename().string();
+                unsigned long long number = 0;
+                char extra = 0;
+                if ((std::sscanf(name.c_str(), "sstable_%llu.sst%c", &number, &extra) == 1 &&
+                     name == Manifest::tableFileName(number)) ||
+                    (std::sscanf(name.c_str(), "sstable_%llu.txt%c", &number, &extra) == 1 &&
+                     name == Manifest::legacyTableFileName(number)))
+                {
+                    TableMeta meta;
+                    meta.number = number;
+                    manifest.tables.push_back(meta);
+                    manifest.nextTableNumber = std::max<uint64_t>(manifest.nextTableNumber, number + 1);
+                }
+            }
+        }
+        catch (const std::filesystem::filesystem_error &e)
+        {
+            std::cerr << "Filesystem error scanning " << sstableDirectory << ": " << e.what() << std::endl;
+        }
+        std::sort(manifest.tables.begin(), manifest.tables.end(), [](const TableMeta &a, const TableMeta &b)
+                  { return a.number < b.number; });
+        rewrite = true;
+    }
+    else
+    {
+        std::vector<uint64_t> liveNumbers;
+        for (const auto &meta : manifest.tables)
+        {
+            liveNumbers.push_back(meta.number);
+        }
+        std::sort(liveNumbers.begin(), liveNumbers.end());
+
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(sstableDirectory, ec))
+        {
+            std::string name = entry.path().filename().string();
+            unsigned long long number = 0;
+            char extra = 0;
+            if (std::sscanf(name.c_str(), "sstable_%llu.sst%c", &number, &extra) == 1 &&
+                name == Manifest::tableFileName(number) &&
+                !std::binary_search(liveNumbers.begin(), liveNumbers.end(), (uint64_t)number))
+            {
+                std::filesystem::remove(entry.path(), ec);
+            }
+        }
+    }
+
+    size_t count = manifest.tables.size();
+    std::vector<std::shared_ptr<TableReader>> loaded(count);
+    std::atomic<size_t> next(0);
+
+    auto work = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            loaded[i] = openTable(manifest.tables[i].number);
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    auto version = std::make_shared<Version>();
+    size_t opened = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!loaded[i])
+        {
+            rewrite = true;
+            continue;
+        }
+
+        auto table = std::make_shared<LiveTable>();
+        table->meta = manifest.tables[i];
+        table->meta.entries = loaded[i]->numEntries();
+        table->meta.smallest = loaded[i]->smallestKey();
+        table->meta.largest = loaded[i]->largestKey();
+        table->reader = std::move(loaded[i]);
+        version->levels[table->meta.level].push_back(std::move(table));
+        ++opened;
+    }
+    for (int level = 1; level < LSM_NUM_LEVELS; ++level)
+    {
+        std::sort(version->levels[level].begin(), version->levels[level].end(),
+                  [](const LiveTablePtr &a, const LiveTablePtr &b)
+                  { return a->meta.smallest < b->meta.smallest; });
+    }
+    manifest.tables = version->tableMetas();
+    version->rangeDeletions = manifest.rangeDeletions;
+    lastSequence.store(manifest.lastSequence, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        current = std::move(version);
+        publishReadState();
+    }
 
-    if (memtable.size() >= MAX_MEMTABLE_SIZE)
+    if (rewrite && (count > 0 || manifest.nextTableNumber > 0))
+    {
+        manifest.save(sstableDirectory);
+    }
+    if (opened > 0)
     {
-        flushMemtableToSSTable();
+        std::cout << "Opened " << opened << " SSTable(s) from " << sstableDirectory << std::endl;
     }
 }
 
 /**
- * @brief Retrieves the value associated with a given key.
+ * @brief Opens a table file.
  *
- * The lookup first checks the memtable, then searches SSTables if necessary.
+ * A table written as text by an earlier version is first rewritten in the
+ * binary format, after which the text file is removed.
  *
- * @param key The key to look up.
- * @return The associated value if found, otherwise "NOT_FOUND".
+ * @param number Table number.
+ * @return The reader, or nullptr if the table cannot be read.
  */
-std::string LSMTree::get(const std::string &key)
+std::shared_ptr<TableReader> LSMTree::openTable(uint64_t number)
 {
-    // std::cout << "KEY IS: " << key << std::endl;
-    auto it = memtable.find(key);
-    if (it != memtable.end())
+    std::string path = sstableDirectory + Manifest::tableFileName(number);
+    std::string legacyPath = sstableDirectory + Manifest::legacyTableFileName(number);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec) && std::filesystem::exists(legacyPath, ec))
+    {
+        SSTable legacy;
+        if (!legacy.loadFromDisk(legacyPath) || !legacy.writeToDisk(path))
+        {
+            return nullptr;
+        }
+        std::filesystem::remove(legacyPath, ec);
+    }
+
+    auto reader = std::make_shared<TableReader>();
+    if (!reader->open(path, cache.get()))
     {
-        return it->second;
+        return nullptr;
     }
+    return reader;
+}
 
-    for (const auto &it : memtable)
+/**
+ * @brief Returns the current table set.
+ *
+ * Used by flushes and compactions; reads find the table set in the read
+ * state instead. The lock is only held to copy the pointer; the caller's
+ * reference keeps the version and its tables alive while it uses them.
+ *
+ * @return The current version.
+ */
+std::shared_ptr<const Version> LSMTree::currentVersion()
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return current;
+}
+
+/**
+ * @brief Publishes the memtables and the current table set as the new read state.
+ *
+ * Readers load the state pointer under a guard of readEpoch; once the
+ * pointer is swapped, waiting for the epoch guarantees that no reader still
+ * uses the previous state, which is freed. The caller holds stateMutex, so
+ * the previous state cannot be replaced twice.
+ */
+void LSMTree::publishReadState()
+{
+    auto state = new ReadState();
+    state->memtables.push_back(memtable);
+    for (auto imm = immutables.rbegin(); imm != immutables.rend(); ++imm)
     {
-        std::cout << "Key: " << it.first << " Value: " << it.second << std::endl;
+        state->memtables.push_back(imm->table);
     }
+    state->version = current;
 
-    for (const auto &sstable : sstables)
+    ReadState *previous = readState.exchange(state);
+    if (previous != nullptr)
     {
-        if (sstable.bloomFilter.mightContain(key))
-        {
-            auto sstableIt = sstable.data.find(key);
-            if (sstableIt != sstable.data.end())
-            {
-                return sstableIt->second;
-            }
-        }
+        readEpoch.synchronize();
+        delete previous;
     }
-    return "NOT_FOUND";
 }
 
 /**
- * @brief Retrieves all key-value pairs from the memtable.
- *
- * Iterates through the in-memory memtable and collects all non-deleted keys
- * and their corresponding values into a single flat vector. This format is
- * ideal for serialization into a RESP array.
+ * @brief Sequence number up to which a read of a state sees writes.
  *
- * For example: { "key1": "val1", "key2": "val2" } becomes [ "key1", "val1", "key2", "val2" ]
+ * Once the active memtable of a state is frozen, later writes go to a
+ * memtable the state does not hold, so the visible sequence number is capped
+ * at the last write of the frozen one. The cap is read after the sequence
+ * number: a write past it is published after the cap is set.
  *
- * @return A vector of strings containing interleaved keys and values.
+ * @param state Read state loaded under a guard of readEpoch.
+ * @return The sequence number.
  */
-std::vector<std::string> LSMTree::getAllKeyValuePairs()
+SequenceNumber LSMTree::visibleSequence(const ReadState &state) const
 {
-    std::vector<std::string> results;
-    // Reserve space to avoid multiple reallocations, assuming memtable is a std::map or similar.
-    results.reserve(memtable.size() * 2);
+    SequenceNumber sequence = lastSequence.load(std::memory_order_acquire);
+    return std::min(sequence, state.frozenAt.load(std::memory_order_acquire));
+}
 
-    for (const auto &pair : memtable)
+/**
+ * @brief Records a new table set in the manifest and publishes it.
+ *
+ * The caller holds manifestMutex, so no other change can slip in between
+ * reading the current version and replacing it.
+ *
+ * @param version The new table set.
+ * @return True if the manifest was written; otherwise the current version is kept.
+ */
+bool LSMTree::installVersion(std::shared_ptr<const Version> version)
+{
+    manifest.tables = version->tableMetas();
+    manifest.rangeDeletions = version->rangeDeletions;
+    if (!manifest.save(sstableDirectory))
     {
-        // Check for the tombstone marker
-        if (pair.second != "DELETED")
-        {
-            results.push_back(pair.first);  // Push the key
-            results.push_back(pair.second); // Push the value
-        }
+        std::shared_ptr<const Version> previous = currentVersion();
+        manifest.tables = previous->tableMetas();
+        manifest.rangeDeletions = previous->rangeDeletions;
+        return false;
     }
 
-    return results;
+    std::lock_guard<std::mutex> lock(stateMutex);
+    current = std::move(version);
+    publishReadState();
+    return true;
 }
 
 /**
- * @brief Marks a key as deleted by inserting a tombstone marker.
+ * @brief Inserts a key-value pair into the LSM Tree.
  *
- * If the memtable reaches its maximum size, it is flushed to an SSTable.
+ * The write goes through the write queue as a batch of one.
  *
- * @param key The key to remove.
+ * @param key The key to insert.
+ * @param value The corresponding value.
+ * @param expiresAt Time in milliseconds since the epoch at which the key is deleted, or 0 for never.
+ * @return False if the write could not be logged; it is then not applied.
+ */
+bool LSMTree::set(const std::string &key, const std::string &value, uint64_t expiresAt)
+{
+    WriteBatch batch;
+    batch.put(key, value, expiresAt);
+    return write(batch);
+}
+
+/**
+ * @brief Adds one write to the memtable and publishes it.
+ *
+ * The write gets the next sequence number, which becomes visible to readers
+ * once the write is in the memtable. Used to replay the single-write records
+ * of logs written before writes were grouped.
+ *
+ * @param key Key to write.
+ * @param type TYPE_VALUE for a put, TYPE_DELETION for a delete.
+ * @param value New value (empty for deletions).
  */
-void LSMTree::remove(const std::string &key)
+void LSMTree::apply(std::string_view key, ValueType type, std::string_view value)
 {
-    memtable[key] = "DELETED";
+    SequenceNumber sequence = lastSequence.load(std::memory_order_relaxed) + 1;
+    memtable->put(key, type, value, sequence);
+    lastSequence.store(sequence, std::memory_order_release);
+}
 
-    if (memtable.size() >= MAX_MEMTABLE_SIZE)
+/**
+ * @brief Searches the tables of a version for a key.
+ *
+ * Tables whose key range excludes the key are skipped before their Bloom
+ * filter is probed. Level-0 ranges overlap and are checked one by one, newest
+ * first; on each deeper level a binary search over the ranges picks the only
+ * table that can hold the key, so a lookup probes at most one filter per level.
+ *
+ * @param version Table set to search.
+ * @param key The key to look up.
+ * @param entry Receives the newest entry of the key.
+ * @return True if a table holds the key.
+ */
+static bool getFromTables(const Version &version, std::string_view key, std::string &entry)
+{
+    for (auto table = version.levels[0].rbegin(); table != version.levels[0].rend(); ++table)
     {
-        flushMemtableToSSTable();
+        const TableMeta &meta = (*table)->meta;
+        if (key < std::string_view(meta.smallest) || key > std::string_view(meta.largest))
+        {
+            continue;
+        }
+        if ((*table)->reader->get(key, entry))
+        {
+            return true;
+        }
+    }
+    for (int level = 1; level < LSM_NUM_LEVELS; ++level)
+    {
+        LiveTablePtr table = version.tableForKey(level, key);
+        if (table && table->reader->get(key, entry))
+        {
+            return true;
+        }
     }
+    return false;
 }
 
 /**
- * @brief Flushes the memtable to SSTables on disk.
+ * @brief Turns the newest entry of a key into the value a read returns.
  *
- * The memtable entries are sorted and split into multiple SSTables
- * if the data size exceeds the maximum SSTable limit.
+ * The entry is live unless it is a deletion, an expired value, or a range
+ * deletion of one of the read's sources, newer than the entry and visible to
+ * the read, covers the key. Expiry is judged by the clock at the time of the
+ * read, which is only consulted for expiring values. The value is cut out of
+ * the entry in place.
+ *
+ * @param entry Newest entry of the key; receives its value if live.
+ * @param key Key of the entry.
+ * @param memtables Memtables of the read.
+ * @param version Table set of the read.
+ * @param sequence Sequence number the read reads at.
+ * @param expiresAt If not null, receives the expiry time of a live value (0 if it never expires).
+ * @return True if the key is live.
  */
-void LSMTree::flushMemtableToSSTable()
+static bool liveValue(std::string &entry, std::string_view key,
+                      const std::vector<std::shared_ptr<const MemTable>> &memtables, const Version &version,
+                      SequenceNumber sequence, uint64_t *expiresAt = nullptr)
 {
-    SSTable newSSTable;
-
-    for (const auto &entry : memtable)
+    ParsedEntry parsed;
+    if (!parseEntry(entry, parsed) || parsed.type == TYPE_DELETION ||
+        (parsed.type == TYPE_EXPIRING_VALUE && parsed.expiresAt <= currentTimeMillis()) ||
+        isRangeDeleted(version.rangeDeletions, key, parsed.sequence, sequence))
+    {
+        return false;
+    }
+    for (const auto &table : memtables)
+    {
+        if (table->isRangeDeleted(key, parsed.sequence, sequence))
+        {
+            return false;
+        }
+    }
+    if (expiresAt != nullptr)
     {
-        newSSTable.addEntry(entry.first, entry.second);
+        *expiresAt = parsed.expiresAt;
+    }
+    entry.erase(0, entry.size() - parsed.value.size());
+    return true;
+}
 
-        if (newSSTable.data.size() >= MAX_SSTABLE_SIZE)
+/**
+ * @brief Looks up a key in the sources of a read.
+ * @param memtables Memtables to search, newest first.
+ * @param version Table set to search.
+ * @param key The key to look up.
+ * @param sequence Sequence number to read at.
+ * @param value Receives the value of the key.
+ * @param expiresAt If not null, receives the expiry time of the value (0 if it never expires).
+ * @return True if the key is live.
+ */
+static bool lookup(const std::vector<std::shared_ptr<const MemTable>> &memtables, const Version &version,
+                   std::string_view key, SequenceNumber sequence, std::string &value, uint64_t *expiresAt = nullptr)
+{
+    bool found = false;
+    for (const auto &table : memtables)
+    {
+        if (table->get(key, value, sequence))
         {
-            writeSSTableToDisk(newSSTable);
-            newSSTable.data.clear();
+            found = true;
+            break;
         }
     }
+    if (!found)
+    {
+        found = getFromTables(version, key, value);
+    }
+    return found && liveValue(value, key, memtables, version, sequence, expiresAt);
+}
+
+/**
+ * @brief Retrieves the value associated with a given key.
+ *
+ * The lookup first checks the memtable and the frozen memtables awaiting
+ * their flush (newest first), then the SSTables from newest to oldest:
+ * level-0 tables in reverse flush order, then each deeper level. A flush
+ * installs its tables before it drops the frozen memtable, so a key is
+ * always found in one or the other. The first entry found is the newest
+ * version of the key; the key is deleted if that entry is a tombstone or a
+ * newer range deletion covers it.
+ *
+ * Memtables are read at the last published sequence number (or that of the
+ * snapshot), so a write still being applied, or a batch partially applied,
+ * is not seen. Tables only hold writes older than any memtable entry.
+ *
+ * Without a snapshot, the sources are those of the current read state,
+ * loaded under a guard of the read epoch, so the lookup takes no lock and
+ * no reference count.
+ *
+ * @param key The key to look up.
+ * @param snapshot View to read, or nullptr for the latest writes.
+ * @return The associated value if found, otherwise "NOT_FOUND".
+ */
+std::string LSMTree::get(std::string_view key, const std::shared_ptr<const Snapshot> &snapshot)
+{
+    std::string value;
+    bool found;
+    if (snapshot)
+    {
+        found = lookup(snapshot->memtables, *snapshot->version, key, snapshot->seq, value);
+    }
+    else
+    {
+        ReadEpoch::Guard guard(readEpoch);
+        const ReadState *state = readState.load();
+        found = lookup(state->memtables, *state->version, key, visibleSequence(*state), value);
+    }
+    if (!found)
+    {
+        return "NOT_FOUND";
+    }
+    return value;
+}
+
+/**
+ * @brief Retrieves the expiry time of a key.
+ *
+ * The lookup is that of get(), without a snapshot.
+ *
+ * @param key The key to look up.
+ * @param expiresAt Receives the expiry time in milliseconds since the epoch, or 0 if the key never expires.
+ * @return False if the key is not live.
+ */
+bool LSMTree::getExpiry(std::string_view key, uint64_t &expiresAt)
+{
+    std::string value;
+    ReadEpoch::Guard guard(readEpoch);
+    const ReadState *state = readState.load();
+    return lookup(state->memtables, *state->version, key, visibleSequence(*state), value, &expiresAt);
+}
 
-    if (!newSSTable.data.empty())
+/**
+ * @brief Changes the expiry time of a live key.
+ *
+ * The value is read and written back with the new expiry time. The two
+ * steps are not atomic: a write of the key made in between is overwritten
+ * by the value read, so callers serialize the writes of a key with this
+ * call, as the server's shards do.
+ *
+ * @param key Key to change.
+ * @param expiresAt New expiry time in milliseconds since the epoch, or 0 to keep the key until overwritten.
+ * @return UPDATED, NOT_FOUND if the key is not live, or WRITE_FAILED if the write could not be logged.
+ */
+ExpireStatus LSMTree::expire(const std::string &key, uint64_t expiresAt)
+{
+    std::string value;
     {
-        writeSSTableToDisk(newSSTable);
+        ReadEpoch::Guard guard(readEpoch);
+        const ReadState *state = readState.load();
+        if (!lookup(state->memtables, *state->version, key, visibleSequence(*state), value))
+        {
+            return ExpireStatus::NOT_FOUND;
+        }
     }
+    return set(key, value, expiresAt) ? ExpireStatus::UPDATED : ExpireStatus::WRITE_FAILED;
+}
 
-    memtable.clear();
+/**
+ * @brief Takes a point-in-time view of the tree.
+ *
+ * The snapshot copies the memtables and table set of the current read state,
+ * which together hold every write up to the state's visible sequence number.
+ * No lock is taken.
+ *
+ * @return The snapshot.
+ */
+std::shared_ptr<const Snapshot> LSMTree::getSnapshot()
+{
+    auto snapshot = std::make_shared<Snapshot>();
+    ReadEpoch::Guard guard(readEpoch);
+    const ReadState *state = readState.load();
+    snapshot->seq = visibleSequence(*state);
+    snapshot->memtables = state->memtables;
+    snapshot->version = state->version;
+    return snapshot;
 }
 
 /**
- * @brief Writes an SSTable to disk and adds it to the list of SSTables.
+ * @brief Looks up several keys at once.
  *
- * @param sstable The SSTable to be persisted.
+ * All keys are read from one snapshot, the given one or one taken for the
+ * call. The keys are sorted and searched in the same order as by get(), but each
+ * source is searched for all keys still unresolved in one pass: the
+ * memtables key by key, then each level-0 table with the keys inside its
+ * range and, on each deeper level, every table with the run of keys between
+ * its smallest and largest key. A key is resolved by the first source that
+ * holds it, tombstones included, and its entry is then checked as by get().
+ *
+ * @param keys Keys to look up, in any order.
+ * @return The value of each key in the order of keys, or std::nullopt where get() finds none.
  */
-void LSMTree::writeSSTableToDisk(SSTable &sstable)
+std::vector<std::optional<std::string>> LSMTree::multiGet(const std::vector<std::string_view> &keys,
+                                                          const std::shared_ptr<const Snapshot> &snapshot)
 {
-    std::string filename = SSTABLE_DIRECTORY + "/sstable_" + std::to_string(sstableCounter++) + ".txt";
-    sstable.writeToDisk(filename);
-    sstables.push_back(sstable);
-}
\ No newline at end of file
+    std::shared_ptr<const Snapshot> view = snapshot ? snapshot : getSnapshot();
+    std::vector<std::string> values(keys.size());
+    std::vector<char> resolved(keys.size(), 0);
+
+    // Positions of the unresolved keys, in key order
+    std::vector<size_t> pending(keys.size());
+    std::iota(pending.begin(), pending.end(), 0);
+    std::sort(pending.begin(), pending.end(), [&](size_t a, size_t b)
+              { return keys[a] < keys[b]; });
+
+    auto dropResolved = [&]()
+    {
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&](size_t i)
+                                     { return resolved[i] != 0; }),
+                      pending.end());
+    };
+
+    auto searchMemTable = [&](const MemTable &table)
+    {
+        for (size_t i : pending)
+        {
+            resolved[i] = table.get(keys[i], values[i], view->seq);
+        }
+        dropResolved();
+    };
+
+    std::vector<std::string_view> batchKeys;
+    std::vector<std::string> batchValues;
+    std::vector<char> batchFound;
+    // Searches a table for the pending keys within its range; they are resolved by dropResolved()
+    auto searchTable = [&](const LiveTable &table)
+    {
+        auto first = std::lower_bound(pending.begin(), pending.end(), std::string_view(table.meta.smallest),
+                                      [&](size_t i, std::string_view k)
+                                      { return keys[i] < k; });
+        auto last = std::upper_bound(first, pending.end(), std::string_view(table.meta.largest),
+                                     [&](std::string_view k, size_t i)
+                                     { return k < keys[i]; });
+        if (first == last)
+        {
+            return;
+        }
+
+        batchKeys.clear();
+        for (auto it = first; it != last; ++it)
+        {
+            batchKeys.push_back(keys[*it]);
+        }
+        batchValues.assign(batchKeys.size(), std::string());
+        batchFound.assign(batchKeys.size(), 0);
+        if (table.reader->multiGet(batchKeys, batchValues, batchFound) == 0)
+        {
+            return;
+        }
+        for (size_t j = 0; j < batchKeys.size(); ++j)
+        {
+            if (batchFound[j])
+            {
+                size_t i = first[j];
+                values[i] = std::move(batchValues[j]);
+                resolved[i] = 1;
+            }
+        }
+    };
+
+    for (const auto &table : view->memtables)
+    {
+        if (pending.empty())
+        {
+            break;
+        }
+        searchMemTable(*table);
+    }
+
+    const std::shared_ptr<const Version> &version = view->version;
+    for (auto table = version->levels[0].rbegin(); table != version->levels[0].rend() && !pending.empty(); ++table)
+    {
+        searchTable(**table);
+        dropResolved();
+    }
+    for (int level = 1; level < LSM_NUM_LEVELS && !pending.empty(); ++level)
+    {
+        // Tables of a level are disjoint, so each key is searched in at most one
+        for (const LiveTablePtr &table : version->levels[level])
+        {
+            searchTable(*table);
+        }
+        dropResolved();
+    }
+
+    std::vector<std::optional<std::string>> results(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (resolved[i] && liveValue(values[i], keys[i], view->memtables, *version, view->seq))
+        {
+            results[i] = std::move(values[i]);
+        }
+    }
+    return results;
+}
+
+/**
+ * @brief Retrieves all key-value pairs stored in the tree.
+ *
+ * Walks a cursor over the memtables and SSTables (see newIterator()) and
+ * collects all live keys and their corresponding values into a single flat
+ * vector in key order. This format is ideal for serialization into a RESP array.
+ *
+ * For example: { "key1": "val1", "key2": "val2" } becomes [ "key1", "val1", "key2", "val2" ]
+ *
+ * @return A vector of strings containing interleaved keys and values.
+ */
+std::vector<std::string> LSMTree::getAllKeyValuePairs()
+{
+    return getRange(std::string_view(), std::string_view(), SIZE_MAX);
+}
+
+/**
+ * @brief Cursor over the live keys of a tree.
+ *
+ * Wraps the merge of all sources, skips deleted keys and stops at the upper
+ * bound. A key is deleted if its newest entry is a tombstone, a value that
+ * expired before the cursor was created, or a range deletion of the snapshot
+ * newer than the entry covers it. It holds the
+ * snapshot it reads, which pins the memtables and the version and is
+ * declared before the merge so that it outlives its children.
+ */
+class TreeIterator : public KeyValueIterator
+{
+private:
+    std::shared_ptr<const Snapshot> snapshot;
+    std::string upperBound;
+    std::vector<RangeTombstone> rangeDeletions; ///< Range deletions of all sources visible in the snapshot
+    uint64_t now;                               ///< Time against which expiry is judged
+    MergingIterator merged;
+    std::string_view currentValue;
+
+    /**
+     * @brief Moves past deleted keys, stopping at the upper bound.
+     */
+    void skipDeleted()
+    {
+        for (; merged.valid() && (upperBound.empty() || merged.key() < upperBound); merged.next())
+        {
+            ParsedEntry entry;
+            if (parseEntry(merged.value(), entry) && !isDeadEntry(entry, now) &&
+                !isRangeDeleted(rangeDeletions, merged.key(), entry.sequence, snapshot->sequence()))
+            {
+                currentValue = entry.value;
+                return;
+            }
+        }
+    }
+
+public:
+    TreeIterator(std::shared_ptr<const Snapshot> view, std::string_view bound,
+                 std::vector<RangeTombstone> tombstones, std::vector<std::unique_ptr<KeyValueIterator>> children)
+        : snapshot(std::move(view)), upperBound(bound), rangeDeletions(std::move(tombstones)),
+          now(currentTimeMillis()), merged(std::move(children))
+    {
+    }
+
+    bool valid() const override { return merged.valid() && (upperBound.empty() || merged.key() < upperBound); }
+    bool corrupted() const override { return merged.corrupted(); }
+    std::string_view key() const override { return merged.key(); }
+    std::string_view value() const override { return currentValue; }
+
+    void seekToFirst() override
+    {
+        merged.seekToFirst();
+        skipDeleted();
+    }
+
+    void seek(std::string_view target) override
+    {
+        merged.seek(target);
+        skipDeleted();
+    }
+
+    void next() override
+    {
+        merged.next();
+        skipDeleted();
+    }
+};
+
+/**
+ * @brief Returns a cursor over the live keys of the tree in key order.
+ *
+ * The sources are merged newest first: the memtables of the snapshot from
+ * newest to oldest, level-0 tables in reverse flush order and one cursor per
+ * deeper level, so the merge keeps the version of every key visible at the
+ * snapshot. The range deletions of the memtables and the version are copied
+ * into the cursor.
+ *
+ * @param upperBound Key at which the cursor stops (exclusive), or empty for none.
+ * @param snapshot Snapshot to read, or nullptr for one taken now.
+ * @return A new, unpositioned cursor.
+ */
+std::unique_ptr<KeyValueIterator> LSMTree::newIterator(std::string_view upperBound,
+                                                       std::shared_ptr<const Snapshot> snapshot)
+{
+    std::shared_ptr<const Snapshot> view = snapshot ? std::move(snapshot) : getSnapshot();
+    const Version &version = *view->version;
+
+    std::vector<RangeTombstone> rangeDeletions;
+    for (const RangeTombstone &tombstone : version.rangeDeletions)
+    {
+        if (tombstone.sequence <= view->seq)
+        {
+            rangeDeletions.push_back(tombstone);
+        }
+    }
+    std::vector<std::unique_ptr<KeyValueIterator>> children;
+    for (auto table = view->memtables.rbegin(); table != view->memtables.rend(); ++table)
+    {
+        (*table)->rangeDeletions(view->seq, rangeDeletions);
+    }
+    for (const auto &table : view->memtables)
+    {
+        children.push_back(table->newIterator(view->seq));
+    }
+    for (auto table = version.levels[0].rbegin(); table != version.levels[0].rend(); ++table)
+    {
+        children.push_back((*table)->reader->newIterator());
+    }
+    for (int level = 1; level < LSM_NUM_LEVELS; ++level)
+    {
+        if (!version.levels[level].empty())
+        {
+            children.push_back(version.newLevelIterator(level));
+        }
+    }
+    return std::make_unique<TreeIterator>(std::move(view), upperBound, std::move(rangeDeletions), std::move(children));
+}
+
+/**
+ * @brief Retrieves the live keys in [start, end), at most limit of them.
+ *
+ * A range read stops at a corrupt table after reporting it, returning the
+ * keys read so far.
+ *
+ * @param start First key of the range.
+ * @param end Key at which the range ends (exclusive), or empty for none.
+ * @param limit Maximum number of keys returned.
+ * @param withValues True to follow each key by its value.
+ * @return Keys in order, interleaved with their values if requested.
+ */
+std::vector<std::string> LSMTree::getRange(std::string_view start, std::string_view end, size_t limit, bool withValues)
+{
+    std::vector<std::string> results;
+    std::unique_ptr<KeyValueIterator> it = newIterator(end);
+    for (it->seek(start); it->valid() && limit > 0; it->next(), --limit)
+    {
+        results.emplace_back(it->key());
+        if (withValues)
+        {
+            results.emplace_back(it->value());
+        }
+    }
+    if (it->corrupted())
+    {
+        std::cerr << "Range read in " << sstableDirectory << " stopped on a corrupt table" << std::endl;
+    }
+    return results;
+}
+
+/**
+ * @brief Marks a key as deleted by inserting a tombstone.
+ *
+ * The write goes through the write queue as a batch of one.
+ *
+ * @param key The key to remove.
+ * @return False if the write could not be logged; it is then not applied.
+ */
+bool LSMTree::remove(const std::string &key)
+{
+    WriteBatch batch;
+    batch.remove(key);
+    return write(batch);
+}
+
+/**
+ * @brief Deletes every key in [start, end) with a single range tombstone.
+ *
+ * The cost of the write does not depend on the number of keys deleted;
+ * their entries are dropped later by compactions.
+ *
+ * @param start First key to delete.
+ * @param end Key at which the range ends (exclusive).
+ * @return False if the write could not be logged; it is then not applied.
+ */
+bool LSMTree::removeRange(const std::string &start, const std::string &end)
+{
+    if (start >= end)
+    {
+        return true;
+    }
+    WriteBatch batch;
+    batch.removeRange(start, end);
+    return write(batch);
+}
+
+/**
+ * @brief Applies a batch of writes.
+ *
+ * The caller joins the write queue and waits until it reaches the head or
+ * another writer has written its batch. The head becomes the leader of a
+ * group: it merges the batches queued behind it, up to
+ * MAX_WRITE_GROUP_BYTES, logs the group as one record and applies it to the
+ * memtable, where readers see it once it is applied entirely. Only the
+ * leader touches the log and the memtable, and the queue lock is released
+ * meanwhile so that more writers can queue up for the next group. If the
+ * group cannot be logged it is not applied, and every writer in it fails.
+ * The leader finally makes room for the next group, then hands the head over.
+ *
+ * @param batch Puts, deletes and range deletes to apply.
+ * @return False if the batch could not be logged; it is then not applied.
+ */
+bool LSMTree::write(const WriteBatch &batch)
+{
+    if (batch.count() == 0)
+    {
+        return true;
+    }
+
+    Writer self(&batch);
+    std::unique_lock<std::mutex> lock(writeMutex);
+    writers.push_back(&self);
+    self.wakeup.wait(lock, [&]
+                     { return self.done || writers.front() == &self; });
+    if (self.done)
+    {
+        return self.ok;
+    }
+
+    WriteBatch merged;
+    const WriteBatch *group = &batch;
+    size_t groupSize = 1;
+    size_t groupBytes = batch.contents().size();
+    for (auto it = writers.begin() + 1; it != writers.end() && groupBytes < MAX_WRITE_GROUP_BYTES; ++it)
+    {
+        if (group == &batch)
+        {
+            merged.append(batch);
+            group = &merged;
+        }
+        merged.append(*(*it)->batch);
+        groupBytes += (*it)->batch->contents().size();
+        ++groupSize;
+    }
+    lock.unlock();
+
+    bool ok = wal.append(WriteAheadLog::RECORD_BATCH, std::string_view(), group->contents());
+    if (ok)
+    {
+        applyBatch(group->contents());
+        makeRoomForWrite();
+    }
+
+    lock.lock();
+    for (size_t i = 0; i < groupSize; ++i)
+    {
+        Writer *writer = writers.front();
+        writers.pop_front();
+        if (writer != &self)
+        {
+            writer->ok = ok;
+            writer->done = true;
+            writer->wakeup.notify_one();
+        }
+    }
+    if (!writers.empty())
+    {
+        writers.front()->wakeup.notify_one();
+    }
+    return ok;
+}
+
+/**
+ * @brief Applies the operations of an encoded batch to the memtable and publishes them together.
+ *
+ * The operations get consecutive sequence numbers, and the last sequence
+ * number is published once all of them are in the memtable, so readers see
+ * either none or all of the batch.
+ *
+ * @param contents Encoded batch.
+ */
+void LSMTree::applyBatch(std::string_view contents)
+{
+    SequenceNumber sequence = lastSequence.load(std::memory_order_relaxed);
+    if (!WriteBatch::iterate(contents, [&](WriteBatch::OpType type, std::string_view key, std::string_view value,
+                                           uint64_t expiresAt)
+                             {
+                                 switch (type)
+                                 {
+                                 case WriteBatch::OP_DELETE_RANGE:
+                                     memtable->deleteRange(key, value, ++sequence);
+                                     break;
+                                 case WriteBatch::OP_PUT_EXPIRING:
+                                     memtable->put(key, TYPE_EXPIRING_VALUE, value, ++sequence, expiresAt);
+                                     break;
+                                 case WriteBatch::OP_PUT:
+                                     memtable->put(key, TYPE_VALUE, value, ++sequence);
+                                     break;
+                                 case WriteBatch::OP_DELETE:
+                                     memtable->put(key, TYPE_DELETION, value, ++sequence);
+                                     break;
+                                 } }))
+    {
+        std::cerr << "Malformed write batch in " << sstableDirectory << std::endl;
+    }
+    lastSequence.store(sequence, std::memory_order_release);
+}
+
+/**
+ * @brief Freezes the memtable once it reaches its maximum size.
+ *
+ * The full memtable joins the queue of the flush thread together with its
+ * log, and writes continue in a fresh memtable and log. Only when
+ * MAX_IMMUTABLE_MEMTABLES memtables are already queued does the writer wait
+ * for a flush to finish. The read state holding the full memtable as active
+ * one is capped at its last write before the new state is published.
+ */
+void LSMTree::makeRoomForWrite()
+{
+    if (memtable->size() < MAX_MEMTABLE_SIZE || !flushThread.joinable())
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    if (immutables.size() >= MAX_IMMUTABLE_MEMTABLES)
+    {
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        flushDone.wait(lock, [this]
+                       { return immutables.size() < MAX_IMMUTABLE_MEMTABLES; });
+    }
+    lock.unlock();
+
+    uint64_t newLogNumber;
+    {
+        std::lock_guard<std::mutex> manifestLock(manifestMutex);
+        newLogNumber = manifest.nextTableNumber++;
+    }
+    if (!wal.rotate(sstableDirectory + Manifest::logFileName(newLogNumber)))
+    {
+        // Keep writing to the current log; the memtable grows until a rotation succeeds
+        return;
+    }
+
+    lock.lock();
+    readState.load()->frozenAt.store(lastSequence.load(std::memory_order_relaxed), std::memory_order_release);
+    immutables.push_back(ImmutableMemTable{std::move(memtable), logNumber});
+    memtable = std::make_shared<MemTable>();
+    logNumber = newLogNumber;
+    publishReadState();
+    lock.unlock();
+    flushCondition.notify_one();
+}
+
+/**
+ * @brief Body of the flush thread.
+ *
+ * Flushes frozen memtables oldest first. After a memtable's tables are
+ * installed it is dropped and its log deleted; the manifest's log number then
+ * names the oldest log still needed. A failed flush is retried after a pause.
+ * On shutdown the queue is drained before the thread exits.
+ */
+void LSMTree::flushLoop()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true)
+    {
+        flushCondition.wait(lock, [this]
+                            { return !immutables.empty() || stopping; });
+        if (immutables.empty())
+        {
+            return;
+        }
+
+        ImmutableMemTable imm = immutables.front();
+        uint64_t minLogNumber = immutables.size() > 1 ? immutables[1].logNumber : logNumber;
+        lock.unlock();
+
+        bool ok = flushMemTable(*imm.table, minLogNumber);
+        if (ok)
+        {
+            std::error_code ec;
+            std::filesystem::remove(sstableDirectory + Manifest::logFileName(imm.logNumber), ec);
+            scheduleCompaction();
+        }
+
+        lock.lock();
+        if (ok)
+        {
+            immutables.pop_front();
+            publishReadState();
+            flushDone.notify_all();
+        }
+        else if (stopping)
+        {
+            return; // The logs are kept and replayed by the next start
+        }
+        else
+        {
+            flushCondition.wait_for(lock, std::chrono::seconds(1));
+        }
+    }
+}
+
+/**
+ * @brief Adds an entry to a table being written and accounts for it in the table's metadata.
+ *
+ * A value that expired by the given time is written as a deletion with the
+ * value's sequence number, which sheds the value but still hides the older
+ * versions of the key in deeper tables.
+ *
+ * @param builder Table being written.
+ * @param key Key of the entry.
+ * @param value Encoded entry.
+ * @param entry Decoded entry.
+ * @param now Time against which expiry is judged.
+ * @param meta Receives the smallest sequence number and earliest expiry of the table's entries.
+ */
+static void addTableEntry(TableBuilder &builder, std::string_view key, std::string_view value,
+                          const ParsedEntry &entry, uint64_t now, TableMeta &meta)
+{
+    meta.smallestSequence = std::min(meta.smallestSequence, entry.sequence);
+    if (entry.type != TYPE_EXPIRING_VALUE)
+    {
+        builder.add(key, value);
+    }
+    else if (entry.expiresAt <= now)
+    {
+        std::string tombstone;
+        encodeEntry(tombstone, TYPE_DELETION, entry.sequence, std::string_view());
+        builder.add(key, tombstone);
+    }
+    else
+    {
+        builder.add(key, value);
+        if (meta.earliestExpiry == 0 || entry.expiresAt < meta.earliestExpiry)
+        {
+            meta.earliestExpiry = entry.expiresAt;
+        }
+    }
+}
+
+/**
+ * @brief Writes a memtable to level-0 tables and installs them.
+ *
+ * Entries are written in key order to tables of at most MAX_SSTABLE_SIZE
+ * entries, leaving out those hidden by the memtable's own range deletions
+ * and writing expired values as deletions; the range deletions join the
+ * version, where they hide the older entries of every table. The tables, range deletions, new log number and last sequence
+ * number are recorded in the manifest in one update. If a table cannot be
+ * written its partial output is deleted.
+ *
+ * @param table Memtable to write.
+ * @param minLogNumber Oldest log still needed once the tables are installed.
+ * @return True if the tables are installed.
+ */
+bool LSMTree::flushMemTable(const MemTable &table, uint64_t minLogNumber)
+{
+    std::vector<RangeTombstone> rangeDeletions;
+    table.rangeDeletions(MAX_SEQUENCE_NUMBER, rangeDeletions);
+    SequenceNumber largestSequence = 0;
+    for (const RangeTombstone &tombstone : rangeDeletions)
+    {
+        largestSequence = std::max(largestSequence, tombstone.sequence);
+    }
+
+    std::vector<LiveTablePtr> outputs;
+    MemTable::Iterator it(&table);
+    ParsedEntry entry;
+    uint64_t now = currentTimeMillis();
+    // Moves to the next entry not hidden by a range deletion, parsing it
+    auto skipHidden = [&]()
+    {
+        for (; it.valid(); it.next())
+        {
+            parseEntry(it.value(), entry);
+            largestSequence = std::max(largestSequence, entry.sequence);
+            if (!table.isRangeDeleted(it.key(), entry.sequence, MAX_SEQUENCE_NUMBER))
+            {
+                return;
+            }
+        }
+    };
+
+    it.seekToFirst();
+    skipHidden();
+    while (it.valid())
+    {
+        TableBuilder builder;
+        uint64_t number = 0;
+        TableMeta meta;
+        meta.smallestSequence = MAX_SEQUENCE_NUMBER;
+        bool ok = startTable(builder, 0, number);
+        for (; ok && it.valid() && builder.numEntries() < MAX_SSTABLE_SIZE; it.next(), skipHidden())
+        {
+            addTableEntry(builder, it.key(), it.value(), entry, now, meta);
+        }
+
+        if (!ok || !finishTable(builder, number, 0, meta, outputs))
+        {
+            std::cerr << "Memtable flush failed; keeping " << table.size() << " entries in memory" << std::endl;
+            discardTables(outputs);
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    auto version = std::make_shared<Version>(*currentVersion());
+    version->levels[0].insert(version->levels[0].end(), outputs.begin(), outputs.end());
+    version->rangeDeletions.insert(version->rangeDeletions.end(), rangeDeletions.begin(), rangeDeletions.end());
+    uint64_t previousLogNumber = manifest.logNumber;
+    SequenceNumber previousSequence = manifest.lastSequence;
+    manifest.logNumber = minLogNumber;
+    manifest.lastSequence = std::max(manifest.lastSequence, largestSequence);
+    if (!installVersion(std::move(version)))
+    {
+        manifest.logNumber = previousLogNumber;
+        manifest.lastSequence = previousSequence;
+        discardTables(outputs);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the block codec of tables written to a level.
+ *
+ * Levels above SSTABLE_DEEP_LEVEL are rewritten often and favour a fast
+ * codec; deeper levels hold most of the data and favour a denser one. A
+ * configured codec that is not built in falls back to the built-in one.
+ *
+ * @param level Level of the table.
+ * @return The codec.
+ */
+static const BlockCodec *codecForLevel(int level)
+{
+    const BlockCodec *codec = findBlockCodec(level >= SSTABLE_DEEP_LEVEL ? SSTABLE_DEEP_COMPRESSION : SSTABLE_COMPRESSION);
+    return codec != nullptr ? codec : findBlockCodec(BLOCK_LZ);
+}
+
+/**
+ * @brief Allocates a table number and creates its file.
+ * @param builder Builder to open.
+ * @param level Level the table is destined for, which selects its compression.
+ * @param number Receives the table number.
+ * @return True on success.
+ */
+bool LSMTree::startTable(TableBuilder &builder, int level, uint64_t &number)
+{
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        number = manifest.nextTableNumber++;
+    }
+    return builder.open(sstableDirectory + Manifest::tableFileName(number), codecForLevel(level));
+}
+
+/**
+ * @brief Finishes a table and opens it for reading.
+ *
+ * The file is synced before it is opened. It only becomes part of the tree
+ * once the caller installs a version containing it, so a restart never
+ * references a partially written table.
+ *
+ * @param builder Builder with at least one entry.
+ * @param number Table number.
+ * @param level Level the table is destined for.
+ * @param stats Smallest sequence number and earliest expiry of the table's entries.
+ * @param outputs Receives the table.
+ * @return True if the table is on disk and open.
+ */
+bool LSMTree::finishTable(TableBuilder &builder, uint64_t number, int level, const TableMeta &stats,
+                          std::vector<LiveTablePtr> &outputs)
+{
+    if (!builder.finish())
+    {
+        return false;
+    }
+
+    auto table = std::make_shared<LiveTable>();
+    table->reader = std::make_shared<TableReader>();
+    if (!table->reader->open(sstableDirectory + Manifest::tableFileName(number), cache.get()))
+    {
+        return false;
+    }
+
+    table->meta.number = number;
+    table->meta.level = level;
+    table->meta.entries = table->reader->numEntries();
+    table->meta.smallestSequence = stats.smallestSequence;
+    table->meta.earliestExpiry = stats.earliestExpiry;
+    table->meta.smallest = table->reader->smallestKey();
+    table->meta.largest = table->reader->largestKey();
+    outputs.push_back(std::move(table));
+    return true;
+}
+
+/**
+ * @brief Deletes the files of tables that were never installed.
+ * @param tables Tables to discard; emptied.
+ */
+void LSMTree::discardTables(std::vector<LiveTablePtr> &tables)
+{
+    std::error_code ec;
+    for (const auto &table : tables)
+    {
+        std::filesystem::remove(table->reader->fileName(), ec);
+    }
+    tables.clear();
+}
+
+/**
+ * @brief Wakes the compaction thread to check whether a level needs compaction.
+ */
+void LSMTree::scheduleCompaction()
+{
+    {
+        std::lock_guard<std::mutex> lock(compactionMutex);
+        compactionPending = true;
+    }
+    compactionCondition.notify_one();
+}
+
+/**
+ * @brief Body of the compaction thread.
+ *
+ * Each wake-up runs compactions until no level exceeds its budget, since one
+ * compaction may push the next level over its own, then collects range
+ * deletions and expired values, rewriting the tables that still hold entries
+ * they hide one at a time. Values expire without any write, so the thread
+ * also wakes every EXPIRY_CHECK_INTERVAL_MS; range deletions, which only
+ * change with the table set, are not collected on such a wake-up.
+ */
+void LSMTree::compactionLoop()
+{
+    std::unique_lock<std::mutex> lock(compactionMutex);
+    while (true)
+    {
+        bool woken = compactionCondition.wait_for(lock, std::chrono::milliseconds(EXPIRY_CHECK_INTERVAL_MS), [this]
+                                                  { return compactionPending || stopping; });
+        if (stopping)
+        {
+            return;
+        }
+        compactionPending = false;
+
+        lock.unlock();
+        while (!stopping && (compactOnce() || (woken && collectRangeDeletions()) || collectExpiredValues()))
+        {
+        }
+        lock.lock();
+    }
+}
+
+/**
+ * @brief Runs the most urgent compaction, if any.
+ *
+ * A single table without overlaps in the next level is moved there by a
+ * manifest update alone. Otherwise the inputs are merged into new tables
+ * that replace them in one version change, after which the input files are
+ * deleted; readers still holding the previous version keep their mappings.
+ * When no level needs compaction, the table picked by
+ * collectRangeDeletions() or collectExpiredValues() is rewritten, if any.
+ *
+ * @return True if the table set changed.
+ */
+bool LSMTree::compactOnce()
+{
+    Compaction compaction;
+    std::shared_ptr<const Version> version = currentVersion();
+    if (!version->pickCompaction(compactPointer, compaction))
+    {
+        LiveTablePtr table = std::move(tableCompaction);
+        tableCompaction = nullptr;
+        if (!table || !version->pickTableCompaction(tableCompactionLevel, table, compaction))
+        {
+            return false;
+        }
+    }
+    version.reset();
+
+    int outputLevel = compaction.level + 1;
+    std::vector<LiveTablePtr> outputs;
+    bool trivialMove = !compaction.rewrite && compaction.level > 0 && compaction.inputs.size() == 1 &&
+                       compaction.nextInputs.empty();
+    if (trivialMove)
+    {
+        auto moved = std::make_shared<LiveTable>(*compaction.inputs.front());
+        moved->meta.level = outputLevel;
+        outputs.push_back(std::move(moved));
+    }
+    else if (!writeCompactionOutputs(compaction, outputs))
+    {
+        discardTables(outputs);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        auto version = std::make_shared<Version>(*currentVersion());
+        auto removeInputs = [](std::vector<LiveTablePtr> &level, const std::vector<LiveTablePtr> &inputs)
+        {
+            level.erase(std::remove_if(level.begin(), level.end(), [&](const LiveTablePtr &table)
+                                       { return std::find(inputs.begin(), inputs.end(), table) != inputs.end(); }),
+                        level.end());
+        };
+        removeInputs(version->levels[compaction.level], compaction.inputs);
+        removeInputs(version->levels[outputLevel], compaction.nextInputs);
+
+        auto &level = version->levels[outputLevel];
+        level.insert(level.end(), outputs.begin(), outputs.end());
+        std::sort(level.begin(), level.end(), [](const LiveTablePtr &a, const LiveTablePtr &b)
+                  { return a->meta.smallest < b->meta.smallest; });
+
+        if (!installVersion(std::move(version)))
+        {
+            if (!trivialMove)
+            {
+                discardTables(outputs);
+            }
+            return false;
+        }
+    }
+
+    std::string largest;
+    for (const auto &table : compaction.inputs)
+    {
+        largest = std::max(largest, table->meta.largest);
+    }
+    compactPointer[compaction.level] = largest;
+
+    if (!trivialMove)
+    {
+        discardTables(compaction.inputs);
+        discardTables(compaction.nextInputs);
+    }
+    return true;
+}
+
+/**
+ * @brief Drops the range deletions that hide no entry any more.
+ *
+ * Every range deletion of the current version is checked against its
+ * tables (see Version::coveredTable()); those hiding nothing are removed in
+ * one version change. Flushes running meanwhile only add entries newer than
+ * every range deletion of the version, so they cannot make a deletion needed
+ * again. The first table found still holding hidden entries is picked for
+ * compactOnce() to rewrite, unless it was picked last time: a table still
+ * there after its rewrite was picked means that rewrite failed.
+ *
+ * @return True if a table was picked.
+ */
+bool LSMTree::collectRangeDeletions()
+{
+    std::shared_ptr<const Version> version = currentVersion();
+    std::vector<SequenceNumber> obsolete;
+    LiveTablePtr covered;
+    int coveredLevel = 0;
+    for (const RangeTombstone &tombstone : version->rangeDeletions)
+    {
+        if (stopping)
+        {
+            return false;
+        }
+        int level = 0;
+        LiveTablePtr table = version->coveredTable(tombstone, level);
+        if (!table)
+        {
+            obsolete.push_back(tombstone.sequence);
+        }
+        else if (!covered && level < LSM_NUM_LEVELS - 1)
+        {
+            covered = std::move(table);
+            coveredLevel = level;
+        }
+    }
+    version.reset();
+
+    if (!obsolete.empty())
+    {
+        std::lock_guard<std::mutex> lock(manifestMutex);
+        auto next = std::make_shared<Version>(*currentVersion());
+        auto &tombstones = next->rangeDeletions;
+        tombstones.erase(std::remove_if(tombstones.begin(), tombstones.end(), [&](const RangeTombstone &tombstone)
+                                        { return std::find(obsolete.begin(), obsolete.end(), tombstone.sequence) != obsolete.end(); }),
+                         tombstones.end());
+        installVersion(std::move(next));
+    }
+
+    if (!covered || covered->meta.number == lastRangeCompaction)
+    {
+        return false;
+    }
+    lastRangeCompaction = covered->meta.number;
+    tableCompaction = std::move(covered);
+    tableCompactionLevel = coveredLevel;
+    return true;
+}
+
+/**
+ * @brief Picks a table holding values expired for EXPIRED_TABLE_REWRITE_DELAY_MS.
+ *
+ * The table whose earliest expiry is oldest is picked for compactOnce() to
+ * rewrite, unless it was picked last time, which means its rewrite failed.
+ * The rewrite sheds every value expired by then, so the earliest expiry of
+ * its outputs is in the future and a table is rewritten for expiry at most
+ * once per EXPIRED_TABLE_REWRITE_DELAY_MS. Values in memtables are shed
+ * when they are flushed.
+ *
+ * @return True if a table was picked.
+ */
+bool LSMTree::collectExpiredValues()
+{
+    uint64_t now = currentTimeMillis();
+    if (now < EXPIRED_TABLE_REWRITE_DELAY_MS)
+    {
+        return false;
+    }
+    int level = 0;
+    LiveTablePtr table = currentVersion()->expiredTable(now - EXPIRED_TABLE_REWRITE_DELAY_MS, level);
+    if (!table || table->meta.number == lastExpiryCompaction)
+    {
+        return false;
+    }
+    lastExpiryCompaction = table->meta.number;
+    tableCompaction = std::move(table);
+    tableCompactionLevel = level;
+    return true;
+}
+
+/**
+ * @brief Merges the inputs of a compaction into new tables of the output level.
+ *
+ * Inputs are merged newest first (level-0 tables in reverse flush order, then
+ * the input level, then the output level), so only the latest version of
+ * each key is kept. Entries hidden by a range deletion are dropped, and
+ * tombstones and expired values too when no deeper level can hold an older
+ * version of their key; otherwise expired values are written as deletions.
+ * Output tables are cut at COMPACTION_TARGET_FILE_SIZE bytes.
+ *
+ * @param compaction Inputs to merge.
+ * @param outputs Receives the new tables.
+ * @return True if all outputs are on disk and open.
+ */
+bool LSMTree::writeCompactionOutputs(const Compaction &compaction, std::vector<LiveTablePtr> &outputs)
+{
+    std::vector<std::unique_ptr<KeyValueIterator>> sources;
+    for (auto table = compaction.inputs.rbegin(); table != compaction.inputs.rend(); ++table)
+    {
+        sources.push_back((*table)->reader->newIterator());
+    }
+    for (const auto &table : compaction.nextInputs)
+    {
+        sources.push_back(table->reader->newIterator());
+    }
+
+    MergingIterator merged(std::move(sources));
+    TableBuilder builder;
+    uint64_t number = 0;
+    TableMeta meta;
+    bool building = false;
+    int outputLevel = compaction.level + 1;
+    uint64_t now = currentTimeMillis();
+
+    for (merged.seekToFirst(); merged.valid(); merged.next())
+    {
+        if (stopping)
+        {
+            return false;
+        }
+        ParsedEntry entry;
+        if (!parseEntry(merged.value(), entry))
+        {
+            std::cerr << "Compaction of level " << compaction.level << " found a malformed entry" << std::endl;
+            return false;
+        }
+        if ((compaction.bottommost && isDeadEntry(entry, now)) ||
+            isRangeDeleted(compaction.rangeDeletions, merged.key(), entry.sequence, MAX_SEQUENCE_NUMBER))
+        {
+            continue;
+        }
+
+        if (!building)
+        {
+            if (!startTable(builder, outputLevel, number))
+            {
+                return false;
+            }
+            building = true;
+            meta = TableMeta();
+            meta.smallestSequence = MAX_SEQUENCE_NUMBER;
+        }
+        addTableEntry(builder, merged.key(), merged.value(), entry, now, meta);
+
+        if (builder.fileSize() >= COMPACTION_TARGET_FILE_SIZE)
+        {
+            building = false;
+            if (!finishTable(builder, number, outputLevel, meta, outputs))
+            {
+                return false;
+            }
+        }
+    }
+
+    if (merged.corrupted())
+    {
+        std::cerr << "Compaction of level " << compaction.level << " stopped on a corrupt table" << std::endl;
+        return false;
+    }
+    return !building || finishTable(builder, number, outputLevel, meta, outputs);
+}
@@ -1,10 +1,25 @@
 #ifndef LSM_TREE_H
 #define LSM_TREE_H
 
-#include "sstable.h"
+#include "table_reader.h"
+#include "table_builder.h"
+#include "block_cache.h"
+#include "version.h"
+#include "memtable.h"
+#include "wal.h"
+#include "write_batch.h"
+#include "manifest.h"
+#include "read_epoch.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <vector>
 #include <string>
-#include <map>
+#include <string_view>
 #include "config.h"
 
 /**
@@ -12,20 +27,153 @@
  * @brief Header file for the LSM Tree implementation.
  */
 
+/**
+ * @brief Outcome of LSMTree::expire().
+ */
+enum class ExpireStatus
+{
+    UPDATED,     ///< The key's expiry time was changed
+    NOT_FOUND,   ///< The key is not live; nothing was written
+    WRITE_FAILED ///< The write could not be logged; it is not applied
+};
+
+/**
+ * @brief Point-in-time view of an LSM tree.
+ *
+ * A snapshot pins a sequence number together with the memtables and the
+ * table set holding every write up to it. Reads through the snapshot ignore
+ * later writes, and flushes and compactions running meanwhile do not affect
+ * it, since the memtables and tables it pins stay readable; the disk space of
+ * tables replaced in the meantime is reclaimed once it is released. A
+ * snapshot must not outlive its tree.
+ */
+class Snapshot
+{
+private:
+    SequenceNumber seq = 0;
+    std::vector<std::shared_ptr<const MemTable>> memtables; ///< Newest first
+    std::shared_ptr<const Version> version;
+
+    friend class LSMTree;
+
+public:
+    /**
+     * @brief Sequence number of the last write visible in the snapshot.
+     */
+    SequenceNumber sequence() const { return seq; }
+};
+
 /**
  * @brief Log-Structured Merge (LSM) Tree implementation.
  *
  * The LSM Tree maintains an in-memory memtable and persistent SSTables for
  * efficient key-value storage. It supports fast writes and range queries
  * while leveraging Bloom filters for efficient lookups.
+ *
+ * Every write is first appended to the write-ahead log of the current
+ * memtable, then added to the memtable tagged with the next sequence number.
+ * Reads see the writes up to the last published sequence number, or up to
+ * that of a Snapshot; a write batch is published at once. A full memtable is
+ * frozen: it becomes immutable but stays readable, a fresh memtable and log
+ * take over, and a background thread flushes it to SSTables and deletes its
+ * log. Writes only stall while MAX_IMMUTABLE_MEMTABLES frozen memtables wait
+ * for their flush. Logs left by a previous run are replayed and flushed on
+ * construction. The set of live SSTables is recorded in a manifest, from
+ * which a restarted tree reopens its tables.
+ * SSTables are served from memory-mapped files; only their Bloom filters and
+ * block indexes stay in memory, and recently read data blocks are kept in a
+ * block cache that may be shared by several trees.
+ *
+ * Entries are typed (see entry_format.h), so a deletion is never mistaken
+ * for a value. A range deletion is a single write hiding every older entry
+ * of its range: it stays in its memtable until flushed, then in the Version,
+ * and reads check the entries they find against the range deletions of all
+ * their sources.
+ *
+ * Flushed tables enter level 0. A background thread compacts them into
+ * levels 1 and deeper (see Version), merging tables, dropping overwritten
+ * values, entries hidden by range deletions and, on the bottommost level,
+ * tombstones. Range deletions that no longer hide any entry are dropped, and
+ * tables still holding hidden entries are rewritten once no level needs
+ * compaction. Every change of the table set publishes a new immutable Version.
+ *
+ * All methods may be called from several threads at once. Writers join a
+ * queue; the writer at its head logs and applies the writes of the writers
+ * queued behind it as one group, so concurrent writers share log appends and
+ * syncs. Readers never take a lock: the memtables and the Version they search
+ * are published together as an immutable read state behind an atomic
+ * pointer, and a ReadEpoch keeps a replaced state alive until the readers
+ * that loaded it are done.
  */
 class LSMTree
 {
 private:
-    std::map<std::string, std::string> memtable;
-    std::vector<SSTable> sstables;
-    int sstableCounter = 0;
+    /**
+     * @brief Frozen memtable waiting for its flush.
+     */
+    struct ImmutableMemTable
+    {
+        std::shared_ptr<const MemTable> table;
+        uint64_t logNumber; ///< Log holding the memtable's writes
+    };
+
+    /**
+     * @brief Sources searched by a read, published as a whole.
+     */
+    struct ReadState
+    {
+        std::vector<std::shared_ptr<const MemTable>> memtables; ///< Active memtable first, then frozen ones newest first
+        std::shared_ptr<const Version> version;
+        /// Last sequence number of the active memtable once it is frozen
+        std::atomic<SequenceNumber> frozenAt{MAX_SEQUENCE_NUMBER};
+    };
+
+    /**
+     * @brief Writer waiting in the write queue.
+     */
+    struct Writer
+    {
+        const WriteBatch *batch;
+        bool done = false; ///< Set once another writer wrote the batch
+        bool ok = false;   ///< Whether the batch was logged and applied, valid once done
+        std::condition_variable wakeup;
+
+        explicit Writer(const WriteBatch *writeBatch) : batch(writeBatch) {}
+    };
+
+    std::shared_ptr<MemTable> memtable = std::make_shared<MemTable>(); ///< Replaced under stateMutex by the write leader
+    uint64_t logNumber = 0; ///< Log of the active memtable
+    std::atomic<SequenceNumber> lastSequence{0}; ///< Last write visible to readers
+    std::shared_ptr<BlockCache> cache; ///< Declared before current so its tables are closed before it
     std::string sstableDirectory;
+    WriteAheadLog wal;
+
+    std::mutex writeMutex; ///< Guards writers
+    std::deque<Writer *> writers; ///< Write queue; its head writes for the group
+
+    std::mutex manifestMutex; ///< Serializes changes of the table set and manifest writes
+    Manifest manifest;
+
+    std::mutex stateMutex; ///< Guards memtable, logNumber, immutables and current, and serializes publishing
+    std::shared_ptr<const Version> current = std::make_shared<Version>();
+    std::atomic<ReadState *> readState{nullptr};
+    ReadEpoch readEpoch; ///< Readers of readState
+    std::condition_variable flushCondition;
+    std::condition_variable flushDone;
+    std::deque<ImmutableMemTable> immutables; ///< Oldest first
+    std::thread flushThread;
+    std::atomic<uint64_t> stalls{0};
+
+    std::string compactPointer[LSM_NUM_LEVELS]; ///< Owned by the compaction thread
+    LiveTablePtr tableCompaction; ///< Table to rewrite for its range-deleted or expired entries; owned by the compaction thread
+    int tableCompactionLevel = 0;
+    uint64_t lastRangeCompaction = UINT64_MAX;  ///< Number of the table picked last for range-deleted entries
+    uint64_t lastExpiryCompaction = UINT64_MAX; ///< Number of the table picked last for expired entries
+    std::thread compactionThread;
+    std::mutex compactionMutex;
+    std::condition_variable compactionCondition;
+    bool compactionPending = false;
+    std::atomic<bool> stopping{false};
 
     /**
      * @brief Creates the directory for storing SSTables if it does not exist.
@@ -34,48 +182,311 @@ private:
     bool createSStableDirectory();
 
     /**
-     * @brief Flushes the memtable to SSTables when it reaches its maximum size.
+     * @brief Reads the manifest and opens the live SSTables in parallel.
+     *
+     * Without a manifest (a directory written by an older version), the
+     * sstable_N files found in the directory are adopted and a manifest is
+     * written for them.
+     */
+    void openTables();
+
+    /**
+     * @brief Opens a table file, converting a text table of an earlier version first.
+     * @param number Table number.
+     * @return The reader, or nullptr if the table cannot be read.
+     */
+    std::shared_ptr<TableReader> openTable(uint64_t number);
+
+    /**
+     * @brief Returns the current table set.
+     */
+    std::shared_ptr<const Version> currentVersion();
+
+    /**
+     * @brief Publishes the memtables and the current table set as the new read state.
+     *
+     * The caller holds stateMutex. Returns once no reader uses the previous
+     * state, which is then freed.
+     */
+    void publishReadState();
+
+    /**
+     * @brief Sequence number up to which a read of a state sees writes.
+     * @param state Read state loaded under a guard of readEpoch.
+     * @return The last published sequence number, capped at the freeze of the state's active memtable.
+     */
+    SequenceNumber visibleSequence(const ReadState &state) const;
+
+    /**
+     * @brief Records a new table set in the manifest and publishes it.
+     *
+     * The caller holds manifestMutex.
+     *
+     * @param version The new table set.
+     * @return True if the manifest was written.
+     */
+    bool installVersion(std::shared_ptr<const Version> version);
+
+    /**
+     * @brief Allocates a table number and creates its file.
+     * @param builder Builder to open.
+     * @param level Level the table is destined for, which selects its compression.
+     * @param number Receives the table number.
+     * @return True on success.
+     */
+    bool startTable(TableBuilder &builder, int level, uint64_t &number);
+
+    /**
+     * @brief Finishes a table and opens it for reading.
+     * @param builder Builder with at least one entry.
+     * @param number Table number.
+     * @param level Level the table is destined for.
+     * @param stats Smallest sequence number and earliest expiry of the table's entries.
+     * @param outputs Receives the table.
+     * @return True if the table is on disk and open.
      */
-    void flushMemtableToSSTable();
+    bool finishTable(TableBuilder &builder, uint64_t number, int level, const TableMeta &stats,
+                     std::vector<LiveTablePtr> &outputs);
 
     /**
-     * @brief Writes an SSTable to disk and adds it to the list of SSTables.
-     * @param sstable The SSTable to be written to disk.
+     * @brief Deletes the files of tables that were never installed.
+     * @param tables Tables to discard.
      */
-    void writeSSTableToDisk(SSTable &sstable);
+    void discardTables(std::vector<LiveTablePtr> &tables);
+
+    /**
+     * @brief Replays the logs of a previous run and flushes their writes.
+     * @return Number of replayed records.
+     */
+    size_t recoverLogs();
+
+    /**
+     * @brief Writes a memtable to level-0 tables and installs them.
+     * @param table Memtable to write.
+     * @param minLogNumber Oldest log still needed once the tables are installed.
+     * @return True if the tables are installed.
+     */
+    bool flushMemTable(const MemTable &table, uint64_t minLogNumber);
+
+    /**
+     * @brief Adds one write to the memtable and publishes it.
+     * @param key Key to write.
+     * @param type TYPE_VALUE for a put, TYPE_DELETION for a delete.
+     * @param value New value (empty for deletions).
+     */
+    void apply(std::string_view key, ValueType type, std::string_view value);
+
+    /**
+     * @brief Applies the operations of an encoded batch to the memtable and publishes them together.
+     * @param contents Encoded batch, as logged.
+     */
+    void applyBatch(std::string_view contents);
+
+    /**
+     * @brief Freezes the memtable once it reaches its maximum size.
+     *
+     * Only called by the head of the write queue.
+     */
+    void makeRoomForWrite();
+
+    /**
+     * @brief Body of the flush thread.
+     */
+    void flushLoop();
+
+    /**
+     * @brief Wakes the compaction thread.
+     */
+    void scheduleCompaction();
+
+    /**
+     * @brief Body of the compaction thread.
+     */
+    void compactionLoop();
+
+    /**
+     * @brief Runs the most urgent compaction, if any.
+     * @return True if the table set changed.
+     */
+    bool compactOnce();
+
+    /**
+     * @brief Drops the range deletions that hide no entry any more.
+     *
+     * Also picks a table still holding hidden entries for the next
+     * compactOnce() to rewrite.
+     *
+     * @return True if a table was picked.
+     */
+    bool collectRangeDeletions();
+
+    /**
+     * @brief Picks a table holding values expired for EXPIRED_TABLE_REWRITE_DELAY_MS
+     *        for the next compactOnce() to rewrite.
+     * @return True if a table was picked.
+     */
+    bool collectExpiredValues();
+
+    /**
+     * @brief Merges the inputs of a compaction into new tables of the output level.
+     * @param compaction Inputs to merge.
+     * @param outputs Receives the new tables.
+     * @return True if all outputs are on disk and open.
+     */
+    bool writeCompactionOutputs(const Compaction &compaction, std::vector<LiveTablePtr> &outputs);
 
 public:
     /**
      * @brief Constructs an LSMTree instance with a specified SSTable directory.
-     * @param directory The directory where SSTables will be stored.
+     * @param directory The directory where SSTables and the write-ahead log are stored.
+     * @param walSyncMode When logged writes are synced to disk.
+     * @param walSyncIntervalMs Sync period for WalSyncMode::INTERVAL.
+     * @param blockCache Block cache to share, or nullptr for a private one of
+     *                   BLOCK_CACHE_CAPACITY bytes.
+     */
+    LSMTree(const std::string &directory,
+            WalSyncMode walSyncMode = WalSyncMode::INTERVAL,
+            unsigned walSyncIntervalMs = WAL_SYNC_INTERVAL_MS,
+            std::shared_ptr<BlockCache> blockCache = nullptr);
+
+    LSMTree(const LSMTree &) = delete;
+    LSMTree &operator=(const LSMTree &) = delete;
+
+    /**
+     * @brief Flushes the frozen memtables and stops the background threads.
+     *
+     * No other thread may use the tree any more.
      */
-    LSMTree(const std::string &directory);
+    ~LSMTree();
 
     /**
      * @brief Inserts a key-value pair into the LSM Tree.
      * @param key The key to insert.
      * @param value The corresponding value.
+     * @param expiresAt Time in milliseconds since the epoch (see currentTimeMillis())
+     *                  at which the key is deleted, or 0 to keep it until overwritten.
+     * @return False if the write could not be logged; it is then not applied.
      */
-    void set(const std::string &key, const std::string &value);
+    bool set(const std::string &key, const std::string &value, uint64_t expiresAt = 0);
 
     /**
      * @brief Retrieves the value associated with a given key.
+     *
+     * The key is only borrowed, so callers holding a view into a network
+     * buffer do not need to copy it.
+     *
      * @param key The key to look up.
+     * @param snapshot View to read, or nullptr for the latest writes.
      * @return The associated value if found, otherwise "NOT_FOUND".
      */
-    std::string get(const std::string &key);
+    std::string get(std::string_view key, const std::shared_ptr<const Snapshot> &snapshot = nullptr);
 
     /**
-     * @brief Marks a key as deleted by inserting a tombstone marker.
+     * @brief Looks up several keys at once.
+     *
+     * Equivalent to calling get() for every key, but each table is searched
+     * once for the whole batch.
+     *
+     * @param keys Keys to look up, in any order.
+     * @param snapshot View to read, or nullptr for the latest writes.
+     * @return The value of each key in the order of keys, or std::nullopt where get() finds none.
+     */
+    std::vector<std::optional<std::string>> multiGet(const std::vector<std::string_view> &keys,
+                                                     const std::shared_ptr<const Snapshot> &snapshot = nullptr);
+
+    /**
+     * @brief Retrieves the expiry time of a key.
+     * @param key The key to look up.
+     * @param expiresAt Receives the expiry time in milliseconds since the epoch, or 0 if the key never expires.
+     * @return False if the key is not live.
+     */
+    bool getExpiry(std::string_view key, uint64_t &expiresAt);
+
+    /**
+     * @brief Changes the expiry time of a live key, keeping its value.
+     *
+     * Not atomic with a concurrent write of the same key.
+     *
+     * @param key Key to change.
+     * @param expiresAt New expiry time in milliseconds since the epoch, or 0 to keep the key until overwritten.
+     * @return Whether the expiry time was changed, the key is not live or the write could not be logged.
+     */
+    ExpireStatus expire(const std::string &key, uint64_t expiresAt);
+
+    /**
+     * @brief Marks a key as deleted by inserting a tombstone.
      * @param key The key to remove.
+     * @return False if the write could not be logged; it is then not applied.
+     */
+    bool remove(const std::string &key);
+
+    /**
+     * @brief Deletes every key in [start, end) with a single range tombstone.
+     * @param start First key to delete.
+     * @param end Key at which the range ends (exclusive); nothing is deleted unless it is greater than start.
+     * @return False if the write could not be logged; it is then not applied.
+     */
+    bool removeRange(const std::string &start, const std::string &end);
+
+    /**
+     * @brief Applies a batch of writes.
+     *
+     * The batch is logged as a single record, so it survives a crash either
+     * entirely or not at all. Batches of concurrent callers are applied in
+     * the order they joined the write queue.
+     *
+     * @param batch Puts, deletes and range deletes to apply, in order.
+     * @return False if the batch could not be logged; it is then not applied.
      */
-    void remove(const std::string &key);
+    bool write(const WriteBatch &batch);
 
     /**
      * @brief Retrives the values of all the keys stored in the database.
      * @return A vector of values found the database.
      */
     std::vector<std::string> getAllKeyValuePairs();
+
+    /**
+     * @brief Takes a point-in-time view of the tree.
+     * @return The snapshot; it is released with its last reference.
+     */
+    std::shared_ptr<const Snapshot> getSnapshot();
+
+    /**
+     * @brief Returns a cursor over the live keys of the tree in key order.
+     *
+     * The cursor merges the memtables and all SSTables, returning only the
+     * newest version of each key and skipping deleted keys. It reads a
+     * snapshot, the one given or one taken on creation, so it sees neither
+     * writes made after that nor part of a batch, and may be used while the
+     * tree flushes and compacts. It must not outlive the tree.
+     *
+     * @param upperBound Key at which the cursor stops (exclusive), or empty for none.
+     * @param snapshot View to read, or nullptr for the current state.
+     * @return A new, unpositioned cursor.
+     */
+    std::unique_ptr<KeyValueIterator> newIterator(std::string_view upperBound = std::string_view(),
+                                                  std::shared_ptr<const Snapshot> snapshot = nullptr);
+
+    /**
+     * @brief Retrieves the live keys in [start, end), at most limit of them.
+     * @param start First key of the range.
+     * @param end Key at which the range ends (exclusive), or empty for none.
+     * @param limit Maximum number of keys returned.
+     * @param withValues True to follow each key by its value.
+     * @return Keys in order, interleaved with their values if requested.
+     */
+    std::vector<std::string> getRange(std::string_view start, std::string_view end, size_t limit, bool withValues = true);
+
+    /**
+     * @brief Returns the block cache used by this tree's SSTables.
+     */
+    const BlockCache &blockCache() const { return *cache; }
+
+    /**
+     * @brief Number of writes that waited for a memtable flush.
+     */
+    uint64_t writeStalls() const { return stalls.load(std::memory_order_relaxed); }
 };
 
 #endif // LSM_TREE_H
@@ -0,0 +1,253 @@
+#include "manifest.h"
+#include "config.h"
+#include <iostream>
+#include <fstream>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief First line of every manifest, including the format version.
+ */
+static const char *MANIFEST_HEADER = "BLINKDB-MANIFEST 4";
+
+/**
+ * @brief Header of version 3 manifests, which have no expiry times.
+ */
+static const char *MANIFEST_HEADER_V3 = "BLINKDB-MANIFEST 3";
+
+/**
+ * @brief Header of version 2 manifests, which have no sequence numbers.
+ */
+static const char *MANIFEST_HEADER_V2 = "BLINKDB-MANIFEST 2";
+
+/**
+ * @brief Header of version 1 manifests, whose tables have no level.
+ */
+static const char *MANIFEST_HEADER_V1 = "BLINKDB-MANIFEST 1";
+
+/**
+ * @brief Reads a length-prefixed key ("<len>:<bytes>").
+ * @param in Stream positioned before the key (leading spaces are skipped).
+ * @param key Receives the key.
+ * @return True on success.
+ */
+static bool readKey(std::istream &in, std::string &key)
+{
+    size_t length = 0;
+    char colon = 0;
+    if (!(in >> length) || !in.get(colon) || colon != ':')
+        return false;
+    key.resize(length);
+    return length == 0 || in.read(&key[0], (std::streamsize)length);
+}
+
+/**
+ * @brief Writes a length-prefixed key.
+ */
+static void writeKey(std::ostream &out, const std::string &key)
+{
+    out << key.size() << ':';
+    out.write(key.data(), (std::streamsize)key.size());
+}
+
+/**
+ * @brief Syncs a file or directory by path.
+ * @return True on success.
+ */
+static bool syncPath(const std::string &path, int flags)
+{
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+/**
+ * @brief Returns the file name of a table.
+ * @param number Table number.
+ * @return File name relative to the tree's directory.
+ */
+std::string Manifest::tableFileName(uint64_t number)
+{
+    return "sstable_" + std::to_string(number) + ".sst";
+}
+
+/**
+ * @brief Returns the file name used for a table by the text format of earlier versions.
+ * @param number Table number.
+ * @return File name relative to the tree's directory.
+ */
+std::string Manifest::legacyTableFileName(uint64_t number)
+{
+    return "sstable_" + std::to_string(number) + ".txt";
+}
+
+/**
+ * @brief Returns the file name of a write-ahead log.
+ * @param number Log number.
+ * @return File name relative to the tree's directory.
+ */
+std::string Manifest::logFileName(uint64_t number)
+{
+    return "wal_" + std::to_string(number) + ".log";
+}
+
+/**
+ * @brief Reads the manifest of a directory.
+ *
+ * @param directory Directory of the LSM tree (ending with '/').
+ * @return True if a valid manifest was read, false if it is missing or corrupt.
+ */
+bool Manifest::load(const std::string &directory)
+{
+    std::ifstream file(directory + MANIFEST_FILE_NAME, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::string header;
+    if (!std::getline(file, header) ||
+        (header != MANIFEST_HEADER && header != MANIFEST_HEADER_V3 && header != MANIFEST_HEADER_V2 &&
+         header != MANIFEST_HEADER_V1))
+    {
+        std::cerr << "Unrecognized manifest in " << directory << std::endl;
+        return false;
+    }
+
+    bool hasLevels = header != MANIFEST_HEADER_V1;
+    bool hasSequences = header == MANIFEST_HEADER || header == MANIFEST_HEADER_V3;
+    bool hasExpiry = header == MANIFEST_HEADER;
+    std::vector<TableMeta> loaded;
+    std::vector<RangeTombstone> ranges;
+    uint64_t next = 0;
+    uint64_t log = 0;
+    SequenceNumber sequence = 0;
+    std::string tag;
+    while (file >> tag)
+    {
+        if (tag == "next")
+        {
+            if (!(file >> next))
+                return false;
+        }
+        else if (tag == "log")
+        {
+            if (!(file >> log))
+                return false;
+        }
+        else if (tag == "sequence")
+        {
+            if (!(file >> sequence))
+                return false;
+        }
+        else if (tag == "table")
+        {
+            TableMeta meta;
+            if (!(file >> meta.number) || (hasLevels && !(file >> meta.level)) || !(file >> meta.entries) ||
+                (hasSequences && !(file >> meta.smallestSequence)) || (hasExpiry && !(file >> meta.earliestExpiry)) ||
+                meta.level < 0 || meta.level >= LSM_NUM_LEVELS ||
+                !readKey(file, meta.smallest) || !readKey(file, meta.largest))
+            {
+                std::cerr << "Corrupt manifest entry in " << directory << std::endl;
+                return false;
+            }
+            loaded.push_back(std::move(meta));
+        }
+        else if (tag == "range")
+        {
+            RangeTombstone tombstone;
+            if (!(file >> tombstone.sequence) || !readKey(file, tombstone.start) || !readKey(file, tombstone.end))
+            {
+                std::cerr << "Corrupt manifest range deletion in " << directory << std::endl;
+                return false;
+            }
+            ranges.push_back(std::move(tombstone));
+        }
+        else
+        {
+            std::cerr << "Unknown manifest record '" << tag << "' in " << directory << std::endl;
+            return false;
+        }
+    }
+
+    nextTableNumber = next;
+    logNumber = log;
+    lastSequence = sequence;
+    tables = std::move(loaded);
+    rangeDeletions = std::move(ranges);
+    return true;
+}
+
+/**
+ * @brief Atomically replaces the manifest of a directory.
+ *
+ * The new contents go to a temporary file that is synced and renamed over the
+ * manifest; the directory is synced afterwards so the rename is durable.
+ *
+ * @param directory Directory of the LSM tree (ending with '/').
+ * @return True on success.
+ */
+bool Manifest::save(const std::string &directory) const
+{
+    std::string path = directory + MANIFEST_FILE_NAME;
+    std::string tempPath = path + ".tmp";
+
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Failed to open manifest for writing: " << tempPath << std::endl;
+            return false;
+        }
+
+        file << MANIFEST_HEADER << "\n";
+        file << "next " << nextTableNumber << "\n";
+        file << "log " << logNumber << "\n";
+        file << "sequence " << lastSequence << "\n";
+        for (const auto &meta : tables)
+        {
+            file << "table " << meta.number << ' ' << meta.level << ' ' << meta.entries << ' '
+                 << meta.smallestSequence << ' ' << meta.earliestExpiry << ' ';
+            writeKey(file, meta.smallest);
+            file << ' ';
+            writeKey(file, meta.largest);
+            file << "\n";
+        }
+        for (const auto &tombstone : rangeDeletions)
+        {
+            file << "range " << tombstone.sequence << ' ';
+            writeKey(file, tombstone.start);
+            file << ' ';
+            writeKey(file, tombstone.end);
+            file << "\n";
+        }
+
+        file.close();
+        if (file.fail())
+        {
+            std::cerr << "Failed to write manifest: " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    if (!syncPath(tempPath, O_RDONLY))
+    {
+        std::cerr << "Failed to sync manifest: " << tempPath << std::endl;
+        return false;
+    }
+
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Failed to install manifest: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    syncPath(directory.empty() ? "." : directory, O_RDONLY | O_DIRECTORY);
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "entry_format.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @file manifest.h
+ * @brief Header file for the manifest describing an LSM tree's live SSTables.
+ */
+
+/**
+ * @brief Metadata of one live SSTable.
+ */
+struct TableMeta
+{
+    uint64_t number = 0;                 ///< Table number, also used in its file name
+    int level = 0;                       ///< Level of the table in the tree
+    size_t entries = 0;                  ///< Number of entries in the table
+    SequenceNumber smallestSequence = 0; ///< Smallest sequence number of its entries
+    uint64_t earliestExpiry = 0;         ///< Earliest expiry time of its values, 0 if none expires
+    std::string smallest;                ///< Smallest key in the table
+    std::string largest;                 ///< Largest key in the table
+};
+
+/**
+ * @brief Persistent record of the live SSTable set.
+ *
+ * The manifest lists every live table (level by level, level 0 oldest first)
+ * with its key range, and the next table number to hand out, so startup knows which files to open
+ * without scanning or parsing them. It also holds the range deletions
+ * flushed from memtables, which apply to the tables, and the last sequence
+ * number written to a table, from which numbering resumes. Each table
+ * records the earliest expiry time of its values, so tables holding expired
+ * values are found without reading them. It is replaced atomically: the new
+ * contents are written to a temporary file, synced and renamed over the old
+ * manifest, so a crash leaves either the old or the new table set.
+ *
+ * File format (text, keys length-prefixed so they may hold any byte):
+ *
+ *     BLINKDB-MANIFEST 4
+ *     next <number>
+ *     log <number>
+ *     sequence <number>
+ *     table <number> <level> <entries> <smallest sequence> <earliest expiry> <len>:<smallest> <len>:<largest>
+ *     range <sequence> <len>:<start> <len>:<end>
+ *
+ * Version 1 manifests, which had no level field, are read with all tables on
+ * level 0; version 1 and 2 manifests have no sequence numbers, which are
+ * read as 0, and versions 1 to 3 have no expiry times, as no value expired.
+ */
+class Manifest
+{
+public:
+    uint64_t nextTableNumber = 0;    ///< Next number for a table or log file
+    uint64_t logNumber = 0;          ///< Oldest write-ahead log not yet flushed to tables
+    SequenceNumber lastSequence = 0; ///< Largest sequence number written to a table
+    std::vector<TableMeta> tables;
+    std::vector<RangeTombstone> rangeDeletions; ///< Oldest first
+
+    /**
+     * @brief Reads the manifest of a directory.
+     * @param directory Directory of the LSM tree (ending with '/').
+     * @return True if a valid manifest was read, false if it is missing or corrupt.
+     */
+    bool load(const std::string &directory);
+
+    /**
+     * @brief Atomically replaces the manifest of a directory.
+     * @param directory Directory of the LSM tree (ending with '/').
+     * @return True on success.
+     */
+    bool save(const std::string &directory) const;
+
+    /**
+     * @brief Returns the file name of a table.
+     * @param number Table number.
+     */
+    static std::string tableFileName(uint64_t number);
+
+    /**
+     * @brief Returns the text-format file name earlier versions used for a table.
+     * @param number Table number.
+     */
+    static std::string legacyTableFileName(uint64_t number);
+
+    /**
+     * @brief Returns the file name of a write-ahead log.
+     * @param number Log number, taken from the same sequence as table numbers.
+     */
+    static std::string logFileName(uint64_t number);
+};
+
+#endif // MANIFEST_H
@@ -0,0 +1,395 @@
+#include "memtable.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <random>
+
+/**
+ * @brief Skiplist node, followed in the arena by its upper links and its key.
+ */
+struct MemTable::Node
+{
+    const char *keyData;
+    uint32_t keyLength;
+    std::atomic<const ValueVersion *> newest; ///< Head of the versions, newest first
+    std::atomic<Node *> links[1];             ///< Link of level 0; links of higher levels follow
+
+    std::string_view key() const { return std::string_view(keyData, keyLength); }
+
+    Node *next(int level) const { return links[level].load(std::memory_order_acquire); }
+};
+
+/**
+ * @brief One version of a key, followed in the arena by its encoded entry.
+ */
+struct MemTable::ValueVersion
+{
+    SequenceNumber sequence;
+    const ValueVersion *older; ///< Previous version of the key, or nullptr
+    uint32_t length;           ///< Size of the encoded entry
+
+    std::string_view entry() const { return std::string_view((const char *)(this + 1), length); }
+};
+
+/**
+ * @brief Deletion of a key range, followed in the arena by the start and end keys.
+ */
+struct MemTable::RangeDeletion
+{
+    SequenceNumber sequence;
+    const RangeDeletion *older; ///< Previous range deletion, or nullptr
+    uint32_t startLength;
+    uint32_t endLength;
+
+    std::string_view start() const { return std::string_view((const char *)(this + 1), startLength); }
+    std::string_view end() const { return std::string_view((const char *)(this + 1) + startLength, endLength); }
+};
+
+/**
+ * @brief Creates an empty memtable.
+ */
+MemTable::MemTable()
+{
+    head = newNode(std::string_view(), kMaxHeight);
+}
+
+/**
+ * @brief Draws a node height: h with probability (1 / kBranching)^(h - 1).
+ * @return Height between 1 and kMaxHeight.
+ */
+int MemTable::randomHeight()
+{
+    thread_local std::minstd_rand rng(std::random_device{}());
+    int height = 1;
+    while (height < kMaxHeight && rng() % kBranching == 0)
+    {
+        ++height;
+    }
+    return height;
+}
+
+/**
+ * @brief Allocates a node with a copy of the key.
+ *
+ * The node, its links and the key bytes share one allocation. All links
+ * start out null.
+ *
+ * @param key Key of the node.
+ * @param height Number of levels the node is linked into.
+ * @return The node.
+ */
+MemTable::Node *MemTable::newNode(std::string_view key, int height)
+{
+    size_t nodeSize = sizeof(Node) + sizeof(std::atomic<Node *>) * (height - 1);
+    char *memory = arena.allocate(nodeSize + key.size());
+    Node *node = new (memory) Node;
+    for (int level = 1; level < height; ++level)
+    {
+        new (&node->links[level]) std::atomic<Node *>();
+    }
+    for (int level = 0; level < height; ++level)
+    {
+        node->links[level].store(nullptr, std::memory_order_relaxed);
+    }
+    node->newest.store(nullptr, std::memory_order_relaxed);
+
+    if (!key.empty())
+    {
+        std::memcpy(memory + nodeSize, key.data(), key.size());
+    }
+    node->keyData = memory + nodeSize;
+    node->keyLength = (uint32_t)key.size();
+    return node;
+}
+
+/**
+ * @brief Encodes an entry into the arena as a version of a key.
+ * @param type Kind of write.
+ * @param value Value to store.
+ * @param sequence Sequence number of the write.
+ * @param expiresAt Expiry time of an expiring value.
+ * @return The version, not yet linked to older ones.
+ */
+MemTable::ValueVersion *MemTable::newVersion(ValueType type, std::string_view value, SequenceNumber sequence,
+                                             uint64_t expiresAt)
+{
+    std::string header; // Type, sequence number and expiry; short enough to stay off the heap
+    encodeEntry(header, type, sequence, std::string_view(), expiresAt);
+
+    char *memory = arena.allocate(sizeof(ValueVersion) + header.size() + value.size());
+    ValueVersion *version = new (memory) ValueVersion;
+    version->sequence = sequence;
+    version->older = nullptr;
+    version->length = (uint32_t)(header.size() + value.size());
+    std::memcpy(memory + sizeof(ValueVersion), header.data(), header.size());
+    if (!value.empty())
+    {
+        std::memcpy(memory + sizeof(ValueVersion) + header.size(), value.data(), value.size());
+    }
+    return version;
+}
+
+/**
+ * @brief Newest version of a node visible at a sequence number.
+ * @param node Node of the key.
+ * @param sequence Sequence number to read at.
+ * @return The version, or nullptr if every version is newer.
+ */
+const MemTable::ValueVersion *MemTable::visibleVersion(const Node *node, SequenceNumber sequence)
+{
+    const ValueVersion *version = node->newest.load(std::memory_order_acquire);
+    while (version != nullptr && version->sequence > sequence)
+    {
+        version = version->older;
+    }
+    return version;
+}
+
+/**
+ * @brief First node at or after a key, starting the search at a node of a level.
+ * @param key Key to find.
+ * @param before Node known to precede the key; receives the last node before it.
+ * @param level Level to search.
+ * @return The node after before, or nullptr.
+ */
+MemTable::Node *MemTable::findSpliceForLevel(std::string_view key, Node *&before, int level)
+{
+    while (true)
+    {
+        Node *after = before->next(level);
+        if (after == nullptr || after->key() >= key)
+        {
+            return after;
+        }
+        before = after;
+    }
+}
+
+/**
+ * @brief First node with a key not less than the given key.
+ *
+ * The search starts on the highest level in use and drops a level whenever
+ * the next node is past the key.
+ *
+ * @param key Key to find.
+ * @param prev If not null, receives the last node before the key on every level.
+ * @return The node, or nullptr if every key is smaller.
+ */
+MemTable::Node *MemTable::findGreaterOrEqual(std::string_view key, Node **prev) const
+{
+    Node *node = head;
+    Node *after = nullptr;
+    for (int level = maxHeight.load(std::memory_order_relaxed) - 1; level >= 0; --level)
+    {
+        after = findSpliceForLevel(key, node, level);
+        if (prev != nullptr)
+        {
+            prev[level] = node;
+        }
+    }
+    return after;
+}
+
+/**
+ * @brief Adds a version of a key.
+ *
+ * If the key exists, the version is pushed onto its list. Otherwise a new
+ * node is linked into level 0 first, which makes it visible to readers, then
+ * into its upper levels. A failed compare-and-swap means another insert
+ * changed the links at that spot; the search resumes from the node found
+ * before it. If a concurrent insert of the same key wins at level 0, the
+ * version is pushed onto that node and this write's node is left unused in
+ * the arena.
+ *
+ * @param key Key to write.
+ * @param type Kind of write.
+ * @param value New value (empty for deletions).
+ * @param sequence Sequence number of the write.
+ * @param expiresAt Expiry time of a TYPE_EXPIRING_VALUE.
+ */
+void MemTable::put(std::string_view key, ValueType type, std::string_view value, SequenceNumber sequence,
+                   uint64_t expiresAt)
+{
+    ValueVersion *version = newVersion(type, value, sequence, expiresAt);
+    auto pushVersion = [version](Node *node)
+    {
+        const ValueVersion *older = node->newest.load(std::memory_order_relaxed);
+        do
+        {
+            version->older = older;
+        } while (!node->newest.compare_exchange_weak(older, version, std::memory_order_release,
+                                                     std::memory_order_relaxed));
+    };
+
+    Node *prev[kMaxHeight];
+    std::fill(prev, prev + kMaxHeight, head); // Levels above the search start at head
+    Node *found = findGreaterOrEqual(key, prev);
+    if (found != nullptr && found->key() == key)
+    {
+        pushVersion(found);
+        return;
+    }
+
+    int height = randomHeight();
+    int currentMax = maxHeight.load(std::memory_order_relaxed);
+    while (height > currentMax)
+    {
+        if (maxHeight.compare_exchange_weak(currentMax, height, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+
+    Node *node = newNode(key, height);
+    node->newest.store(version, std::memory_order_relaxed);
+    for (int level = 0; level < height; ++level)
+    {
+        while (true)
+        {
+            Node *after = findSpliceForLevel(key, prev[level], level);
+            if (level == 0 && after != nullptr && after->key() == key)
+            {
+                pushVersion(after);
+                return;
+            }
+            node->links[level].store(after, std::memory_order_relaxed);
+            if (prev[level]->links[level].compare_exchange_strong(after, node, std::memory_order_release,
+                                                                  std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+    }
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Adds a deletion of the keys in [start, end).
+ *
+ * The deletion is pushed onto the list of range deletions, newest first, so
+ * readers see it once it is complete.
+ *
+ * @param start First key to delete.
+ * @param end Key at which the range ends (exclusive).
+ * @param sequence Sequence number of the write.
+ */
+void MemTable::deleteRange(std::string_view start, std::string_view end, SequenceNumber sequence)
+{
+    char *memory = arena.allocate(sizeof(RangeDeletion) + start.size() + end.size());
+    RangeDeletion *deletion = new (memory) RangeDeletion;
+    deletion->sequence = sequence;
+    deletion->startLength = (uint32_t)start.size();
+    deletion->endLength = (uint32_t)end.size();
+    if (!start.empty())
+    {
+        std::memcpy(memory + sizeof(RangeDeletion), start.data(), start.size());
+    }
+    std::memcpy(memory + sizeof(RangeDeletion) + start.size(), end.data(), end.size());
+
+    const RangeDeletion *older = rangeDeletionList.load(std::memory_order_relaxed);
+    do
+    {
+        deletion->older = older;
+    } while (!rangeDeletionList.compare_exchange_weak(older, deletion, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+}
+
+/**
+ * @brief True if a range deletion of the memtable hides an entry from a reader.
+ * @param key Key of the entry.
+ * @param entrySequence Sequence number of the entry.
+ * @param readSequence Sequence number the reader reads at.
+ * @return True if a deletion visible at readSequence, newer than the entry, covers the key.
+ */
+bool MemTable::isRangeDeleted(std::string_view key, SequenceNumber entrySequence, SequenceNumber readSequence) const
+{
+    for (const RangeDeletion *deletion = rangeDeletionList.load(std::memory_order_acquire);
+         deletion != nullptr && deletion->sequence > entrySequence; deletion = deletion->older)
+    {
+        if (deletion->sequence <= readSequence && key >= deletion->start() && key < deletion->end())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Copies the range deletions visible at a sequence number.
+ * @param sequence Sequence number to read at.
+ * @param tombstones Receives the deletions, appended oldest first.
+ */
+void MemTable::rangeDeletions(SequenceNumber sequence, std::vector<RangeTombstone> &tombstones) const
+{
+    size_t first = tombstones.size();
+    for (const RangeDeletion *deletion = rangeDeletionList.load(std::memory_order_acquire); deletion != nullptr;
+         deletion = deletion->older)
+    {
+        if (deletion->sequence <= sequence)
+        {
+            tombstones.push_back(RangeTombstone{std::string(deletion->start()), std::string(deletion->end()),
+                                                deletion->sequence});
+        }
+    }
+    std::reverse(tombstones.begin() + (std::ptrdiff_t)first, tombstones.end());
+}
+
+/**
+ * @brief Looks up a key.
+ * @param key Key to find.
+ * @param entry Receives the encoded entry if found.
+ * @param sequence Sequence number to read at.
+ * @return True if the memtable holds a version of the key visible at sequence.
+ */
+bool MemTable::get(std::string_view key, std::string &entry, SequenceNumber sequence) const
+{
+    Node *node = findGreaterOrEqual(key, nullptr);
+    if (node == nullptr || node->key() != key)
+    {
+        return false;
+    }
+    const ValueVersion *version = visibleVersion(node, sequence);
+    if (version == nullptr)
+    {
+        return false;
+    }
+    entry = version->entry();
+    return true;
+}
+
+void MemTable::Iterator::skipInvisible()
+{
+    version = nullptr;
+    while (node != nullptr && (version = visibleVersion(node, sequence)) == nullptr)
+    {
+        node = node->next(0);
+    }
+}
+
+void MemTable::Iterator::seekToFirst()
+{
+    node = table->head->next(0);
+    skipInvisible();
+}
+
+void MemTable::Iterator::seek(std::string_view target)
+{
+    node = table->findGreaterOrEqual(target, nullptr);
+    skipInvisible();
+}
+
+void MemTable::Iterator::next()
+{
+    node = node->next(0);
+    skipInvisible();
+}
+
+std::string_view MemTable::Iterator::key() const
+{
+    return node->key();
+}
+
+std::string_view MemTable::Iterator::value() const
+{
+    return version->entry();
+}
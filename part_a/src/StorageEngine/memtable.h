@@ -0,0 +1,208 @@
+#ifndef MEMTABLE_H
+#define MEMTABLE_H
+
+#include "arena.h"
+#include "entry_format.h"
+#include "iterator.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file memtable.h
+ * @brief In-memory sorted write buffer of the LSM tree.
+ */
+
+/**
+ * @brief Sorted, multi-version key-value map built on a skiplist in an arena.
+ *
+ * Each key is one arena allocation holding the skiplist node and the key.
+ * Every write of a key adds a version holding the write's entry (see
+ * entry_format.h), tagged with its sequence number; the versions of a key form a list, newest first, whose head is
+ * published through an atomic pointer. Entries are thus ordered by key, then
+ * by decreasing sequence number, and a reader at sequence number s sees the
+ * newest version not newer than s, so writes made after it started stay
+ * invisible to it. Nothing is freed before the memtable itself, which
+ * releases the whole arena at once.
+ *
+ * Readers take no locks: nodes are fully built before they are linked in with
+ * release stores, and links are followed with acquire loads. Inserts from
+ * several threads link their nodes with compare-and-swap, level by level from
+ * the bottom, and redo the search of a level when another insert got there
+ * first. Versions of a key are pushed onto its list with compare-and-swap;
+ * callers serialize writes of the same key so that the list stays ordered.
+ *
+ * Range deletions are kept apart from the keys, on a list pushed the same
+ * way; lookups and iterators return entries as they are, and callers check
+ * them against the range deletions of every source they read.
+ */
+class MemTable
+{
+private:
+    static constexpr int kMaxHeight = 12;
+    static constexpr unsigned kBranching = 4;
+
+    struct Node;
+    struct ValueVersion;
+    struct RangeDeletion;
+
+    Arena arena;
+    Node *head;
+    std::atomic<int> maxHeight{1};
+    std::atomic<size_t> count{0};
+    std::atomic<const RangeDeletion *> rangeDeletionList{nullptr}; ///< Newest first
+
+    /**
+     * @brief Draws a node height: h with probability (1 / kBranching)^(h - 1).
+     */
+    static int randomHeight();
+
+    /**
+     * @brief Allocates a node with a copy of the key.
+     * @param key Key of the node.
+     * @param height Number of levels the node is linked into.
+     */
+    Node *newNode(std::string_view key, int height);
+
+    /**
+     * @brief Encodes an entry into the arena as a version of a key.
+     * @param type Kind of write.
+     * @param value Value to store.
+     * @param sequence Sequence number of the write.
+     * @param expiresAt Expiry time of an expiring value.
+     * @return The version, not yet linked to older ones.
+     */
+    ValueVersion *newVersion(ValueType type, std::string_view value, SequenceNumber sequence, uint64_t expiresAt);
+
+    /**
+     * @brief Newest version of a node visible at a sequence number.
+     * @return The version, or nullptr if every version is newer.
+     */
+    static const ValueVersion *visibleVersion(const Node *node, SequenceNumber sequence);
+
+    /**
+     * @brief First node at or after a key, starting the search at a node of a level.
+     * @param key Key to find.
+     * @param before Node known to precede the key; receives the last node before it.
+     * @param level Level to search.
+     * @return The node after before, or nullptr.
+     */
+    static Node *findSpliceForLevel(std::string_view key, Node *&before, int level);
+
+    /**
+     * @brief First node with a key not less than the given key.
+     * @param key Key to find.
+     * @param prev If not null, receives the last node before the key on every level.
+     */
+    Node *findGreaterOrEqual(std::string_view key, Node **prev) const;
+
+public:
+    /**
+     * @brief Cursor over the keys in order, each with the entry of its newest
+     *        version visible at the cursor's sequence number.
+     *
+     * Keys whose versions are all newer are skipped; deletions are returned. It must not outlive the
+     * memtable.
+     */
+    class Iterator : public KeyValueIterator
+    {
+    private:
+        const MemTable *table;
+        SequenceNumber sequence;
+        Node *node = nullptr;
+        const ValueVersion *version = nullptr;
+
+        /**
+         * @brief Moves forward from node to the first key with a visible version.
+         */
+        void skipInvisible();
+
+    public:
+        explicit Iterator(const MemTable *memtable, SequenceNumber snapshot = MAX_SEQUENCE_NUMBER)
+            : table(memtable), sequence(snapshot) {}
+
+        bool valid() const override { return node != nullptr; }
+        void seekToFirst() override;
+        void seek(std::string_view target) override;
+        void next() override;
+        std::string_view key() const override;
+        std::string_view value() const override;
+    };
+
+    MemTable();
+    MemTable(const MemTable &) = delete;
+    MemTable &operator=(const MemTable &) = delete;
+
+    /**
+     * @brief Adds a version of a key.
+     * @param key Key to write.
+     * @param type Kind of write.
+     * @param value New value (empty for deletions).
+     * @param sequence Sequence number of the write, larger than that of any
+     *                 earlier write of the key.
+     * @param expiresAt Expiry time of a TYPE_EXPIRING_VALUE, in milliseconds since the epoch.
+     */
+    void put(std::string_view key, ValueType type, std::string_view value, SequenceNumber sequence,
+             uint64_t expiresAt = 0);
+
+    /**
+     * @brief Adds a deletion of the keys in [start, end).
+     * @param start First key to delete.
+     * @param end Key at which the range ends (exclusive).
+     * @param sequence Sequence number of the write.
+     */
+    void deleteRange(std::string_view start, std::string_view end, SequenceNumber sequence);
+
+    /**
+     * @brief Looks up a key.
+     * @param key Key to find.
+     * @param entry Receives the encoded entry if found.
+     * @param sequence Sequence number to read at.
+     * @return True if the memtable holds a version of the key visible at sequence.
+     */
+    bool get(std::string_view key, std::string &entry, SequenceNumber sequence = MAX_SEQUENCE_NUMBER) const;
+
+    /**
+     * @brief True if a range deletion of the memtable hides an entry from a reader.
+     * @param key Key of the entry.
+     * @param entrySequence Sequence number of the entry.
+     * @param readSequence Sequence number the reader reads at.
+     */
+    bool isRangeDeleted(std::string_view key, SequenceNumber entrySequence, SequenceNumber readSequence) const;
+
+    /**
+     * @brief Copies the range deletions visible at a sequence number.
+     * @param sequence Sequence number to read at.
+     * @param tombstones Receives the deletions, appended oldest first.
+     */
+    void rangeDeletions(SequenceNumber sequence, std::vector<RangeTombstone> &tombstones) const;
+
+    /**
+     * @brief Number of distinct keys.
+     */
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief True if the memtable holds neither keys nor range deletions.
+     */
+    bool empty() const { return size() == 0 && rangeDeletionList.load(std::memory_order_acquire) == nullptr; }
+
+    /**
+     * @brief Bytes allocated by the arena.
+     */
+    size_t memoryUsage() const { return arena.memoryUsage(); }
+
+    /**
+     * @brief Returns a cursor over the entries visible at a sequence number.
+     * @param sequence Sequence number to read at.
+     */
+    std::unique_ptr<KeyValueIterator> newIterator(SequenceNumber sequence = MAX_SEQUENCE_NUMBER) const
+    {
+        return std::make_unique<Iterator>(this, sequence);
+    }
+};
+
+#endif // MEMTABLE_H
@@ -0,0 +1,149 @@
+#include "merging_iterator.h"
+#include <algorithm>
+
+/**
+ * @brief Creates a merged cursor.
+ * @param sources Cursors over the inputs, newest first.
+ */
+MergingIterator::MergingIterator(std::vector<std::unique_ptr<KeyValueIterator>> sources)
+    : children(std::move(sources))
+{
+    heap.reserve(children.size());
+}
+
+/**
+ * @brief Heap order: a child with a larger key, or the same key and an older
+ *        source, sinks below the other.
+ * @param a Child position.
+ * @param b Child position.
+ * @return True if a comes after b.
+ */
+bool MergingIterator::after(size_t a, size_t b) const
+{
+    int cmp = children[a]->key().compare(children[b]->key());
+    return cmp > 0 || (cmp == 0 && a > b);
+}
+
+/**
+ * @brief Rebuilds the heap from the valid children and selects the top.
+ */
+void MergingIterator::rebuild()
+{
+    heap.clear();
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (children[i]->valid())
+        {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), [this](size_t a, size_t b)
+                   { return after(a, b); });
+    selectTop();
+}
+
+/**
+ * @brief Pops the top child.
+ * @return Position of the child.
+ */
+size_t MergingIterator::popTop()
+{
+    std::pop_heap(heap.begin(), heap.end(), [this](size_t a, size_t b)
+                  { return after(a, b); });
+    size_t child = heap.back();
+    heap.pop_back();
+    return child;
+}
+
+/**
+ * @brief Pushes a child if it is still valid.
+ * @param child Position of the child.
+ */
+void MergingIterator::push(size_t child)
+{
+    if (children[child]->valid())
+    {
+        heap.push_back(child);
+        std::push_heap(heap.begin(), heap.end(), [this](size_t a, size_t b)
+                       { return after(a, b); });
+    }
+}
+
+/**
+ * @brief Selects the top of the heap as the current entry.
+ */
+void MergingIterator::selectTop()
+{
+    isValid = !heap.empty();
+    if (isValid)
+    {
+        current = heap.front();
+    }
+}
+
+/**
+ * @brief Positions at the smallest key of all children.
+ */
+void MergingIterator::seekToFirst()
+{
+    for (auto &child : children)
+    {
+        child->seekToFirst();
+    }
+    rebuild();
+}
+
+/**
+ * @brief Positions at the first key >= target in any child.
+ * @param target Key to seek to.
+ */
+void MergingIterator::seek(std::string_view target)
+{
+    for (auto &child : children)
+    {
+        child->seek(target);
+    }
+    rebuild();
+}
+
+/**
+ * @brief Advances past the current key in every child that holds it.
+ *
+ * The current child is on top of the heap; older children holding the same
+ * key follow it directly and are advanced too, dropping the shadowed versions.
+ */
+void MergingIterator::next()
+{
+    if (!isValid)
+    {
+        return;
+    }
+
+    std::string key(children[current]->key());
+    size_t child = popTop();
+    children[child]->next();
+    push(child);
+    while (!heap.empty() && children[heap.front()]->key() == key)
+    {
+        child = popTop();
+        children[child]->next();
+        push(child);
+    }
+    selectTop();
+}
+
+/**
+ * @brief True if any child stopped on corruption.
+ * @return Whether the merged output may be incomplete.
+ */
+bool MergingIterator::corrupted() const
+{
+    for (const auto &child : children)
+    {
+        if (child->corrupted())
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,72 @@
+#ifndef MERGING_ITERATOR_H
+#define MERGING_ITERATOR_H
+
+#include "iterator.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @file merging_iterator.h
+ * @brief K-way merge of sorted cursors with newest-wins resolution of duplicate keys.
+ */
+
+/**
+ * @brief Merges several sorted cursors into one.
+ *
+ * Children are given newest first. When several children hold the same key
+ * only the entry of the newest one is returned and the older versions are
+ * skipped, so the merged cursor visits every key once with its current
+ * value. A binary min-heap ordered by (key, child position) selects the next
+ * entry in O(log k) comparisons.
+ */
+class MergingIterator : public KeyValueIterator
+{
+private:
+    std::vector<std::unique_ptr<KeyValueIterator>> children;
+    std::vector<size_t> heap; ///< Valid children, smallest key (then newest) on top
+    size_t current = 0;       ///< Child holding the current entry
+    bool isValid = false;
+
+    /**
+     * @brief Heap order: true if child a comes after child b.
+     */
+    bool after(size_t a, size_t b) const;
+
+    /**
+     * @brief Rebuilds the heap from the valid children and selects the top.
+     */
+    void rebuild();
+
+    /**
+     * @brief Pops the top child; it is advanced and pushed back by the caller.
+     */
+    size_t popTop();
+
+    /**
+     * @brief Pushes a child if it is still valid.
+     */
+    void push(size_t child);
+
+    /**
+     * @brief Selects the top of the heap as the current entry.
+     */
+    void selectTop();
+
+public:
+    /**
+     * @brief Creates a merged cursor.
+     * @param sources Cursors over the inputs, newest first.
+     */
+    explicit MergingIterator(std::vector<std::unique_ptr<KeyValueIterator>> sources);
+
+    bool valid() const override { return isValid; }
+    void seekToFirst() override;
+    void seek(std::string_view target) override;
+    void next() override;
+    std::string_view key() const override { return children[current]->key(); }
+    std::string_view value() const override { return children[current]->value(); }
+    bool corrupted() const override;
+};
+
+#endif // MERGING_ITERATOR_H
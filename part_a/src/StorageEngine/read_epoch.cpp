@@ -0,0 +1,54 @@
+#include "read_epoch.h"
+#include <thread>
+
+/**
+ * @brief Slot of the calling thread.
+ *
+ * Threads are assigned slots round-robin on their first read, so up to
+ * READ_EPOCH_SLOTS reader threads never share a counter.
+ *
+ * @param owner Epoch whose slot is returned.
+ * @return The slot.
+ */
+ReadEpoch::Slot &ReadEpoch::slotOf(ReadEpoch &owner)
+{
+    static std::atomic<unsigned> nextSlot{0};
+    thread_local unsigned slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % READ_EPOCH_SLOTS;
+    return owner.slots[slot];
+}
+
+/**
+ * @brief Waits until no reader is counted under a parity.
+ *
+ * The counters are read with sequentially consistent loads, so a reader that
+ * loaded the shared state before the writer replaced it is still counted.
+ *
+ * @param parity Epoch parity to drain.
+ */
+void ReadEpoch::drain(unsigned parity)
+{
+    for (Slot &slot : slots)
+    {
+        while (slot.readers[parity].load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * @brief Waits until every reader that entered before the call has left.
+ *
+ * Each round flips the epoch, so new readers count under the other parity,
+ * and drains the previous one. Two rounds are needed: a reader may have read
+ * the epoch before the last flip of the previous call and incremented its
+ * counter only afterwards, under the parity the first round does not drain.
+ */
+void ReadEpoch::synchronize()
+{
+    std::lock_guard<std::mutex> lock(syncMutex);
+    for (int round = 0; round < 2; ++round)
+    {
+        drain((unsigned)(epoch.fetch_add(1) & 1));
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef READ_EPOCH_H
+#define READ_EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "config.h"
+
+/**
+ * @file read_epoch.h
+ * @brief Reclamation of shared state read without locks or reference counts.
+ */
+
+/**
+ * @brief Tracks readers so that state they may be reading is freed only once they are done.
+ *
+ * A reader wraps its accesses in a Guard, which increments one of two
+ * counters of the current epoch parity on entry and decrements it on exit. A
+ * writer replaces the shared pointer to the state, then calls synchronize(),
+ * which flips the epoch and waits for the counters of the previous parity to
+ * drain, twice, so that every reader that entered before the call has left;
+ * the replaced state can then be freed.
+ *
+ * Readers never block and never write a shared cache line: the counters are
+ * spread over READ_EPOCH_SLOTS cache lines and each thread uses the slot
+ * assigned to it on its first read. A reader must not call synchronize()
+ * while it holds a guard of the same epoch.
+ */
+class ReadEpoch
+{
+private:
+    /**
+     * @brief Reader counters of one group of threads, one per epoch parity.
+     */
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> readers[2] = {{0}, {0}};
+    };
+
+    alignas(64) std::atomic<uint64_t> epoch{0};
+    Slot slots[READ_EPOCH_SLOTS];
+    std::mutex syncMutex; ///< Serializes synchronize()
+
+    /**
+     * @brief Slot of the calling thread, assigned round-robin on first use.
+     */
+    static Slot &slotOf(ReadEpoch &owner);
+
+    /**
+     * @brief Waits until no reader is counted under a parity.
+     * @param parity Epoch parity to drain.
+     */
+    void drain(unsigned parity);
+
+public:
+    /**
+     * @brief Marks the calling thread as reading for the guard's lifetime.
+     */
+    class Guard
+    {
+    private:
+        std::atomic<uint64_t> &counter;
+
+    public:
+        explicit Guard(ReadEpoch &owner)
+            : counter(slotOf(owner).readers[owner.epoch.load() & 1])
+        {
+            // Sequentially consistent, so the state loaded next is ordered after the increment
+            counter.fetch_add(1);
+        }
+
+        ~Guard() { counter.fetch_sub(1, std::memory_order_release); }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    ReadEpoch() = default;
+    ReadEpoch(const ReadEpoch &) = delete;
+    ReadEpoch &operator=(const ReadEpoch &) = delete;
+
+    /**
+     * @brief Waits until every reader that entered before the call has left.
+     */
+    void synchronize();
+};
+
+#endif // READ_EPOCH_H
@@ -1,13 +1,20 @@
 #include "sstable.h"
+#include "table_builder.h"
+#include "coding.h"
+#include "entry_format.h"
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <iterator>
 
 /**
  * @brief Writes the SSTable data to a file on disk.
  *
- * Ensures that the parent directory exists before writing. The file is opened
- * in truncation mode, meaning any previous content is overwritten.
+ * Ensures that the parent directory exists before writing. The entries are
+ * written in key order in the binary block format described in
+ * table_format.h, their raw values (with "DELETED" marking deletions)
+ * converted to typed entries; the file is synced before returning, since the write-ahead
+ * log covering its entries is discarded afterwards.
  *
  * @param filename The name of the file where SSTable data will be stored.
  * @return True if the write operation was successful, false otherwise.
@@ -23,27 +30,83 @@ bool SSTable::writeToDisk(const std::string &filename)
         {
             std::filesystem::create_directories(parentPath);
         }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Exception while writing SSTable to disk: " << e.what() << std::endl;
+        return false;
+    }
 
-        std::ofstream file(filename, std::ios::out | std::ios::trunc);
-        if (!file.is_open())
-        {
-            std::cerr << "Failed to open file for writing: " << filename << std::endl;
-            return false;
-        }
+    TableBuilder builder;
+    if (!builder.open(filename))
+    {
+        return false;
+    }
 
-        for (const auto &entry : data)
-        {
-            file << entry.first << " " << entry.second << "\n";
-        }
+    std::string converted;
+    for (const auto &entry : data)
+    {
+        converted.clear();
+        encodeLegacyEntry(converted, entry.second);
+        builder.add(entry.first, converted);
+    }
+
+    return builder.finish();
+}
+
+/**
+ * @brief Reads an SSTable written in the text format of earlier versions.
+ *
+ * The format has one entry per line, key and value separated by the first
+ * space. Binary tables are served by TableReader instead and are rejected.
+ *
+ * @param filename The name of the file to read.
+ * @return True if the file was read successfully, false otherwise.
+ */
+bool SSTable::loadFromDisk(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open SSTable: " << filename << std::endl;
+        return false;
+    }
 
-        file.close();
-        return true;
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (file.bad())
+    {
+        std::cerr << "Failed to read SSTable: " << filename << std::endl;
+        return false;
     }
-    catch (const std::exception &e)
+
+    if (contents.size() >= SSTABLE_FOOTER_SIZE &&
+        decodeFixed64(contents.data() + contents.size() - 8) == SSTABLE_MAGIC)
     {
-        std::cerr << "Exception while writing SSTable to disk: " << e.what() << std::endl;
+        std::cerr << "Not a text SSTable: " << filename << std::endl;
         return false;
     }
+
+    data.clear();
+    bloomFilter = BloomFilter();
+
+    size_t lineStart = 0;
+    while (lineStart < contents.size())
+    {
+        size_t lineEnd = contents.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+        {
+            lineEnd = contents.size();
+        }
+
+        std::string_view line(contents.data() + lineStart, lineEnd - lineStart);
+        size_t separator = line.find(' ');
+        if (separator != std::string_view::npos)
+        {
+            addEntry(std::string(line.substr(0, separator)), std::string(line.substr(separator + 1)));
+        }
+        lineStart = lineEnd + 1;
+    }
+    return true;
 }
 
 /**
@@ -15,13 +15,15 @@
  * @brief Represents an SSTable (Sorted String Table) in the LSM tree.
  *
  * An SSTable is a persistent, immutable key-value store used in LSM trees.
- * It maintains a sorted map of key-value pairs and a Bloom filter for fast lookups.
+ * This class holds a table's sorted entries and Bloom filter in memory; it
+ * writes binary table files and reads text tables of earlier versions. Live
+ * tables are served from their files by TableReader.
  */
 class SSTable
 {
 public:
     BloomFilter bloomFilter;
-    std::map<std::string, std::string> data;
+    std::map<std::string, std::string, std::less<>> data;
 
     /**
      * @brief Writes the SSTable data to a file on disk.
@@ -31,6 +33,14 @@ public:
      */
     bool writeToDisk(const std::string &filename);
 
+    /**
+     * @brief Reads a text SSTable of earlier versions and rebuilds its Bloom filter.
+     *
+     * @param filename The name of the file to read.
+     * @return True if the file was read successfully, false otherwise.
+     */
+    bool loadFromDisk(const std::string &filename);
+
     /**
      * @brief Adds an entry to the SSTable and updates the Bloom filter.
      *
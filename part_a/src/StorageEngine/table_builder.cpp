@@ -0,0 +1,200 @@
+#include "table_builder.h"
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Write-buffer size; blocks are collected before calling write().
+ */
+static const size_t TABLE_WRITE_BUFFER_SIZE = 256 * 1024;
+
+/**
+ * @brief Removes the file if the table was neither finished nor abandoned.
+ */
+TableBuilder::~TableBuilder()
+{
+    if (fd >= 0)
+    {
+        abandon();
+    }
+}
+
+/**
+ * @brief Creates the table file.
+ *
+ * A builder may be reused after finish() or abandon(); opening clears the
+ * state of the previous table.
+ *
+ * @param path Path of the new file (truncated if it exists).
+ * @param blockCodec Codec compressing the table's blocks, or nullptr for none.
+ * @return True on success.
+ */
+bool TableBuilder::open(const std::string &path, const BlockCodec *blockCodec)
+{
+    abandon();
+    pendingWrite.clear();
+    offset = 0;
+    entries = 0;
+    failed = false;
+    dataBlock.reset();
+    indexBlock.reset();
+    filter = BloomFilter();
+    codec = blockCodec;
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open SSTable for writing: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    filename = path;
+    return true;
+}
+
+/**
+ * @brief Appends an entry, writing out the current data block once it
+ *        reaches SSTABLE_BLOCK_SIZE.
+ *
+ * @param key Key of the entry.
+ * @param value Value of the entry.
+ */
+void TableBuilder::add(std::string_view key, std::string_view value)
+{
+    dataBlock.add(key, value);
+    filter.add(key);
+    ++entries;
+
+    if (dataBlock.currentSizeEstimate() >= SSTABLE_BLOCK_SIZE)
+    {
+        flushDataBlock();
+    }
+}
+
+/**
+ * @brief Writes out the current data block and adds its index entry.
+ *
+ * The index maps the block's last key to its location, so the first index
+ * entry whose key is >= a lookup key names the only block that can hold it.
+ */
+void TableBuilder::flushDataBlock()
+{
+    if (dataBlock.empty())
+    {
+        return;
+    }
+
+    BlockHandle handle;
+    writeBlock(dataBlock.finish(), true, handle);
+
+    std::string encodedHandle;
+    handle.encodeTo(encodedHandle);
+    indexBlock.add(dataBlock.lastAddedKey(), encodedHandle);
+    dataBlock.reset();
+}
+
+/**
+ * @brief Appends a block and its trailer to the output.
+ *
+ * The block is stored compressed if requested and worthwhile; the trailer
+ * records which codec was used, and the handle covers the stored bytes.
+ *
+ * @param contents Block contents.
+ * @param compress True to compress the block with the table's codec.
+ * @param handle Receives the block's location.
+ */
+void TableBuilder::writeBlock(std::string_view contents, bool compress, BlockHandle &handle)
+{
+    BlockType type = BLOCK_UNCOMPRESSED;
+    if (compress && codec != nullptr && compressBlock(*codec, contents, compressed))
+    {
+        contents = compressed;
+        type = codec->type();
+    }
+
+    handle.offset = offset;
+    handle.size = contents.size();
+
+    pendingWrite.append(contents.data(), contents.size());
+    pendingWrite.append(blockTrailer(contents, type));
+    offset += contents.size() + BLOCK_TRAILER_SIZE;
+
+    if (pendingWrite.size() >= TABLE_WRITE_BUFFER_SIZE)
+    {
+        writePending();
+    }
+}
+
+/**
+ * @brief Hands buffered bytes to the file.
+ * @return False on a write error.
+ */
+bool TableBuilder::writePending()
+{
+    size_t written = 0;
+    while (!failed && written < pendingWrite.size())
+    {
+        ssize_t n = ::write(fd, pendingWrite.data() + written, pendingWrite.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Failed to write SSTable " << filename << ": " << std::strerror(errno) << std::endl;
+            failed = true;
+            break;
+        }
+        written += (size_t)n;
+    }
+    pendingWrite.clear();
+    return !failed;
+}
+
+/**
+ * @brief Writes the last data block, the filter and index blocks and the
+ *        footer, then syncs and closes the file.
+ *
+ * @return True if the complete table is on disk.
+ */
+bool TableBuilder::finish()
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    flushDataBlock();
+
+    Footer footer;
+    footer.entries = entries;
+    writeBlock(filter.serialize(), false, footer.filter);
+    writeBlock(indexBlock.finish(), true, footer.index);
+
+    std::string encodedFooter;
+    footer.encodeTo(encodedFooter);
+    pendingWrite.append(encodedFooter);
+    offset += encodedFooter.size();
+
+    if (!writePending() || fsync(fd) != 0)
+    {
+        abandon();
+        return false;
+    }
+
+    ::close(fd);
+    fd = -1;
+    return true;
+}
+
+/**
+ * @brief Stops building and deletes the partial file.
+ */
+void TableBuilder::abandon()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+        ::unlink(filename.c_str());
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef TABLE_BUILDER_H
+#define TABLE_BUILDER_H
+
+#include "block.h"
+#include "bloomfilter.h"
+#include "compression.h"
+#include "table_format.h"
+#include <string>
+#include <string_view>
+
+/**
+ * @file table_builder.h
+ * @brief Writer for binary SSTable files.
+ */
+
+/**
+ * @brief Streams sorted entries into a binary SSTable file.
+ *
+ * Entries are packed into data blocks of about SSTABLE_BLOCK_SIZE bytes. When
+ * a block fills up it is written out and its last key and location are added
+ * to the index block; finish() appends the filter block, the index block and
+ * the footer (see table_format.h) and syncs the file. Data and index blocks
+ * are compressed with the codec the table is opened with, unless that saves
+ * too little (see compressBlock()).
+ */
+class TableBuilder
+{
+private:
+    int fd = -1;
+    std::string filename;
+    std::string pendingWrite; ///< Bytes not yet handed to write()
+    uint64_t offset = 0;      ///< Bytes produced so far
+    size_t entries = 0;
+    bool failed = false;
+    const BlockCodec *codec = nullptr; ///< Codec of data and index blocks, or nullptr for none
+    std::string compressed;            ///< Buffer for the stored form of a compressed block
+
+    BlockBuilder dataBlock;
+    BlockBuilder indexBlock;
+    BloomFilter filter;
+
+    /**
+     * @brief Writes out the current data block and indexes it.
+     */
+    void flushDataBlock();
+
+    /**
+     * @brief Appends a block with its trailer.
+     * @param contents Block contents.
+     * @param compress True to compress the block with the table's codec.
+     * @param handle Receives the block's location.
+     */
+    void writeBlock(std::string_view contents, bool compress, BlockHandle &handle);
+
+    /**
+     * @brief Hands buffered bytes to the file.
+     * @return False on a write error.
+     */
+    bool writePending();
+
+public:
+    TableBuilder() = default;
+    TableBuilder(const TableBuilder &) = delete;
+    TableBuilder &operator=(const TableBuilder &) = delete;
+
+    /**
+     * @brief Removes the file if the table was neither finished nor abandoned.
+     */
+    ~TableBuilder();
+
+    /**
+     * @brief Creates the table file.
+     * @param path Path of the new file (truncated if it exists).
+     * @param blockCodec Codec compressing the table's blocks, or nullptr for none.
+     * @return True on success.
+     */
+    bool open(const std::string &path, const BlockCodec *blockCodec = nullptr);
+
+    /**
+     * @brief Appends an entry; keys must be added in strictly increasing order.
+     * @param key Key of the entry.
+     * @param value Value of the entry.
+     */
+    void add(std::string_view key, std::string_view value);
+
+    /**
+     * @brief Writes the remaining blocks and the footer and syncs the file.
+     * @return True if the complete table is on disk.
+     */
+    bool finish();
+
+    /**
+     * @brief Stops building and deletes the partial file.
+     */
+    void abandon();
+
+    /**
+     * @brief Number of entries added.
+     */
+    size_t numEntries() const { return entries; }
+
+    /**
+     * @brief Size of the file produced so far.
+     */
+    uint64_t fileSize() const { return offset; }
+};
+
+#endif // TABLE_BUILDER_H
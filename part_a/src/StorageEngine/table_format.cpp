@@ -0,0 +1,114 @@
+#include "table_format.h"
+#include "coding.h"
+
+/**
+ * @brief Appends the handle as two varints.
+ * @param dst Destination buffer.
+ */
+void BlockHandle::encodeTo(std::string &dst) const
+{
+    putVarint64(dst, offset);
+    putVarint64(dst, size);
+}
+
+/**
+ * @brief Decodes a handle and advances the cursor.
+ * @param p Cursor.
+ * @param end End of the readable range.
+ * @return False if the input is malformed.
+ */
+bool BlockHandle::decodeFrom(const char *&p, const char *end)
+{
+    return getVarint64(p, end, offset) && getVarint64(p, end, size);
+}
+
+/**
+ * @brief Appends the footer.
+ *
+ * Fields are fixed-width so the footer can be read from a known offset:
+ * filter offset/size, index offset/size, entry count (fixed64 each),
+ * version (fixed32), magic (fixed64).
+ *
+ * @param dst Destination buffer.
+ */
+void Footer::encodeTo(std::string &dst) const
+{
+    putFixed64(dst, filter.offset);
+    putFixed64(dst, filter.size);
+    putFixed64(dst, index.offset);
+    putFixed64(dst, index.size);
+    putFixed64(dst, entries);
+    putFixed32(dst, version);
+    putFixed64(dst, SSTABLE_MAGIC);
+}
+
+/**
+ * @brief Decodes the footer.
+ * @param input The last SSTABLE_FOOTER_SIZE bytes of a table file.
+ * @return False if the input is not a footer of a supported version.
+ */
+bool Footer::decodeFrom(std::string_view input)
+{
+    if (input.size() != SSTABLE_FOOTER_SIZE)
+    {
+        return false;
+    }
+
+    const char *p = input.data();
+    if (decodeFixed64(p + 44) != SSTABLE_MAGIC)
+    {
+        return false;
+    }
+
+    filter.offset = decodeFixed64(p);
+    filter.size = decodeFixed64(p + 8);
+    index.offset = decodeFixed64(p + 16);
+    index.size = decodeFixed64(p + 24);
+    entries = decodeFixed64(p + 32);
+    version = decodeFixed32(p + 40);
+    return version >= 1 && version <= SSTABLE_FORMAT_VERSION;
+}
+
+/**
+ * @brief Returns the trailer to write after a block.
+ * @param contents Block as stored, compressed or not.
+ * @param type Block type.
+ * @return Type byte followed by the CRC-32C of contents and type.
+ */
+std::string blockTrailer(std::string_view contents, BlockType type)
+{
+    std::string trailer;
+    trailer.push_back((char)type);
+    uint32_t crc = crc32c(contents.data(), contents.size());
+    crc = crc32c(trailer.data(), 1, crc);
+    putFixed32(trailer, crc);
+    return trailer;
+}
+
+/**
+ * @brief Verifies a block read from disk and strips its trailer.
+ * @param raw Stored block followed by the trailer.
+ * @param contents Receives the stored block, compressed if type says so.
+ * @param type Receives the block type.
+ * @param verifyChecksum False to check only the block type.
+ * @return False on a checksum mismatch or unknown block type.
+ */
+bool verifyBlock(std::string_view raw, std::string_view &contents, BlockType &type, bool verifyChecksum)
+{
+    if (raw.size() < BLOCK_TRAILER_SIZE)
+    {
+        return false;
+    }
+
+    size_t size = raw.size() - BLOCK_TRAILER_SIZE;
+    const char *trailer = raw.data() + size;
+    if ((uint8_t)trailer[0] > BLOCK_ZSTD ||
+        (verifyChecksum && crc32c(raw.data(), size + 1) != decodeFixed32(trailer + 1)))
+    {
+        return false;
+    }
+
+    type = (BlockType)trailer[0];
+    contents = raw.substr(0, size);
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef TABLE_FORMAT_H
+#define TABLE_FORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @file table_format.h
+ * @brief On-disk layout of binary SSTable files.
+ *
+ * A table file is laid out as
+ *
+ *     data block 0 | ... | data block N-1 | filter block | index block | footer
+ *
+ * Every block is followed by a 5-byte trailer: one byte naming the block's
+ * compression and the CRC-32C of the stored block plus that byte. A
+ * compressed block is stored as its uncompressed size (varint32) followed by
+ * the output of the codec the type byte names (see compression.h); the
+ * filter block is always stored uncompressed. The
+ * index block is a regular block (see BlockBuilder) mapping the last key of
+ * each data block to its BlockHandle. The filter block holds the serialized
+ * Bloom filter of all keys; version 1 tables carry a fixed-size filter of an
+ * earlier layout, which is ignored. The fixed-size footer at the end of the file
+ * locates the filter and index blocks and carries the format version and a
+ * magic number.
+ *
+ * Data blocks map keys to entries tagged with their type and sequence number
+ * (see entry_format.h). Tables of versions 1 to 3 map keys to raw values, with
+ * the value "DELETED" marking deletions; TableReader converts their values to
+ * entries as they are read.
+ */
+
+/**
+ * @brief Magic number at the end of every binary SSTable ("BLINKSST").
+ */
+#define SSTABLE_MAGIC 0x5453534b4e494c42ULL
+
+/**
+ * @brief Current version of the SSTable format.
+ */
+#define SSTABLE_FORMAT_VERSION 4
+
+/**
+ * @brief Size of the trailer following every block (type byte + CRC-32C).
+ */
+#define BLOCK_TRAILER_SIZE 5
+
+/**
+ * @brief Size of the footer: two block handles, entry count, version, magic.
+ */
+#define SSTABLE_FOOTER_SIZE 52
+
+/**
+ * @brief Compression applied to a block's contents.
+ */
+enum BlockType : uint8_t
+{
+    BLOCK_UNCOMPRESSED = 0,
+    BLOCK_LZ = 1,  ///< Built-in LZ77 codec
+    BLOCK_LZ4 = 2, ///< LZ4 block format
+    BLOCK_ZSTD = 3 ///< Zstandard frame
+};
+
+/**
+ * @brief Location of a block in a table file.
+ */
+struct BlockHandle
+{
+    uint64_t offset = 0; ///< File offset of the block
+    uint64_t size = 0;   ///< Size of the block contents, excluding the trailer
+
+    /**
+     * @brief Appends the handle as two varints.
+     */
+    void encodeTo(std::string &dst) const;
+
+    /**
+     * @brief Decodes a handle and advances the cursor.
+     * @return False if the input is malformed.
+     */
+    bool decodeFrom(const char *&p, const char *end);
+};
+
+/**
+ * @brief Fixed-size trailer of a table file.
+ */
+struct Footer
+{
+    BlockHandle filter;
+    BlockHandle index;
+    uint64_t entries = 0;
+    uint32_t version = SSTABLE_FORMAT_VERSION;
+
+    /**
+     * @brief Appends the SSTABLE_FOOTER_SIZE bytes of the footer.
+     */
+    void encodeTo(std::string &dst) const;
+
+    /**
+     * @brief Decodes the footer from the last SSTABLE_FOOTER_SIZE bytes of a file.
+     * @param input Exactly SSTABLE_FOOTER_SIZE bytes.
+     * @return False if the magic number or version does not match.
+     */
+    bool decodeFrom(std::string_view input);
+};
+
+/**
+ * @brief Returns the trailer to write after a block.
+ * @param contents Block contents as written.
+ * @param type Block type.
+ * @return BLOCK_TRAILER_SIZE bytes.
+ */
+std::string blockTrailer(std::string_view contents, BlockType type);
+
+/**
+ * @brief Verifies a block read from disk and strips its trailer.
+ * @param raw Stored block followed by the trailer.
+ * @param contents Receives the stored block, compressed if type says so.
+ * @param type Receives the block type.
+ * @param verifyChecksum False to check only the block type.
+ * @return False on a checksum mismatch or unknown block type.
+ */
+bool verifyBlock(std::string_view raw, std::string_view &contents, BlockType &type, bool verifyChecksum = true);
+
+#endif // TABLE_FORMAT_H
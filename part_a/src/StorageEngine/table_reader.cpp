@@ -0,0 +1,477 @@
+#include "table_reader.h"
+#include "block.h"
+#include "compression.h"
+#include "coding.h"
+#include "entry_format.h"
+#include <algorithm>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Unmaps the file.
+ */
+TableReader::~TableReader()
+{
+    if (base != nullptr)
+    {
+        munmap((void *)base, size);
+    }
+}
+
+/**
+ * @brief Maps a table file and loads its filter and index.
+ *
+ * The descriptor is closed once the mapping exists. Lookups touch a single
+ * block each, so the mapping is advised as randomly accessed to keep the
+ * kernel from reading ahead.
+ *
+ * @param path Path of a file written by TableBuilder.
+ * @param blockCache Cache for data blocks, or nullptr to read them from the mapping.
+ * @return True on success; errors are reported on stderr.
+ */
+bool TableReader::open(const std::string &path, BlockCache *blockCache)
+{
+    filename = path;
+    cache = blockCache;
+    if (cache != nullptr)
+    {
+        cacheId = cache->newId();
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open SSTable: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < SSTABLE_FOOTER_SIZE)
+    {
+        std::cerr << "Corrupt SSTable: " << path << ": file too short" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Failed to map SSTable: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    base = (const char *)mapping;
+    size = (size_t)st.st_size;
+    madvise(mapping, size, MADV_RANDOM);
+
+    if (!readMetadata())
+    {
+        std::cerr << "Corrupt SSTable: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Decodes the footer, filter and index of the mapped file.
+ *
+ * The filter and index are verified and copied out of the mapping so that
+ * they stay resident; the first data block is read for the smallest key.
+ * Tables of format version 1 are read without their filter, so every lookup
+ * searches their index until compaction rewrites them.
+ *
+ * @return True if the file is a valid table.
+ */
+bool TableReader::readMetadata()
+{
+    Footer footer;
+    if (!footer.decodeFrom(std::string_view(base + size - SSTABLE_FOOTER_SIZE, SSTABLE_FOOTER_SIZE)))
+    {
+        return false;
+    }
+    entries = footer.entries;
+    legacyValues = footer.version < 4;
+
+    std::string_view filterContents, indexContents;
+    std::string filterBuffer, indexBuffer;
+    BlockReader indexBlock;
+    if (!readBlock(footer.filter, filterContents, filterBuffer, true) ||
+        (footer.version >= 2 && !filter.deserialize(filterContents)) ||
+        !readBlock(footer.index, indexContents, indexBuffer, true) || !indexBlock.init(indexContents))
+    {
+        return false;
+    }
+
+    BlockReader::Iterator it = indexBlock.iterator();
+    for (it.seekToFirst(); it.valid(); it.next())
+    {
+        IndexEntry entry;
+        entry.lastKey = it.key();
+        const char *p = it.value().data();
+        if (!entry.handle.decodeFrom(p, p + it.value().size()))
+        {
+            return false;
+        }
+        index.push_back(std::move(entry));
+    }
+    if (it.corrupted())
+    {
+        return false;
+    }
+    index.shrink_to_fit();
+
+    if (!index.empty())
+    {
+        std::string_view contents;
+        std::string buffer;
+        BlockReader first;
+        if (!readBlock(index.front().handle, contents, buffer, true) || !first.init(contents))
+        {
+            return false;
+        }
+        BlockReader::Iterator firstIt = first.iterator();
+        firstIt.seekToFirst();
+        if (!firstIt.valid())
+        {
+            return false;
+        }
+        smallest = firstIt.key();
+    }
+    return true;
+}
+
+/**
+ * @brief Locates a block in the mapping, strips its trailer and uncompresses it.
+ *
+ * An uncompressed block is returned in place in the mapping; a compressed
+ * one is decoded into the buffer.
+ *
+ * @param handle Location of the block.
+ * @param contents Receives the block contents.
+ * @param buffer Holds the contents of a compressed block.
+ * @param verifyChecksum True to verify the block's CRC.
+ * @return False if the handle is out of range, the block is corrupt or its
+ *         codec is not built in.
+ */
+bool TableReader::readBlock(const BlockHandle &handle, std::string_view &contents, std::string &buffer,
+                            bool verifyChecksum) const
+{
+    if (handle.offset > size || handle.size + BLOCK_TRAILER_SIZE > size - handle.offset)
+    {
+        return false;
+    }
+    BlockType type;
+    if (!verifyBlock(std::string_view(base + handle.offset, handle.size + BLOCK_TRAILER_SIZE), contents, type,
+                     verifyChecksum))
+    {
+        return false;
+    }
+    if (type == BLOCK_UNCOMPRESSED)
+    {
+        return true;
+    }
+    if (!uncompressBlock(type, contents, buffer))
+    {
+        return false;
+    }
+    contents = buffer;
+    return true;
+}
+
+/**
+ * @brief Reads a data block for a lookup.
+ *
+ * Blocks entering the cache are always verified and enter it uncompressed;
+ * without a cache the block is read from the mapping and verified only if
+ * SSTABLE_VERIFY_READS is set. A cached block stays pinned while the caller
+ * holds the handle.
+ *
+ * @param entry Index entry of the block.
+ * @param cached Receives the pin on the block when it comes from the cache.
+ * @param buffer Holds the block when it was compressed and there is no cache.
+ * @param block Receives the parsed block.
+ * @return False if the block is corrupt.
+ */
+bool TableReader::readDataBlock(const IndexEntry &entry, BlockCache::Handle &cached, std::string &buffer,
+                                BlockReader &block) const
+{
+    std::string_view contents;
+    bool ok;
+    if (cache != nullptr)
+    {
+        cached = cache->lookup(cacheId, entry.handle.offset);
+        ok = true;
+        if (!cached)
+        {
+            ok = readBlock(entry.handle, contents, buffer, true);
+            if (ok)
+            {
+                std::string copy = contents.data() == buffer.data() ? std::move(buffer) : std::string(contents);
+                cached = cache->insert(cacheId, entry.handle.offset, std::move(copy));
+            }
+        }
+        if (ok)
+        {
+            contents = cached.contents();
+        }
+    }
+    else
+    {
+        ok = readBlock(entry.handle, contents, buffer, SSTABLE_VERIFY_READS);
+    }
+
+    if (!ok || !block.init(contents))
+    {
+        std::cerr << "Corrupt block in SSTable " << filename << " at offset " << entry.handle.offset << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Looks up a key.
+ *
+ * The index holds the last key of every block in order, so the first entry
+ * not less than the key names the only block that can contain it. The block
+ * stays pinned in the cache while it is searched.
+ *
+ * @param key Key to find.
+ * @param entry Receives the entry of the key if found.
+ * @return True if the table holds the key.
+ */
+bool TableReader::get(std::string_view key, std::string &entry) const
+{
+    if (!filter.mightContain(key))
+    {
+        return false;
+    }
+
+    auto it = std::lower_bound(index.begin(), index.end(), key, [](const IndexEntry &entry, std::string_view k)
+                               { return std::string_view(entry.lastKey) < k; });
+    if (it == index.end())
+    {
+        return false;
+    }
+
+    BlockCache::Handle cached;
+    std::string buffer;
+    BlockReader block;
+    if (!readDataBlock(*it, cached, buffer, block) || !block.get(key, entry))
+    {
+        return false;
+    }
+    if (legacyValues)
+    {
+        std::string value = std::move(entry);
+        entry.clear();
+        encodeLegacyEntry(entry, value);
+    }
+    return true;
+}
+
+/**
+ * @brief Looks up a batch of keys.
+ *
+ * Keys rejected by the filter are skipped. Since the keys are sorted, the
+ * block of each remaining key is found by a binary search of the index
+ * entries after the previous key's block, and consecutive keys in the same
+ * block share one read (and one cache pin) of it.
+ *
+ * @param keys Keys to find, in increasing order.
+ * @param values Receives the entry of each key found, at the key's position.
+ * @param found Set to 1 at the position of each key found.
+ * @return Number of keys found.
+ */
+size_t TableReader::multiGet(const std::vector<std::string_view> &keys, std::vector<std::string> &values,
+                             std::vector<char> &found) const
+{
+    std::vector<char> candidates;
+    filter.mightContain(keys, candidates);
+
+    size_t hits = 0;
+    auto blockIt = index.begin();
+    auto loadedIt = index.end();
+    BlockCache::Handle cached;
+    std::string buffer;
+    BlockReader block;
+    bool blockOk = false;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        if (!candidates[i])
+        {
+            continue;
+        }
+
+        blockIt = std::lower_bound(blockIt, index.end(), keys[i], [](const IndexEntry &entry, std::string_view k)
+                                   { return std::string_view(entry.lastKey) < k; });
+        if (blockIt == index.end())
+        {
+            break;
+        }
+        if (blockIt != loadedIt)
+        {
+            cached.reset();
+            blockOk = readDataBlock(*blockIt, cached, buffer, block);
+            loadedIt = blockIt;
+        }
+        if (blockOk && block.get(keys[i], values[i]))
+        {
+            if (legacyValues)
+            {
+                std::string value = std::move(values[i]);
+                values[i].clear();
+                encodeLegacyEntry(values[i], value);
+            }
+            found[i] = 1;
+            ++hits;
+        }
+    }
+    return hits;
+}
+
+/**
+ * @brief Two-level cursor over a table: the index picks the block, a block
+ *        iterator walks its entries.
+ */
+class TableIterator : public KeyValueIterator
+{
+private:
+    const TableReader *table;
+    size_t blockIndex = 0;
+    std::string buffer; ///< Contents of the current block if it is compressed
+    mutable std::string converted; ///< Entry of the current value of a legacy table
+    BlockReader block;
+    BlockReader::Iterator blockIt;
+    bool corrupt = false;
+
+    /**
+     * @brief Loads a data block, leaving the block iterator unpositioned.
+     * @param i Index entry of the block.
+     * @return False past the last block or if the block is corrupt.
+     */
+    bool loadBlock(size_t i)
+    {
+        blockIndex = i;
+        blockIt = BlockReader::Iterator();
+        if (i >= table->index.size())
+        {
+            return false;
+        }
+
+        std::string_view contents;
+        if (!table->readBlock(table->index[i].handle, contents, buffer, true) || !block.init(contents))
+        {
+            std::cerr << "Corrupt block in SSTable " << table->filename << " at offset "
+                      << table->index[i].handle.offset << std::endl;
+            corrupt = true;
+            return false;
+        }
+        blockIt = block.iterator();
+        return true;
+    }
+
+    /**
+     * @brief Moves past the end of exhausted blocks to the next entry.
+     */
+    void skipExhaustedBlocks()
+    {
+        while (!blockIt.valid() && !corrupt)
+        {
+            if (blockIt.corrupted())
+            {
+                corrupt = true;
+                return;
+            }
+            if (!loadBlock(blockIndex + 1))
+            {
+                return;
+            }
+            blockIt.seekToFirst();
+        }
+    }
+
+public:
+    explicit TableIterator(const TableReader *reader) : table(reader) {}
+
+    bool valid() const override { return !corrupt && blockIt.valid(); }
+    bool corrupted() const override { return corrupt; }
+    std::string_view key() const override { return blockIt.key(); }
+
+    std::string_view value() const override
+    {
+        if (!table->legacyValues)
+        {
+            return blockIt.value();
+        }
+        converted.clear();
+        encodeLegacyEntry(converted, blockIt.value());
+        return converted;
+    }
+
+    void seekToFirst() override
+    {
+        corrupt = false;
+        if (loadBlock(0))
+        {
+            blockIt.seekToFirst();
+        }
+        skipExhaustedBlocks();
+    }
+
+    void seek(std::string_view target) override
+    {
+        corrupt = false;
+        auto it = std::lower_bound(table->index.begin(), table->index.end(), target,
+                                   [](const TableReader::IndexEntry &entry, std::string_view k)
+                                   { return std::string_view(entry.lastKey) < k; });
+        if (loadBlock((size_t)(it - table->index.begin())))
+        {
+            blockIt.seek(target);
+        }
+        skipExhaustedBlocks();
+    }
+
+    void next() override
+    {
+        blockIt.next();
+        skipExhaustedBlocks();
+    }
+};
+
+/**
+ * @brief Returns a cursor over all entries of the table.
+ * @return A new, unpositioned cursor.
+ */
+std::unique_ptr<KeyValueIterator> TableReader::newIterator() const
+{
+    return std::make_unique<TableIterator>(this);
+}
+
+/**
+ * @brief Largest key in the table, the last key of its last block.
+ * @return The key, or an empty string for an empty table.
+ */
+const std::string &TableReader::largestKey() const
+{
+    static const std::string empty;
+    return index.empty() ? empty : index.back().lastKey;
+}
+
+/**
+ * @brief Heap memory held by the filter and index.
+ * @return Approximate size in bytes.
+ */
+size_t TableReader::memoryUsage() const
+{
+    size_t usage = sizeof(*this) + filter.memoryUsage() + index.capacity() * sizeof(IndexEntry) + smallest.capacity();
+    for (const IndexEntry &entry : index)
+    {
+        usage += entry.lastKey.capacity();
+    }
+    return usage;
+}
@@ -0,0 +1,168 @@
+#ifndef TABLE_READER_H
+#define TABLE_READER_H
+
+#include "bloomfilter.h"
+#include "block.h"
+#include "block_cache.h"
+#include "iterator.h"
+#include "table_format.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file table_reader.h
+ * @brief Reader serving lookups from a memory-mapped binary SSTable file.
+ */
+
+/**
+ * @brief Read-only access to a binary SSTable.
+ *
+ * The file is memory-mapped; only its Bloom filter and its decoded index (the
+ * last key and location of every data block) are copied to the heap, so the
+ * resident memory of an open table is proportional to its number of blocks
+ * rather than to its data. A lookup checks the filter, binary-searches the
+ * index for the single data block that can hold the key and binary-searches
+ * that block's restart points, letting the kernel page data in and out as
+ * needed. With a block cache, data blocks are verified once and served from
+ * the cache afterwards. Compressed blocks are uncompressed on every read from
+ * the mapping; the cache holds them uncompressed, so a cache hit costs no
+ * decoding. Values are returned as entries (see entry_format.h), converted
+ * from the raw values of tables written before entries were typed.
+ */
+class TableReader
+{
+private:
+    /**
+     * @brief Index entry of one data block.
+     */
+    struct IndexEntry
+    {
+        std::string lastKey; ///< Largest key in the block
+        BlockHandle handle;  ///< Location of the block
+    };
+
+    std::string filename;
+    const char *base = nullptr; ///< Start of the mapping
+    size_t size = 0;            ///< Length of the mapping
+    BloomFilter filter;
+    std::vector<IndexEntry> index;
+    std::string smallest;
+    uint64_t entries = 0;
+    BlockCache *cache = nullptr;
+    uint64_t cacheId = 0; ///< Identifies this table's blocks in the cache
+    bool legacyValues = false; ///< Written before entries were typed; values are converted when read
+
+    /**
+     * @brief Locates a block in the mapping, strips its trailer and uncompresses it.
+     * @param handle Location of the block.
+     * @param contents Receives the block contents.
+     * @param buffer Holds the contents of a compressed block.
+     * @param verifyChecksum True to verify the block's CRC.
+     * @return False if the handle is out of range or the block is corrupt.
+     */
+    bool readBlock(const BlockHandle &handle, std::string_view &contents, std::string &buffer,
+                   bool verifyChecksum) const;
+
+    /**
+     * @brief Reads a data block for a lookup, through the block cache if there is one.
+     * @param entry Index entry of the block.
+     * @param cached Receives the pin on the block when it comes from the cache.
+     * @param buffer Holds the block when it was compressed and there is no cache.
+     * @param block Receives the parsed block.
+     * @return False if the block is corrupt; the error is reported on stderr.
+     */
+    bool readDataBlock(const IndexEntry &entry, BlockCache::Handle &cached, std::string &buffer,
+                       BlockReader &block) const;
+
+    /**
+     * @brief Decodes the footer, filter and index of the mapped file.
+     * @return True if the file is a valid table.
+     */
+    bool readMetadata();
+
+    friend class TableIterator;
+
+public:
+    TableReader() = default;
+    TableReader(const TableReader &) = delete;
+    TableReader &operator=(const TableReader &) = delete;
+
+    /**
+     * @brief Unmaps the file.
+     */
+    ~TableReader();
+
+    /**
+     * @brief Maps a table file and loads its filter and index.
+     * @param path Path of a file written by TableBuilder.
+     * @param blockCache Cache for data blocks, or nullptr to read them from the mapping.
+     * @return True on success; errors are reported on stderr.
+     */
+    bool open(const std::string &path, BlockCache *blockCache = nullptr);
+
+    /**
+     * @brief Looks up a key.
+     * @param key Key to find.
+     * @param entry Receives the entry of the key if found.
+     * @return True if the table holds the key.
+     */
+    bool get(std::string_view key, std::string &entry) const;
+
+    /**
+     * @brief Looks up a batch of keys.
+     *
+     * The filter is probed for the whole batch first, then the index is
+     * walked once in key order and every data block is read a single time
+     * for all the keys it may hold.
+     *
+     * @param keys Keys to find, in increasing order.
+     * @param values Receives the entry of each key found, at the key's position.
+     * @param found Set to 1 at the position of each key found; other positions are left unchanged.
+     * @return Number of keys found.
+     */
+    size_t multiGet(const std::vector<std::string_view> &keys, std::vector<std::string> &values,
+                    std::vector<char> &found) const;
+
+    /**
+     * @brief Returns a cursor over all entries of the table.
+     *
+     * Blocks are read from the mapping and verified, bypassing the block cache
+     * so that bulk reads do not evict blocks of point lookups. The reader must
+     * outlive the cursor.
+     */
+    std::unique_ptr<KeyValueIterator> newIterator() const;
+
+    /**
+     * @brief Number of entries in the table.
+     */
+    uint64_t numEntries() const { return entries; }
+
+    /**
+     * @brief Smallest key in the table (empty for an empty table).
+     */
+    const std::string &smallestKey() const { return smallest; }
+
+    /**
+     * @brief Largest key in the table (empty for an empty table).
+     */
+    const std::string &largestKey() const;
+
+    /**
+     * @brief Size of the table file.
+     */
+    size_t fileSize() const { return size; }
+
+    /**
+     * @brief Heap memory held by the filter and index.
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * @brief Path the table was opened from.
+     */
+    const std::string &fileName() const { return filename; }
+};
+
+#endif // TABLE_READER_H
@@ -0,0 +1,399 @@
+#include "version.h"
+#include <algorithm>
+
+/**
+ * @brief Total file size of a level.
+ * @param level Level number.
+ * @return Bytes.
+ */
+uint64_t Version::levelBytes(int level) const
+{
+    uint64_t total = 0;
+    for (const auto &table : levels[level])
+    {
+        total += table->reader->fileSize();
+    }
+    return total;
+}
+
+/**
+ * @brief First table of a level >= 1 whose largest key is not less than a key.
+ * @param tables Tables of the level, sorted and disjoint.
+ * @param key Key to find.
+ * @return Position of the table, or the end of the level.
+ */
+static std::vector<LiveTablePtr>::const_iterator findTable(const std::vector<LiveTablePtr> &tables, std::string_view key)
+{
+    return std::lower_bound(tables.begin(), tables.end(), key, [](const LiveTablePtr &table, std::string_view k)
+                            { return std::string_view(table->meta.largest) < k; });
+}
+
+/**
+ * @brief Tables of a level whose key range intersects [smallest, largest].
+ *
+ * Level-0 ranges may overlap, so every table is checked; on deeper levels the
+ * matching tables are a contiguous run found by binary search.
+ *
+ * @param level Level number.
+ * @param smallest Lower bound of the range.
+ * @param largest Upper bound of the range.
+ * @return The tables, in level order.
+ */
+std::vector<LiveTablePtr> Version::overlapping(int level, std::string_view smallest, std::string_view largest) const
+{
+    std::vector<LiveTablePtr> result;
+    const auto &tables = levels[level];
+    auto it = level == 0 ? tables.begin() : findTable(tables, smallest);
+    for (; it != tables.end(); ++it)
+    {
+        const LiveTablePtr &table = *it;
+        if (std::string_view(table->meta.smallest) > largest)
+        {
+            if (level > 0)
+            {
+                break;
+            }
+            continue;
+        }
+        if (std::string_view(table->meta.largest) >= smallest)
+        {
+            result.push_back(table);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief The only table of a level >= 1 whose key range can contain a key.
+ *
+ * Tables of a deeper level are disjoint and sorted, so the first one whose
+ * largest key is not less than the key is the only candidate; it holds the
+ * key only if its smallest key does not exceed it.
+ *
+ * @param level Level number, at least 1.
+ * @param key Key to find.
+ * @return The table, or nullptr if the key falls outside every table's range.
+ */
+LiveTablePtr Version::tableForKey(int level, std::string_view key) const
+{
+    const auto &tables = levels[level];
+    auto it = findTable(tables, key);
+    if (it == tables.end() || std::string_view((*it)->meta.smallest) > key)
+    {
+        return nullptr;
+    }
+    return *it;
+}
+
+/**
+ * @brief Cursor over the disjoint, sorted tables of one level.
+ *
+ * Each table is opened for iteration when the cursor reaches it, and a seek
+ * binary-searches the key ranges for the only table that can hold the target.
+ */
+class LevelIterator : public KeyValueIterator
+{
+private:
+    const std::vector<LiveTablePtr> &tables;
+    size_t tableIndex = 0;
+    std::unique_ptr<KeyValueIterator> tableIt;
+    bool corrupt = false;
+
+    /**
+     * @brief Starts iterating a table, leaving its cursor unpositioned.
+     * @param i Position of the table in the level.
+     */
+    void openTable(size_t i)
+    {
+        tableIndex = i;
+        tableIt = i < tables.size() ? tables[i]->reader->newIterator() : nullptr;
+    }
+
+    /**
+     * @brief Moves past the end of exhausted tables to the next entry.
+     */
+    void skipExhaustedTables()
+    {
+        while (tableIt && !tableIt->valid())
+        {
+            if (tableIt->corrupted())
+            {
+                corrupt = true;
+                return;
+            }
+            openTable(tableIndex + 1);
+            if (tableIt)
+            {
+                tableIt->seekToFirst();
+            }
+        }
+    }
+
+public:
+    explicit LevelIterator(const std::vector<LiveTablePtr> &levelTables) : tables(levelTables) {}
+
+    bool valid() const override { return !corrupt && tableIt && tableIt->valid(); }
+    bool corrupted() const override { return corrupt; }
+    std::string_view key() const override { return tableIt->key(); }
+    std::string_view value() const override { return tableIt->value(); }
+
+    void seekToFirst() override
+    {
+        corrupt = false;
+        openTable(0);
+        if (tableIt)
+        {
+            tableIt->seekToFirst();
+        }
+        skipExhaustedTables();
+    }
+
+    void seek(std::string_view target) override
+    {
+        corrupt = false;
+        openTable((size_t)(findTable(tables, target) - tables.begin()));
+        if (tableIt)
+        {
+            tableIt->seek(target);
+        }
+        skipExhaustedTables();
+    }
+
+    void next() override
+    {
+        tableIt->next();
+        skipExhaustedTables();
+    }
+};
+
+/**
+ * @brief Returns a cursor over the tables of a level >= 1 as one sorted run.
+ * @param level Level number, at least 1.
+ * @return A new, unpositioned cursor.
+ */
+std::unique_ptr<KeyValueIterator> Version::newLevelIterator(int level) const
+{
+    return std::make_unique<LevelIterator>(levels[level]);
+}
+
+/**
+ * @brief Size budget of a level.
+ * @param level Level number, at least 1.
+ * @return LEVEL1_MAX_BYTES times LEVEL_SIZE_MULTIPLIER per level below 1.
+ */
+uint64_t Version::maxBytesForLevel(int level)
+{
+    uint64_t bytes = LEVEL1_MAX_BYTES;
+    for (int i = 1; i < level; ++i)
+    {
+        bytes *= LEVEL_SIZE_MULTIPLIER;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Chooses the most urgent compaction.
+ *
+ * All level-0 tables are compacted together since their ranges may overlap.
+ *
+ * @param compactPointer Per level, the largest key of its last compacted table.
+ * @param compaction Receives the chosen work.
+ * @return False if no level needs compaction.
+ */
+bool Version::pickCompaction(const std::string compactPointer[LSM_NUM_LEVELS], Compaction &compaction) const
+{
+    int bestLevel = -1;
+    double bestScore = 1.0;
+    for (int level = 0; level < LSM_NUM_LEVELS - 1; ++level)
+    {
+        double score = level == 0 ? (double)levels[0].size() / L0_COMPACTION_TRIGGER
+                                  : (double)levelBytes(level) / (double)maxBytesForLevel(level);
+        if (score >= bestScore)
+        {
+            bestScore = score;
+            bestLevel = level;
+        }
+    }
+    if (bestLevel < 0)
+    {
+        return false;
+    }
+
+    compaction = Compaction();
+    compaction.level = bestLevel;
+    if (bestLevel == 0)
+    {
+        compaction.inputs = levels[0];
+    }
+    else
+    {
+        // First table past the previous compaction of this level, wrapping around
+        const auto &tables = levels[bestLevel];
+        auto it = std::find_if(tables.begin(), tables.end(), [&](const LiveTablePtr &table)
+                               { return table->meta.smallest > compactPointer[bestLevel]; });
+        compaction.inputs.push_back(it != tables.end() ? *it : tables.front());
+    }
+    addNextInputs(compaction);
+    return true;
+}
+
+/**
+ * @brief Sets up a compaction rewriting a given table.
+ *
+ * Used to drop the entries a range deletion hides from a table no regular
+ * compaction would pick soon. A level-0 table is compacted with the whole
+ * level, as every level-0 compaction is.
+ *
+ * @param level Level of the table, above the last one.
+ * @param table Table to rewrite.
+ * @param compaction Receives the work.
+ * @return False if the table is no longer on that level.
+ */
+bool Version::pickTableCompaction(int level, const LiveTablePtr &table, Compaction &compaction) const
+{
+    const auto &tables = levels[level];
+    if (level >= LSM_NUM_LEVELS - 1 || std::find(tables.begin(), tables.end(), table) == tables.end())
+    {
+        return false;
+    }
+
+    compaction = Compaction();
+    compaction.level = level;
+    compaction.rewrite = true;
+    if (level == 0)
+    {
+        compaction.inputs = levels[0];
+    }
+    else
+    {
+        compaction.inputs.push_back(table);
+    }
+    addNextInputs(compaction);
+    return true;
+}
+
+/**
+ * @brief Completes a compaction whose inputs are chosen.
+ *
+ * The output level's tables overlapping the inputs join the compaction so
+ * that it stays free of overlaps. Inputs are bottommost when no deeper level
+ * holds keys in their range, which lets the compaction drop tombstones. The
+ * range deletions overlapping the inputs are copied for the merge to apply.
+ *
+ * @param compaction Compaction with its level and inputs set.
+ */
+void Version::addNextInputs(Compaction &compaction) const
+{
+    std::string smallest = compaction.inputs.front()->meta.smallest;
+    std::string largest = compaction.inputs.front()->meta.largest;
+    for (const auto &table : compaction.inputs)
+    {
+        smallest = std::min(smallest, table->meta.smallest);
+        largest = std::max(largest, table->meta.largest);
+    }
+    compaction.nextInputs = overlapping(compaction.level + 1, smallest, largest);
+
+    if (!compaction.nextInputs.empty())
+    {
+        smallest = std::min(smallest, compaction.nextInputs.front()->meta.smallest);
+        largest = std::max(largest, compaction.nextInputs.back()->meta.largest);
+    }
+    compaction.bottommost = true;
+    for (int level = compaction.level + 2; level < LSM_NUM_LEVELS && compaction.bottommost; ++level)
+    {
+        compaction.bottommost = overlapping(level, smallest, largest).empty();
+    }
+
+    for (const RangeTombstone &tombstone : rangeDeletions)
+    {
+        if (tombstone.start <= largest && tombstone.end > smallest)
+        {
+            compaction.rangeDeletions.push_back(tombstone);
+        }
+    }
+}
+
+/**
+ * @brief Finds a table holding an entry hidden by a range deletion.
+ *
+ * A table whose smallest sequence number is not below the deletion's holds
+ * only newer entries and is skipped unread. Other tables overlapping the
+ * range are scanned from its start until an older entry is found or the
+ * range ends; a table that cannot be read counts as holding one.
+ *
+ * @param tombstone Range deletion.
+ * @param level Receives the level of the table found.
+ * @return The table, or nullptr if the deletion hides nothing any more.
+ */
+LiveTablePtr Version::coveredTable(const RangeTombstone &tombstone, int &level) const
+{
+    for (int l = 0; l < LSM_NUM_LEVELS; ++l)
+    {
+        for (const LiveTablePtr &table : overlapping(l, tombstone.start, tombstone.end))
+        {
+            if (table->meta.smallestSequence >= tombstone.sequence)
+            {
+                continue;
+            }
+
+            std::unique_ptr<KeyValueIterator> it = table->reader->newIterator();
+            bool covered = false;
+            for (it->seek(tombstone.start); it->valid() && it->key() < tombstone.end && !covered; it->next())
+            {
+                ParsedEntry entry;
+                covered = !parseEntry(it->value(), entry) || entry.sequence < tombstone.sequence;
+            }
+            if (covered || it->corrupted())
+            {
+                level = l;
+                return table;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Finds the table above the last level whose values expired longest ago.
+ *
+ * Only the recorded earliest expiry of each table is compared, so no table
+ * is read. Tables on the last level have no level to be compacted into.
+ *
+ * @param before Time in milliseconds since the epoch by which a value must have expired.
+ * @param level Receives the level of the table found.
+ * @return The table, or nullptr if no table holds such a value.
+ */
+LiveTablePtr Version::expiredTable(uint64_t before, int &level) const
+{
+    LiveTablePtr found;
+    for (int l = 0; l < LSM_NUM_LEVELS - 1; ++l)
+    {
+        for (const LiveTablePtr &table : levels[l])
+        {
+            uint64_t expiry = table->meta.earliestExpiry;
+            if (expiry != 0 && expiry <= before && (!found || expiry < found->meta.earliestExpiry))
+            {
+                found = table;
+                level = l;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Lists the tables of all levels in manifest order.
+ * @return Level 0 oldest first, then each deeper level by key.
+ */
+std::vector<TableMeta> Version::tableMetas() const
+{
+    std::vector<TableMeta> metas;
+    for (const auto &level : levels)
+    {
+        for (const auto &table : level)
+        {
+            metas.push_back(table->meta);
+        }
+    }
+    return metas;
+}
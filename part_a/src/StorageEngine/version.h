@@ -0,0 +1,154 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+#include "manifest.h"
+#include "table_reader.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.h"
+
+/**
+ * @file version.h
+ * @brief Immutable snapshots of an LSM tree's table set and compaction picking.
+ */
+
+/**
+ * @brief An open SSTable together with its manifest entry.
+ */
+struct LiveTable
+{
+    TableMeta meta;
+    std::shared_ptr<TableReader> reader;
+};
+
+using LiveTablePtr = std::shared_ptr<const LiveTable>;
+
+/**
+ * @brief Work description of one compaction.
+ */
+struct Compaction
+{
+    int level = 0;                              ///< Level of the inputs; outputs go to level + 1
+    std::vector<LiveTablePtr> inputs;           ///< Tables of the input level
+    std::vector<LiveTablePtr> nextInputs;       ///< Overlapping tables of the output level
+    bool bottommost = false;                    ///< No deeper level holds keys in the input range
+    bool rewrite = false;                       ///< Rewrite a single input even without overlaps
+    std::vector<RangeTombstone> rangeDeletions; ///< Range deletions overlapping the inputs
+};
+
+/**
+ * @brief Immutable set of live tables arranged in levels.
+ *
+ * Level 0 holds flushed tables whose key ranges may overlap, ordered oldest
+ * first. Each deeper level holds tables with disjoint key ranges, sorted by
+ * smallest key, and a size budget LEVEL_SIZE_MULTIPLIER times that of the
+ * level above. A change to the table set builds a new Version, so readers
+ * holding the previous one keep a consistent view (and its tables open).
+ *
+ * A version also holds the range deletions flushed from memtables. They hide
+ * the older entries of their range in every table; compactions drop those
+ * entries, and a range deletion is dropped once no table holds any of them.
+ */
+class Version
+{
+private:
+    /**
+     * @brief Completes a compaction whose inputs are chosen.
+     * @param compaction Compaction with its level and inputs set.
+     */
+    void addNextInputs(Compaction &compaction) const;
+
+public:
+    std::vector<LiveTablePtr> levels[LSM_NUM_LEVELS];
+    std::vector<RangeTombstone> rangeDeletions; ///< Oldest first
+
+    /**
+     * @brief Total file size of a level.
+     * @param level Level number.
+     */
+    uint64_t levelBytes(int level) const;
+
+    /**
+     * @brief Tables of a level whose key range intersects [smallest, largest].
+     * @param level Level number.
+     * @param smallest Lower bound of the range.
+     * @param largest Upper bound of the range.
+     */
+    std::vector<LiveTablePtr> overlapping(int level, std::string_view smallest, std::string_view largest) const;
+
+    /**
+     * @brief The only table of a level >= 1 whose key range can contain a key.
+     * @param level Level number, at least 1.
+     * @param key Key to find.
+     * @return The table, or nullptr if the key falls outside every table's range.
+     */
+    LiveTablePtr tableForKey(int level, std::string_view key) const;
+
+    /**
+     * @brief Returns a cursor over the tables of a level >= 1 as one sorted run.
+     *
+     * Only the table under the cursor is open for iteration. The version must
+     * outlive the cursor.
+     *
+     * @param level Level number, at least 1.
+     */
+    std::unique_ptr<KeyValueIterator> newLevelIterator(int level) const;
+
+    /**
+     * @brief Chooses the most urgent compaction.
+     *
+     * Level 0 is scored by its table count against L0_COMPACTION_TRIGGER and
+     * deeper levels by their size against their budget; the level with the
+     * highest score of at least 1 is compacted. From a deeper level one table
+     * is picked, rotating through the key space via compactPointer.
+     *
+     * @param compactPointer Per level, the largest key of its last compacted table.
+     * @param compaction Receives the chosen work.
+     * @return False if no level needs compaction.
+     */
+    bool pickCompaction(const std::string compactPointer[LSM_NUM_LEVELS], Compaction &compaction) const;
+
+    /**
+     * @brief Sets up a compaction rewriting a given table, with level 0 as a whole.
+     * @param level Level of the table, above the last one.
+     * @param table Table to rewrite.
+     * @param compaction Receives the work.
+     * @return False if the table is no longer on that level.
+     */
+    bool pickTableCompaction(int level, const LiveTablePtr &table, Compaction &compaction) const;
+
+    /**
+     * @brief Finds a table holding an entry hidden by a range deletion.
+     *
+     * Tables whose entries are all newer than the deletion are skipped
+     * unread; others are scanned over the deleted range.
+     *
+     * @param tombstone Range deletion.
+     * @param level Receives the level of the table found.
+     * @return The table, or nullptr if the deletion hides nothing any more.
+     */
+    LiveTablePtr coveredTable(const RangeTombstone &tombstone, int &level) const;
+
+    /**
+     * @brief Finds the table above the last level whose values expired longest ago.
+     * @param before Time in milliseconds since the epoch by which a value must have expired.
+     * @param level Receives the level of the table found.
+     * @return The table, or nullptr if no table holds such a value.
+     */
+    LiveTablePtr expiredTable(uint64_t before, int &level) const;
+
+    /**
+     * @brief Size budget of a level.
+     * @param level Level number, at least 1.
+     */
+    static uint64_t maxBytesForLevel(int level);
+
+    /**
+     * @brief Lists the tables of all levels in manifest order.
+     */
+    std::vector<TableMeta> tableMetas() const;
+};
+
+#endif // VERSION_H
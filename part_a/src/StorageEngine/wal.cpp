@@ -0,0 +1,346 @@
+#include "wal.h"
+#include "coding.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of the fixed record header: checksum and payload length.
+ */
+static const size_t WAL_HEADER_SIZE = 8;
+
+/**
+ * @brief Flushes pending records and closes the log.
+ */
+WriteAheadLog::~WriteAheadLog()
+{
+    close();
+}
+
+/**
+ * @brief Opens (or creates) the log file for appending.
+ *
+ * In INTERVAL mode a background thread is started that syncs the file every
+ * intervalMs milliseconds if anything was written in the meantime.
+ *
+ * @param filename Path of the log file.
+ * @param mode Sync mode.
+ * @param intervalMs Sync period for WalSyncMode::INTERVAL.
+ * @return True on success.
+ */
+bool WriteAheadLog::open(const std::string &filename, WalSyncMode mode, unsigned intervalMs)
+{
+    close();
+
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open write-ahead log " << filename << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    path = filename;
+    syncMode = mode;
+    syncIntervalMs = intervalMs > 0 ? intervalMs : 1;
+    failed = false;
+    stopping = false;
+
+    if (syncMode == WalSyncMode::INTERVAL)
+    {
+        syncThread = std::thread(&WriteAheadLog::syncLoop, this);
+    }
+    return true;
+}
+
+/**
+ * @brief Replays the records of a log file.
+ *
+ * @param filename Path of the log file.
+ * @param handler Receives each valid record in log order.
+ * @return Number of records replayed.
+ */
+size_t WriteAheadLog::replay(const std::string &filename, const ReplayHandler &handler)
+{
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        return 0;
+    }
+
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    size_t count = 0;
+    size_t offset = 0;
+    while (contents.size() - offset >= WAL_HEADER_SIZE)
+    {
+        const char *header = contents.data() + offset;
+        uint32_t crc = decodeFixed32(header);
+        uint32_t length = decodeFixed32(header + 4);
+        if (length == 0 || length > contents.size() - offset - WAL_HEADER_SIZE)
+            break;
+
+        const char *payload = header + WAL_HEADER_SIZE;
+        if (crc32c(payload, length) != crc)
+            break;
+
+        const char *p = payload + 1;
+        const char *end = payload + length;
+        uint32_t keyLength = 0;
+        if (!getVarint32(p, end, keyLength) || keyLength > (size_t)(end - p))
+            break;
+
+        RecordType type = (RecordType)(unsigned char)payload[0];
+        std::string key(p, keyLength);
+        std::string value(p + keyLength, end);
+        handler(type, std::move(key), std::move(value));
+
+        offset += WAL_HEADER_SIZE + length;
+        ++count;
+    }
+
+    if (offset < contents.size())
+    {
+        std::cerr << "Discarding " << contents.size() - offset << " bytes of torn write-ahead log tail" << std::endl;
+        if (truncate(filename.c_str(), (off_t)offset) != 0)
+        {
+            std::cerr << "Failed to truncate write-ahead log: " << std::strerror(errno) << std::endl;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Writes a whole buffer, retrying on short writes and interrupts.
+ * @param data Bytes to write.
+ * @return True on success.
+ */
+bool WriteAheadLog::writeFully(const std::string &data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        written += (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * @brief Appends a record and waits until it is committed.
+ *
+ * The record is encoded into the shared pending buffer. If no write is in
+ * progress the caller becomes the leader and commits the whole buffer,
+ * including records of writers that arrived meanwhile; otherwise it waits for
+ * a leader to commit its record.
+ *
+ * @param type Operation type.
+ * @param key Key of the operation.
+ * @param value Value (empty for deletes).
+ * @return False if the log could not be written.
+ */
+bool WriteAheadLog::append(RecordType type, std::string_view key, std::string_view value)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (fd < 0 || failed)
+    {
+        return false;
+    }
+
+    size_t start = pending.size();
+    pending.append(WAL_HEADER_SIZE, '\0');
+    pending.push_back((char)type);
+    putVarint32(pending, (uint32_t)key.size());
+    pending.append(key.data(), key.size());
+    pending.append(value.data(), value.size());
+
+    size_t length = pending.size() - start - WAL_HEADER_SIZE;
+    encodeFixed32(&pending[start], crc32c(pending.data() + start + WAL_HEADER_SIZE, length));
+    encodeFixed32(&pending[start + 4], (uint32_t)length);
+
+    uint64_t seq = ++appendedSeq;
+    while (writtenSeq < seq && !failed)
+    {
+        if (leaderActive)
+        {
+            committed.wait(lock);
+            continue;
+        }
+
+        // Become the leader for everything appended so far
+        leaderActive = true;
+        std::string batch = std::move(pending);
+        pending = std::move(spare);
+        pending.clear();
+        uint64_t batchSeq = appendedSeq;
+
+        lock.unlock();
+        bool ok = writeFully(batch) && (syncMode != WalSyncMode::ALWAYS || fdatasync(fd) == 0);
+        int error = errno;
+        lock.lock();
+
+        batch.clear();
+        spare = std::move(batch);
+        leaderActive = false;
+        if (ok)
+        {
+            writtenSeq = batchSeq;
+            dirty = true;
+        }
+        else
+        {
+            failed = true;
+            std::cerr << "Write-ahead log write failed: " << std::strerror(error) << std::endl;
+        }
+        committed.notify_all();
+    }
+
+    return !failed;
+}
+
+/**
+ * @brief Writes and syncs everything appended so far.
+ * @return True on success.
+ */
+bool WriteAheadLog::sync()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (fd < 0)
+    {
+        return false;
+    }
+    while (leaderActive)
+    {
+        committed.wait(lock);
+    }
+
+    leaderActive = true;
+    std::string batch = std::move(pending);
+    pending.clear();
+    uint64_t batchSeq = appendedSeq;
+
+    lock.unlock();
+    bool ok = writeFully(batch) && fdatasync(fd) == 0;
+    lock.lock();
+
+    leaderActive = false;
+    if (ok)
+    {
+        writtenSeq = batchSeq;
+        dirty = false;
+    }
+    else
+    {
+        failed = true;
+    }
+    committed.notify_all();
+    return ok;
+}
+
+/**
+ * @brief Switches appends to a new, empty log file.
+ *
+ * Waits until every appended record is written and no background sync is
+ * using the current descriptor, then swaps descriptors under the lock.
+ *
+ * @param filename Path of the new log file.
+ * @return True on success; the previous file stays in use otherwise.
+ */
+bool WriteAheadLog::rotate(const std::string &filename)
+{
+    int newFd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (newFd < 0)
+    {
+        std::cerr << "Failed to open write-ahead log " << filename << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while ((leaderActive || syncing || writtenSeq < appendedSeq) && !failed)
+    {
+        committed.wait(lock);
+    }
+
+    if (fd >= 0)
+    {
+        if (syncMode != WalSyncMode::OS && dirty && fdatasync(fd) != 0)
+        {
+            std::cerr << "Write-ahead log sync failed: " << std::strerror(errno) << std::endl;
+        }
+        ::close(fd);
+    }
+
+    fd = newFd;
+    path = filename;
+    dirty = false;
+    return true;
+}
+
+/**
+ * @brief Background loop of INTERVAL mode.
+ *
+ * Syncs the file every syncIntervalMs milliseconds when records were written
+ * since the previous sync. Writers never wait for this thread.
+ */
+void WriteAheadLog::syncLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        syncWake.wait_for(lock, std::chrono::milliseconds(syncIntervalMs), [this]
+                          { return stopping; });
+        if (!dirty || failed)
+        {
+            continue;
+        }
+
+        dirty = false;
+        syncing = true;
+        lock.unlock();
+        if (fdatasync(fd) != 0)
+        {
+            std::cerr << "Write-ahead log sync failed: " << std::strerror(errno) << std::endl;
+        }
+        lock.lock();
+        syncing = false;
+        committed.notify_all();
+    }
+}
+
+/**
+ * @brief Commits pending records, stops the sync thread and closes the file.
+ */
+void WriteAheadLog::close()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    sync();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    syncWake.notify_all();
+    if (syncThread.joinable())
+    {
+        syncThread.join();
+    }
+
+    ::close(fd);
+    fd = -1;
+}
@@ -0,0 +1,161 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "config.h"
+
+/**
+ * @file wal.h
+ * @brief Header file for the write-ahead log.
+ */
+
+/**
+ * @brief When appended log records are forced to stable storage.
+ */
+enum class WalSyncMode
+{
+    ALWAYS,   ///< fdatasync before a write is acknowledged (batched by group commit)
+    INTERVAL, ///< write immediately, fdatasync from a background thread every N ms
+    OS        ///< write immediately, leave syncing to the operating system
+};
+
+/**
+ * @brief Append-only write-ahead log with group commit.
+ *
+ * Each record is stored as
+ *
+ *     crc32c (4) | payload length (4) | type (1) | key length (varint) | key | value
+ *
+ * with fixed-width fields in little-endian order; the checksum covers
+ * everything after the length field. Replay stops at the first torn or
+ * corrupt record.
+ *
+ * Writers encode their record into a shared buffer. The first writer that
+ * finds no write in progress becomes the leader: it takes the whole buffer,
+ * issues one write() (plus one fdatasync() in ALWAYS mode) and then wakes
+ * every writer whose record was part of the batch. Writers arriving while the
+ * leader is busy queue up behind it and are committed together by the next
+ * leader, so the number of syncs grows with the number of batches, not with
+ * the number of writes.
+ */
+class WriteAheadLog
+{
+public:
+    /**
+     * @brief Kind of logged operation.
+     */
+    enum RecordType : uint8_t
+    {
+        RECORD_PUT = 1,
+        RECORD_DELETE = 2,
+        RECORD_BATCH = 3 ///< Empty key; the value is an encoded WriteBatch
+    };
+
+    /**
+     * @brief Callback receiving replayed records in log order.
+     */
+    using ReplayHandler = std::function<void(RecordType type, std::string &&key, std::string &&value)>;
+
+private:
+    int fd = -1;
+    std::string path;
+    WalSyncMode syncMode = WalSyncMode::INTERVAL;
+    unsigned syncIntervalMs = WAL_SYNC_INTERVAL_MS;
+
+    std::mutex mutex;
+    std::condition_variable committed;
+    std::string pending;         ///< Encoded records not yet handed to write()
+    std::string spare;           ///< Storage of the previous batch, reused by the next leader
+    uint64_t appendedSeq = 0;    ///< Records appended to pending so far
+    uint64_t writtenSeq = 0;     ///< Records written (and synced in ALWAYS mode)
+    bool leaderActive = false;
+    bool failed = false;
+    bool dirty = false;          ///< Written since the last background sync
+    bool syncing = false;        ///< Background sync running outside the lock
+
+    std::thread syncThread;
+    std::condition_variable syncWake;
+    bool stopping = false;
+
+    /**
+     * @brief Background loop syncing the log every syncIntervalMs (INTERVAL mode).
+     */
+    void syncLoop();
+
+    /**
+     * @brief Writes a whole buffer, retrying on short writes.
+     * @return True on success.
+     */
+    bool writeFully(const std::string &data);
+
+public:
+    WriteAheadLog() = default;
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    /**
+     * @brief Flushes pending records and closes the log.
+     */
+    ~WriteAheadLog();
+
+    /**
+     * @brief Opens (or creates) the log file for appending.
+     * @param filename Path of the log file.
+     * @param mode Sync mode.
+     * @param intervalMs Sync period for WalSyncMode::INTERVAL.
+     * @return True on success.
+     */
+    bool open(const std::string &filename, WalSyncMode mode, unsigned intervalMs);
+
+    /**
+     * @brief Replays the records of a log file.
+     *
+     * A torn record at the end of the file (from a crash mid-write) is cut off
+     * so that new records are appended after the last valid one.
+     *
+     * @param filename Path of the log file; a missing file replays nothing.
+     * @param handler Receives each valid record.
+     * @return Number of records replayed.
+     */
+    static size_t replay(const std::string &filename, const ReplayHandler &handler);
+
+    /**
+     * @brief Appends a record and waits until it is committed according to the sync mode.
+     * @param type Operation type.
+     * @param key Key of the operation.
+     * @param value Value (empty for deletes).
+     * @return False if the log could not be written.
+     */
+    bool append(RecordType type, std::string_view key, std::string_view value);
+
+    /**
+     * @brief Switches appends to a new, empty log file.
+     *
+     * Records appended so far stay in the previous file, which is synced
+     * (unless the sync mode is OS) and closed, so it can be deleted once the
+     * memtable holding them is flushed.
+     *
+     * @param filename Path of the new log file.
+     * @return True on success; the previous file stays in use otherwise.
+     */
+    bool rotate(const std::string &filename);
+
+    /**
+     * @brief Writes and syncs everything appended so far.
+     * @return True on success.
+     */
+    bool sync();
+
+    /**
+     * @brief Stops the background sync thread and closes the file.
+     */
+    void close();
+};
+
+#endif // WAL_H
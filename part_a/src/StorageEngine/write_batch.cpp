@@ -0,0 +1,131 @@
+#include "write_batch.h"
+#include "coding.h"
+
+/**
+ * @brief Size of the operation count at the start of the encoding.
+ */
+static const size_t WRITE_BATCH_HEADER_SIZE = 4;
+
+/**
+ * @brief Creates an empty batch.
+ */
+WriteBatch::WriteBatch()
+{
+    clear();
+}
+
+/**
+ * @brief Adds a write of a key.
+ * @param key Key to write.
+ * @param value New value.
+ * @param expiresAt Expiry time in milliseconds since the epoch, or 0 for none.
+ */
+void WriteBatch::put(std::string_view key, std::string_view value, uint64_t expiresAt)
+{
+    encodeFixed32(&rep[0], count() + 1);
+    rep.push_back((char)(expiresAt != 0 ? OP_PUT_EXPIRING : OP_PUT));
+    putLengthPrefixed(rep, key);
+    putLengthPrefixed(rep, value);
+    if (expiresAt != 0)
+    {
+        putVarint64(rep, expiresAt);
+    }
+}
+
+/**
+ * @brief Adds a deletion of a key.
+ * @param key Key to delete.
+ */
+void WriteBatch::remove(std::string_view key)
+{
+    encodeFixed32(&rep[0], count() + 1);
+    rep.push_back((char)OP_DELETE);
+    putLengthPrefixed(rep, key);
+}
+
+/**
+ * @brief Adds a deletion of every key in [start, end).
+ * @param start First key to delete.
+ * @param end Key at which the range ends (exclusive).
+ */
+void WriteBatch::removeRange(std::string_view start, std::string_view end)
+{
+    encodeFixed32(&rep[0], count() + 1);
+    rep.push_back((char)OP_DELETE_RANGE);
+    putLengthPrefixed(rep, start);
+    putLengthPrefixed(rep, end);
+}
+
+/**
+ * @brief Adds the operations of another batch after those of this one.
+ * @param other Batch to copy.
+ */
+void WriteBatch::append(const WriteBatch &other)
+{
+    encodeFixed32(&rep[0], count() + other.count());
+    rep.append(other.rep, WRITE_BATCH_HEADER_SIZE, std::string::npos);
+}
+
+/**
+ * @brief Removes all operations, keeping the allocated buffer.
+ */
+void WriteBatch::clear()
+{
+    rep.assign(WRITE_BATCH_HEADER_SIZE, '\0');
+}
+
+/**
+ * @brief Number of operations in the batch.
+ * @return The count stored in the header.
+ */
+uint32_t WriteBatch::count() const
+{
+    return decodeFixed32(rep.data());
+}
+
+/**
+ * @brief Decodes an encoded batch and passes its operations to a handler.
+ *
+ * The number of decoded operations must match the header, so a batch cut
+ * short is reported as malformed.
+ *
+ * @param contents Encoded batch.
+ * @param handler Receives each operation.
+ * @return False if the encoding is malformed.
+ */
+bool WriteBatch::iterate(std::string_view contents, const Handler &handler)
+{
+    if (contents.size() < WRITE_BATCH_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    uint32_t expected = decodeFixed32(contents.data());
+    const char *p = contents.data() + WRITE_BATCH_HEADER_SIZE;
+    const char *end = contents.data() + contents.size();
+    uint32_t found = 0;
+    while (p < end)
+    {
+        OpType type = (OpType)(unsigned char)*p++;
+        std::string_view key, value;
+        uint64_t expiresAt = 0;
+        if (!getLengthPrefixed(p, end, key))
+        {
+            return false;
+        }
+        if (type == OP_PUT || type == OP_DELETE_RANGE || type == OP_PUT_EXPIRING)
+        {
+            if (!getLengthPrefixed(p, end, value) || (type == OP_PUT_EXPIRING && !getVarint64(p, end, expiresAt)))
+            {
+                return false;
+            }
+        }
+        else if (type != OP_DELETE)
+        {
+            return false;
+        }
+        handler(type, key, value, expiresAt);
+        ++found;
+    }
+    return found == expected;
+}
@@ -0,0 +1,106 @@
+#ifndef WRITE_BATCH_H
+#define WRITE_BATCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * @file write_batch.h
+ * @brief Group of writes applied to an LSM tree as one unit.
+ */
+
+/**
+ * @brief Sequence of puts, deletes and range deletes applied atomically by LSMTree::write().
+ *
+ * The operations are encoded into a single buffer as
+ *
+ *     count (4) | { type (1) | key (varint length + bytes) | value (varint length + bytes) }*
+ *
+ * where deletes have no value, range deletes store the start of the
+ * range as key and its (exclusive) end as value, and expiring puts follow
+ * their value by the expiry time (varint64). The batch is logged as one
+ * write-ahead log record, so after a crash either every operation of the
+ * batch is recovered or none is. Operations on the same key are applied in
+ * the order they were added.
+ */
+class WriteBatch
+{
+public:
+    /**
+     * @brief Kind of batched operation.
+     */
+    enum OpType : uint8_t
+    {
+        OP_PUT = 1,
+        OP_DELETE = 2,
+        OP_DELETE_RANGE = 3,
+        OP_PUT_EXPIRING = 4
+    };
+
+    /**
+     * @brief Callback receiving the operations of a batch in order.
+     */
+    using Handler = std::function<void(OpType type, std::string_view key, std::string_view value, uint64_t expiresAt)>;
+
+private:
+    std::string rep;
+
+public:
+    WriteBatch();
+
+    /**
+     * @brief Adds a write of a key.
+     * @param key Key to write.
+     * @param value New value.
+     * @param expiresAt Time in milliseconds since the epoch at which the key
+     *                  is deleted, or 0 to keep it until overwritten.
+     */
+    void put(std::string_view key, std::string_view value, uint64_t expiresAt = 0);
+
+    /**
+     * @brief Adds a deletion of a key.
+     * @param key Key to delete.
+     */
+    void remove(std::string_view key);
+
+    /**
+     * @brief Adds a deletion of every key in [start, end).
+     * @param start First key to delete.
+     * @param end Key at which the range ends (exclusive).
+     */
+    void removeRange(std::string_view start, std::string_view end);
+
+    /**
+     * @brief Adds the operations of another batch after those of this one.
+     * @param other Batch to copy.
+     */
+    void append(const WriteBatch &other);
+
+    /**
+     * @brief Removes all operations.
+     */
+    void clear();
+
+    /**
+     * @brief Number of operations in the batch.
+     */
+    uint32_t count() const;
+
+    /**
+     * @brief Encoded operations, as logged.
+     */
+    std::string_view contents() const { return rep; }
+
+    /**
+     * @brief Decodes an encoded batch and passes its operations to a handler.
+     * @param contents Encoded batch, as returned by contents().
+     * @param handler Receives each operation.
+     * @return False if the encoding is malformed; operations before the
+     *         malformed one have been passed on.
+     */
+    static bool iterate(std::string_view contents, const Handler &handler);
+};
+
+#endif // WRITE_BATCH_H
@@ -9,14 +9,14 @@ using namespace std;
  * @brief Runs a Read-Eval-Print Loop (REPL) for the key-value store.
  *
  * Allows users to interact with an LSMTree-backed key-value store
- * using commands: SET, GET, and DEL.
+ * using commands: SET, GET, DEL, and DELRANGE.
  * Type 'EXIT' to quit the REPL.
  */
 void runREPL()
 {
-    LSMTree store("/sstabledata");
+    LSMTree store("sstabledata");
 
-    cout << "Welcome to the Key-Value Store REPL. Supported commands: SET, GET, DEL.\n";
+    cout << "Welcome to the Key-Value Store REPL. Supported commands: SET, GET, DEL, DELRANGE.\n";
     cout << "Type 'EXIT' to quit.\n";
 
     string line;
@@ -42,8 +42,7 @@ void runREPL()
                 cout << "Invalid SET command. Usage: SET <key> <value>\n";
                 continue;
             }
-            store.set(key, value);
-            cout << "OK\n";
+            cout << (store.set(key, value) ? "OK\n" : "Write failed\n");
         }
         else if (command == "GET" || command == "get")
         {
@@ -53,9 +52,7 @@ void runREPL()
                 cout << "Invalid GET command. Usage: GET <key>\n";
                 continue;
             }
-            string result = store.get(key);
-            result = (result == "DELETED") ? "NULL" : result;
-            cout << result << "\n";
+            cout << store.get(key) << "\n";
         }
         else if (command == "DEL" || command == "del")
         {
@@ -65,12 +62,21 @@ void runREPL()
                 cout << "Invalid DEL command. Usage: DEL <key>\n";
                 continue;
             }
-            store.remove(key);
-            cout << "Deleted\n";
+            cout << (store.remove(key) ? "Deleted\n" : "Write failed\n");
+        }
+        else if (command == "DELRANGE" || command == "delrange")
+        {
+            ss >> key >> value;
+            if (key.empty() || value.empty())
+            {
+                cout << "Invalid DELRANGE command. Usage: DELRANGE <start> <end>\n";
+                continue;
+            }
+            cout << (store.removeRange(key, value) ? "Deleted\n" : "Write failed\n");
         }
         else
         {
-            cout << "Unknown command. Supported commands: SET, GET, DEL.\n";
+            cout << "Unknown command. Supported commands: SET, GET, DEL, DELRANGE.\n";
         }
     }
 
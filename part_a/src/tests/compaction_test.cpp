@@ -0,0 +1,120 @@
+/**
+ * @file compaction_test.cpp
+ * @brief Tests of background compaction of level-0 tables into deeper levels.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/lsmtree.h"
+#include "../StorageEngine/manifest.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Formats a key so that numeric and key order agree.
+ * @param i Key number.
+ * @return The key.
+ */
+static std::string compactionKey(int i)
+{
+    char key[16];
+    std::snprintf(key, sizeof(key), "c%06d", i);
+    return key;
+}
+
+/**
+ * @brief Counts the tables of a level in a directory's manifest.
+ * @param manifest Loaded manifest.
+ * @param level Level to count, or -1 for the levels below 0.
+ * @return Number of tables.
+ */
+static size_t tablesOnLevel(const Manifest &manifest, int level)
+{
+    size_t count = 0;
+    for (const TableMeta &meta : manifest.tables)
+    {
+        if (meta.level == level || (level < 0 && meta.level > 0))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+TEST(compactionMergesOverlappingTables)
+{
+    TempDirectory dir;
+    const int keys = MAX_MEMTABLE_SIZE;
+    const int rounds = L0_COMPACTION_TRIGGER + 3;
+    {
+        LSMTree tree(dir.path(), WalSyncMode::OS);
+        // Every round rewrites the whole key range, so each flush yields an overlapping level-0 table
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (int i = 0; i < keys; ++i)
+            {
+                CHECK(tree.set(compactionKey(i), std::to_string(round) + "-" + std::to_string(i)));
+            }
+        }
+        for (int i = 0; i < keys; i += 10)
+        {
+            CHECK(tree.remove(compactionKey(i)));
+        }
+
+        // Wait for the compaction thread to empty level 0 below its trigger
+        Manifest manifest;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            if (manifest.load(dir.path() + "/") && tablesOnLevel(manifest, 0) < L0_COMPACTION_TRIGGER &&
+                tablesOnLevel(manifest, -1) > 0)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        CHECK(tablesOnLevel(manifest, 0) < L0_COMPACTION_TRIGGER);
+        REQUIRE(tablesOnLevel(manifest, -1) > 0);
+
+        // Merging dropped the overwritten versions
+        size_t entries = 0;
+        for (const TableMeta &meta : manifest.tables)
+        {
+            entries += meta.entries;
+        }
+        CHECK(entries < (size_t)keys * (L0_COMPACTION_TRIGGER + 1));
+
+        int mismatches = 0;
+        std::string last = std::to_string(rounds - 1) + "-";
+        for (int i = 0; i < keys; ++i)
+        {
+            std::string expected = i % 10 == 0 ? "NOT_FOUND" : last + std::to_string(i);
+            mismatches += tree.get(compactionKey(i)) == expected ? 0 : 1;
+        }
+        CHECK_EQ(mismatches, 0);
+        CHECK_EQ(tree.getRange("", "", 2 * keys, false).size(), (size_t)(keys - keys / 10));
+    }
+
+    // The inputs of finished compactions are gone, and the outputs reopen
+    Manifest manifest;
+    REQUIRE(manifest.load(dir.path() + "/"));
+    size_t files = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir.path()))
+    {
+        files += entry.path().extension() == ".sst" ? 1 : 0;
+    }
+    CHECK_EQ(files, manifest.tables.size());
+
+    LSMTree tree(dir.path(), WalSyncMode::OS);
+    int mismatches = 0;
+    std::string last = std::to_string(rounds - 1) + "-";
+    for (int i = 0; i < keys; ++i)
+    {
+        std::string expected = i % 10 == 0 ? "NOT_FOUND" : last + std::to_string(i);
+        mismatches += tree.get(compactionKey(i)) == expected ? 0 : 1;
+    }
+    CHECK_EQ(mismatches, 0);
+}
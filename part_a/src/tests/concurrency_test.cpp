@@ -0,0 +1,186 @@
+/**
+ * @file concurrency_test.cpp
+ * @brief Concurrent writers and snapshot readers across memtable flushes.
+ *
+ * Meant to be run under ThreadSanitizer as well (make tsan): besides checking
+ * that snapshots see whole batches, it exercises the write queue, memtable
+ * freezing and flushing, and read-state publication from several threads.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/lsmtree.h"
+#include "../StorageEngine/write_batch.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Number of writer threads, and of reader threads.
+ */
+static const int CONCURRENT_THREADS = 4;
+
+/**
+ * @brief Keys each writer's batch adds per round.
+ */
+static const int KEYS_PER_ROUND = 10;
+
+/**
+ * @brief Rounds per writer; the writers together add several memtables' worth of keys.
+ */
+static const int ROUNDS = 2 * MAX_MEMTABLE_SIZE / KEYS_PER_ROUND;
+
+/**
+ * @brief Builds the key of one writer's round.
+ * @param writer Writer thread.
+ * @param round Round of the writer.
+ * @param index Key within the round.
+ * @return The key.
+ */
+static std::string roundKey(int writer, int round, int index)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "w%d-r%06d-k%d", writer, round, index);
+    return buffer;
+}
+
+/**
+ * @brief Key holding the last round a writer completed.
+ * @param writer Writer thread.
+ * @return The key.
+ */
+static std::string latestKey(int writer)
+{
+    return "w" + std::to_string(writer) + "-latest";
+}
+
+/**
+ * @brief Counts the keys of a round that a snapshot holds with the round's value.
+ * @param tree Tree to read.
+ * @param snapshot View to read.
+ * @param writer Writer thread.
+ * @param round Round of the writer.
+ * @param errors Incremented for keys holding an unexpected value.
+ * @return Number of keys of the round found.
+ */
+static int countRound(LSMTree &tree, const std::shared_ptr<const Snapshot> &snapshot, int writer, int round,
+                      std::atomic<int> &errors)
+{
+    int found = 0;
+    for (int i = 0; i < KEYS_PER_ROUND; ++i)
+    {
+        std::string value = tree.get(roundKey(writer, round, i), snapshot);
+        if (value == std::to_string(round))
+        {
+            found++;
+        }
+        else if (value != "NOT_FOUND")
+        {
+            errors++;
+        }
+    }
+    return found;
+}
+
+TEST(snapshotsSeeWholeBatchesDuringFlushes)
+{
+    TempDirectory dir;
+    LSMTree tree(dir.path(), WalSyncMode::OS);
+    std::atomic<int> errors{0};
+    std::atomic<int> writersDone{0};
+    std::atomic<long> checks{0};
+
+    // Round r of a writer adds the keys of r, deletes those of r - 2 and
+    // records r as the writer's latest round, all in one batch
+    std::vector<std::thread> threads;
+    for (int writer = 0; writer < CONCURRENT_THREADS; ++writer)
+    {
+        threads.emplace_back(
+            [&, writer]
+            {
+                for (int round = 0; round < ROUNDS; ++round)
+                {
+                    WriteBatch batch;
+                    for (int i = 0; i < KEYS_PER_ROUND; ++i)
+                    {
+                        batch.put(roundKey(writer, round, i), std::to_string(round));
+                        if (round >= 2)
+                        {
+                            batch.remove(roundKey(writer, round - 2, i));
+                        }
+                    }
+                    batch.put(latestKey(writer), std::to_string(round));
+                    if (!tree.write(batch))
+                    {
+                        errors++;
+                    }
+                }
+                writersDone++;
+            });
+    }
+
+    // A snapshot that sees round r of a writer must see all of r and r - 1,
+    // none of r - 2 and nothing of r + 1
+    for (int reader = 0; reader < CONCURRENT_THREADS; ++reader)
+    {
+        threads.emplace_back(
+            [&, reader]
+            {
+                std::vector<int> lastSeen(CONCURRENT_THREADS, -1);
+                while (writersDone.load() < CONCURRENT_THREADS)
+                {
+                    std::shared_ptr<const Snapshot> snapshot = tree.getSnapshot();
+                    int writer = (int)(checks.fetch_add(1) + reader) % CONCURRENT_THREADS;
+                    std::string latest = tree.get(latestKey(writer), snapshot);
+                    int round = latest == "NOT_FOUND" ? -1 : std::stoi(latest);
+                    if (round < lastSeen[writer])
+                    {
+                        errors++;
+                    }
+                    lastSeen[writer] = round;
+                    if (round < 0)
+                    {
+                        continue;
+                    }
+
+                    if (countRound(tree, snapshot, writer, round, errors) != KEYS_PER_ROUND ||
+                        (round >= 1 && countRound(tree, snapshot, writer, round - 1, errors) != KEYS_PER_ROUND) ||
+                        (round >= 2 && countRound(tree, snapshot, writer, round - 2, errors) != 0) ||
+                        countRound(tree, snapshot, writer, round + 1, errors) != 0)
+                    {
+                        errors++;
+                    }
+
+                    // The snapshot's cursor agrees with its point reads
+                    std::string prefix = "w" + std::to_string(writer) + "-r";
+                    std::unique_ptr<KeyValueIterator> it = tree.newIterator(prefix + "~", snapshot);
+                    int live = 0;
+                    for (it->seek(prefix); it->valid(); it->next())
+                    {
+                        live++;
+                    }
+                    if (live != (round >= 1 ? 2 : 1) * KEYS_PER_ROUND)
+                    {
+                        errors++;
+                    }
+                }
+            });
+    }
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    CHECK_EQ(errors.load(), 0);
+    CHECK(checks.load() > 0);
+
+    for (int writer = 0; writer < CONCURRENT_THREADS; ++writer)
+    {
+        CHECK_EQ(tree.get(latestKey(writer)), std::to_string(ROUNDS - 1));
+        CHECK_EQ(countRound(tree, nullptr, writer, ROUNDS - 1, errors), KEYS_PER_ROUND);
+        CHECK_EQ(countRound(tree, nullptr, writer, ROUNDS - 2, errors), KEYS_PER_ROUND);
+        CHECK_EQ(countRound(tree, nullptr, writer, ROUNDS - 3, errors), 0);
+    }
+    CHECK_EQ(errors.load(), 0);
+}
@@ -0,0 +1,144 @@
+/**
+ * @file manifest_test.cpp
+ * @brief Tests of the manifest format and of reopening a tree from its manifest.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/lsmtree.h"
+#include "../StorageEngine/manifest.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Formats a key so that numeric and key order agree.
+ * @param i Key number.
+ * @return The key.
+ */
+static std::string manifestKey(int i)
+{
+    char key[16];
+    std::snprintf(key, sizeof(key), "m%06d", i);
+    return key;
+}
+
+TEST(manifestRoundTrip)
+{
+    TempDirectory dir;
+    std::string directory = dir.path() + "/";
+    Manifest missing;
+    CHECK(!missing.load(directory));
+
+    Manifest written;
+    written.nextTableNumber = 42;
+    written.logNumber = 40;
+    written.lastSequence = 123456789012ULL;
+    TableMeta first;
+    first.number = 7;
+    first.level = 0;
+    first.entries = 1000;
+    first.smallestSequence = 5;
+    first.smallest = "a key with spaces";
+    first.largest = std::string("line\nbreak\0byte", 15);
+    TableMeta second;
+    second.number = 9;
+    second.level = 3;
+    second.entries = 1;
+    second.earliestExpiry = 1700000000000ULL;
+    second.smallest = "";
+    second.largest = "z";
+    written.tables = {first, second};
+    RangeTombstone deletion;
+    deletion.start = "b";
+    deletion.end = "c d";
+    deletion.sequence = 77;
+    written.rangeDeletions = {deletion};
+    REQUIRE(written.save(directory));
+
+    Manifest read;
+    REQUIRE(read.load(directory));
+    CHECK_EQ(read.nextTableNumber, 42u);
+    CHECK_EQ(read.logNumber, 40u);
+    CHECK_EQ(read.lastSequence, 123456789012ULL);
+    REQUIRE(read.tables.size() == 2);
+    for (size_t i = 0; i < 2; ++i)
+    {
+        const TableMeta &expected = written.tables[i];
+        const TableMeta &actual = read.tables[i];
+        CHECK_EQ(actual.number, expected.number);
+        CHECK_EQ(actual.level, expected.level);
+        CHECK_EQ(actual.entries, expected.entries);
+        CHECK_EQ(actual.smallestSequence, expected.smallestSequence);
+        CHECK_EQ(actual.earliestExpiry, expected.earliestExpiry);
+        CHECK_EQ(actual.smallest, expected.smallest);
+        CHECK_EQ(actual.largest, expected.largest);
+    }
+    REQUIRE(read.rangeDeletions.size() == 1);
+    CHECK_EQ(read.rangeDeletions[0].start, "b");
+    CHECK_EQ(read.rangeDeletions[0].end, "c d");
+    CHECK_EQ(read.rangeDeletions[0].sequence, 77u);
+
+    // A file that is not a manifest is rejected
+    {
+        std::ofstream file(directory + MANIFEST_FILE_NAME, std::ios::trunc);
+        file << "NOT-A-MANIFEST\n";
+    }
+    Manifest corrupt;
+    CHECK(!corrupt.load(directory));
+}
+
+TEST(treeReopensTablesFromManifest)
+{
+    TempDirectory dir;
+    const int keys = 3 * MAX_MEMTABLE_SIZE;
+    {
+        LSMTree tree(dir.path(), WalSyncMode::OS);
+        for (int i = 0; i < keys; ++i)
+        {
+            CHECK(tree.set(manifestKey(i), "value" + std::to_string(i)));
+        }
+        for (int i = 0; i < keys; i += 4)
+        {
+            CHECK(tree.remove(manifestKey(i)));
+        }
+        CHECK(tree.removeRange(manifestKey(100), manifestKey(200)));
+    }
+
+    // The manifest lists tables whose files exist
+    Manifest manifest;
+    REQUIRE(manifest.load(dir.path() + "/"));
+    CHECK(!manifest.tables.empty());
+    for (const TableMeta &meta : manifest.tables)
+    {
+        CHECK(std::filesystem::exists(dir.file(Manifest::tableFileName(meta.number))));
+        CHECK(meta.smallest <= meta.largest);
+    }
+
+    // A table file the manifest does not list is left over from an interrupted flush
+    std::string stray = dir.file(Manifest::tableFileName(manifest.nextTableNumber + 100));
+    std::filesystem::copy_file(dir.file(Manifest::tableFileName(manifest.tables[0].number)), stray);
+
+    for (int reopen = 0; reopen < 2; ++reopen)
+    {
+        LSMTree tree(dir.path(), WalSyncMode::OS);
+        int mismatches = 0;
+        for (int i = 0; i < keys; ++i)
+        {
+            bool deleted = i % 4 == 0 || (i >= 100 && i < 200);
+            std::string expected = deleted ? "NOT_FOUND" : "value" + std::to_string(i);
+            if (i == 1 && reopen > 0)
+            {
+                expected = "reopened" + std::to_string(reopen - 1);
+            }
+            mismatches += tree.get(manifestKey(i)) == expected ? 0 : 1;
+        }
+        CHECK_EQ(mismatches, 0);
+        CHECK(!std::filesystem::exists(stray));
+
+        // Sequence numbers resume after the reopened tables: new writes shadow them
+        CHECK(tree.set(manifestKey(1), "reopened" + std::to_string(reopen)));
+        CHECK_EQ(tree.get(manifestKey(1)), "reopened" + std::to_string(reopen));
+    }
+}
@@ -0,0 +1,314 @@
+/**
+ * @file memtable_test.cpp
+ * @brief Tests of memtable versions, tombstones and snapshots, of the merging
+ *        iterator and of snapshot reads through the tree.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/lsmtree.h"
+#include "../StorageEngine/memtable.h"
+#include "../StorageEngine/merging_iterator.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Decodes the entry of a key at a sequence number into a readable form.
+ * @param table Memtable to read.
+ * @param key Key to look up.
+ * @param sequence Sequence number to read at.
+ * @return "missing", "deleted" or the value.
+ */
+static std::string lookup(const MemTable &table, std::string_view key, SequenceNumber sequence = MAX_SEQUENCE_NUMBER)
+{
+    std::string entry;
+    if (!table.get(key, entry, sequence))
+    {
+        return "missing";
+    }
+    ParsedEntry parsed;
+    if (!parseEntry(entry, parsed))
+    {
+        return "corrupt";
+    }
+    return parsed.type == TYPE_DELETION ? "deleted" : std::string(parsed.value);
+}
+
+/**
+ * @brief Lists an iterator's entries as "key=value" or "key=deleted".
+ * @param it Iterator to drain from its first entry.
+ * @return The entries in order.
+ */
+static std::vector<std::string> drain(KeyValueIterator &it)
+{
+    std::vector<std::string> entries;
+    for (it.seekToFirst(); it.valid(); it.next())
+    {
+        ParsedEntry parsed;
+        if (!parseEntry(it.value(), parsed))
+        {
+            entries.push_back(std::string(it.key()) + "=corrupt");
+        }
+        else
+        {
+            entries.push_back(std::string(it.key()) + "=" +
+                              (parsed.type == TYPE_DELETION ? std::string("deleted") : std::string(parsed.value)));
+        }
+    }
+    return entries;
+}
+
+/**
+ * @brief Lists the live keys and values of a tree cursor as "key=value".
+ * @param it Cursor to drain from its first entry.
+ * @return The entries in order.
+ */
+static std::vector<std::string> drainLive(KeyValueIterator &it)
+{
+    std::vector<std::string> entries;
+    for (it.seekToFirst(); it.valid(); it.next())
+    {
+        entries.push_back(std::string(it.key()) + "=" + std::string(it.value()));
+    }
+    return entries;
+}
+
+TEST(memTableKeepsVersionsPerSequence)
+{
+    MemTable table;
+    table.put("a", TYPE_VALUE, "1", 1);
+    table.put("b", TYPE_VALUE, "x", 2);
+    table.put("a", TYPE_VALUE, "2", 3);
+    table.put("a", TYPE_DELETION, "", 4);
+    table.put("a", TYPE_VALUE, "3", 5);
+
+    CHECK_EQ(lookup(table, "a", 0), "missing");
+    CHECK_EQ(lookup(table, "a", 1), "1");
+    CHECK_EQ(lookup(table, "a", 2), "1");
+    CHECK_EQ(lookup(table, "a", 3), "2");
+    CHECK_EQ(lookup(table, "a", 4), "deleted");
+    CHECK_EQ(lookup(table, "a"), "3");
+    CHECK_EQ(lookup(table, "b", 1), "missing");
+    CHECK_EQ(lookup(table, "b"), "x");
+    CHECK_EQ(lookup(table, "c"), "missing");
+    CHECK_EQ(table.size(), 2u);
+
+    // The tombstone is returned as an entry so that it hides older tables
+    std::string entry;
+    REQUIRE(table.get("a", entry, 4));
+    ParsedEntry parsed;
+    REQUIRE(parseEntry(entry, parsed));
+    CHECK(parsed.type == TYPE_DELETION);
+    CHECK_EQ(parsed.sequence, 4u);
+
+    table.put("e", TYPE_EXPIRING_VALUE, "temp", 6, 1234);
+    REQUIRE(table.get("e", entry));
+    REQUIRE(parseEntry(entry, parsed));
+    CHECK(parsed.type == TYPE_EXPIRING_VALUE);
+    CHECK_EQ(parsed.expiresAt, 1234u);
+}
+
+TEST(memTableIteratorReadsSnapshot)
+{
+    MemTable table;
+    table.put("b", TYPE_VALUE, "b1", 1);
+    table.put("a", TYPE_VALUE, "a1", 2);
+    table.put("c", TYPE_VALUE, "c1", 3);
+    table.put("b", TYPE_DELETION, "", 4);
+    table.put("d", TYPE_VALUE, "d1", 5);
+    table.put("a", TYPE_VALUE, "a2", 6);
+
+    std::unique_ptr<KeyValueIterator> it = table.newIterator(4);
+    CHECK(drain(*it) == std::vector<std::string>({"a=a1", "b=deleted", "c=c1"}));
+    it = table.newIterator(1);
+    CHECK(drain(*it) == std::vector<std::string>({"b=b1"}));
+    it = table.newIterator(0);
+    CHECK(drain(*it).empty());
+    it = table.newIterator();
+    CHECK(drain(*it) == std::vector<std::string>({"a=a2", "b=deleted", "c=c1", "d=d1"}));
+
+    it->seek("bb");
+    REQUIRE(it->valid());
+    CHECK_EQ(it->key(), "c");
+
+    // Writes after the iterator was created stay invisible to its snapshot
+    it = table.newIterator(6);
+    table.put("a0", TYPE_VALUE, "new", 7);
+    table.put("c", TYPE_VALUE, "c2", 8);
+    CHECK(drain(*it) == std::vector<std::string>({"a=a2", "b=deleted", "c=c1", "d=d1"}));
+}
+
+TEST(memTableRangeDeletions)
+{
+    MemTable table;
+    table.put("a", TYPE_VALUE, "1", 1);
+    table.put("b", TYPE_VALUE, "2", 2);
+    table.put("c", TYPE_VALUE, "3", 3);
+    table.deleteRange("b", "d", 4);
+    table.put("c", TYPE_VALUE, "4", 5);
+    CHECK(!table.empty());
+
+    CHECK(!table.isRangeDeleted("a", 1, MAX_SEQUENCE_NUMBER));
+    CHECK(table.isRangeDeleted("b", 2, MAX_SEQUENCE_NUMBER));
+    CHECK(table.isRangeDeleted("c", 3, MAX_SEQUENCE_NUMBER));
+    CHECK(!table.isRangeDeleted("c", 5, MAX_SEQUENCE_NUMBER));
+    CHECK(!table.isRangeDeleted("d", 1, MAX_SEQUENCE_NUMBER));
+    // A reader whose snapshot predates the deletion still sees the keys
+    CHECK(!table.isRangeDeleted("b", 2, 3));
+
+    std::vector<RangeTombstone> tombstones;
+    table.rangeDeletions(3, tombstones);
+    CHECK(tombstones.empty());
+    table.rangeDeletions(MAX_SEQUENCE_NUMBER, tombstones);
+    REQUIRE(tombstones.size() == 1);
+    CHECK_EQ(tombstones[0].start, "b");
+    CHECK_EQ(tombstones[0].end, "d");
+    CHECK_EQ(tombstones[0].sequence, 4u);
+
+    MemTable onlyRange;
+    CHECK(onlyRange.empty());
+    onlyRange.deleteRange("x", "y", 1);
+    CHECK(!onlyRange.empty());
+}
+
+TEST(mergingIteratorPrefersNewestSource)
+{
+    MemTable newest;
+    MemTable middle;
+    MemTable oldest;
+    oldest.put("a", TYPE_VALUE, "old-a", 1);
+    oldest.put("b", TYPE_VALUE, "old-b", 2);
+    oldest.put("d", TYPE_VALUE, "old-d", 3);
+    middle.put("b", TYPE_DELETION, "", 4);
+    middle.put("c", TYPE_VALUE, "mid-c", 5);
+    middle.put("d", TYPE_VALUE, "mid-d", 6);
+    newest.put("a", TYPE_VALUE, "new-a", 7);
+    newest.put("b", TYPE_VALUE, "new-b", 8);
+    newest.put("e", TYPE_DELETION, "", 9);
+
+    std::vector<std::unique_ptr<KeyValueIterator>> sources;
+    sources.push_back(newest.newIterator());
+    sources.push_back(middle.newIterator());
+    sources.push_back(oldest.newIterator());
+    MergingIterator merged(std::move(sources));
+    CHECK(drain(merged) == std::vector<std::string>({"a=new-a", "b=new-b", "c=mid-c", "d=mid-d", "e=deleted"}));
+
+    merged.seek("b");
+    REQUIRE(merged.valid());
+    CHECK_EQ(merged.key(), "b");
+    merged.next();
+    REQUIRE(merged.valid());
+    CHECK_EQ(merged.key(), "c");
+    CHECK(!merged.corrupted());
+
+    // Read below the newest writes, the middle tombstone shadows the oldest value
+    sources.clear();
+    sources.push_back(newest.newIterator(6));
+    sources.push_back(middle.newIterator(6));
+    sources.push_back(oldest.newIterator(6));
+    MergingIterator snapshot(std::move(sources));
+    CHECK(drain(snapshot) == std::vector<std::string>({"a=old-a", "b=deleted", "c=mid-c", "d=mid-d"}));
+
+    MergingIterator empty({});
+    empty.seekToFirst();
+    CHECK(!empty.valid());
+}
+
+TEST(treeSnapshotsIgnoreLaterWrites)
+{
+    TempDirectory dir;
+    LSMTree tree(dir.path(), WalSyncMode::OS);
+    CHECK(tree.set("a", "1"));
+    CHECK(tree.set("b", "1"));
+    CHECK(tree.set("c", "1"));
+    std::shared_ptr<const Snapshot> first = tree.getSnapshot();
+
+    CHECK(tree.set("a", "2"));
+    CHECK(tree.remove("b"));
+    CHECK(tree.removeRange("c", "d"));
+    CHECK(tree.set("d", "2"));
+    std::shared_ptr<const Snapshot> second = tree.getSnapshot();
+    CHECK(second->sequence() > first->sequence());
+
+    CHECK_EQ(tree.get("a", first), "1");
+    CHECK_EQ(tree.get("b", first), "1");
+    CHECK_EQ(tree.get("c", first), "1");
+    CHECK_EQ(tree.get("d", first), "NOT_FOUND");
+    CHECK_EQ(tree.get("a"), "2");
+    CHECK_EQ(tree.get("b"), "NOT_FOUND");
+    CHECK_EQ(tree.get("c"), "NOT_FOUND");
+    CHECK_EQ(tree.get("d"), "2");
+
+    std::vector<std::string_view> keys = {"d", "a", "b", "zz"};
+    std::vector<std::optional<std::string>> values = tree.multiGet(keys, first);
+    REQUIRE(values.size() == 4);
+    CHECK(!values[0]);
+    CHECK(values[1] && *values[1] == "1");
+    CHECK(values[2] && *values[2] == "1");
+    CHECK(!values[3]);
+
+    std::unique_ptr<KeyValueIterator> it = tree.newIterator(std::string_view(), first);
+    CHECK(drainLive(*it) == std::vector<std::string>({"a=1", "b=1", "c=1"}));
+    it = tree.newIterator(std::string_view(), second);
+    CHECK(drainLive(*it) == std::vector<std::string>({"a=2", "d=2"}));
+
+    // Writes after the snapshot, including a tombstone of a live key, stay hidden
+    CHECK(tree.remove("a"));
+    CHECK(tree.set("b", "3"));
+    it = tree.newIterator(std::string_view(), second);
+    CHECK(drainLive(*it) == std::vector<std::string>({"a=2", "d=2"}));
+    it = tree.newIterator("c");
+    CHECK(drainLive(*it) == std::vector<std::string>({"b=3"}));
+}
+
+TEST(treeSnapshotsSurviveFlushes)
+{
+    TempDirectory dir;
+    LSMTree tree(dir.path(), WalSyncMode::OS);
+    const int keys = 2 * MAX_MEMTABLE_SIZE;
+    for (int i = 0; i < keys; ++i)
+    {
+        CHECK(tree.set("key" + std::to_string(i), "old"));
+    }
+    std::shared_ptr<const Snapshot> snapshot = tree.getSnapshot();
+
+    // Overwrite and delete enough to freeze and flush the memtables the snapshot reads
+    for (int i = 0; i < keys; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            CHECK(tree.set("key" + std::to_string(i), "new"));
+        }
+        else
+        {
+            CHECK(tree.remove("key" + std::to_string(i)));
+        }
+    }
+    CHECK(tree.removeRange("key1", "key2"));
+
+    int mismatches = 0;
+    for (int i = 0; i < keys; ++i)
+    {
+        std::string key = "key" + std::to_string(i);
+        if (tree.get(key, snapshot) != "old")
+        {
+            mismatches++;
+        }
+        bool rangeDeleted = key >= "key1" && key < "key2";
+        std::string expected = i % 2 == 0 && !rangeDeleted ? "new" : "NOT_FOUND";
+        if (tree.get(key) != expected)
+        {
+            mismatches++;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    size_t seen = 0;
+    std::unique_ptr<KeyValueIterator> it = tree.newIterator(std::string_view(), snapshot);
+    for (it->seekToFirst(); it->valid(); it->next())
+    {
+        CHECK_EQ(it->value(), "old");
+        seen++;
+    }
+    CHECK_EQ(seen, (size_t)keys);
+}
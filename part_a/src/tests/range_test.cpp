@@ -0,0 +1,95 @@
+/**
+ * @file range_test.cpp
+ * @brief Tests of range reads through the tree across memtables, SSTables,
+ *        tombstones and range tombstones.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/lsmtree.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Formats a key so that numeric and key order agree.
+ * @param i Key number.
+ * @return The key.
+ */
+static std::string rangeKey(int i)
+{
+    char key[16];
+    std::snprintf(key, sizeof(key), "k%06d", i);
+    return key;
+}
+
+/**
+ * @brief Lists the entries of a model in [start, end) the way getRange() returns them.
+ * @param model Expected contents of the tree.
+ * @param start First key of the range.
+ * @param end Key at which the range ends (exclusive), or empty for none.
+ * @param limit Maximum number of keys.
+ * @param withValues True to follow each key by its value.
+ * @return Keys in order, interleaved with their values if requested.
+ */
+static std::vector<std::string> expectedRange(const std::map<std::string, std::string> &model, const std::string &start,
+                                              const std::string &end, size_t limit, bool withValues)
+{
+    std::vector<std::string> entries;
+    for (auto it = model.lower_bound(start); it != model.end() && limit > 0; ++it, --limit)
+    {
+        if (!end.empty() && it->first >= end)
+        {
+            break;
+        }
+        entries.push_back(it->first);
+        if (withValues)
+        {
+            entries.push_back(it->second);
+        }
+    }
+    return entries;
+}
+
+TEST(getRangeMergesMemtablesAndTables)
+{
+    TempDirectory dir;
+    std::map<std::string, std::string> model;
+    const int keys = 3 * MAX_MEMTABLE_SIZE;
+    {
+        LSMTree tree(dir.path(), WalSyncMode::OS);
+        // Enough keys to flush the older ones to SSTables, then updates in the memtable
+        for (int i = 0; i < keys; ++i)
+        {
+            CHECK(tree.set(rangeKey(i), "old" + std::to_string(i)));
+            model[rangeKey(i)] = "old" + std::to_string(i);
+        }
+        for (int i = 0; i < keys; i += 3)
+        {
+            CHECK(tree.remove(rangeKey(i)));
+            model.erase(rangeKey(i));
+        }
+        for (int i = 1; i < keys; i += 5)
+        {
+            CHECK(tree.set(rangeKey(i), "new" + std::to_string(i)));
+            model[rangeKey(i)] = "new" + std::to_string(i);
+        }
+        CHECK(tree.removeRange(rangeKey(10000), rangeKey(11000)));
+        model.erase(model.lower_bound(rangeKey(10000)), model.lower_bound(rangeKey(11000)));
+        CHECK(tree.set(rangeKey(10500), "inside"));
+        model[rangeKey(10500)] = "inside";
+
+        CHECK(tree.getRange("", "", keys) == expectedRange(model, "", "", keys, true));
+        CHECK(tree.getRange(rangeKey(9990), rangeKey(11010), 100) ==
+              expectedRange(model, rangeKey(9990), rangeKey(11010), 100, true));
+        CHECK(tree.getRange(rangeKey(20000), "", 10, false) == expectedRange(model, rangeKey(20000), "", 10, false));
+        CHECK(tree.getRange(rangeKey(5), rangeKey(5), 10).empty());
+        CHECK(tree.getRange(rangeKey(keys), "", 10).empty());
+    }
+
+    // The same ranges once everything was flushed and the tree reopened
+    LSMTree tree(dir.path(), WalSyncMode::OS);
+    CHECK(tree.getRange("", "", keys) == expectedRange(model, "", "", keys, true));
+    CHECK(tree.getRange(rangeKey(9990), rangeKey(11010), 100) ==
+          expectedRange(model, rangeKey(9990), rangeKey(11010), 100, true));
+}
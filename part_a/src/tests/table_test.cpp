@@ -0,0 +1,438 @@
+/**
+ * @file table_test.cpp
+ * @brief Round-trip tests of the encodings, block codecs, Bloom filters and SSTables.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/block_cache.h"
+#include "../StorageEngine/bloomfilter.h"
+#include "../StorageEngine/coding.h"
+#include "../StorageEngine/compression.h"
+#include "../StorageEngine/entry_format.h"
+#include "../StorageEngine/table_builder.h"
+#include "../StorageEngine/table_reader.h"
+#include "../StorageEngine/write_batch.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Codecs built into this binary, uncompressed first.
+ * @return The available codecs.
+ */
+static std::vector<const BlockCodec *> availableCodecs()
+{
+    std::vector<const BlockCodec *> codecs;
+    for (BlockType type : {BLOCK_UNCOMPRESSED, BLOCK_LZ, BLOCK_LZ4, BLOCK_ZSTD})
+    {
+        if (const BlockCodec *codec = findBlockCodec(type))
+        {
+            codecs.push_back(codec);
+        }
+    }
+    return codecs;
+}
+
+/**
+ * @brief Builds a key whose byte order matches its number.
+ * @param i Key number.
+ * @return The key.
+ */
+static std::string tableKey(int i)
+{
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "k%08d", i);
+    return buffer;
+}
+
+/**
+ * @brief Builds the entry stored for a key: a value, or every fifth key a tombstone.
+ * @param i Key number.
+ * @return The encoded entry.
+ */
+static std::string tableEntry(int i)
+{
+    std::string entry;
+    if (i % 5 == 0)
+    {
+        encodeEntry(entry, TYPE_DELETION, (SequenceNumber)i, std::string_view());
+    }
+    else
+    {
+        encodeEntry(entry, TYPE_VALUE, (SequenceNumber)i, "value-" + std::to_string(i) + std::string(i % 40, 'v'));
+    }
+    return entry;
+}
+
+TEST(fixedAndVarintRoundTrip)
+{
+    const uint64_t values[] = {0, 1, 127, 128, 255, 300, 16383, 16384, UINT32_MAX, (uint64_t)UINT32_MAX + 1, UINT64_MAX};
+    std::string buffer;
+    for (uint64_t value : values)
+    {
+        putVarint64(buffer, value);
+        putFixed64(buffer, value);
+        putVarint32(buffer, (uint32_t)value);
+        putFixed32(buffer, (uint32_t)value);
+    }
+    putLengthPrefixed(buffer, "length prefixed");
+    putLengthPrefixed(buffer, "");
+
+    const char *p = buffer.data();
+    const char *end = p + buffer.size();
+    for (uint64_t value : values)
+    {
+        uint64_t wide = 0;
+        uint32_t narrow = 0;
+        REQUIRE(getVarint64(p, end, wide));
+        CHECK_EQ(wide, value);
+        CHECK_EQ(decodeFixed64(p), value);
+        p += 8;
+        REQUIRE(getVarint32(p, end, narrow));
+        CHECK_EQ(narrow, (uint32_t)value);
+        CHECK_EQ(decodeFixed32(p), (uint32_t)value);
+        p += 4;
+    }
+    std::string_view text;
+    REQUIRE(getLengthPrefixed(p, end, text));
+    CHECK_EQ(text, "length prefixed");
+    REQUIRE(getLengthPrefixed(p, end, text));
+    CHECK(text.empty());
+    CHECK(p == end);
+
+    // Truncated encodings are rejected rather than read past the end
+    std::string truncated;
+    putVarint64(truncated, UINT64_MAX);
+    p = truncated.data();
+    uint64_t value = 0;
+    CHECK(!getVarint64(p, truncated.data() + truncated.size() - 1, value));
+    truncated.clear();
+    putLengthPrefixed(truncated, "abc");
+    p = truncated.data();
+    CHECK(!getLengthPrefixed(p, truncated.data() + truncated.size() - 1, text));
+}
+
+TEST(entryFormatRoundTrip)
+{
+    std::string entry;
+    ParsedEntry parsed;
+
+    encodeEntry(entry, TYPE_VALUE, 42, "hello");
+    REQUIRE(parseEntry(entry, parsed));
+    CHECK(parsed.type == TYPE_VALUE);
+    CHECK_EQ(parsed.sequence, 42u);
+    CHECK_EQ(parsed.expiresAt, 0u);
+    CHECK_EQ(parsed.value, "hello");
+
+    entry.clear();
+    encodeEntry(entry, TYPE_EXPIRING_VALUE, UINT64_MAX - 1, "soon", 1700000000000ULL);
+    REQUIRE(parseEntry(entry, parsed));
+    CHECK(parsed.type == TYPE_EXPIRING_VALUE);
+    CHECK_EQ(parsed.sequence, UINT64_MAX - 1);
+    CHECK_EQ(parsed.expiresAt, 1700000000000ULL);
+    CHECK_EQ(parsed.value, "soon");
+    CHECK(isDeadEntry(parsed, 1700000000000ULL));
+    CHECK(!isDeadEntry(parsed, 1699999999999ULL));
+
+    entry.clear();
+    encodeEntry(entry, TYPE_DELETION, 7, std::string_view());
+    REQUIRE(parseEntry(entry, parsed));
+    CHECK(parsed.type == TYPE_DELETION);
+    CHECK(isDeadEntry(parsed, 0));
+
+    CHECK(!parseEntry(std::string_view(), parsed));
+    CHECK(!parseEntry(std::string_view("\x07", 1), parsed));
+
+    RangeTombstone tombstone{"b", "d", 10};
+    CHECK(tombstone.covers("b", 9, MAX_SEQUENCE_NUMBER));
+    CHECK(tombstone.covers("c", 9, MAX_SEQUENCE_NUMBER));
+    CHECK(!tombstone.covers("d", 9, MAX_SEQUENCE_NUMBER));
+    CHECK(!tombstone.covers("a", 9, MAX_SEQUENCE_NUMBER));
+    CHECK(!tombstone.covers("c", 11, MAX_SEQUENCE_NUMBER));
+    CHECK(!tombstone.covers("c", 9, 9));
+}
+
+TEST(writeBatchRoundTrip)
+{
+    WriteBatch batch;
+    batch.put("a", "1");
+    batch.put("b", "2", 12345);
+    batch.remove("c");
+    batch.removeRange("d", "f");
+    WriteBatch other;
+    other.put("g", std::string(1000, 'g'));
+    batch.append(other);
+    CHECK_EQ(batch.count(), 5u);
+
+    std::vector<std::string> seen;
+    bool ok = WriteBatch::iterate(batch.contents(),
+                                  [&](WriteBatch::OpType type, std::string_view key, std::string_view value, uint64_t expiresAt)
+                                  {
+                                      seen.push_back(std::to_string(type) + ":" + std::string(key) + ":" +
+                                                     std::to_string(value.size()) + ":" + std::to_string(expiresAt));
+                                  });
+    CHECK(ok);
+    REQUIRE(seen.size() == 5);
+    CHECK_EQ(seen[0], "1:a:1:0");
+    CHECK_EQ(seen[1], "4:b:1:12345");
+    CHECK_EQ(seen[2], "2:c:0:0");
+    CHECK_EQ(seen[3], "3:d:1:0");
+    CHECK_EQ(seen[4], "1:g:1000:0");
+
+    // A truncated batch reports the damage after passing on the intact operations
+    std::string truncated(batch.contents().substr(0, batch.contents().size() - 1));
+    size_t passed = 0;
+    CHECK(!WriteBatch::iterate(truncated, [&](WriteBatch::OpType, std::string_view, std::string_view, uint64_t) { passed++; }));
+    CHECK(passed < 5);
+
+    batch.clear();
+    CHECK_EQ(batch.count(), 0u);
+}
+
+TEST(blockCodecsRoundTrip)
+{
+    std::mt19937 random(7);
+    std::string compressible;
+    for (int i = 0; i < 2000; ++i)
+    {
+        compressible += tableKey(i % 50) + "=repeated value;";
+    }
+    std::string incompressible(8192, '\0');
+    for (char &c : incompressible)
+    {
+        c = (char)(random() & 0xff);
+    }
+
+    for (const BlockCodec *codec : availableCodecs())
+    {
+        for (const std::string *input : {&compressible, &incompressible})
+        {
+            std::string stored;
+            if (!compressBlock(*codec, *input, stored))
+            {
+                // Only worth storing uncompressed: random bytes, or the identity codec
+                CHECK(input == &incompressible || codec->type() == BLOCK_UNCOMPRESSED);
+                continue;
+            }
+            CHECK(stored.size() < input->size());
+            std::string restored;
+            REQUIRE(uncompressBlock(codec->type(), stored, restored));
+            CHECK(restored == *input);
+
+            // A truncated block is rejected, or at least not restored as the original
+            std::string damaged = stored.substr(0, stored.size() / 2);
+            std::string partial;
+            if (uncompressBlock(codec->type(), damaged, partial))
+            {
+                CHECK(partial != *input);
+            }
+        }
+        if (codec->type() != BLOCK_UNCOMPRESSED)
+        {
+            std::string stored;
+            CHECK(compressBlock(*codec, compressible, stored));
+        }
+    }
+
+    CHECK(findBlockCodec("lz") != nullptr);
+    CHECK(findBlockCodec("no such codec") == nullptr);
+}
+
+TEST(tableRoundTripWithEveryCodec)
+{
+    const int count = 5000;
+    for (const BlockCodec *codec : availableCodecs())
+    {
+        TempDirectory dir;
+        std::string path = dir.file("table.sst");
+
+        TableBuilder builder;
+        REQUIRE(builder.open(path, codec));
+        for (int i = 0; i < count; ++i)
+        {
+            builder.add(tableKey(i * 2), tableEntry(i * 2));
+        }
+        CHECK_EQ(builder.numEntries(), (size_t)count);
+        REQUIRE(builder.finish());
+
+        BlockCache cache(1 << 20);
+        for (BlockCache *blockCache : {(BlockCache *)nullptr, &cache})
+        {
+            TableReader reader;
+            REQUIRE(reader.open(path, blockCache));
+            CHECK_EQ(reader.numEntries(), (uint64_t)count);
+            CHECK_EQ(reader.smallestKey(), tableKey(0));
+            CHECK_EQ(reader.largestKey(), tableKey((count - 1) * 2));
+
+            // Point lookups of present keys, and of absent keys between them
+            int mismatches = 0;
+            std::string entry;
+            for (int i = 0; i < count * 2; ++i)
+            {
+                bool found = reader.get(tableKey(i), entry);
+                if (found != (i % 2 == 0) || (found && entry != tableEntry(i)))
+                {
+                    mismatches++;
+                }
+            }
+            CHECK_EQ(mismatches, 0);
+            CHECK(!reader.get("a", entry));
+            CHECK(!reader.get("z", entry));
+
+            std::vector<std::string> keyStorage;
+            for (int i = 0; i < 300; ++i)
+            {
+                keyStorage.push_back(tableKey(i * 31));
+            }
+            std::vector<std::string_view> keys(keyStorage.begin(), keyStorage.end());
+            std::vector<std::string> values(keys.size());
+            std::vector<char> found(keys.size(), 0);
+            size_t hits = reader.multiGet(keys, values, found);
+            size_t expectedHits = 0;
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                bool present = (i * 31) % 2 == 0;
+                expectedHits += present ? 1 : 0;
+                CHECK_EQ((bool)found[i], present);
+                if (present && found[i])
+                {
+                    CHECK(values[i] == tableEntry((int)i * 31));
+                }
+            }
+            CHECK_EQ(hits, expectedHits);
+
+            std::unique_ptr<KeyValueIterator> it = reader.newIterator();
+            int seen = 0;
+            for (it->seekToFirst(); it->valid(); it->next())
+            {
+                if (it->key() != tableKey(seen * 2) || it->value() != tableEntry(seen * 2))
+                {
+                    mismatches++;
+                }
+                seen++;
+            }
+            CHECK_EQ(seen, count);
+            CHECK_EQ(mismatches, 0);
+            CHECK(!it->corrupted());
+
+            it->seek(tableKey(1001));
+            REQUIRE(it->valid());
+            CHECK_EQ(it->key(), tableKey(1002));
+            it->seek(tableKey(count * 2));
+            CHECK(!it->valid());
+        }
+    }
+}
+
+TEST(tableIteratorDetectsCorruption)
+{
+    TempDirectory dir;
+    std::string path = dir.file("table.sst");
+
+    TableBuilder builder;
+    REQUIRE(builder.open(path));
+    for (int i = 0; i < 1000; ++i)
+    {
+        builder.add(tableKey(i), tableEntry(i));
+    }
+    REQUIRE(builder.finish());
+
+    // Damage a data block in the middle; open() only reads the first one
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp((std::streamoff)(std::filesystem::file_size(path) / 3));
+        file.put('\xff');
+    }
+
+    TableReader reader;
+    REQUIRE(reader.open(path));
+    std::unique_ptr<KeyValueIterator> it = reader.newIterator();
+    int seen = 0;
+    for (it->seekToFirst(); it->valid(); it->next())
+    {
+        seen++;
+    }
+    CHECK(seen < 1000);
+    CHECK(it->corrupted());
+}
+
+TEST(abandonedTableLeavesNoFile)
+{
+    TempDirectory dir;
+    std::string path = dir.file("table.sst");
+    {
+        TableBuilder builder;
+        REQUIRE(builder.open(path));
+        builder.add("a", "1");
+        builder.abandon();
+    }
+    CHECK(!std::filesystem::exists(path));
+    {
+        TableBuilder builder;
+        REQUIRE(builder.open(path));
+        builder.add("a", "1");
+    }
+    CHECK(!std::filesystem::exists(path));
+}
+
+TEST(bloomFilterHasNoFalseNegatives)
+{
+    const int keys = 20000;
+    BloomFilter builder;
+    for (int i = 0; i < keys; ++i)
+    {
+        builder.add(tableKey(i));
+    }
+    std::string data = builder.serialize();
+    CHECK(data.size() >= (size_t)keys * BLOOM_BITS_PER_KEY / 8);
+
+    BloomFilter filter;
+    REQUIRE(filter.deserialize(data));
+    int missed = 0;
+    std::vector<std::string> stored;
+    for (int i = 0; i < keys; ++i)
+    {
+        stored.push_back(tableKey(i));
+        missed += filter.mightContain(stored.back()) ? 0 : 1;
+    }
+    CHECK_EQ(missed, 0);
+
+    // The batched lookup agrees with the single one
+    std::vector<std::string_view> batch(stored.begin(), stored.end());
+    batch.push_back("absent");
+    std::vector<char> results;
+    filter.mightContain(batch, results);
+    REQUIRE(results.size() == batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        missed += (results[i] != 0) != filter.mightContain(batch[i]) ? 1 : 0;
+    }
+    CHECK_EQ(missed, 0);
+
+    // About 1% of absent keys match at 10 bits per key; blocking costs a little more
+    int falsePositives = 0;
+    const int probes = 100000;
+    for (int i = keys; i < keys + probes; ++i)
+    {
+        falsePositives += filter.mightContain(tableKey(i)) ? 1 : 0;
+    }
+    CHECK(falsePositives < probes * 3 / 100);
+}
+
+TEST(bloomFilterRejectsInvalidData)
+{
+    BloomFilter filter;
+    CHECK(filter.mightContain("anything"));
+    CHECK(!filter.deserialize(""));
+    CHECK(!filter.deserialize(std::string(64, '\0')));
+    CHECK(!filter.deserialize(std::string(64, '\0') + std::string(1, (char)0)));
+    CHECK(!filter.deserialize(std::string(64, '\0') + std::string(1, (char)31)));
+    CHECK(filter.mightContain("anything"));
+
+    // An all-zero filter rejects every key
+    REQUIRE(filter.deserialize(std::string(64, '\0') + std::string(1, (char)6)));
+    CHECK(!filter.mightContain("anything"));
+}
@@ -0,0 +1,143 @@
+/**
+ * @file test_harness.h
+ * @brief Minimal test registry and assertion macros for the engine tests
+ */
+
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/**
+ * @brief A registered test case
+ */
+struct TestCase
+{
+    const char *name;
+    void (*run)();
+};
+
+/**
+ * @brief All test cases, in registration order
+ */
+inline std::vector<TestCase> &testRegistry()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+/**
+ * @brief Number of failed checks of the running test
+ */
+inline int &testFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+/**
+ * @brief Adds a test case to the registry from a static initializer
+ */
+struct TestRegistrar
+{
+    TestRegistrar(const char *name, void (*run)()) { testRegistry().push_back({name, run}); }
+};
+
+/**
+ * @brief Defines and registers a test case
+ */
+#define TEST(name)                                              \
+    static void name();                                         \
+    static TestRegistrar name##Registrar(#name, name);          \
+    static void name()
+
+/**
+ * @brief Records a failure if a condition is false, and continues
+ */
+#define CHECK(condition)                                                                         \
+    do                                                                                           \
+    {                                                                                            \
+        if (!(condition))                                                                        \
+        {                                                                                        \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            testFailures()++;                                                                    \
+        }                                                                                        \
+    } while (0)
+
+/**
+ * @brief Records a failure if two values differ, printing both, and continues
+ */
+#define CHECK_EQ(actual, expected)                                                               \
+    do                                                                                           \
+    {                                                                                            \
+        const auto &checkActual = (actual);                                                      \
+        const auto &checkExpected = (expected);                                                  \
+        if (!(checkActual == checkExpected))                                                     \
+        {                                                                                        \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected     \
+                      << ") failed: " << checkActual << " != " << checkExpected << std::endl;    \
+            testFailures()++;                                                                    \
+        }                                                                                        \
+    } while (0)
+
+/**
+ * @brief Records a failure and leaves the test if a condition is false
+ */
+#define REQUIRE(condition)                                                                       \
+    do                                                                                           \
+    {                                                                                            \
+        if (!(condition))                                                                        \
+        {                                                                                        \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": REQUIRE(" #condition ") failed" << std::endl; \
+            testFailures()++;                                                                    \
+            return;                                                                              \
+        }                                                                                        \
+    } while (0)
+
+/**
+ * @class TempDirectory
+ * @brief Fresh directory under the system temporary directory, removed with its contents on destruction
+ */
+class TempDirectory
+{
+private:
+    std::string dir;
+
+public:
+    TempDirectory()
+    {
+        std::string pattern = (std::filesystem::temp_directory_path() / "engine_test_XXXXXX").string();
+        if (mkdtemp(pattern.data()) == nullptr)
+        {
+            throw std::runtime_error("Cannot create a temporary directory");
+        }
+        dir = pattern;
+    }
+
+    TempDirectory(const TempDirectory &) = delete;
+    TempDirectory &operator=(const TempDirectory &) = delete;
+
+    ~TempDirectory()
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    /**
+     * @brief Path of the directory, without a trailing slash
+     */
+    const std::string &path() const { return dir; }
+
+    /**
+     * @brief Path of a file in the directory
+     */
+    std::string file(const std::string &name) const { return dir + "/" + name; }
+};
+
+#endif // TEST_HARNESS_H
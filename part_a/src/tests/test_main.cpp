@@ -0,0 +1,50 @@
+/**
+ * @file test_main.cpp
+ * @brief Runs the registered engine tests.
+ */
+
+#include "test_harness.h"
+#include <cstring>
+#include <exception>
+
+/**
+ * @brief Runs every test, or those whose name contains one of the arguments.
+ * @return 0 if all selected tests passed, 1 otherwise.
+ */
+int main(int argc, char *argv[])
+{
+    size_t run = 0;
+    size_t failed = 0;
+    for (const TestCase &test : testRegistry())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc && !selected; ++i)
+        {
+            selected = std::strstr(test.name, argv[i]) != nullptr;
+        }
+        if (!selected)
+        {
+            continue;
+        }
+
+        testFailures() = 0;
+        try
+        {
+            test.run();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << test.name << ": unexpected exception: " << e.what() << std::endl;
+            testFailures()++;
+        }
+        run++;
+        if (testFailures() != 0)
+        {
+            failed++;
+        }
+        std::cout << (testFailures() == 0 ? "[ OK ] " : "[FAIL] ") << test.name << std::endl;
+    }
+
+    std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
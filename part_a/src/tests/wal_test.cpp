@@ -0,0 +1,344 @@
+/**
+ * @file wal_test.cpp
+ * @brief Tests of write-ahead log replay and of tree recovery after a crash.
+ */
+
+#include "test_harness.h"
+#include "../StorageEngine/lsmtree.h"
+#include "../StorageEngine/wal.h"
+#include "../StorageEngine/write_batch.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief A replayed log record.
+ */
+struct ReplayedRecord
+{
+    WriteAheadLog::RecordType type;
+    std::string key;
+    std::string value;
+};
+
+/**
+ * @brief Replays a log file into a list of records.
+ * @param path Log file.
+ * @return The records in log order.
+ */
+static std::vector<ReplayedRecord> replayAll(const std::string &path)
+{
+    std::vector<ReplayedRecord> records;
+    WriteAheadLog::replay(path, [&](WriteAheadLog::RecordType type, std::string &&key, std::string &&value)
+                          { records.push_back({type, std::move(key), std::move(value)}); });
+    return records;
+}
+
+/**
+ * @brief Builds a fixed-width key so that numeric and key order agree.
+ * @param i Key number.
+ * @return The key.
+ */
+static std::string testKey(int i)
+{
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "key%06d", i);
+    return buffer;
+}
+
+/**
+ * @brief Value written for a key by the crash tests.
+ * @param i Key number.
+ * @return The value.
+ */
+static std::string testValue(int i)
+{
+    return "value" + std::to_string(i);
+}
+
+/**
+ * @brief Runs a function in a child process that exits without any cleanup,
+ *        as a crashing server would.
+ * @param body Work of the child; returns false to report a failure.
+ * @return True if the child ran body to completion and it returned true.
+ */
+template <typename Body>
+static bool runAndCrash(Body body)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return false;
+    }
+    if (pid == 0)
+    {
+        _exit(body() ? 0 : 1);
+    }
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid)
+    {
+        return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Finds the newest numbered log of a tree directory.
+ * @param dir Tree directory.
+ * @return Path of the log with the highest number, or empty if there is none.
+ */
+static std::string newestLog(const std::string &dir)
+{
+    std::string newest;
+    unsigned long long newestNumber = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dir))
+    {
+        unsigned long long number = 0;
+        std::string name = entry.path().filename().string();
+        if (std::sscanf(name.c_str(), "wal_%llu.log", &number) == 1 && (newest.empty() || number > newestNumber))
+        {
+            newest = entry.path().string();
+            newestNumber = number;
+        }
+    }
+    return newest;
+}
+
+TEST(walReplaysRecordsInOrder)
+{
+    TempDirectory dir;
+    std::string path = dir.file("test.log");
+
+    WriteBatch batch;
+    batch.put("b", "2");
+    batch.remove("c");
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.open(path, WalSyncMode::ALWAYS, 0));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "a", "1"));
+        CHECK(wal.append(WriteAheadLog::RECORD_DELETE, "a", ""));
+        CHECK(wal.append(WriteAheadLog::RECORD_BATCH, "", batch.contents()));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "", std::string(100000, 'x')));
+    }
+
+    std::vector<ReplayedRecord> records = replayAll(path);
+    REQUIRE(records.size() == 4);
+    CHECK(records[0].type == WriteAheadLog::RECORD_PUT);
+    CHECK_EQ(records[0].key, "a");
+    CHECK_EQ(records[0].value, "1");
+    CHECK(records[1].type == WriteAheadLog::RECORD_DELETE);
+    CHECK_EQ(records[1].key, "a");
+    CHECK(records[2].type == WriteAheadLog::RECORD_BATCH);
+    CHECK(records[2].value == batch.contents());
+    CHECK_EQ(records[3].key, "");
+    CHECK(records[3].value == std::string(100000, 'x'));
+
+    CHECK_EQ(WriteAheadLog::replay(dir.file("missing.log"), [](WriteAheadLog::RecordType, std::string &&, std::string &&) {}),
+             0u);
+}
+
+TEST(walCutsOffTornTail)
+{
+    TempDirectory dir;
+    std::string path = dir.file("test.log");
+
+    uintmax_t intactSize = 0;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.open(path, WalSyncMode::ALWAYS, 0));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "a", "1"));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "b", "2"));
+        intactSize = std::filesystem::file_size(path);
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "c", "3"));
+    }
+
+    // A crash in the middle of the last write leaves part of its record
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 2);
+    std::vector<ReplayedRecord> records = replayAll(path);
+    REQUIRE(records.size() == 2);
+    CHECK_EQ(records[1].key, "b");
+    CHECK_EQ(std::filesystem::file_size(path), intactSize);
+
+    // Records appended after the replay follow the last valid one
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.open(path, WalSyncMode::ALWAYS, 0));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "d", "4"));
+    }
+    records = replayAll(path);
+    REQUIRE(records.size() == 3);
+    CHECK_EQ(records[2].key, "d");
+    CHECK_EQ(records[2].value, "4");
+}
+
+TEST(walStopsAtCorruptRecord)
+{
+    TempDirectory dir;
+    std::string path = dir.file("test.log");
+
+    uintmax_t firstSize = 0;
+    {
+        WriteAheadLog wal;
+        REQUIRE(wal.open(path, WalSyncMode::ALWAYS, 0));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "a", "1"));
+        firstSize = std::filesystem::file_size(path);
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "b", "value of b"));
+        CHECK(wal.append(WriteAheadLog::RECORD_PUT, "c", "3"));
+    }
+
+    // Flip the last byte of the second record's value so that its checksum fails
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg((std::streamoff)firstSize + 8 + 1 + 1 + 1 + 9);
+        char byte = 0;
+        file.get(byte);
+        file.seekp((std::streamoff)firstSize + 8 + 1 + 1 + 1 + 9);
+        file.put((char)(byte ^ 0x01));
+    }
+
+    std::vector<ReplayedRecord> records = replayAll(path);
+    REQUIRE(records.size() == 1);
+    CHECK_EQ(records[0].key, "a");
+    CHECK_EQ(std::filesystem::file_size(path), firstSize);
+}
+
+TEST(treeRecoversLoggedWritesAfterCrash)
+{
+    TempDirectory dir;
+    const int keys = 3 * MAX_MEMTABLE_SIZE;
+
+    // Enough writes for several memtable flushes, so that the crash finds
+    // data in tables, in frozen memtables and only in the log
+    bool completed = runAndCrash(
+        [&]
+        {
+            LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+            for (int i = 0; i < keys; i += 100)
+            {
+                WriteBatch batch;
+                for (int j = i; j < i + 100; ++j)
+                {
+                    batch.put(testKey(j), testValue(j));
+                }
+                if (!tree.write(batch))
+                {
+                    return false;
+                }
+            }
+            for (int i = 0; i < keys; i += 7)
+            {
+                if (!tree.remove(testKey(i)))
+                {
+                    return false;
+                }
+            }
+            return tree.removeRange(testKey(1000), testKey(2000)) && tree.set(testKey(1500), "reborn") &&
+                   tree.set(testKey(1), "overwritten");
+        });
+    REQUIRE(completed);
+
+    LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+    int mismatches = 0;
+    for (int i = 0; i < keys; ++i)
+    {
+        std::string expected = testValue(i);
+        if (i == 1)
+        {
+            expected = "overwritten";
+        }
+        else if (i == 1500)
+        {
+            expected = "reborn";
+        }
+        else if (i % 7 == 0 || (i >= 1000 && i < 2000))
+        {
+            expected = "NOT_FOUND";
+        }
+        if (tree.get(testKey(i)) != expected)
+        {
+            mismatches++;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+TEST(treeRecoversTornLogAfterCrash)
+{
+    TempDirectory dir;
+
+    bool completed = runAndCrash(
+        [&]
+        {
+            LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+            for (int i = 0; i < 100; ++i)
+            {
+                if (!tree.set(testKey(i), testValue(i)))
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+    REQUIRE(completed);
+
+    // The crash cut a record short: a header promising more than was written
+    std::string log = newestLog(dir.path());
+    REQUIRE(!log.empty());
+    {
+        std::ofstream file(log, std::ios::app | std::ios::binary);
+        file.write("\x12\x34\x56\x78\x40\x00\x00\x00\x01\x05", 10);
+    }
+
+    {
+        LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+        for (int i = 0; i < 100; ++i)
+        {
+            CHECK_EQ(tree.get(testKey(i)), testValue(i));
+        }
+        CHECK(tree.set(testKey(100), testValue(100)));
+    }
+
+    // Writes after the recovery survive the next restart as well
+    LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+    CHECK_EQ(tree.get(testKey(0)), testValue(0));
+    CHECK_EQ(tree.get(testKey(100)), testValue(100));
+}
+
+TEST(treeRecoversAcrossRepeatedCrashes)
+{
+    TempDirectory dir;
+
+    for (int round = 0; round < 3; ++round)
+    {
+        bool completed = runAndCrash(
+            [&]
+            {
+                LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+                for (int i = 0; i < 50; ++i)
+                {
+                    if (!tree.set(testKey(round * 50 + i), testValue(round)))
+                    {
+                        return false;
+                    }
+                }
+                return round == 0 || tree.remove(testKey((round - 1) * 50));
+            });
+        REQUIRE(completed);
+    }
+
+    LSMTree tree(dir.path(), WalSyncMode::ALWAYS);
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 50; ++i)
+        {
+            bool deleted = i == 0 && round < 2;
+            CHECK_EQ(tree.get(testKey(round * 50 + i)), deleted ? std::string("NOT_FOUND") : testValue(round));
+        }
+    }
+}
@@ -24,7 +24,7 @@ BenchmarkData::BenchmarkData(
     size_t writes,
     size_t keyLength,
     size_t valueLength) : numReads(reads), numWrites(writes),
-                          keySize(keyLength), valueSize(valueLength)
+                          keySize(keyLength), valueSize(valueLength), generator(std::random_device()())
 {
     std::cout << "Generating test data..." << std::endl;
     generateTestData();
@@ -33,7 +33,7 @@ BenchmarkData::BenchmarkData(
 /**
  * @brief Generates a random alphanumeric string of a specified length.
  *
- * Uses a random number generator to create a string consisting of
+ * Uses the object's random number generator to create a string consisting of
  * uppercase letters, lowercase letters, and digits.
  *
  * @param length Length of the string to generate.
@@ -46,8 +46,6 @@ std::string BenchmarkData::generateRandomString(size_t length)
         "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
         "abcdefghijklmnopqrstuvwxyz";
 
-    std::random_device rd;
-    std::mt19937 generator(rd());
     std::uniform_int_distribution<int> distribution(0, sizeof(charset) - 2);
 
     std::string result;
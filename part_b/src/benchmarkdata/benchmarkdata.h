@@ -6,6 +6,7 @@
 #ifndef BENCHMARK_DATA_H
 #define BENCHMARK_DATA_H
 
+#include <random>
 #include <string>
 #include <vector>
 
@@ -23,6 +24,7 @@ private:
     size_t numWrites;
     size_t keySize;
     size_t valueSize;
+    std::mt19937 generator;
 
     /**
      * @brief Generates a random string of specified length
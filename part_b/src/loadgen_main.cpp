@@ -0,0 +1,158 @@
+/**
+ * @file loadgen_main.cpp
+ * @brief Entry point of the load generator measuring BLINK DB server latency
+ */
+
+#include "loadgenerator/load_generator.h"
+#include "benchmarkdata/benchmarkdata.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <stdexcept>
+
+/**
+ * @brief Prints command line usage.
+ * @param prog Program name.
+ */
+static void printUsage(const char *prog)
+{
+    std::cerr << "Usage: " << prog << " [--host HOST] [--port PORT] [--threads N] [--connections N] [--pipeline N]\n"
+              << "       [--rate OPS] [--reads PERCENT] [--duration S] [--warmup S] [--keys N]\n"
+              << "       [--key-size BYTES] [--value-size BYTES] [--preload] [--csv]\n"
+              << "  --host HOST         Server address (default 127.0.0.1)\n"
+              << "  --port PORT         Server port (default " << LOADGEN_DEFAULT_PORT << ")\n"
+              << "  --threads N         Client threads (default 1)\n"
+              << "  --connections N     Connections in total, spread over the threads (default 10)\n"
+              << "  --pipeline N        Requests in flight per connection (default 1)\n"
+              << "  --rate OPS          Open loop: requests per second in total, latency measured from when each\n"
+              << "                      request was due; 0 runs closed loop (default 0)\n"
+              << "  --reads PERCENT     Share of GET requests, the rest are SET (default 50)\n"
+              << "  --duration S        Measured seconds (default 10)\n"
+              << "  --warmup S          Seconds of load before measuring (default 0)\n"
+              << "  --keys N            Number of distinct keys (default 100000)\n"
+              << "  --key-size BYTES    Key length (default 16)\n"
+              << "  --value-size BYTES  Value length (default 16)\n"
+              << "  --preload           SET every key once before the run so that GETs hit\n"
+              << "  --csv               Print the results as CSV\n";
+}
+
+/**
+ * @brief Prints one row of latency percentiles in microseconds.
+ * @param name Row label.
+ * @param histogram Latencies in nanoseconds.
+ * @param seconds Measured time, for the throughput.
+ * @param csv Print a CSV row instead of a table row.
+ */
+static void printRow(const char *name, const LatencyHistogram &histogram, double seconds, bool csv)
+{
+    const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    double ops = seconds > 0 ? (double)histogram.count() / seconds : 0;
+    if (csv)
+        std::printf("%s,%llu,%.0f,%.1f", name, (unsigned long long)histogram.count(), ops, histogram.mean() / 1e3);
+    else
+        std::printf("%-4s %12llu %12.0f %10.1f", name, (unsigned long long)histogram.count(), ops, histogram.mean() / 1e3);
+    for (double p : percentiles)
+        std::printf(csv ? ",%.1f" : " %10.1f", (double)histogram.percentile(p) / 1e3);
+    std::printf(csv ? ",%.1f\n" : " %10.1f\n", (double)histogram.max() / 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        LoadOptions options;
+        size_t keys = 100000;
+        size_t keySize = 16;
+        size_t valueSize = 16;
+        bool csv = false;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--host" && i + 1 < argc)
+                options.host = argv[++i];
+            else if (arg == "--port" && i + 1 < argc)
+                options.port = std::stoi(argv[++i]);
+            else if (arg == "--threads" && i + 1 < argc)
+                options.threads = std::stoul(argv[++i]);
+            else if (arg == "--connections" && i + 1 < argc)
+                options.connections = std::stoul(argv[++i]);
+            else if (arg == "--pipeline" && i + 1 < argc)
+                options.pipeline = std::stoul(argv[++i]);
+            else if (arg == "--rate" && i + 1 < argc)
+                options.rate = std::stod(argv[++i]);
+            else if (arg == "--reads" && i + 1 < argc)
+                options.readPercent = (unsigned)std::stoul(argv[++i]);
+            else if (arg == "--duration" && i + 1 < argc)
+                options.durationSeconds = std::stod(argv[++i]);
+            else if (arg == "--warmup" && i + 1 < argc)
+                options.warmupSeconds = std::stod(argv[++i]);
+            else if (arg == "--keys" && i + 1 < argc)
+                keys = std::stoul(argv[++i]);
+            else if (arg == "--key-size" && i + 1 < argc)
+                keySize = std::stoul(argv[++i]);
+            else if (arg == "--value-size" && i + 1 < argc)
+                valueSize = std::stoul(argv[++i]);
+            else if (arg == "--preload")
+                options.preload = true;
+            else if (arg == "--csv")
+                csv = true;
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (options.threads == 0 || options.connections == 0 || options.pipeline == 0 || keys == 0 || keySize == 0 ||
+            valueSize == 0 || options.readPercent > 100 || options.rate < 0 || options.durationSeconds <= 0 ||
+            options.warmupSeconds < 0)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        // Test data progress goes to stderr so that --csv output stays clean
+        std::streambuf *stdoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+        BenchmarkData data(keys, keys, keySize, valueSize);
+        std::cout.rdbuf(stdoutBuffer);
+
+        LoadGenerator generator(options, data);
+        LoadReport report = generator.run();
+
+        LatencyHistogram all = report.reads;
+        all.merge(report.writes);
+
+        if (csv)
+        {
+            std::printf("op,count,ops_per_sec,mean_us,p50_us,p90_us,p99_us,p99.9_us,p99.99_us,max_us\n");
+        }
+        else
+        {
+            if (options.preload)
+                std::printf("Preloaded %zu keys in %.2f s\n", keys, report.preloadSeconds);
+            std::printf("%s loop, %zu connections, pipeline %zu", options.rate > 0 ? "Open" : "Closed",
+                        options.connections, options.pipeline);
+            if (options.rate > 0)
+                std::printf(", target %.0f ops/s", options.rate);
+            std::printf(", %.1f s measured\n", report.seconds);
+            std::printf("%-4s %12s %12s %10s %10s %10s %10s %10s %10s %10s  (latency in us)\n", "op", "count", "ops/s",
+                        "mean", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+        }
+        printRow("GET", report.reads, report.seconds, csv);
+        printRow("SET", report.writes, report.seconds, csv);
+        printRow("ALL", all, report.seconds, csv);
+
+        if (report.errors != 0)
+            std::cerr << report.errors << " requests failed" << std::endl;
+        if (report.unsent != 0)
+            std::cerr << report.unsent << " requests were never sent: the server did not keep up with --rate "
+                      << "at this --connections and --pipeline" << std::endl;
+        return report.errors != 0 ? 2 : 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Fatal error: " << e.what() << std::endl;
+        return 1;
+    }
+}
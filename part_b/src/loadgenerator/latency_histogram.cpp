@@ -0,0 +1,126 @@
+/**
+ * @file latency_histogram.cpp
+ * @brief Implementation of the log-linear latency histogram.
+ */
+
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Number of buckets: 2^S for the values below 2^S, then 2^(S-1) for
+ *        each further power of two up to 2^LATENCY_HISTOGRAM_MAX_BITS.
+ */
+static const size_t BUCKET_COUNT =
+    ((size_t)(LATENCY_HISTOGRAM_MAX_BITS - LATENCY_HISTOGRAM_SUB_BUCKET_BITS) << (LATENCY_HISTOGRAM_SUB_BUCKET_BITS - 1)) +
+    ((size_t)1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS);
+
+/**
+ * @brief Constructs an empty histogram.
+ */
+LatencyHistogram::LatencyHistogram() : counts(BUCKET_COUNT, 0)
+{
+}
+
+/**
+ * @brief Finds the bucket of a value.
+ *
+ * A value whose highest set bit is m >= S is shifted right by m - S + 1,
+ * leaving a sub-bucket in [2^(S-1), 2^S); the shift selects the power of two.
+ *
+ * @param value Sample.
+ * @return Bucket index, clamped to the last bucket.
+ */
+size_t LatencyHistogram::bucketOf(uint64_t value)
+{
+    const int S = LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    if (value < ((uint64_t)1 << S))
+        return (size_t)value;
+
+    int highestBit = 63 - __builtin_clzll(value);
+    int shift = highestBit - S + 1;
+    size_t bucket = ((size_t)shift << (S - 1)) + (size_t)(value >> shift);
+    return std::min(bucket, BUCKET_COUNT - 1);
+}
+
+/**
+ * @brief Computes the largest value a bucket counts.
+ * @param bucket Bucket index.
+ * @return Upper bound of the bucket.
+ */
+uint64_t LatencyHistogram::highestValueOf(size_t bucket)
+{
+    const int S = LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    if (bucket < ((size_t)1 << S))
+        return bucket;
+
+    int shift = (int)(bucket >> (S - 1)) - 1;
+    uint64_t sub = bucket - ((size_t)shift << (S - 1));
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * @brief Counts one sample.
+ * @param value Sample.
+ */
+void LatencyHistogram::record(uint64_t value)
+{
+    counts[bucketOf(value)]++;
+    total++;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+    sum += value;
+}
+
+/**
+ * @brief Adds the samples of another histogram.
+ * @param other Histogram to add.
+ */
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        counts[i] += other.counts[i];
+    total += other.total;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    sum += other.sum;
+}
+
+/**
+ * @brief Forgets all samples.
+ */
+void LatencyHistogram::clear()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    minValue = UINT64_MAX;
+    maxValue = 0;
+    sum = 0;
+}
+
+/**
+ * @brief Finds the value at a percentile.
+ *
+ * Walks the buckets until the cumulative count reaches the percentile's rank
+ * and reports that bucket's upper bound, so the result is never below the true
+ * percentile and exceeds it by less than the bucket width.
+ *
+ * @param percent Percentile in [0, 100].
+ * @return Value at the percentile, at most the exact maximum.
+ */
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+    if (total == 0)
+        return 0;
+
+    percent = std::min(std::max(percent, 0.0), 100.0);
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(percent / 100.0 * (double)total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return i == BUCKET_COUNT - 1 ? maxValue : std::min(highestValueOf(i), maxValue);
+    }
+    return maxValue;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file latency_histogram.h
+ * @brief Log-linear latency histogram with bounded relative error
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Log2 of the number of linear sub-buckets per power of two; 11 keeps the
+ *        relative error of a reported value below 0.1%
+ */
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS 11
+
+/**
+ * @brief Log2 of the largest value tracked with full precision; larger values share the
+ *        last bucket (2^40 ns is about 18 minutes)
+ */
+#define LATENCY_HISTOGRAM_MAX_BITS 40
+
+/**
+ * @class LatencyHistogram
+ * @brief Counts latency samples in buckets whose width grows with the value
+ *
+ * Values below 2^LATENCY_HISTOGRAM_SUB_BUCKET_BITS get one bucket each; every
+ * higher power of two is split into half as many equal buckets, as in
+ * HdrHistogram, so percentiles of any magnitude are exact to a fixed relative
+ * precision while recording is a few shifts and an increment. The exact
+ * minimum and maximum are kept besides.
+ */
+class LatencyHistogram
+{
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t minValue = UINT64_MAX;
+    uint64_t maxValue = 0;
+    long double sum = 0;
+
+    /**
+     * @brief Index of the bucket counting a value
+     */
+    static size_t bucketOf(uint64_t value);
+
+    /**
+     * @brief Largest value counted by a bucket
+     */
+    static uint64_t highestValueOf(size_t bucket);
+
+public:
+    LatencyHistogram();
+
+    /**
+     * @brief Counts one sample
+     * @param value Sample, e.g. a latency in nanoseconds
+     */
+    void record(uint64_t value);
+
+    /**
+     * @brief Adds the samples of another histogram
+     * @param other Histogram to add
+     */
+    void merge(const LatencyHistogram &other);
+
+    /**
+     * @brief Forgets all samples
+     */
+    void clear();
+
+    /**
+     * @brief Value below or at which the given percentage of samples lie
+     * @param percent Percentile in [0, 100]
+     * @return Upper bound of the bucket holding the percentile, at most max(); 0 without samples
+     */
+    uint64_t percentile(double percent) const;
+
+    /**
+     * @brief Number of samples
+     */
+    uint64_t count() const { return total; }
+
+    /**
+     * @brief Smallest sample, 0 without samples
+     */
+    uint64_t min() const { return total == 0 ? 0 : minValue; }
+
+    /**
+     * @brief Largest sample
+     */
+    uint64_t max() const { return maxValue; }
+
+    /**
+     * @brief Arithmetic mean of the samples, 0 without samples
+     */
+    double mean() const { return total == 0 ? 0 : (double)(sum / total); }
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,418 @@
+/**
+ * @file load_generator.cpp
+ * @brief Implementation of the RESP load generator.
+ */
+
+#include "load_generator.h"
+#include "../server/output_buffer.h"
+#include "../server/resp_parser.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief A request awaiting its reply.
+ */
+struct InFlightRequest
+{
+    uint64_t due;  ///< Time the request was due, from which its latency is measured
+    bool write;    ///< SET rather than GET
+};
+
+/**
+ * @brief A connection to the server and the requests pipelined on it.
+ */
+struct LoadConnection
+{
+    int fd = -1;
+    std::string input;                   ///< Received bytes not yet parsed, from inputStart
+    size_t inputStart = 0;
+    OutputBuffer output;                 ///< Serialized requests the socket has not accepted yet
+    std::deque<InFlightRequest> inFlight;
+    uint64_t nextDue = 0;                ///< Open loop: due time of the next request
+};
+
+/**
+ * @brief Connections and measurements of one client thread.
+ */
+struct LoadThread
+{
+    std::vector<LoadConnection> connections;
+    std::mt19937_64 rng;
+    LatencyHistogram reads;
+    LatencyHistogram writes;
+    uint64_t errors = 0;
+    uint64_t unsent = 0;
+    size_t nextKey = 0; ///< Preload: next key to SET
+    size_t endKey = 0;  ///< Preload: end of this thread's key range
+};
+
+/**
+ * @brief Reads a monotonic clock.
+ * @return Nanoseconds since an arbitrary epoch.
+ */
+static uint64_t nowNanos()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Opens a non-blocking TCP connection with Nagle's algorithm disabled.
+ * @param host Server host name or address.
+ * @param port Server port.
+ * @return Connected socket.
+ * @throws std::runtime_error if no address of the host accepts the connection.
+ */
+static int connectTo(const std::string &host, int port)
+{
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo *addresses = nullptr;
+    int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses);
+    if (rc != 0)
+        throw std::runtime_error("Cannot resolve " + host + ": " + gai_strerror(rc));
+
+    int fd = -1;
+    int error = 0;
+    for (struct addrinfo *ai = addresses; ai != nullptr && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+        {
+            error = errno;
+            continue;
+        }
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) < 0)
+        {
+            error = errno;
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0)
+        throw std::runtime_error("Cannot connect to " + host + ":" + std::to_string(port) + ": " + std::strerror(error));
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+/**
+ * @brief Serializes a GET or SET of a benchmark key onto a connection.
+ * @param data Benchmark keys and values.
+ * @param conn Connection.
+ * @param key Index of the key.
+ * @param write Send SET rather than GET.
+ * @param due Time the request was due.
+ */
+static void sendRequest(const BenchmarkData &data, LoadConnection &conn, size_t key, bool write, uint64_t due)
+{
+    RespParser::writeArrayHeader(conn.output, write ? 3 : 2);
+    RespParser::writeBulkString(conn.output, std::string_view(write ? "SET" : "GET"));
+    RespParser::writeBulkString(conn.output, std::string_view(data.keys[key]));
+    if (write)
+        RespParser::writeBulkString(conn.output, std::string_view(data.values[key % data.values.size()]));
+    conn.inFlight.push_back({due, write});
+}
+
+/**
+ * @brief Closes a failed connection, counting its outstanding requests as errors.
+ * @param thread Owning thread.
+ * @param conn Connection.
+ */
+static void dropConnection(LoadThread &thread, LoadConnection &conn)
+{
+    thread.errors += conn.inFlight.size();
+    conn.inFlight.clear();
+    conn.output.clear();
+    close(conn.fd);
+    conn.fd = -1;
+}
+
+/**
+ * @brief Reads the available replies of a connection and records their latency.
+ * @param thread Owning thread.
+ * @param conn Connection.
+ * @param measureFrom Requests due earlier belong to the warm-up and are not recorded.
+ * @return False if the connection closed or sent something other than the expected replies.
+ */
+static bool readReplies(LoadThread &thread, LoadConnection &conn, uint64_t measureFrom)
+{
+    char buffer[LOADGEN_READ_SIZE];
+    for (;;)
+    {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            conn.input.append(buffer, (size_t)n);
+            if ((size_t)n < sizeof(buffer))
+                break;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        return false;
+    }
+
+    uint64_t now = nowNanos();
+    for (;;)
+    {
+        size_t consumed = 0;
+        bool isError = false;
+        RespParser::ParseStatus status = RespParser::parseReply(conn.input.data() + conn.inputStart,
+                                                                conn.input.size() - conn.inputStart, consumed, isError);
+        if (status == RespParser::PARSE_INCOMPLETE)
+            break;
+        if (status == RespParser::PARSE_ERROR || conn.inFlight.empty())
+            return false;
+
+        InFlightRequest request = conn.inFlight.front();
+        conn.inFlight.pop_front();
+        conn.inputStart += consumed;
+        if (isError)
+            thread.errors++;
+        else if (request.due >= measureFrom)
+            (request.write ? thread.writes : thread.reads).record(now - request.due);
+    }
+
+    // Compact once the parsed prefix dominates the buffer
+    if (conn.inputStart > 0 && conn.inputStart * 2 >= conn.input.size())
+    {
+        conn.input.erase(0, conn.inputStart);
+        conn.inputStart = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Runs one thread's share of a phase.
+ *
+ * The preload SETs the thread's key range with every connection's pipeline
+ * full. The measured phase sends until the deadline, then waits up to
+ * LOADGEN_DRAIN_TIMEOUT_MS for the outstanding replies.
+ *
+ * @param options Run parameters.
+ * @param data Benchmark keys and values.
+ * @param thread Thread state.
+ * @param preload Run the preload instead of the measured phase.
+ * @param measureFrom End of the warm-up.
+ * @param deadline End of the measured phase.
+ * @param interval Open loop: nanoseconds between two requests of a connection.
+ */
+static void drive(const LoadOptions &options, const BenchmarkData &data, LoadThread &thread, bool preload,
+                  uint64_t measureFrom, uint64_t deadline, uint64_t interval)
+{
+    std::uniform_int_distribution<size_t> keyDist(0, data.keys.size() - 1);
+    std::uniform_int_distribution<unsigned> mixDist(0, 99);
+    bool openLoop = !preload && options.rate > 0;
+    std::vector<struct pollfd> fds(thread.connections.size());
+    uint64_t drainUntil = 0;
+
+    for (;;)
+    {
+        uint64_t now = nowNanos();
+        bool sending = preload ? thread.nextKey < thread.endKey : now < deadline;
+        bool idle = true;
+        size_t live = 0;
+        uint64_t wakeAt = preload ? UINT64_MAX : deadline;
+
+        for (LoadConnection &conn : thread.connections)
+        {
+            if (conn.fd < 0)
+                continue;
+            while (sending && conn.inFlight.size() < options.pipeline)
+            {
+                if (preload)
+                {
+                    if (thread.nextKey == thread.endKey)
+                        break;
+                    sendRequest(data, conn, thread.nextKey++, true, now);
+                }
+                else if (openLoop)
+                {
+                    if (conn.nextDue > now || conn.nextDue >= deadline)
+                        break;
+                    sendRequest(data, conn, keyDist(thread.rng), mixDist(thread.rng) >= options.readPercent, conn.nextDue);
+                    conn.nextDue += interval;
+                }
+                else
+                {
+                    sendRequest(data, conn, keyDist(thread.rng), mixDist(thread.rng) >= options.readPercent, now);
+                }
+            }
+            if (openLoop && conn.inFlight.size() < options.pipeline)
+                wakeAt = std::min(wakeAt, conn.nextDue);
+
+            if (!conn.output.empty() && conn.output.flush(conn.fd) == OutputBuffer::FLUSH_ERROR)
+            {
+                dropConnection(thread, conn);
+                continue;
+            }
+            if (!conn.inFlight.empty())
+                idle = false;
+            live++;
+        }
+
+        if (live == 0)
+            break;
+        if (!sending)
+        {
+            if (idle)
+                break;
+            if (drainUntil == 0)
+                drainUntil = now + (uint64_t)LOADGEN_DRAIN_TIMEOUT_MS * 1000000;
+            else if (now >= drainUntil)
+            {
+                for (LoadConnection &conn : thread.connections)
+                {
+                    if (conn.fd >= 0)
+                        dropConnection(thread, conn);
+                }
+                break;
+            }
+            wakeAt = drainUntil;
+        }
+
+        for (size_t i = 0; i < thread.connections.size(); ++i)
+        {
+            LoadConnection &conn = thread.connections[i];
+            fds[i].fd = conn.fd;
+            fds[i].events = (short)((conn.inFlight.empty() ? 0 : POLLIN) | (conn.output.empty() ? 0 : POLLOUT));
+            fds[i].revents = 0;
+        }
+
+        // poll() counts whole milliseconds; a request due sooner is waited for by polling without blocking
+        int timeout = -1;
+        if (wakeAt != UINT64_MAX)
+            timeout = wakeAt <= now ? 0 : (int)std::min<uint64_t>((wakeAt - now) / 1000000, 1000);
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+            break;
+
+        for (size_t i = 0; i < thread.connections.size(); ++i)
+        {
+            LoadConnection &conn = thread.connections[i];
+            if (conn.fd < 0 || (fds[i].revents & (POLLIN | POLLERR | POLLHUP)) == 0)
+                continue;
+            if (!readReplies(thread, conn, measureFrom))
+                dropConnection(thread, conn);
+        }
+    }
+
+    if (openLoop)
+    {
+        for (LoadConnection &conn : thread.connections)
+        {
+            uint64_t from = std::max(conn.nextDue, measureFrom);
+            if (from < deadline)
+                thread.unsent += (deadline - from + interval - 1) / interval;
+        }
+    }
+}
+
+/**
+ * @brief Constructs a load generator.
+ * @param options Run parameters.
+ * @param data Keys and values to use.
+ */
+LoadGenerator::LoadGenerator(const LoadOptions &options, const BenchmarkData &data) : options(options), data(data)
+{
+}
+
+/**
+ * @brief Performs the preload, if requested, and the measured run.
+ *
+ * All connections are opened up front, connection i going to thread
+ * i % threads. Each phase runs on its own set of threads, so the measured
+ * phase starts only after every thread has finished the preload. Open-loop
+ * connections are started evenly staggered over one request interval so
+ * that requests arrive at a steady rate rather than in bursts.
+ *
+ * @return Merged measurements of all threads.
+ */
+LoadReport LoadGenerator::run()
+{
+    size_t threadCount = std::max<size_t>(1, std::min(options.threads, options.connections));
+    std::vector<LoadThread> threads(threadCount);
+    std::random_device seed;
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads[i].rng.seed(((uint64_t)seed() << 32) ^ seed() ^ i);
+        threads[i].nextKey = i * data.keys.size() / threadCount;
+        threads[i].endKey = (i + 1) * data.keys.size() / threadCount;
+    }
+    for (size_t i = 0; i < options.connections; ++i)
+    {
+        LoadConnection conn;
+        conn.fd = connectTo(options.host, options.port);
+        threads[i % threadCount].connections.push_back(std::move(conn));
+    }
+
+    auto runPhase = [&](bool preload, uint64_t measureFrom, uint64_t deadline, uint64_t interval)
+    {
+        std::vector<std::thread> workers;
+        for (LoadThread &thread : threads)
+            workers.emplace_back(drive, std::cref(options), std::cref(data), std::ref(thread), preload, measureFrom, deadline,
+                                 interval);
+        for (std::thread &worker : workers)
+            worker.join();
+    };
+
+    LoadReport report;
+    if (options.preload)
+    {
+        uint64_t start = nowNanos();
+        runPhase(true, UINT64_MAX, 0, 0);
+        report.preloadSeconds = (double)(nowNanos() - start) / 1e9;
+        for (LoadThread &thread : threads)
+        {
+            report.errors += thread.errors;
+            thread.errors = 0;
+        }
+    }
+
+    uint64_t interval = options.rate > 0 ? std::max<uint64_t>(1, (uint64_t)(options.connections * 1e9 / options.rate)) : 0;
+    uint64_t start = nowNanos();
+    uint64_t measureFrom = start + (uint64_t)(options.warmupSeconds * 1e9);
+    uint64_t deadline = measureFrom + (uint64_t)(options.durationSeconds * 1e9);
+    for (size_t i = 0; i < options.connections; ++i)
+        threads[i % threadCount].connections[i / threadCount].nextDue = start + interval * i / options.connections;
+
+    runPhase(false, measureFrom, deadline, interval);
+
+    report.seconds = options.durationSeconds;
+    for (LoadThread &thread : threads)
+    {
+        report.reads.merge(thread.reads);
+        report.writes.merge(thread.writes);
+        report.errors += thread.errors;
+        report.unsent += thread.unsent;
+        for (LoadConnection &conn : thread.connections)
+        {
+            if (conn.fd >= 0)
+                close(conn.fd);
+        }
+    }
+    return report;
+}
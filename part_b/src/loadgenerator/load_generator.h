@@ -0,0 +1,98 @@
+/**
+ * @file load_generator.h
+ * @brief Multi-threaded RESP load generator measuring server latency
+ */
+
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include "latency_histogram.h"
+#include "../benchmarkdata/benchmarkdata.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Default server port (the server listens on PORT from server.h)
+ */
+#define LOADGEN_DEFAULT_PORT 9002
+
+/**
+ * @brief Size of the buffer each connection reads replies into
+ */
+#define LOADGEN_READ_SIZE 65536
+
+/**
+ * @brief Time in milliseconds to wait for outstanding replies once a run ends
+ */
+#define LOADGEN_DRAIN_TIMEOUT_MS 5000
+
+/**
+ * @brief Parameters of a load run
+ */
+struct LoadOptions
+{
+    std::string host = "127.0.0.1";  ///< Server address
+    int port = LOADGEN_DEFAULT_PORT;  ///< Server port
+    size_t threads = 1;               ///< Client threads, each driving its share of the connections
+    size_t connections = 10;          ///< Connections in total
+    size_t pipeline = 1;              ///< Requests in flight per connection
+    double rate = 0;                  ///< Total requests per second (open loop), or 0 for closed loop
+    unsigned readPercent = 50;        ///< Share of GET requests; the rest are SET
+    double durationSeconds = 10;      ///< Length of the measured run
+    double warmupSeconds = 0;         ///< Load applied before measuring starts
+    bool preload = false;             ///< SET every key once before the run
+};
+
+/**
+ * @brief Outcome of a load run
+ */
+struct LoadReport
+{
+    LatencyHistogram reads;    ///< GET latencies in nanoseconds
+    LatencyHistogram writes;   ///< SET latencies in nanoseconds
+    uint64_t errors = 0;       ///< Error replies and requests lost with a connection, preload included
+    uint64_t unsent = 0;       ///< Open loop: requests due but never sent because the pipelines were full
+    double seconds = 0;        ///< Measured wall-clock time
+    double preloadSeconds = 0; ///< Time the preload took
+};
+
+/**
+ * @class LoadGenerator
+ * @brief Drives a server with GET and SET requests and records their latency
+ *
+ * Every thread multiplexes its connections with poll() and keeps up to
+ * LoadOptions::pipeline requests in flight on each. Keys are drawn uniformly
+ * from BenchmarkData::keys and SET values from BenchmarkData::values.
+ *
+ * In closed-loop mode a connection sends its next request as soon as a reply
+ * frees a pipeline slot, so the offered load adapts to the server. In
+ * open-loop mode each connection is given requests at a fixed rate, and a
+ * request's latency is measured from the time it was due rather than the time
+ * it could be sent: a stalled server is charged for every request that queued
+ * up behind the stall instead of just one, which keeps the tail latency free
+ * of coordinated omission.
+ */
+class LoadGenerator
+{
+private:
+    LoadOptions options;
+    const BenchmarkData &data;
+
+public:
+    /**
+     * @brief Constructor
+     * @param options Run parameters
+     * @param data Keys and values to use; must outlive the generator
+     */
+    LoadGenerator(const LoadOptions &options, const BenchmarkData &data);
+
+    /**
+     * @brief Performs the preload, if requested, and the measured run
+     * @return Merged measurements of all threads
+     * @throws std::runtime_error if the server cannot be reached
+     */
+    LoadReport run();
+};
+
+#endif // LOAD_GENERATOR_H
@@ -6,21 +6,221 @@
 #include "server/server.h"
 #include "benchmarkdata/benchmarkdata.h"
 #include "../../part_a/src/StorageEngine/lsmtree.h"
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <stdexcept>
+#include <vector>
 
-int main()
+/**
+ * @brief Prints command line usage.
+ * @param prog Program name.
+ */
+static void printUsage(const char *prog)
+{
+    std::cerr << "Usage: " << prog << " [--port PORT] [--threads N] [--output-hwm BYTES] [--io epoll|io_uring]\n"
+              << "       [--wal-sync always|interval|os] [--wal-sync-ms MS] [--block-cache BYTES]\n"
+              << "  --port PORT         TCP port to listen on (default " << PORT << ")\n"
+              << "  --threads N         Number of event-loop threads, each owning one storage shard (default 1)\n"
+              << "  --output-hwm BYTES  Buffered reply bytes per client at which reading pauses (default "
+              << OUTPUT_HIGH_WATER_MARK << ")\n"
+              << "  --io BACKEND        Networking backend: epoll (kqueue on macOS) or io_uring (default epoll)\n"
+              << "  --wal-sync MODE     Write-ahead log sync: always (group commit), interval or os (default interval)\n"
+              << "  --wal-sync-ms MS    Sync period of --wal-sync interval (default " << WAL_SYNC_INTERVAL_MS << ")\n"
+              << "  --block-cache BYTES SSTable block cache shared by all shards (default " << BLOCK_CACHE_CAPACITY << ")\n";
+}
+
+/**
+ * @brief Counts the shards of a data directory that does not record its shard count.
+ *
+ * Such a directory holds either shard_i subdirectories or the files of a
+ * single tree.
+ *
+ * @param dir Data directory.
+ * @return Number of shards found, or 0 if the directory is missing or empty.
+ */
+static size_t detectShardCount(const std::string &dir)
+{
+    std::error_code ec;
+    size_t shards = 0;
+    bool files = false;
+    for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+    {
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory(ec) && name.compare(0, 6, "shard_") == 0)
+            shards++;
+        else
+            files = true;
+    }
+    return shards != 0 ? shards : (files ? 1 : 0);
+}
+
+/**
+ * @brief Checks that a data directory is opened with the shard count it was created with.
+ *
+ * Keys are assigned to shards by hash modulo the shard count, and a single
+ * shard lives in the directory itself rather than in shard_0, so any other
+ * count would hide the stored keys. The count is recorded on first start.
+ *
+ * @param dir Data directory.
+ * @param threads Shard count requested with --threads.
+ * @return True if the server may start.
+ */
+static bool checkShardCount(const std::string &dir, size_t threads)
+{
+    std::string path = dir + "/" + SHARD_COUNT_FILE_NAME;
+    std::ifstream in(path);
+    size_t recorded = 0;
+    if (in && (!(in >> recorded) || recorded == 0))
+    {
+        std::cerr << "Invalid shard count in " << path << std::endl;
+        return false;
+    }
+    if (!in)
+        recorded = detectShardCount(dir);
+
+    if (recorded != 0 && recorded != threads)
+    {
+        std::cerr << dir << " holds " << recorded << " shard(s); start with --threads " << recorded << std::endl;
+        return false;
+    }
+    if (in)
+        return true;
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    std::ofstream out(path, std::ios::trunc);
+    if (!(out << threads << "\n") || !out.flush())
+    {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
 {
     try
     {
         std::string sstableDir = "sstabledata";
+        int port = PORT;
+        size_t threads = 1;
+        size_t outputHighWaterMark = OUTPUT_HIGH_WATER_MARK;
+        IoBackend io = IoBackend::EVENT_LOOP;
+        WalSyncMode walSync = WalSyncMode::INTERVAL;
+        unsigned walSyncMs = WAL_SYNC_INTERVAL_MS;
+        size_t blockCacheBytes = BLOCK_CACHE_CAPACITY;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--port" && i + 1 < argc)
+            {
+                port = std::stoi(argv[++i]);
+            }
+            else if (arg == "--threads" && i + 1 < argc)
+            {
+                threads = std::stoul(argv[++i]);
+            }
+            else if (arg == "--output-hwm" && i + 1 < argc)
+            {
+                outputHighWaterMark = std::stoul(argv[++i]);
+            }
+            else if (arg == "--io" && i + 1 < argc)
+            {
+                std::string name = argv[++i];
+                if (name == "epoll" || name == "kqueue")
+                    io = IoBackend::EVENT_LOOP;
+                else if (name == "io_uring")
+                    io = IoBackend::IO_URING;
+                else
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else if (arg == "--wal-sync" && i + 1 < argc)
+            {
+                std::string mode = argv[++i];
+                if (mode == "always")
+                    walSync = WalSyncMode::ALWAYS;
+                else if (mode == "interval")
+                    walSync = WalSyncMode::INTERVAL;
+                else if (mode == "os")
+                    walSync = WalSyncMode::OS;
+                else
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else if (arg == "--wal-sync-ms" && i + 1 < argc)
+            {
+                walSyncMs = (unsigned)std::stoul(argv[++i]);
+            }
+            else if (arg == "--block-cache" && i + 1 < argc)
+            {
+                blockCacheBytes = std::stoul(argv[++i]);
+            }
+            else
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (threads == 0 || threads > MAX_WORKER_THREADS)
+        {
+            std::cerr << "--threads must be between 1 and " << MAX_WORKER_THREADS << std::endl;
+            return 1;
+        }
+
+        if (port <= 0 || port > 65535)
+        {
+            std::cerr << "--port must be between 1 and 65535" << std::endl;
+            return 1;
+        }
+
+        if (!checkShardCount(sstableDir, threads))
+            return 1;
 
         BenchmarkData data;
+        auto blockCache = std::make_shared<BlockCache>(blockCacheBytes);
+
+        if (threads == 1)
+        {
+            LSMTree store(sstableDir, walSync, walSyncMs, blockCache);
+
+            KQueueServer server(store, data);
+            server.setOutputHighWaterMark(outputHighWaterMark);
+            server.setPort(port);
+            if (!server.setIoBackend(io))
+            {
+                std::cerr << "io_uring is not supported on this platform" << std::endl;
+                return 1;
+            }
+            return server.run();
+        }
 
-        LSMTree store(sstableDir);
+        // One LSMTree per shard, each with its own memtable and SSTable directory
+        std::vector<std::unique_ptr<LSMTree>> stores;
+        std::vector<LSMTree *> shards;
+        for (size_t i = 0; i < threads; ++i)
+        {
+            stores.emplace_back(new LSMTree(sstableDir + "/shard_" + std::to_string(i), walSync, walSyncMs, blockCache));
+            shards.push_back(stores.back().get());
+        }
 
-        KQueueServer server(store, data);
+        KQueueServer server(shards, data);
+        server.setOutputHighWaterMark(outputHighWaterMark);
+        server.setPort(port);
+        if (!server.setIoBackend(io))
+        {
+            std::cerr << "io_uring is not supported on this platform" << std::endl;
+            return 1;
+        }
         return server.run();
     }
     catch (const std::exception &e)
@@ -0,0 +1,193 @@
+/**
+ * @file event_loop.cpp
+ * @brief epoll and kqueue implementations of the EventLoop interface.
+ */
+
+#include "event_loop.h"
+#include <unistd.h>
+#include <cerrno>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <sys/event.h>
+#endif
+
+#if defined(__linux__)
+
+/**
+ * @class EpollEventLoop
+ * @brief Edge-triggered epoll backend
+ *
+ * Peer shutdown is reported through EPOLLRDHUP so a half-closed connection is
+ * detected on the same wakeup that delivers its final bytes.
+ */
+class EpollEventLoop : public EventLoop
+{
+private:
+    int epfd = -1;
+    std::vector<struct epoll_event> raw;
+
+public:
+    ~EpollEventLoop() override
+    {
+        if (epfd >= 0)
+        {
+            close(epfd);
+        }
+    }
+
+    bool init() override
+    {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        return epfd >= 0;
+    }
+
+    bool add(int fd, uint32_t interest) override
+    {
+        struct epoll_event ev = {};
+        ev.events = EPOLLET | EPOLLRDHUP;
+        if (interest & EVENT_READABLE)
+            ev.events |= EPOLLIN;
+        if (interest & EVENT_WRITABLE)
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    void remove(int fd) override
+    {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    int wait(IoEvent *events, int maxEvents, int timeoutMs) override
+    {
+        if ((int)raw.size() < maxEvents)
+            raw.resize(maxEvents);
+
+        int n;
+        do
+        {
+            n = epoll_wait(epfd, raw.data(), maxEvents, timeoutMs);
+        } while (n < 0 && errno == EINTR);
+
+        for (int i = 0; i < n; ++i)
+        {
+            uint32_t flags = 0;
+            if (raw[i].events & EPOLLIN)
+                flags |= EVENT_READABLE;
+            if (raw[i].events & EPOLLOUT)
+                flags |= EVENT_WRITABLE;
+            if (raw[i].events & (EPOLLRDHUP | EPOLLHUP))
+                flags |= EVENT_HANGUP;
+            if (raw[i].events & EPOLLERR)
+                flags |= EVENT_ERROR;
+            events[i].fd = raw[i].data.fd;
+            events[i].flags = flags;
+        }
+        return n;
+    }
+
+    const char *name() const override { return "epoll"; }
+};
+
+std::unique_ptr<EventLoop> EventLoop::create()
+{
+    return std::unique_ptr<EventLoop>(new EpollEventLoop());
+}
+
+#else
+
+/**
+ * @class KQueueEventLoop
+ * @brief kqueue backend using EV_CLEAR for edge-triggered semantics
+ */
+class KQueueEventLoop : public EventLoop
+{
+private:
+    int kq = -1;
+    std::vector<struct kevent> raw;
+
+public:
+    ~KQueueEventLoop() override
+    {
+        if (kq >= 0)
+        {
+            close(kq);
+        }
+    }
+
+    bool init() override
+    {
+        kq = kqueue();
+        return kq >= 0;
+    }
+
+    bool add(int fd, uint32_t interest) override
+    {
+        struct kevent changes[2];
+        int n = 0;
+        if (interest & EVENT_READABLE)
+            EV_SET(&changes[n++], fd, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, NULL);
+        if (interest & EVENT_WRITABLE)
+            EV_SET(&changes[n++], fd, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, NULL);
+        return kevent(kq, changes, n, NULL, 0, NULL) == 0;
+    }
+
+    void remove(int fd) override
+    {
+        // Each filter is deleted separately so a missing one does not abort the other
+        struct kevent change;
+        EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        kevent(kq, &change, 1, NULL, 0, NULL);
+        EV_SET(&change, fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+        kevent(kq, &change, 1, NULL, 0, NULL);
+    }
+
+    int wait(IoEvent *events, int maxEvents, int timeoutMs) override
+    {
+        if ((int)raw.size() < maxEvents)
+            raw.resize(maxEvents);
+
+        struct timespec ts;
+        struct timespec *tsp = NULL;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+            tsp = &ts;
+        }
+
+        int n;
+        do
+        {
+            n = kevent(kq, NULL, 0, raw.data(), maxEvents, tsp);
+        } while (n < 0 && errno == EINTR);
+
+        for (int i = 0; i < n; ++i)
+        {
+            uint32_t flags = 0;
+            if (raw[i].filter == EVFILT_READ)
+                flags |= EVENT_READABLE;
+            if (raw[i].filter == EVFILT_WRITE)
+                flags |= EVENT_WRITABLE;
+            if (raw[i].flags & EV_EOF)
+                flags |= EVENT_HANGUP;
+            if (raw[i].flags & EV_ERROR)
+                flags |= EVENT_ERROR;
+            events[i].fd = (int)raw[i].ident;
+            events[i].flags = flags;
+        }
+        return n;
+    }
+
+    const char *name() const override { return "kqueue"; }
+};
+
+std::unique_ptr<EventLoop> EventLoop::create()
+{
+    return std::unique_ptr<EventLoop>(new KQueueEventLoop());
+}
+
+#endif
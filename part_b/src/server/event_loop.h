@@ -0,0 +1,84 @@
+/**
+ * @file event_loop.h
+ * @brief Readiness-based event loop abstraction over epoll (Linux) and kqueue (macOS)
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Interest / readiness flags reported by the event loop.
+ */
+#define EVENT_READABLE 0x1
+#define EVENT_WRITABLE 0x2
+#define EVENT_HANGUP 0x4
+#define EVENT_ERROR 0x8
+
+/**
+ * @struct IoEvent
+ * @brief A single readiness notification returned by EventLoop::wait()
+ */
+struct IoEvent
+{
+    int fd;
+    uint32_t flags;
+};
+
+/**
+ * @class EventLoop
+ * @brief Edge-triggered readiness notification backend
+ *
+ * All registrations are edge-triggered: after a readiness event the owner must
+ * drain the descriptor (read/accept/write until EAGAIN) before the next event
+ * for that descriptor is delivered.
+ */
+class EventLoop
+{
+public:
+    virtual ~EventLoop() = default;
+
+    /**
+     * @brief Creates the kernel object backing the loop
+     * @return True on success
+     */
+    virtual bool init() = 0;
+
+    /**
+     * @brief Registers a descriptor for edge-triggered notifications
+     * @param fd File descriptor (must be non-blocking)
+     * @param interest Combination of EVENT_READABLE / EVENT_WRITABLE
+     * @return True on success
+     */
+    virtual bool add(int fd, uint32_t interest) = 0;
+
+    /**
+     * @brief Removes a descriptor from the loop (call before close())
+     * @param fd File descriptor
+     */
+    virtual void remove(int fd) = 0;
+
+    /**
+     * @brief Waits for readiness events
+     * @param events Output array
+     * @param maxEvents Capacity of the output array
+     * @param timeoutMs Timeout in milliseconds, -1 to block indefinitely
+     * @return Number of events written, or -1 on error
+     */
+    virtual int wait(IoEvent *events, int maxEvents, int timeoutMs) = 0;
+
+    /**
+     * @brief Human readable backend name
+     */
+    virtual const char *name() const = 0;
+
+    /**
+     * @brief Creates the native backend for the current platform
+     * @return Event loop instance (not yet initialized)
+     */
+    static std::unique_ptr<EventLoop> create();
+};
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,106 @@
+/**
+ * @file mailbox.cpp
+ * @brief Implementation of the cross-shard mailbox.
+ */
+
+#include "mailbox.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+/**
+ * @brief Closes the wakeup descriptors.
+ */
+Mailbox::~Mailbox()
+{
+    if (write_fd >= 0 && write_fd != read_fd)
+    {
+        close(write_fd);
+    }
+    if (read_fd >= 0)
+    {
+        close(read_fd);
+    }
+}
+
+/**
+ * @brief Creates the wakeup descriptor.
+ *
+ * Linux uses a single eventfd; other platforms use a non-blocking pipe.
+ *
+ * @return True on success.
+ */
+bool Mailbox::init()
+{
+#if defined(__linux__)
+    read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    write_fd = read_fd;
+    return read_fd >= 0;
+#else
+    int fds[2];
+    if (pipe(fds) < 0)
+        return false;
+    for (int fd : fds)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    read_fd = fds[0];
+    write_fd = fds[1];
+    return true;
+#endif
+}
+
+/**
+ * @brief Enqueues a message for the consumer thread.
+ * @param msg Message to deliver.
+ */
+void Mailbox::post(ShardMessage &&msg)
+{
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wasEmpty = queue.empty();
+        queue.push_back(std::move(msg));
+    }
+
+    if (wasEmpty)
+    {
+#if defined(__linux__)
+        uint64_t one = 1;
+        ssize_t ignored = write(write_fd, &one, sizeof(one));
+#else
+        char one = 1;
+        ssize_t ignored = write(write_fd, &one, 1);
+#endif
+        (void)ignored;
+    }
+}
+
+/**
+ * @brief Resets the wakeup descriptor and takes all pending messages.
+ *
+ * The descriptor is drained before the queue is swapped, so a message posted
+ * after the swap always produces a fresh wakeup.
+ *
+ * @param out Receives the pending messages.
+ */
+void Mailbox::drain(std::vector<ShardMessage> &out)
+{
+    char buf[64];
+    while (true)
+    {
+        ssize_t n = read(read_fd, buf, sizeof(buf));
+        if (n > 0 || (n < 0 && errno == EINTR))
+            continue;
+        break;
+    }
+
+    out.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    out.swap(queue);
+}
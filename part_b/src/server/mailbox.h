@@ -0,0 +1,92 @@
+/**
+ * @file mailbox.h
+ * @brief Cross-thread message queue used to forward commands and pub/sub messages between shard workers
+ */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ShardMessage
+ * @brief A command forwarded to the shard that owns its key, the reply to one, or a
+ *        pub/sub message for the receiving worker's subscribers
+ */
+struct ShardMessage
+{
+    enum Type
+    {
+        COMMAND,     ///< Execute args on the receiving shard and reply with response
+        GATHER,      ///< Return the receiving shard's key-value pairs (all, or the page of a SCAN/RANGE in args) in values,
+                     ///< or execute its share of the multi-key command in args
+        REPLY,        ///< Response to a COMMAND
+        GATHER_REPLY, ///< Response to a GATHER
+        PUBLISH,      ///< Deliver message args[1] to the receiving worker's subscribers of channel args[0]
+        UPDATE        ///< Deliver one UPDATE to the receiving worker's subscribers of the change channel
+    };
+
+    Type type;
+    size_t origin;     ///< Index of the worker that owns the client connection
+    uint64_t clientId; ///< Connection the reply belongs to
+    uint64_t seq;      ///< Reply slot on that connection
+    std::vector<std::string> args;
+    std::string response;
+    std::vector<std::string> values;
+    bool failed = false; ///< The receiving shard could not log its share of a GATHER
+};
+
+/**
+ * @class Mailbox
+ * @brief Multi-producer, single-consumer queue with a pollable wakeup descriptor
+ *
+ * Producers append under a mutex and only signal the wakeup descriptor when the
+ * queue transitions from empty, so a burst of forwards costs one wakeup. The
+ * consumer registers fd() with its event loop and calls drain() on readiness.
+ */
+class Mailbox
+{
+private:
+    std::mutex mutex;
+    std::vector<ShardMessage> queue;
+    int read_fd = -1;
+    int write_fd = -1;
+
+public:
+    Mailbox() = default;
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    /**
+     * @brief Destructor, closes the wakeup descriptors
+     */
+    ~Mailbox();
+
+    /**
+     * @brief Creates the non-blocking wakeup descriptor (eventfd or pipe)
+     * @return True on success
+     */
+    bool init();
+
+    /**
+     * @brief Descriptor that becomes readable when messages are pending
+     */
+    int fd() const { return read_fd; }
+
+    /**
+     * @brief Enqueues a message and wakes the consumer if needed
+     * @param msg Message to deliver
+     */
+    void post(ShardMessage &&msg);
+
+    /**
+     * @brief Takes all pending messages
+     * @param out Receives the messages (previous contents are replaced)
+     */
+    void drain(std::vector<ShardMessage> &out);
+};
+
+#endif // MAILBOX_H
@@ -0,0 +1,251 @@
+/**
+ * @file output_buffer.cpp
+ * @brief Implementation of the chunked connection output buffer.
+ */
+
+#include "output_buffer.h"
+#include <sys/uio.h>
+#include <cerrno>
+
+/**
+ * @brief Returns the chunk new bytes should be appended to.
+ *
+ * A new chunk (reusing the spare's storage when available) is started when the
+ * tail chunk cannot take minFree more bytes without reallocating.
+ *
+ * @param minFree Bytes about to be appended.
+ * @return Chunk to append to.
+ */
+std::string &OutputBuffer::tail(size_t minFree)
+{
+    if (!chunks.empty())
+    {
+        std::string &last = chunks.back();
+        if (last.capacity() - last.size() >= minFree)
+            return last;
+    }
+
+    chunks.emplace_back(std::move(spare));
+    spare = std::string();
+    std::string &chunk = chunks.back();
+    chunk.clear();
+    chunk.reserve(minFree > OUTPUT_CHUNK_SIZE ? minFree : OUTPUT_CHUNK_SIZE);
+    return chunk;
+}
+
+/**
+ * @brief Appends raw bytes.
+ * @param data Bytes to append.
+ * @param len Number of bytes.
+ */
+void OutputBuffer::append(const char *data, size_t len)
+{
+    if (len == 0)
+        return;
+
+    // Fill the remainder of the tail chunk before opening another one
+    if (!chunks.empty() && len > OUTPUT_CHUNK_SIZE)
+    {
+        std::string &last = chunks.back();
+        size_t room = last.capacity() - last.size();
+        if (room > 0)
+        {
+            last.append(data, room);
+            data += room;
+            len -= room;
+            total += room;
+        }
+    }
+
+    tail(len).append(data, len);
+    total += len;
+}
+
+/**
+ * @brief Appends a string, taking over its storage when it is large enough
+ *        that copying would cost more than an extra iovec.
+ * @param data String to append.
+ */
+void OutputBuffer::append(std::string &&data)
+{
+    if (data.size() < OUTPUT_ADOPT_THRESHOLD)
+    {
+        append(data.data(), data.size());
+        return;
+    }
+
+    total += data.size();
+    chunks.emplace_back(std::move(data));
+}
+
+/**
+ * @brief Appends a single character.
+ * @param c Character to append.
+ */
+void OutputBuffer::append(char c)
+{
+    tail(1).push_back(c);
+    total += 1;
+}
+
+/**
+ * @brief Appends the decimal representation of an integer without going
+ *        through std::to_string.
+ * @param value Integer to append.
+ */
+void OutputBuffer::appendInteger(long long value)
+{
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    do
+    {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+
+    if (value < 0)
+        *--p = '-';
+
+    append(p, (size_t)(end - p));
+}
+
+/**
+ * @brief Splices another buffer's chunks onto this one.
+ * @param other Buffer to splice; left empty.
+ */
+void OutputBuffer::append(OutputBuffer &&other)
+{
+    if (other.total == 0)
+        return;
+
+    if (other.headOffset > 0)
+    {
+        other.chunks.front().erase(0, other.headOffset);
+        other.headOffset = 0;
+    }
+
+    // Small payloads are copied so that the tail chunk keeps absorbing replies
+    if (other.chunks.size() == 1 && other.total < OUTPUT_ADOPT_THRESHOLD)
+    {
+        append(other.chunks.front().data(), other.chunks.front().size());
+    }
+    else
+    {
+        for (auto &chunk : other.chunks)
+        {
+            chunks.emplace_back(std::move(chunk));
+        }
+        total += other.total;
+    }
+
+    other.chunks.clear();
+    other.total = 0;
+}
+
+/**
+ * @brief Fills an iovec array with the buffered bytes, oldest first.
+ *
+ * Appends never reallocate a chunk that already holds data (a new chunk is
+ * opened instead), so the described memory is stable until consumed.
+ *
+ * @param iov Output array.
+ * @param maxIov Capacity of the array.
+ * @return Number of entries filled.
+ */
+int OutputBuffer::gather(struct iovec *iov, int maxIov) const
+{
+    int count = 0;
+    for (auto it = chunks.begin(); it != chunks.end() && count < maxIov; ++it)
+    {
+        size_t offset = (it == chunks.begin()) ? headOffset : 0;
+        if (it->size() == offset)
+            continue;
+        iov[count].iov_base = const_cast<char *>(it->data()) + offset;
+        iov[count].iov_len = it->size() - offset;
+        ++count;
+    }
+    return count;
+}
+
+/**
+ * @brief Drops written bytes from the front of the buffer.
+ * @param n Number of bytes written.
+ */
+void OutputBuffer::consume(size_t n)
+{
+    total -= n;
+    while (n > 0)
+    {
+        size_t remaining = chunks.front().size() - headOffset;
+        if (n < remaining)
+        {
+            headOffset += n;
+            break;
+        }
+        n -= remaining;
+        headOffset = 0;
+        // Keep one chunk's storage around for the next batch of replies
+        if (chunks.front().capacity() <= OUTPUT_CHUNK_SIZE && spare.capacity() < OUTPUT_CHUNK_SIZE)
+            spare = std::move(chunks.front());
+        chunks.pop_front();
+    }
+}
+
+/**
+ * @brief Writes as much as the socket accepts using scatter/gather I/O.
+ * @param fd Non-blocking socket descriptor.
+ * @return FLUSH_DONE, FLUSH_AGAIN, or FLUSH_ERROR.
+ */
+OutputBuffer::FlushStatus OutputBuffer::flush(int fd)
+{
+    while (total > 0)
+    {
+        struct iovec iov[OUTPUT_MAX_IOV];
+        int count = gather(iov, OUTPUT_MAX_IOV);
+
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return FLUSH_AGAIN;
+            return FLUSH_ERROR;
+        }
+
+        consume((size_t)n);
+    }
+
+    return FLUSH_DONE;
+}
+
+/**
+ * @brief Copies the buffered bytes into a single string.
+ * @return Buffered bytes.
+ */
+std::string OutputBuffer::toString() const
+{
+    std::string result;
+    result.reserve(total);
+    bool first = true;
+    for (const auto &chunk : chunks)
+    {
+        size_t offset = first ? headOffset : 0;
+        result.append(chunk, offset, std::string::npos);
+        first = false;
+    }
+    return result;
+}
+
+/**
+ * @brief Discards all buffered bytes.
+ */
+void OutputBuffer::clear()
+{
+    chunks.clear();
+    headOffset = 0;
+    total = 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * @file output_buffer.h
+ * @brief Append-only, chunked per-connection output buffer flushed with writev()
+ */
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+struct iovec;
+
+/**
+ * @brief Capacity of one output chunk
+ */
+#define OUTPUT_CHUNK_SIZE 16384
+
+/**
+ * @brief Payloads at least this large are moved in as their own chunk instead of copied
+ */
+#define OUTPUT_ADOPT_THRESHOLD 4096
+
+/**
+ * @brief Maximum number of iovecs passed to a single writev() call
+ */
+#define OUTPUT_MAX_IOV 64
+
+/**
+ * @class OutputBuffer
+ * @brief Queue of serialized reply bytes awaiting transmission
+ *
+ * Replies are appended into the tail chunk; a large string can be adopted by
+ * move as its own chunk. flush() hands up to OUTPUT_MAX_IOV chunks to one
+ * writev() call and keeps whatever the socket did not accept. The emptied
+ * chunk's storage is kept as a spare, so a connection in steady state does not
+ * allocate per reply.
+ */
+class OutputBuffer
+{
+public:
+    /**
+     * @brief Result of a flush attempt
+     */
+    enum FlushStatus
+    {
+        FLUSH_DONE,   ///< Everything was written
+        FLUSH_AGAIN,  ///< The socket is full; retry when it becomes writable
+        FLUSH_ERROR   ///< The connection failed
+    };
+
+private:
+    std::deque<std::string> chunks;
+    std::string spare;
+    size_t headOffset = 0;
+    size_t total = 0;
+
+    /**
+     * @brief Returns a chunk with at least minFree bytes of spare capacity
+     */
+    std::string &tail(size_t minFree);
+
+public:
+    /**
+     * @brief Appends raw bytes
+     * @param data Bytes to append
+     * @param len Number of bytes
+     */
+    void append(const char *data, size_t len);
+
+    /**
+     * @brief Appends a string view
+     * @param data Bytes to append
+     */
+    void append(std::string_view data) { append(data.data(), data.size()); }
+
+    /**
+     * @brief Appends a string, adopting its storage if it is large
+     * @param data String to append
+     */
+    void append(std::string &&data);
+
+    /**
+     * @brief Appends a single character
+     * @param c Character to append
+     */
+    void append(char c);
+
+    /**
+     * @brief Appends the decimal representation of an integer
+     * @param value Integer to append
+     */
+    void appendInteger(long long value);
+
+    /**
+     * @brief Moves all bytes of another buffer to the end of this one
+     * @param other Buffer to splice (left empty)
+     */
+    void append(OutputBuffer &&other);
+
+    /**
+     * @brief Writes buffered bytes to a non-blocking socket with writev()
+     * @param fd Socket descriptor
+     * @return Flush status
+     */
+    FlushStatus flush(int fd);
+
+    /**
+     * @brief Describes the buffered bytes as an iovec array without consuming them
+     *
+     * The described memory stays valid until consume() releases it, even if more
+     * bytes are appended meanwhile, so it can be handed to asynchronous I/O.
+     *
+     * @param iov Output array
+     * @param maxIov Capacity of the array
+     * @return Number of entries filled
+     */
+    int gather(struct iovec *iov, int maxIov) const;
+
+    /**
+     * @brief Releases bytes from the front after they have been written
+     * @param n Number of bytes written
+     */
+    void consume(size_t n);
+
+    /**
+     * @brief Copies the buffered bytes into one string
+     */
+    std::string toString() const;
+
+    /**
+     * @brief Number of buffered bytes
+     */
+    size_t size() const { return total; }
+
+    /**
+     * @brief True if nothing is buffered
+     */
+    bool empty() const { return total == 0; }
+
+    /**
+     * @brief Discards all buffered bytes
+     */
+    void clear();
+};
+
+#endif // OUTPUT_BUFFER_H
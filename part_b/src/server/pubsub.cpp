@@ -0,0 +1,70 @@
+/**
+ * @file pubsub.cpp
+ * @brief Implementation of the pub/sub channel registry.
+ */
+
+#include "pubsub.h"
+
+/**
+ * @brief Counts a new subscriber of a channel on a worker.
+ * @param channel Channel name.
+ * @param worker Index of the worker owning the subscriber's connection.
+ */
+void ChannelRegistry::add(const std::string &channel, size_t worker)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<size_t> &counts = channels[channel];
+    if (counts.size() <= worker)
+        counts.resize(worker + 1, 0);
+    counts[worker]++;
+}
+
+/**
+ * @brief Forgets a subscriber of a channel on a worker.
+ *
+ * The channel is dropped once no worker has a subscriber left.
+ *
+ * @param channel Channel name.
+ * @param worker Index of the worker owning the subscriber's connection.
+ */
+void ChannelRegistry::remove(const std::string &channel, size_t worker)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = channels.find(channel);
+    if (it == channels.end() || it->second.size() <= worker || it->second[worker] == 0)
+        return;
+
+    it->second[worker]--;
+    for (size_t count : it->second)
+    {
+        if (count != 0)
+            return;
+    }
+    channels.erase(it);
+}
+
+/**
+ * @brief Finds the workers with subscribers of a channel.
+ * @param channel Channel name.
+ * @param workers Receives the worker indices.
+ * @return Total number of subscribers of the channel.
+ */
+size_t ChannelRegistry::lookup(const std::string &channel, std::vector<size_t> &workers)
+{
+    workers.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = channels.find(channel);
+    if (it == channels.end())
+        return 0;
+
+    size_t total = 0;
+    for (size_t worker = 0; worker < it->second.size(); ++worker)
+    {
+        if (it->second[worker] != 0)
+        {
+            workers.push_back(worker);
+            total += it->second[worker];
+        }
+    }
+    return total;
+}
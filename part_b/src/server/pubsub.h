@@ -0,0 +1,54 @@
+/**
+ * @file pubsub.h
+ * @brief Server-wide registry of pub/sub channels and the workers subscribed to them
+ */
+
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ChannelRegistry
+ * @brief Records, per channel, how many subscribers each worker has
+ *
+ * Every worker keeps the subscriptions of its own connections and delivers
+ * their messages itself; the registry only tells a publisher which workers to
+ * hand a message to and how many subscribers it reaches. Channels are
+ * forgotten once their last subscriber leaves. All methods are thread-safe.
+ */
+class ChannelRegistry
+{
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<size_t>> channels; ///< Subscriber count per worker index
+
+public:
+    /**
+     * @brief Counts a new subscriber of a channel on a worker
+     * @param channel Channel name
+     * @param worker Index of the worker owning the subscriber's connection
+     */
+    void add(const std::string &channel, size_t worker);
+
+    /**
+     * @brief Forgets a subscriber of a channel on a worker
+     * @param channel Channel name
+     * @param worker Index of the worker owning the subscriber's connection
+     */
+    void remove(const std::string &channel, size_t worker);
+
+    /**
+     * @brief Finds the workers with subscribers of a channel
+     * @param channel Channel name
+     * @param workers Receives the worker indices (previous contents are replaced)
+     * @return Total number of subscribers of the channel
+     */
+    size_t lookup(const std::string &channel, std::vector<size_t> &workers);
+};
+
+#endif // PUBSUB_H
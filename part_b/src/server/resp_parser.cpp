@@ -4,38 +4,184 @@
  */
 
 #include "resp_parser.h"
+#include <cstring>
 #include <sstream>
 
+/**
+ * @brief Parses a "<prefix><integer>\r\n" header line.
+ *
+ * Digits are accumulated while scanning, so the CRLF is found and the length
+ * decoded in a single pass without strtol() or a temporary string.
+ *
+ * @param data Input buffer.
+ * @param len Buffer length.
+ * @param pos Position of the prefix character; advanced past the CRLF on success.
+ * @param prefix Expected prefix ('*' or '$').
+ * @param value Receives the parsed integer.
+ * @return Parse status.
+ */
+static RespParser::ParseStatus parseHeader(const char *data, size_t len, size_t &pos, char prefix, long long &value)
+{
+    if (pos >= len)
+        return RespParser::PARSE_INCOMPLETE;
+    if (data[pos] != prefix)
+        return RespParser::PARSE_ERROR;
+
+    size_t i = pos + 1;
+    bool negative = false;
+    if (i < len && data[i] == '-')
+    {
+        negative = true;
+        ++i;
+    }
+
+    long long result = 0;
+    size_t digits = 0;
+    for (; i < len && data[i] >= '0' && data[i] <= '9'; ++i, ++digits)
+    {
+        if (digits >= 18)
+            return RespParser::PARSE_ERROR;
+        result = result * 10 + (data[i] - '0');
+    }
+
+    if (i + 2 > len)
+        return (i - pos) > RESP_MAX_HEADER_LENGTH ? RespParser::PARSE_ERROR : RespParser::PARSE_INCOMPLETE;
+    if (digits == 0 || data[i] != '\r' || data[i + 1] != '\n')
+        return RespParser::PARSE_ERROR;
+
+    value = negative ? -result : result;
+    pos = i + 2;
+    return RespParser::PARSE_OK;
+}
+
+/**
+ * @brief Extracts the first complete RESP-2 command from a buffer.
+ *
+ * Commands are RESP-2 arrays: '*' followed by the number of elements, and each
+ * element a bulk string prefixed with '$' followed by its length. Bulk payloads
+ * are located by length, so they are never scanned and are returned as views
+ * into the caller's buffer rather than copied.
+ *
+ * @param data Start of the unparsed input.
+ * @param len Number of unparsed bytes.
+ * @param consumed Set to the number of bytes making up the command on PARSE_OK.
+ * @param args Receives the parsed arguments on PARSE_OK.
+ * @return PARSE_OK, PARSE_INCOMPLETE if more input is needed, or PARSE_ERROR.
+ */
+RespParser::ParseStatus RespParser::parseCommand(const char *data, size_t len, size_t &consumed, std::vector<std::string_view> &args)
+{
+    args.clear();
+    size_t pos = 0;
+    long long arg_count;
+
+    ParseStatus status = parseHeader(data, len, pos, '*', arg_count);
+    if (status != PARSE_OK)
+        return status;
+    if (arg_count < 0 || arg_count > RESP_MAX_ARRAY_LENGTH)
+        return PARSE_ERROR;
+
+    for (long long i = 0; i < arg_count; ++i)
+    {
+        long long length;
+        status = parseHeader(data, len, pos, '$', length);
+        if (status != PARSE_OK)
+            return status;
+        if (length < 0 || length > RESP_MAX_BULK_LENGTH)
+            return PARSE_ERROR;
+
+        if (len - pos < (size_t)length + 2)
+            return PARSE_INCOMPLETE;
+        if (data[pos + length] != '\r' || data[pos + length + 1] != '\n')
+            return PARSE_ERROR;
+
+        args.emplace_back(data + pos, (size_t)length);
+        pos += length + 2;
+    }
+
+    consumed = pos;
+    return PARSE_OK;
+}
+
+/**
+ * @brief Finds the end of the first complete RESP-2 reply in a buffer.
+ *
+ * Arrays are walked iteratively by counting the elements still expected, so
+ * deeply nested replies cannot exhaust the stack. Bulk payloads are skipped by
+ * length; status, error and integer lines are scanned for their CRLF.
+ *
+ * @param data Start of the unparsed input.
+ * @param len Number of unparsed bytes.
+ * @param consumed Set to the number of bytes making up the reply on PARSE_OK.
+ * @param isError Set on PARSE_OK to whether the reply is an error.
+ * @return PARSE_OK, PARSE_INCOMPLETE if more input is needed, or PARSE_ERROR.
+ */
+RespParser::ParseStatus RespParser::parseReply(const char *data, size_t len, size_t &consumed, bool &isError)
+{
+    size_t pos = 0;
+    long long remaining = 1;
+    bool error = len > 0 && data[0] == '-';
+
+    while (remaining > 0)
+    {
+        if (pos >= len)
+            return PARSE_INCOMPLETE;
+        remaining--;
+
+        char type = data[pos];
+        if (type == '+' || type == '-' || type == ':')
+        {
+            const char *end = static_cast<const char *>(memchr(data + pos, '\n', len - pos));
+            if (end == nullptr)
+                return PARSE_INCOMPLETE;
+            size_t eol = (size_t)(end - data);
+            if (eol == pos || data[eol - 1] != '\r')
+                return PARSE_ERROR;
+            pos = eol + 1;
+            continue;
+        }
+
+        long long length;
+        ParseStatus status = parseHeader(data, len, pos, type == '*' ? '*' : '$', length);
+        if (status != PARSE_OK)
+            return status;
+        if (length < 0)
+            continue;
+        if (type == '*')
+        {
+            if (length > RESP_MAX_ARRAY_LENGTH)
+                return PARSE_ERROR;
+            remaining += length;
+            continue;
+        }
+        if (length > RESP_MAX_BULK_LENGTH)
+            return PARSE_ERROR;
+        if (len - pos < (size_t)length + 2)
+            return PARSE_INCOMPLETE;
+        if (data[pos + length] != '\r' || data[pos + length + 1] != '\n')
+            return PARSE_ERROR;
+        pos += length + 2;
+    }
+
+    consumed = pos;
+    isError = error;
+    return PARSE_OK;
+}
+
 /**
  * @brief Parses a RESP-2 array message and extracts command arguments.
  *
- * RESP-2 arrays start with '*' followed by the number of elements, and each element
- * is a bulk string prefixed with '$' followed by its length.
+ * Convenience wrapper around parseCommand() for a buffer holding one command.
  *
  * @param buffer The RESP-2 formatted string received from the client.
  * @return A vector containing the parsed arguments as strings.
  */
 std::vector<std::string> RespParser::parseArray(const std::string &buffer)
 {
-    std::vector<std::string> args;
-    std::istringstream stream(buffer);
-    char prefix;
-    int arg_count;
-
-    stream >> prefix >> arg_count;
-    stream.ignore(2, '\n'); // Skip \r\n
-    for (int i = 0; i < arg_count; ++i)
-    {
-        stream >> prefix; // Should be '$'
-        int length;
-        stream >> length;
-        stream.ignore(2, '\n'); // Skip \r\n
-        std::string arg(length, '\0');
-        stream.read(&arg[0], length);
-        args.push_back(arg);
-        stream.ignore(2, '\n'); // Skip \r\n
-    }
-    return args;
+    std::vector<std::string_view> views;
+    size_t consumed = 0;
+    if (parseCommand(buffer.data(), buffer.size(), consumed, views) != PARSE_OK)
+        return {};
+    return std::vector<std::string>(views.begin(), views.end());
 }
 
 /**
@@ -109,4 +255,119 @@ std::string RespParser::serializeArray(const std::vector<std::string> &values)
     }
 
     return ss.str();
-}
\ No newline at end of file
+}
+/**
+ * @brief Appends a RESP-2 bulk string to an output buffer.
+ *
+ * Like serializeBulkString(), an empty value is encoded as the null bulk string.
+ *
+ * @param out Destination buffer.
+ * @param value The string to serialize.
+ */
+void RespParser::writeBulkString(OutputBuffer &out, std::string_view value)
+{
+    if (value.empty())
+    {
+        out.append(std::string_view("$-1\r\n"));
+        return;
+    }
+    out.append('$');
+    out.appendInteger((long long)value.size());
+    out.append(std::string_view("\r\n"));
+    out.append(value);
+    out.append(std::string_view("\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 bulk string whose payload is moved into the buffer.
+ * @param out Destination buffer.
+ * @param value The string to serialize.
+ */
+void RespParser::writeBulkString(OutputBuffer &out, std::string &&value)
+{
+    if (value.size() < OUTPUT_ADOPT_THRESHOLD)
+    {
+        writeBulkString(out, std::string_view(value));
+        return;
+    }
+    out.append('$');
+    out.appendInteger((long long)value.size());
+    out.append(std::string_view("\r\n"));
+    out.append(std::move(value));
+    out.append(std::string_view("\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 bulk string of length 0.
+ *
+ * Unlike writeBulkString() with an empty value, this is not the null bulk
+ * string, so clients can tell an empty value from a missing one.
+ *
+ * @param out Destination buffer.
+ */
+void RespParser::writeEmptyBulkString(OutputBuffer &out)
+{
+    out.append(std::string_view("$0\r\n\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 simple string.
+ * @param out Destination buffer.
+ * @param status The status message.
+ */
+void RespParser::writeSimpleString(OutputBuffer &out, std::string_view status)
+{
+    out.append('+');
+    out.append(status);
+    out.append(std::string_view("\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 error.
+ * @param out Destination buffer.
+ * @param error The error message.
+ */
+void RespParser::writeError(OutputBuffer &out, std::string_view error)
+{
+    out.append(std::string_view("-ERR "));
+    out.append(error);
+    out.append(std::string_view("\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 integer.
+ * @param out Destination buffer.
+ * @param value The integer.
+ */
+void RespParser::writeInteger(OutputBuffer &out, long long value)
+{
+    out.append(':');
+    out.appendInteger(value);
+    out.append(std::string_view("\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 array header.
+ * @param out Destination buffer.
+ * @param count Number of elements that will follow.
+ */
+void RespParser::writeArrayHeader(OutputBuffer &out, size_t count)
+{
+    out.append('*');
+    out.appendInteger((long long)count);
+    out.append(std::string_view("\r\n"));
+}
+
+/**
+ * @brief Appends a RESP-2 array of bulk strings.
+ * @param out Destination buffer.
+ * @param values The elements.
+ */
+void RespParser::writeArray(OutputBuffer &out, const std::vector<std::string> &values)
+{
+    writeArrayHeader(out, values.size());
+    for (const auto &value : values)
+    {
+        writeBulkString(out, std::string_view(value));
+    }
+}
@@ -7,21 +7,82 @@
 #define RESP_PARSER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstddef>
+#include "output_buffer.h"
+
+/**
+ * @brief Largest accepted bulk string length (same limit as Redis)
+ */
+#define RESP_MAX_BULK_LENGTH (512LL * 1024 * 1024)
+
+/**
+ * @brief Largest accepted number of elements in a command array
+ */
+#define RESP_MAX_ARRAY_LENGTH (1024LL * 1024)
+
+/**
+ * @brief Longest accepted '*' or '$' header line before CRLF
+ */
+#define RESP_MAX_HEADER_LENGTH 32
 
 /**
  * @class RespParser
  * @brief Parser for Redis RESP-2 protocol
  *
  * Handles serialization and deserialization of Redis RESP-2 protocol messages.
+ * The write* functions serialize straight into a connection's OutputBuffer;
+ * the string-returning variants are kept for callers that need an owned message.
  */
 class RespParser
 {
 public:
+    /**
+     * @brief Result of an incremental parse attempt
+     */
+    enum ParseStatus
+    {
+        PARSE_OK,         ///< A complete command was extracted
+        PARSE_INCOMPLETE, ///< The buffer ends inside a command; wait for more bytes
+        PARSE_ERROR       ///< The buffer does not contain a valid RESP command
+    };
+
+    /**
+     * @brief Extracts the first complete command from a buffer
+     *
+     * Nothing is consumed unless a whole command is present, so the caller can
+     * keep the partial frame and retry once more bytes have arrived. The
+     * arguments are views into data and stay valid only while the caller's
+     * buffer is left untouched; no memory is allocated once args has grown to
+     * the command's arity.
+     *
+     * @param data Start of the unparsed input
+     * @param len Number of unparsed bytes
+     * @param consumed Set to the size of the command on PARSE_OK
+     * @param args Receives views of the command arguments on PARSE_OK
+     * @return Parse status
+     */
+    static ParseStatus parseCommand(const char *data, size_t len, size_t &consumed, std::vector<std::string_view> &args);
+
+    /**
+     * @brief Finds the end of the first complete reply in a buffer
+     *
+     * Used by clients of the server. Any RESP-2 reply is accepted, arrays
+     * nested to any depth included; its contents are skipped, not decoded.
+     *
+     * @param data Start of the unparsed input
+     * @param len Number of unparsed bytes
+     * @param consumed Set to the size of the reply on PARSE_OK
+     * @param isError Set on PARSE_OK to whether the reply is an error ('-')
+     * @return Parse status
+     */
+    static ParseStatus parseReply(const char *data, size_t len, size_t &consumed, bool &isError);
+
     /**
      * @brief Parses a RESP array message into command arguments
      * @param buffer The RESP message buffer
-     * @return Vector of command arguments
+     * @return Vector of command arguments (empty if the buffer holds no complete command)
      */
     static std::vector<std::string> parseArray(const std::string &buffer);
 
@@ -53,6 +114,61 @@ public:
      * @brief Serializes a vector of strings into a RESP-2 array.
      */
     static std::string serializeArray(const std::vector<std::string> &values);
+
+    /**
+     * @brief Appends a RESP bulk string (null bulk string if value is empty)
+     * @param out Destination buffer
+     * @param value The string to serialize
+     */
+    static void writeBulkString(OutputBuffer &out, std::string_view value);
+
+    /**
+     * @brief Appends a RESP bulk string, adopting the value's storage when large
+     * @param out Destination buffer
+     * @param value The string to serialize
+     */
+    static void writeBulkString(OutputBuffer &out, std::string &&value);
+
+    /**
+     * @brief Appends an empty, non-null RESP bulk string
+     * @param out Destination buffer
+     */
+    static void writeEmptyBulkString(OutputBuffer &out);
+
+    /**
+     * @brief Appends a RESP simple string (status) reply
+     * @param out Destination buffer
+     * @param status The status message
+     */
+    static void writeSimpleString(OutputBuffer &out, std::string_view status);
+
+    /**
+     * @brief Appends a RESP error reply
+     * @param out Destination buffer
+     * @param error The error message
+     */
+    static void writeError(OutputBuffer &out, std::string_view error);
+
+    /**
+     * @brief Appends a RESP integer reply
+     * @param out Destination buffer
+     * @param value The integer
+     */
+    static void writeInteger(OutputBuffer &out, long long value);
+
+    /**
+     * @brief Appends a RESP array header; the elements must follow
+     * @param out Destination buffer
+     * @param count Number of elements
+     */
+    static void writeArrayHeader(OutputBuffer &out, size_t count);
+
+    /**
+     * @brief Appends a RESP array of bulk strings
+     * @param out Destination buffer
+     * @param values The elements
+     */
+    static void writeArray(OutputBuffer &out, const std::vector<std::string> &values);
 };
 
 #endif // RESP_PARSER_H
@@ -1,296 +1,2183 @@
 /**
  * @file server.cpp
- * @brief Implementation of KQueue-based server for handling key-value store operations.
+ * @brief Implementation of the event-driven server for handling key-value store operations.
  */
 
 #include "server.h"
 #include "resp_parser.h"
 #include <iostream>
-#include <sys/event.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
 #include <algorithm>
-#include <random>
+#include <numeric>
+#include <optional>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef HAVE_IO_URING
+#include <poll.h>
+
+/**
+ * @brief Operation tags stored in the low byte of an io_uring user_data value;
+ *        the remaining bits hold the connection id.
+ */
+enum UringOp : unsigned
+{
+    URING_OP_ACCEPT = 1,
+    URING_OP_MAILBOX = 2,
+    URING_OP_RECV = 3,
+    URING_OP_SEND = 4,
+    URING_OP_CANCEL = 5
+};
+
+/**
+ * @brief Buffer group id of the worker's provided receive buffers.
+ */
+static const unsigned short URING_BUFFER_GROUP = 0;
+
+static inline uint64_t uringTag(uint64_t clientId, unsigned op)
+{
+    return (clientId << 8) | op;
+}
+#endif
+
+/**
+ * @brief Puts a descriptor into non-blocking mode.
+ * @param fd File descriptor.
+ * @return True on success.
+ */
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/**
+ * @brief FNV-1a hash used for shard placement.
+ *
+ * A fixed function (rather than std::hash) keeps key placement stable across
+ * builds, since each shard persists its SSTables in its own directory.
+ *
+ * @param key Key to hash.
+ * @return 64-bit hash value.
+ */
+static uint64_t shardHash(std::string_view key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * @brief Case-insensitive comparison of a command name against a lowercase literal.
+ * @param name Command name as sent by the client.
+ * @param lower Lowercase command name.
+ * @return True if both name the same command.
+ */
+static bool isCommand(std::string_view name, std::string_view lower)
+{
+    if (name.size() != lower.size())
+        return false;
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        if ((name[i] | 0x20) != lower[i])
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Recognizes the commands applied to several keys as one batch.
+ *
+ * These are MGET key [key ...], MSET key value [key value ...] and DEL with
+ * more than one key.
+ *
+ * @param args Command arguments.
+ * @return True for a well-formed multi-key command.
+ */
+static bool isBatchCommand(const std::vector<std::string_view> &args)
+{
+    if (args.size() < 2)
+        return false;
+    if (isCommand(args[0], "mget"))
+        return true;
+    if (isCommand(args[0], "mset"))
+        return args.size() % 2 == 1;
+    return isCommand(args[0], "del") && args.size() > 2;
+}
+
+/**
+ * @brief Recognizes DELRANGE start end, which deletes the keys in [start, end).
+ *
+ * Keys are spread over the shards by hash, so the range is deleted on every
+ * shard, each with a single range tombstone.
+ *
+ * @param args Command arguments.
+ * @return True for a well-formed range delete.
+ */
+static bool isRangeDelete(const std::vector<std::string_view> &args)
+{
+    return args.size() == 3 && isCommand(args[0], "delrange");
+}
+
+/**
+ * @brief Recognizes the commands acting on the single key in args[1].
+ * @param args Command arguments.
+ * @return True for GET, SET, single-key DEL and the expiry commands.
+ */
+static bool isKeyCommand(const std::vector<std::string_view> &args)
+{
+    std::string_view cmd = args[0];
+    return isCommand(cmd, "get") || isCommand(cmd, "set") || (isCommand(cmd, "del") && args.size() == 2) ||
+           isCommand(cmd, "setex") || isCommand(cmd, "expire") || isCommand(cmd, "ttl") || isCommand(cmd, "persist");
+}
+
+/**
+ * @brief Turns the seconds argument of SETEX or EXPIRE into an expiry time.
+ *
+ * A time that is not in the future yields an expiry time already past, so
+ * the key reads as deleted from then on.
+ *
+ * @param seconds Decimal number of seconds from now, possibly negative.
+ * @param expiresAt Receives the expiry time in milliseconds since the epoch.
+ * @return False if seconds is not an integer within EXPIRE_MAX_SECONDS.
+ */
+static bool parseExpiry(std::string_view seconds, uint64_t &expiresAt)
+{
+    bool negative = !seconds.empty() && seconds[0] == '-';
+    std::string_view digits = negative ? seconds.substr(1) : seconds;
+    long long value = 0;
+    if (digits.empty())
+        return false;
+    for (char c : digits)
+    {
+        if (c < '0' || c > '9')
+            return false;
+        value = value * 10 + (c - '0');
+        if (value > EXPIRE_MAX_SECONDS)
+            return false;
+    }
+    expiresAt = negative || value == 0 ? 1 : currentTimeMillis() + (uint64_t)value * 1000;
+    return true;
+}
+
+/**
+ * @brief Serializes the reply of an MGET.
+ *
+ * Keys that do not exist or were deleted are returned as nil, and empty
+ * values as empty bulk strings rather than nil.
+ *
+ * @param out Buffer the response is appended to.
+ * @param values Result of LSMTree::multiGet for each key, in command order.
+ */
+static void writeMultiGetReply(OutputBuffer &out, const std::vector<std::optional<std::string>> &values)
+{
+    RespParser::writeArrayHeader(out, values.size());
+    for (const std::optional<std::string> &value : values)
+    {
+        if (!value)
+            RespParser::writeBulkString(out, std::string_view());
+        else if (value->empty())
+            RespParser::writeEmptyBulkString(out);
+        else
+            RespParser::writeBulkString(out, std::string_view(*value));
+    }
+}
+
+/**
+ * @brief Encodes the key a SCAN resumes from as a cursor.
+ *
+ * Clients expect SCAN cursors to be decimal integers, with 0 reserved for the
+ * start and end of an iteration. The cursor is a 1 followed by every byte of
+ * the key as three decimal digits, so it is never 0, takes linear time to
+ * build and parse, and decodes back to the key without any server-side state.
+ *
+ * A key longer than SCAN_CURSOR_MAX_KEY_LENGTH is cut to that prefix, which
+ * sorts before the key: the next page may repeat keys, as SCAN allows, but
+ * never skips one.
+ *
+ * @param key Next key to return.
+ * @return The cursor.
+ */
+static std::string encodeCursor(std::string_view key)
+{
+    key = key.substr(0, SCAN_CURSOR_MAX_KEY_LENGTH);
+    std::string decimal;
+    decimal.reserve(1 + 3 * key.size());
+    decimal.push_back('1');
+    for (char c : key)
+    {
+        unsigned byte = (unsigned char)c;
+        decimal.push_back((char)('0' + byte / 100));
+        decimal.push_back((char)('0' + byte / 10 % 10));
+        decimal.push_back((char)('0' + byte % 10));
+    }
+    return decimal;
+}
+
+/**
+ * @brief Decodes a cursor produced by encodeCursor().
+ * @param cursor Cursor sent by the client, not "0".
+ * @param key Receives the key to resume from.
+ * @return False if the cursor is not a valid encoding.
+ */
+static bool decodeCursor(std::string_view cursor, std::string &key)
+{
+    // Rejected before looking at the digits, so a huge cursor costs nothing
+    if (cursor.size() > 1 + 3 * (size_t)SCAN_CURSOR_MAX_KEY_LENGTH || cursor.empty() || cursor[0] != '1' ||
+        (cursor.size() - 1) % 3 != 0)
+        return false;
+
+    key.clear();
+    key.reserve((cursor.size() - 1) / 3);
+    for (size_t i = 1; i < cursor.size(); i += 3)
+    {
+        unsigned byte = 0;
+        for (size_t j = i; j < i + 3; ++j)
+        {
+            if (cursor[j] < '0' || cursor[j] > '9')
+                return false;
+            byte = byte * 10 + (unsigned)(cursor[j] - '0');
+        }
+        if (byte > 255)
+            return false;
+        key.push_back((char)byte);
+    }
+    return true;
+}
+
+/**
+ * @brief Parses the arguments of SCAN or RANGE.
+ *
+ * SCAN cursor [COUNT n] pages through all keys; RANGE start end [COUNT n]
+ * pages through the keys in [start, end) with their values, an empty end
+ * meaning no bound.
+ *
+ * @param args Command arguments.
+ * @param query Receives the page request.
+ * @param error Receives the error reply on failure.
+ * @return True if the arguments are valid.
+ */
+bool KQueueServer::parseRangeQuery(const std::vector<std::string_view> &args, RangeQuery &query, std::string &error)
+{
+    query = RangeQuery();
+    query.keysOnly = isCommand(args[0], "scan");
+    size_t options = query.keysOnly ? 2 : 3;
+    if (args.size() < options || (args.size() - options) % 2 != 0)
+    {
+        error = query.keysOnly ? "wrong number of arguments for 'scan' command"
+                               : "wrong number of arguments for 'range' command";
+        return false;
+    }
+
+    if (query.keysOnly)
+    {
+        if (args[1] != "0" && !decodeCursor(args[1], query.start))
+        {
+            error = "invalid cursor";
+            return false;
+        }
+    }
+    else
+    {
+        query.start = args[1];
+        query.end = args[2];
+    }
+
+    for (size_t i = options; i < args.size(); i += 2)
+    {
+        if (!isCommand(args[i], "count"))
+        {
+            error = "syntax error";
+            return false;
+        }
+        std::string_view value = args[i + 1];
+        size_t count = 0;
+        for (char c : value)
+        {
+            if (c < '0' || c > '9' || count > SCAN_MAX_COUNT)
+            {
+                count = 0;
+                break;
+            }
+            count = count * 10 + (size_t)(c - '0');
+        }
+        if (count == 0 || count > SCAN_MAX_COUNT)
+        {
+            error = "value is not an integer or out of range";
+            return false;
+        }
+        query.count = count;
+    }
+    return true;
+}
+
+/**
+ * @brief Serializes a SCAN or RANGE page.
+ *
+ * Each shard contributes up to count + 1 entries at or after the start key,
+ * so the first count + 1 entries of their union in key order are those of the
+ * whole keyspace. The first count entries form the page and the entry after
+ * them, if any, is where the next page starts. The reply is a two-element
+ * array: the next cursor (SCAN; "0" when done) or next start key (RANGE;
+ * nil when done), then the keys, interleaved with their values for RANGE.
+ *
+ * @param out Buffer the response is appended to.
+ * @param query Page request.
+ * @param values Matching entries of the shards, each shard's in key order.
+ */
+void KQueueServer::writeRangeReply(OutputBuffer &out, const RangeQuery &query, const std::vector<std::string> &values)
+{
+    size_t stride = query.keysOnly ? 1 : 2;
+    std::vector<size_t> order(values.size() / stride);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+              { return values[a * stride] < values[b * stride]; });
+
+    size_t entries = std::min(order.size(), query.count);
+    RespParser::writeArrayHeader(out, 2);
+    if (order.size() > entries)
+    {
+        const std::string &next = values[order[entries] * stride];
+        if (query.keysOnly)
+            RespParser::writeBulkString(out, encodeCursor(next));
+        else
+            RespParser::writeBulkString(out, std::string_view(next));
+    }
+    else
+    {
+        RespParser::writeBulkString(out, std::string_view(query.keysOnly ? "0" : ""));
+    }
+
+    RespParser::writeArrayHeader(out, entries * stride);
+    for (size_t i = 0; i < entries; ++i)
+    {
+        for (size_t j = 0; j < stride; ++j)
+            RespParser::writeBulkString(out, std::string_view(values[order[i] * stride + j]));
+    }
+}
+
+/**
+ * @brief Serializes the reply of a multi-key command gathered from several shards.
+ *
+ * The (position, value) pairs of an MGET are put back in command order, and
+ * positions no shard returned are nil; the writes of an MSET, DEL or DELRANGE
+ * are acknowledged once every shard applied its share, or fail if any shard
+ * could not log its share.
+ *
+ * @param slot Reply slot holding the parts of all shards.
+ */
+void KQueueServer::writeBatchReply(PendingReply &slot)
+{
+    if (slot.batchKeys == 0)
+    {
+        if (slot.failed)
+            RespParser::writeError(slot.response, "write-ahead log write failed");
+        else
+        {
+            sendUpdateNotification();
+            RespParser::writeSimpleString(slot.response, "OK");
+        }
+        return;
+    }
+
+    std::vector<std::optional<std::string>> values(slot.batchKeys);
+    for (size_t i = 0; i + 1 < slot.parts.size(); i += 2)
+    {
+        size_t position = std::stoul(slot.parts[i]);
+        if (position < values.size())
+            values[position] = std::move(slot.parts[i + 1]);
+    }
+    writeMultiGetReply(slot.response, values);
+}
+
+/**
+ * @brief Constructs a KQueueServer object.
+ * @param store Reference to the LSMTree storage engine.
+ * @param data Reference to the BenchmarkData generator.
+ */
+KQueueServer::KQueueServer(LSMTree &store, BenchmarkData &data)
+    : shards{&store}, data(data), outputHighWaterMark(OUTPUT_HIGH_WATER_MARK), backend(IoBackend::EVENT_LOOP)
+{
+}
+
+/**
+ * @brief Constructs a sharded KQueueServer object.
+ * @param shards Storage shards, one worker thread is started per shard.
+ * @param data Reference to the BenchmarkData generator.
+ */
+KQueueServer::KQueueServer(const std::vector<LSMTree *> &shards, BenchmarkData &data)
+    : shards(shards), data(data), outputHighWaterMark(OUTPUT_HIGH_WATER_MARK), backend(IoBackend::EVENT_LOOP)
+{
+}
+
+/**
+ * @brief Sets the per-connection output high-water mark.
+ * @param bytes Buffered reply bytes at which reading from a client pauses.
+ */
+void KQueueServer::setOutputHighWaterMark(size_t bytes)
+{
+    outputHighWaterMark = bytes;
+}
+
+/**
+ * @brief Sets the TCP port the workers listen on.
+ * @param tcpPort Port number, PORT by default.
+ */
+void KQueueServer::setPort(int tcpPort)
+{
+    port = tcpPort;
+}
+
+/**
+ * @brief Selects the networking backend.
+ * @param io Backend to use.
+ * @return False if io_uring was requested but is not available in this build.
+ */
+bool KQueueServer::setIoBackend(IoBackend io)
+{
+#ifndef HAVE_IO_URING
+    if (io == IoBackend::IO_URING)
+        return false;
+#endif
+    backend = io;
+    return true;
+}
+
+/**
+ * @brief Destroys the KQueueServer object and closes open file descriptors.
+ */
+KQueueServer::~KQueueServer()
+{
+    for (auto &worker : workers)
+    {
+        for (const auto &entry : worker->clients)
+        {
+            close(entry.first);
+        }
+        if (worker->listen_fd >= 0)
+        {
+            close(worker->listen_fd);
+        }
+    }
+}
+
+/**
+ * @brief Announces a write to the subscribers of UPDATE_CHANNEL.
+ *
+ * Each worker with such subscribers is posted one UPDATE unless it still has
+ * one pending, into which this write is folded; the worker clears the flag
+ * before delivering, so no write goes unannounced. Without subscribers the
+ * cost is a single atomic load.
+ */
+void KQueueServer::sendUpdateNotification()
+{
+    if (updateSubscribers.load(std::memory_order_relaxed) == 0)
+        return;
+
+    for (auto &worker : workers)
+    {
+        if (worker->updateSubscribers.load(std::memory_order_relaxed) == 0 ||
+            worker->updatePending.load(std::memory_order_relaxed) ||
+            worker->updatePending.exchange(true, std::memory_order_acq_rel))
+            continue;
+
+        ShardMessage msg;
+        msg.type = ShardMessage::UPDATE;
+        worker->mailbox.post(std::move(msg));
+    }
+}
+
+/**
+ * @brief Hands a message to every worker with subscribers of a channel.
+ *
+ * The message is posted to the workers' mailboxes, the publisher's own
+ * included, so publishing never waits for a subscriber's socket.
+ *
+ * @param channel Channel name.
+ * @param message Message to deliver.
+ * @return Number of subscribers of the channel.
+ */
+size_t KQueueServer::publish(const std::string &channel, const std::string &message)
+{
+    std::vector<size_t> targets;
+    size_t receivers = channels.lookup(channel, targets);
+    for (size_t index : targets)
+    {
+        ShardMessage msg;
+        msg.type = ShardMessage::PUBLISH;
+        msg.args = {channel, message};
+        workers[index]->mailbox.post(std::move(msg));
+    }
+    return receivers;
+}
+
+/**
+ * @brief Appends a message to the output of a worker's subscribers of a channel.
+ *
+ * Each subscriber's output buffer is its outbound queue, written as the
+ * socket accepts it. A subscriber already holding more than
+ * PUBSUB_OUTPUT_LIMIT bytes does not keep up and is disconnected rather than
+ * buffered without bound.
+ *
+ * @param worker Delivering worker.
+ * @param channel Channel name.
+ * @param message Message to deliver.
+ */
+void KQueueServer::deliverMessage(Worker &worker, const std::string &channel, std::string_view message)
+{
+    auto it = worker.channels.find(channel);
+    if (it == worker.channels.end())
+        return;
+
+    std::string bytes = RespParser::createResponseForSubscriber(std::string(message), channel);
+
+    // Disconnecting a subscriber changes the list
+    std::vector<uint64_t> subscribers = it->second;
+    for (uint64_t id : subscribers)
+    {
+        auto fdIt = worker.clientFds.find(id);
+        if (fdIt == worker.clientFds.end())
+            continue;
+        int fd = fdIt->second;
+        Client &client = worker.clients[fd];
+        bool slow = client.output.size() > PUBSUB_OUTPUT_LIMIT;
+        if (!slow)
+            client.output.append(std::string_view(bytes));
+#ifdef HAVE_IO_URING
+        if (worker.ring)
+        {
+            if (slow)
+                uringCloseClient(worker, fd, client, false);
+            else
+                uringPumpOutput(worker, fd, client);
+            continue;
+        }
+#endif
+        if (slow || !onWritable(worker, fd))
+            closeClient(worker, fd);
+    }
+}
+
+/**
+ * @brief Subscribes a connection to a channel unless it already is.
+ * @param worker Worker owning the connection.
+ * @param client Connection state.
+ * @param channel Channel name.
+ */
+void KQueueServer::subscribe(Worker &worker, Client &client, const std::string &channel)
+{
+    if (std::find(client.channels.begin(), client.channels.end(), channel) != client.channels.end())
+        return;
+
+    client.channels.push_back(channel);
+    worker.channels[channel].push_back(client.id);
+    channels.add(channel, worker.index);
+    if (channel == UPDATE_CHANNEL)
+    {
+        worker.updateSubscribers.fetch_add(1, std::memory_order_relaxed);
+        updateSubscribers.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Unsubscribes a connection from a channel.
+ * @param worker Worker owning the connection.
+ * @param client Connection state.
+ * @param channel Channel name.
+ * @return False if the connection was not subscribed to it.
+ */
+bool KQueueServer::unsubscribe(Worker &worker, Client &client, const std::string &channel)
+{
+    auto it = std::find(client.channels.begin(), client.channels.end(), channel);
+    if (it == client.channels.end())
+        return false;
+    client.channels.erase(it);
+
+    auto local = worker.channels.find(channel);
+    if (local != worker.channels.end())
+    {
+        std::vector<uint64_t> &ids = local->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), client.id), ids.end());
+        if (ids.empty())
+            worker.channels.erase(local);
+    }
+    channels.remove(channel, worker.index);
+    if (channel == UPDATE_CHANNEL)
+    {
+        worker.updateSubscribers.fetch_sub(1, std::memory_order_relaxed);
+        updateSubscribers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+/**
+ * @brief Unsubscribes a closing connection from all its channels.
+ * @param worker Worker owning the connection.
+ * @param client Connection state.
+ */
+void KQueueServer::dropSubscriptions(Worker &worker, Client &client)
+{
+    while (!client.channels.empty())
+    {
+        std::string channel = client.channels.back();
+        unsubscribe(worker, client, channel);
+    }
+}
+
+/**
+ * @brief Recognizes the pub/sub commands, which act on the connection itself.
+ * @param args Command arguments.
+ * @return True for SUBSCRIBE, UNSUBSCRIBE and PUBLISH.
+ */
+static bool isPubSubCommand(const std::vector<std::string_view> &args)
+{
+    return !args.empty() &&
+           (isCommand(args[0], "subscribe") || isCommand(args[0], "unsubscribe") || isCommand(args[0], "publish"));
+}
+
+/**
+ * @brief Serializes one confirmation of SUBSCRIBE or UNSUBSCRIBE.
+ * @param out Buffer the confirmation is appended to.
+ * @param kind "subscribe" or "unsubscribe".
+ * @param channel Channel name, or nullptr for nil.
+ * @param count Number of channels the connection is subscribed to afterwards.
+ */
+static void writeSubscription(OutputBuffer &out, std::string_view kind, const std::string *channel, size_t count)
+{
+    RespParser::writeArrayHeader(out, 3);
+    RespParser::writeBulkString(out, kind);
+    if (channel != nullptr)
+        RespParser::writeBulkString(out, std::string_view(*channel));
+    else
+        RespParser::writeBulkString(out, std::string_view());
+    RespParser::writeInteger(out, (long long)count);
+}
+
+/**
+ * @brief Executes SUBSCRIBE, UNSUBSCRIBE or PUBLISH for a connection.
+ *
+ * SUBSCRIBE channel [channel ...] and UNSUBSCRIBE [channel ...] confirm each
+ * channel with the connection's subscription count, UNSUBSCRIBE without
+ * channels leaving all of them. PUBLISH channel message replies with the
+ * number of subscribers the message is handed to.
+ *
+ * @param worker Worker owning the connection.
+ * @param client Connection state.
+ * @param args Command arguments.
+ * @param out Buffer the response is serialized into.
+ */
+void KQueueServer::processPubSubCommand(Worker &worker, Client &client, const std::vector<std::string_view> &args,
+                                        OutputBuffer &out)
+{
+    std::string_view cmd = args[0];
+    if (isCommand(cmd, "subscribe"))
+    {
+        if (args.size() < 2)
+        {
+            RespParser::writeError(out, "wrong number of arguments for 'subscribe' command");
+            return;
+        }
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            std::string channel(args[i]);
+            subscribe(worker, client, channel);
+            writeSubscription(out, "subscribe", &channel, client.channels.size());
+        }
+    }
+    else if (isCommand(cmd, "unsubscribe"))
+    {
+        std::vector<std::string> names(args.begin() + 1, args.end());
+        if (names.empty())
+            names = client.channels;
+        if (names.empty())
+            writeSubscription(out, "unsubscribe", nullptr, 0);
+        for (const std::string &channel : names)
+        {
+            unsubscribe(worker, client, channel);
+            writeSubscription(out, "unsubscribe", &channel, client.channels.size());
+        }
+    }
+    else if (args.size() == 3)
+    {
+        RespParser::writeInteger(out, (long long)publish(std::string(args[1]), std::string(args[2])));
+    }
+    else
+    {
+        RespParser::writeError(out, "wrong number of arguments for 'publish' command");
+    }
+}
+
+/**
+ * @brief Processes a client command and serializes the response.
+ * @param store Shard the command executes against.
+ * @param args Parsed command arguments.
+ * @param out Buffer the RESP-formatted response is appended to.
+ */
+void KQueueServer::processCommand(LSMTree &store, const std::vector<std::string_view> &args, OutputBuffer &out)
+{
+    if (args.empty())
+    {
+        RespParser::writeError(out, "no command");
+        return;
+    }
+
+    std::string_view cmd = args[0];
+
+    try
+    {
+        if (isCommand(cmd, "getall") && args.size() == 1)
+        {
+            std::vector<std::string> arrVals = store.getAllKeyValuePairs();
+            RespParser::writeArray(out, arrVals);
+        }
+        else if (isCommand(cmd, "scan") || isCommand(cmd, "range"))
+        {
+            RangeQuery query;
+            std::string error;
+            if (!parseRangeQuery(args, query, error))
+                RespParser::writeError(out, error);
+            else
+                writeRangeReply(out, query, store.getRange(query.start, query.end, query.count + 1, !query.keysOnly));
+        }
+        else if (isCommand(cmd, "set") && args.size() == 3)
+        {
+            if (!store.set(std::string(args[1]), std::string(args[2])))
+                RespParser::writeError(out, "write-ahead log write failed");
+            else
+            {
+                sendUpdateNotification();
+                RespParser::writeSimpleString(out, "OK");
+            }
+        }
+        else if (isCommand(cmd, "get") && args.size() == 2)
+        {
+            std::string value = store.get(args[1]);
+            if (value.empty())
+                RespParser::writeBulkString(out, std::string_view("NULL"));
+            else
+                RespParser::writeBulkString(out, std::move(value));
+        }
+        else if (isCommand(cmd, "del") && args.size() == 2)
+        {
+            if (!store.remove(std::string(args[1])))
+                RespParser::writeError(out, "write-ahead log write failed");
+            else
+            {
+                sendUpdateNotification();
+                RespParser::writeSimpleString(out, "OK");
+            }
+        }
+        else if (isRangeDelete(args))
+        {
+            if (!store.removeRange(std::string(args[1]), std::string(args[2])))
+                RespParser::writeError(out, "write-ahead log write failed");
+            else
+            {
+                sendUpdateNotification();
+                RespParser::writeSimpleString(out, "OK");
+            }
+        }
+        else if (isCommand(cmd, "setex") && args.size() == 4)
+        {
+            // SETEX key seconds value
+            uint64_t expiresAt = 0;
+            if (!parseExpiry(args[2], expiresAt))
+                RespParser::writeError(out, "value is not an integer or out of range");
+            else if (expiresAt == 1)
+                RespParser::writeError(out, "invalid expire time in 'setex' command");
+            else if (!store.set(std::string(args[1]), std::string(args[3]), expiresAt))
+                RespParser::writeError(out, "write-ahead log write failed");
+            else
+            {
+                sendUpdateNotification();
+                RespParser::writeSimpleString(out, "OK");
+            }
+        }
+        else if (isCommand(cmd, "expire") && args.size() == 3)
+        {
+            // EXPIRE key seconds: 1 if the key exists, 0 otherwise
+            uint64_t expiresAt = 0;
+            if (!parseExpiry(args[2], expiresAt))
+                RespParser::writeError(out, "value is not an integer or out of range");
+            else
+            {
+                ExpireStatus status = store.expire(std::string(args[1]), expiresAt);
+                if (status == ExpireStatus::WRITE_FAILED)
+                    RespParser::writeError(out, "write-ahead log write failed");
+                else
+                {
+                    if (status == ExpireStatus::UPDATED)
+                        sendUpdateNotification();
+                    RespParser::writeInteger(out, status == ExpireStatus::UPDATED ? 1 : 0);
+                }
+            }
+        }
+        else if (isCommand(cmd, "persist") && args.size() == 2)
+        {
+            // PERSIST key: 1 if an expiry was removed, 0 otherwise
+            uint64_t expiresAt = 0;
+            ExpireStatus status = ExpireStatus::NOT_FOUND;
+            if (store.getExpiry(args[1], expiresAt) && expiresAt != 0)
+                status = store.expire(std::string(args[1]), 0);
+            if (status == ExpireStatus::WRITE_FAILED)
+                RespParser::writeError(out, "write-ahead log write failed");
+            else
+            {
+                if (status == ExpireStatus::UPDATED)
+                    sendUpdateNotification();
+                RespParser::writeInteger(out, status == ExpireStatus::UPDATED ? 1 : 0);
+            }
+        }
+        else if (isCommand(cmd, "ttl") && args.size() == 2)
+        {
+            // TTL key: seconds left, -1 without expiry, -2 if the key does not exist
+            uint64_t expiresAt = 0;
+            if (!store.getExpiry(args[1], expiresAt))
+                RespParser::writeInteger(out, -2);
+            else if (expiresAt == 0)
+                RespParser::writeInteger(out, -1);
+            else
+            {
+                uint64_t now = currentTimeMillis();
+                RespParser::writeInteger(out, expiresAt > now ? (long long)((expiresAt - now + 500) / 1000) : 0);
+            }
+        }
+        else if (isCommand(cmd, "mget") && isBatchCommand(args))
+        {
+            std::vector<std::string_view> keys(args.begin() + 1, args.end());
+            writeMultiGetReply(out, store.multiGet(keys));
+        }
+        else if (isBatchCommand(args))
+        {
+            // MSET or DEL of several keys
+            WriteBatch batch;
+            if (isCommand(cmd, "mset"))
+            {
+                for (size_t i = 1; i < args.size(); i += 2)
+                    batch.put(args[i], args[i + 1]);
+            }
+            else
+            {
+                for (size_t i = 1; i < args.size(); ++i)
+                    batch.remove(args[i]);
+            }
+            if (!store.write(batch))
+                RespParser::writeError(out, "write-ahead log write failed");
+            else
+            {
+                sendUpdateNotification();
+                RespParser::writeSimpleString(out, "OK");
+            }
+        }
+        else if (isCommand(cmd, "ping"))
+        {
+            if (args.size() == 1)
+                RespParser::writeSimpleString(out, args[0]); // PING msg
+            else
+                RespParser::writeSimpleString(out, "PONG"); // Default PING
+        }
+        else if (isCommand(cmd, "echo") && args.size() == 1)
+        {
+            RespParser::writeBulkString(out, args[0]);
+        }
+        else if (isCommand(cmd, "command"))
+        {
+            RespParser::writeArrayHeader(out, 0); // Respond with empty array
+        }
+        else if (isCommand(cmd, "select") && args.size() == 1)
+        {
+            RespParser::writeSimpleString(out, "OK"); // Stubbed; no DB switching
+        }
+        else if (isCommand(cmd, "client"))
+        {
+            RespParser::writeSimpleString(out, "OK"); // Ignore subcommands
+        }
+        else if (isCommand(cmd, "info"))
+        {
+            const BlockCache &cache = store.blockCache();
+            std::string info = "redis_version: 6.0.0\r\n";
+            info += "block_cache_hits:" + std::to_string(cache.hits()) + "\r\n";
+            info += "block_cache_misses:" + std::to_string(cache.misses()) + "\r\n";
+            info += "block_cache_usage:" + std::to_string(cache.usage()) + "\r\n";
+            info += "block_cache_capacity:" + std::to_string(cache.capacity()) + "\r\n";
+            RespParser::writeBulkString(out, std::move(info));
+        }
+        else
+            RespParser::writeError(out, "unknown command");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Unknown command received: " << cmd << std::endl;
+        RespParser::writeError(out, e.what());
+    }
+}
+
+/**
+ * @brief Returns the shard owning a key.
+ * @param key Key of a command.
+ * @return Shard index.
+ */
+size_t KQueueServer::shardOf(std::string_view key) const
+{
+    return (size_t)(shardHash(key) % shards.size());
+}
+
+/**
+ * @brief Returns the shard owning a keyed command.
+ *
+ * A multi-key command whose keys all belong to one shard is sent there as a
+ * whole, like a single-key command.
+ *
+ * @param args Parsed command arguments.
+ * @return Shard index, -1 for commands that are executed where they arrive,
+ *         or MULTI_SHARD for multi-key commands spanning several shards.
+ */
+int KQueueServer::shardFor(const std::vector<std::string_view> &args) const
+{
+    if (shards.size() == 1 || args.size() < 2)
+        return -1;
+
+    if (isKeyCommand(args))
+        return (int)shardOf(args[1]);
+
+    if (!isBatchCommand(args))
+        return -1;
+
+    size_t step = isCommand(args[0], "mset") ? 2 : 1;
+    size_t shard = shardOf(args[1]);
+    for (size_t i = 1 + step; i < args.size(); i += step)
+    {
+        if (shardOf(args[i]) != shard)
+            return MULTI_SHARD;
+    }
+    return (int)shard;
+}
+
+/**
+ * @brief Executes the share of a multi-key command whose keys a shard owns.
+ *
+ * The shard's keys of an MGET are looked up in one multiGet() and the ones
+ * found are returned as (position in the command, value) pairs; the writes of an MSET or DEL are
+ * applied as one batch, so they are atomic within the shard.
+ *
+ * @param store Storage of the shard.
+ * @param shard Index of the shard.
+ * @param args Command arguments.
+ * @param values Receives (position, value) pairs for MGET.
+ * @return False if the writes could not be logged.
+ */
+bool KQueueServer::processBatchPart(LSMTree &store, size_t shard, const std::vector<std::string_view> &args,
+                                    std::vector<std::string> &values)
+{
+    if (isCommand(args[0], "mget"))
+    {
+        std::vector<std::string_view> keys;
+        std::vector<size_t> positions;
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            if (shardOf(args[i]) == shard)
+            {
+                keys.push_back(args[i]);
+                positions.push_back(i - 1);
+            }
+        }
+        std::vector<std::optional<std::string>> found = store.multiGet(keys);
+        for (size_t j = 0; j < found.size(); ++j)
+        {
+            if (!found[j])
+                continue;
+            values.push_back(std::to_string(positions[j]));
+            values.push_back(std::move(*found[j]));
+        }
+        return true;
+    }
+
+    bool mset = isCommand(args[0], "mset");
+    WriteBatch batch;
+    for (size_t i = 1; i < args.size(); i += mset ? 2 : 1)
+    {
+        if (shardOf(args[i]) != shard)
+            continue;
+        if (mset)
+            batch.put(args[i], args[i + 1]);
+        else
+            batch.remove(args[i]);
+    }
+    return store.write(batch);
+}
+
+/**
+ * @brief Executes a shard's share of a gathered command.
+ *
+ * GETALL and SCAN or RANGE pages return the shard's entries, DELRANGE deletes
+ * the range from the shard and multi-key commands execute the shard's keys.
+ *
+ * @param worker Worker owning the shard.
+ * @param args Command arguments; empty for GETALL.
+ * @param values Receives the entries the shard contributes.
+ * @return False if the shard could not log its writes.
+ */
+bool KQueueServer::processGatherPart(Worker &worker, const std::vector<std::string_view> &args,
+                                     std::vector<std::string> &values)
+{
+    RangeQuery query;
+    std::string error;
+    if (args.empty() || isCommand(args[0], "getall"))
+        values = worker.store->getAllKeyValuePairs();
+    else if (isRangeDelete(args))
+        return worker.store->removeRange(std::string(args[1]), std::string(args[2]));
+    else if (isBatchCommand(args))
+        return processBatchPart(*worker.store, worker.index, args, values);
+    else if (parseRangeQuery(args, query, error))
+        values = worker.store->getRange(query.start, query.end, query.count + 1, !query.keysOnly);
+    return true;
+}
+
+/**
+ * @brief Adds a shard's share to a gathered reply.
+ *
+ * Once the last share arrived the reply is serialized and the slot marked
+ * ready; the caller then flushes the connection's replies.
+ *
+ * @param slot Reply slot of the gathered command.
+ * @param values Entries the shard contributed.
+ * @param ok False if the shard could not log its writes.
+ */
+void KQueueServer::addGatherPart(PendingReply &slot, std::vector<std::string> &&values, bool ok)
+{
+    slot.failed = slot.failed || !ok;
+    slot.parts.insert(slot.parts.end(), std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+    if (--slot.partsRemaining != 0)
+        return;
+
+    if (slot.rangeQuery)
+        writeRangeReply(slot.response, slot.query, slot.parts);
+    else if (slot.batch)
+        writeBatchReply(slot);
+    else
+        RespParser::writeArray(slot.response, slot.parts);
+    slot.parts.clear();
+    slot.ready = true;
+}
+
+/**
+ * @brief Executes a command on the owning shard.
+ *
+ * Commands for the local shard run inline. Commands for another shard reserve a
+ * reply slot on the connection and are forwarded to the owner's mailbox. GETALL,
+ * SCAN and RANGE are scattered to every shard and gathered into one reply,
+ * DELRANGE is applied by every shard and acknowledged once all are done, and
+ * multi-key commands spanning several shards to the shards owning their keys.
+ * Pub/sub commands act on the connection and run inline.
+ *
+ * The local share of a gathered command is executed right away rather than
+ * posted to the worker's own mailbox: later commands of the connection on
+ * local keys run inline, and must neither overtake its writes nor show up
+ * in its reads.
+ *
+ * @param worker Worker that owns the connection.
+ * @param client Connection state.
+ * @param args Parsed command arguments; copied only when forwarded.
+ */
+void KQueueServer::dispatchCommand(Worker &worker, Client &client, const std::vector<std::string_view> &args)
+{
+    if (isPubSubCommand(args))
+    {
+        processPubSubCommand(worker, client, args, replyBuffer(client));
+        return;
+    }
+
+    int shard = shardFor(args);
+    bool gather = shards.size() > 1 && args.size() == 1 && isCommand(args[0], "getall");
+    RangeQuery query;
+    std::string error;
+    bool rangeQuery = shards.size() > 1 && !args.empty() && (isCommand(args[0], "scan") || isCommand(args[0], "range")) &&
+                      parseRangeQuery(args, query, error);
+    bool rangeDelete = shards.size() > 1 && isRangeDelete(args);
+    bool batch = shard == MULTI_SHARD || rangeDelete;
+    gather = gather || rangeQuery || batch;
+
+    // Shards taking part in a gather
+    std::vector<bool> targets(shards.size(), shard != MULTI_SHARD);
+    if (shard == MULTI_SHARD)
+    {
+        size_t step = isCommand(args[0], "mset") ? 2 : 1;
+        for (size_t i = 1; i < args.size(); i += step)
+            targets[shardOf(args[i])] = true;
+    }
+
+    if (!gather && (shard < 0 || (size_t)shard == worker.index))
+    {
+        processCommand(*worker.store, args, replyBuffer(client));
+        return;
+    }
+
+    PendingReply slot;
+    slot.seq = client.nextSeq++;
+    slot.ready = false;
+    slot.partsRemaining = gather ? (size_t)std::count(targets.begin(), targets.end(), true) : 1;
+    slot.rangeQuery = rangeQuery;
+    slot.query = query;
+    slot.batch = batch;
+    slot.batchKeys = batch && isCommand(args[0], "mget") ? args.size() - 1 : 0;
+    client.replies.push_back(std::move(slot));
+
+    ShardMessage msg;
+    msg.type = gather ? ShardMessage::GATHER : ShardMessage::COMMAND;
+    msg.origin = worker.index;
+    msg.clientId = client.id;
+    msg.seq = client.replies.back().seq;
+
+    if (gather)
+    {
+        bool local = targets[worker.index];
+        if (rangeQuery || batch)
+            msg.args.assign(args.begin(), args.end());
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            if (targets[i] && !(local && i == worker.index))
+                workers[i]->mailbox.post(ShardMessage(msg));
+        }
+        if (local)
+        {
+            std::vector<std::string> values;
+            bool ok = processGatherPart(worker, args, values);
+            addGatherPart(client.replies.back(), std::move(values), ok);
+            flushReplies(client);
+        }
+    }
+    else
+    {
+        msg.args.assign(args.begin(), args.end());
+        workers[shard]->mailbox.post(std::move(msg));
+    }
+}
+
+/**
+ * @brief Returns the buffer the next reply on a connection is serialized into.
+ *
+ * With no forwarded command in flight this is the connection's output buffer
+ * itself. Otherwise a ready slot is queued behind the pending ones so the reply
+ * is released in command order. The front slot is never ready (ready slots are
+ * moved out eagerly), so nothing needs flushing here.
+ *
+ * @param client Connection state.
+ * @return Buffer to append the reply to.
+ */
+OutputBuffer &KQueueServer::replyBuffer(Client &client)
+{
+    client.nextSeq++;
+    if (client.replies.empty())
+        return client.output;
+
+    PendingReply slot;
+    slot.seq = client.nextSeq - 1;
+    slot.ready = true;
+    slot.partsRemaining = 0;
+    client.replies.push_back(std::move(slot));
+    return client.replies.back().response;
+}
+
+/**
+ * @brief Moves ready replies from the front of the queue to the output buffer.
+ *
+ * Replies are released strictly in command order, so a forwarded command that
+ * is still in flight holds back later local replies on the same connection.
+ *
+ * @param client Connection state.
+ */
+void KQueueServer::flushReplies(Client &client)
+{
+    while (!client.replies.empty() && client.replies.front().ready)
+    {
+        client.output.append(std::move(client.replies.front().response));
+        client.replies.pop_front();
+    }
+}
+
+/**
+ * @brief Flushes the output buffer and resumes a paused reader once drained.
+ *
+ * Called when the socket becomes writable (and after mailbox replies arrive).
+ * If reading was paused by the high-water mark and the buffer has dropped
+ * below half of it, buffered and pending input is processed again.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
+ * @return False if the connection failed.
+ */
+bool KQueueServer::onWritable(Worker &worker, int fd)
+{
+    auto it = worker.clients.find(fd);
+    if (it == worker.clients.end())
+        return true;
+
+    Client &client = it->second;
+    if (client.output.flush(fd) == OutputBuffer::FLUSH_ERROR)
+        return false;
+
+    if (client.readPaused && client.output.size() <= outputHighWaterMark / 2)
+        return handleClient(worker, fd);
+
+    return true;
+}
+
+/**
+ * @brief Handles forwarded commands, replies and pub/sub messages posted to a worker.
+ * @param worker Receiving worker.
+ */
+void KQueueServer::handleMailbox(Worker &worker)
+{
+    std::vector<ShardMessage> messages;
+    worker.mailbox.drain(messages);
+
+    std::vector<std::string_view> args;
+
+    for (auto &msg : messages)
+    {
+        if (msg.type == ShardMessage::COMMAND)
+        {
+            args.assign(msg.args.begin(), msg.args.end());
+            OutputBuffer out;
+            processCommand(*worker.store, args, out);
+            msg.response = out.toString();
+            msg.args.clear();
+            msg.type = ShardMessage::REPLY;
+            workers[msg.origin]->mailbox.post(std::move(msg));
+            continue;
+        }
+        if (msg.type == ShardMessage::GATHER)
+        {
+            args.assign(msg.args.begin(), msg.args.end());
+            msg.failed = !processGatherPart(worker, args, msg.values);
+            msg.args.clear();
+            msg.type = ShardMessage::GATHER_REPLY;
+            workers[msg.origin]->mailbox.post(std::move(msg));
+            continue;
+        }
+        if (msg.type == ShardMessage::PUBLISH)
+        {
+            deliverMessage(worker, msg.args[0], msg.args[1]);
+            continue;
+        }
+        if (msg.type == ShardMessage::UPDATE)
+        {
+            // Writes from here on post a new notification
+            worker.updatePending.store(false, std::memory_order_release);
+            deliverMessage(worker, UPDATE_CHANNEL, "UPDATE");
+            continue;
+        }
+
+        // Reply for one of our connections; it may have closed in the meantime
+        auto idIt = worker.clientFds.find(msg.clientId);
+        if (idIt == worker.clientFds.end())
+            continue;
+        int fd = idIt->second;
+        Client &client = worker.clients[fd];
+        if (client.replies.empty() || msg.seq < client.replies.front().seq)
+            continue;
+
+        PendingReply &slot = client.replies[msg.seq - client.replies.front().seq];
+        if (msg.type == ShardMessage::REPLY)
+        {
+            slot.response.append(std::move(msg.response));
+            slot.ready = true;
+        }
+        else
+            addGatherPart(slot, std::move(msg.values), !msg.failed);
+        flushReplies(client);
+#ifdef HAVE_IO_URING
+        if (worker.ring)
+        {
+            uringPumpOutput(worker, fd, client);
+            continue;
+        }
+#endif
+        if (!onWritable(worker, fd))
+        {
+            closeClient(worker, fd);
+        }
+    }
+}
+
+/**
+ * @brief Executes the complete commands buffered on a connection.
+ *
+ * Stops early, leaving the rest of the input buffered, once the connection's
+ * output reaches the high-water mark; reading is then paused until the client
+ * has consumed enough of its replies.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
+ * @param client Connection state.
+ * @return False on a protocol error.
+ */
+bool KQueueServer::processInput(Worker &worker, int fd, Client &client)
+{
+    std::vector<std::string_view> &args = worker.args;
+    size_t pos = 0;
+
+    while (pos < client.input.size())
+    {
+        if (client.output.size() >= outputHighWaterMark)
+        {
+            client.readPaused = true;
+            break;
+        }
+
+        size_t consumed = 0;
+        RespParser::ParseStatus status = RespParser::parseCommand(
+            client.input.data() + pos, client.input.size() - pos, consumed, args);
+
+        if (status == RespParser::PARSE_INCOMPLETE)
+            break;
+        if (status == RespParser::PARSE_ERROR)
+        {
+            RespParser::writeError(replyBuffer(client), "Protocol error");
+            flushReplies(client);
+            // With io_uring a writev may be in flight; the caller drains output instead
+            if (backend == IoBackend::EVENT_LOOP)
+                client.output.flush(fd);
+            return false;
+        }
+
+        pos += consumed;
+        dispatchCommand(worker, client, args);
+    }
+
+    client.input.erase(0, pos);
+    return true;
+}
+
+/**
+ * @brief Handles client requests.
+ *
+ * The socket is edge-triggered, so it is drained until recv() would block.
+ * Bytes are appended to the connection's input buffer and every complete
+ * command in it is executed, which makes pipelined requests work; a trailing
+ * partial command stays buffered for the next read. All replies produced by
+ * the batch are written back together with writev().
+ *
+ * While the connection's output is above the high-water mark nothing more is
+ * read, so a slow reader is throttled by TCP flow control instead of growing
+ * its buffer and stalling other clients.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
+ * @return False if the connection was closed by the peer or failed.
+ */
+bool KQueueServer::handleClient(Worker &worker, int fd)
+{
+    auto it = worker.clients.find(fd);
+    if (it == worker.clients.end())
+        return true;
+
+    Client &client = it->second;
+    bool open = true;
+
+    while (true)
+    {
+        client.readPaused = false;
+        if (!processInput(worker, fd, client))
+            return false;
+
+        while (open && !client.readPaused)
+        {
+            size_t used = client.input.size();
+            client.input.resize(used + BUFFER_SIZE);
+            ssize_t bytes_read = recv(fd, &client.input[used], BUFFER_SIZE, 0);
+            client.input.resize(used + (bytes_read > 0 ? bytes_read : 0));
+
+            if (bytes_read == 0)
+            {
+                open = false;
+            }
+            else if (bytes_read < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    open = false;
+                break;
+            }
+
+            if (!processInput(worker, fd, client))
+                return false;
+        }
+
+        if (client.output.flush(fd) == OutputBuffer::FLUSH_ERROR)
+            return false;
+
+        // The socket took enough of the backlog: keep serving this client
+        if (open && client.readPaused && client.output.size() <= outputHighWaterMark / 2)
+            continue;
+
+        return open;
+    }
+}
+
+/**
+ * @brief Accepts all pending connections.
+ *
+ * The listener is edge-triggered, so accept is repeated until the backlog is
+ * empty. On Linux accept4() creates the socket non-blocking in one call.
+ *
+ * @param worker Worker that owns the listener.
+ */
+void KQueueServer::acceptClients(Worker &worker)
+{
+    while (true)
+    {
+        struct sockaddr_in client_addr;
+        socklen_t len = sizeof(client_addr);
+#if defined(__linux__)
+        int client_fd = accept4(worker.listen_fd, (struct sockaddr *)&client_addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int client_fd = accept(worker.listen_fd, (struct sockaddr *)&client_addr, &len);
+        if (client_fd >= 0 && !setNonBlocking(client_fd))
+        {
+            close(client_fd);
+            continue;
+        }
+#endif
+
+        if (client_fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                std::cerr << "Failed to accept connection: " << std::strerror(errno) << std::endl;
+            return;
+        }
+
+        int nodelay = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        if (!worker.loop->add(client_fd, EVENT_READABLE | EVENT_WRITABLE))
+        {
+            std::cerr << "Failed to register client socket" << std::endl;
+            close(client_fd);
+            continue;
+        }
+
+        registerClient(worker, client_fd);
+    }
+}
 
 /**
- * @brief Constructs a KQueueServer object.
- * @param store Reference to the LSMTree storage engine.
- * @param data Reference to the BenchmarkData generator.
+ * @brief Creates the state of a newly accepted connection.
+ * @param worker Accepting worker.
+ * @param client_fd Connected socket.
+ * @return Connection state.
  */
-KQueueServer::KQueueServer(LSMTree &store, BenchmarkData &data)
-    : store(store), data(data), server_fd(-1), kq(-1)
+KQueueServer::Client &KQueueServer::registerClient(Worker &worker, int client_fd)
 {
+    Client &client = worker.clients[client_fd];
+    client.id = worker.nextClientId++;
+    client.nextSeq = 0;
+    client.replies.clear();
+    client.input.clear();
+    client.output.clear();
+    client.readPaused = false;
+    client.inflight = 0;
+    client.recvArmed = false;
+    client.sendInFlight = false;
+    client.closing = false;
+    client.armPending = false;
+    client.channels.clear();
+    worker.clientFds[client.id] = client_fd;
+    return client;
 }
 
 /**
- * @brief Destroys the KQueueServer object and closes open file descriptors.
+ * @brief Removes a client from the event loop and closes its socket.
+ *
+ * Replies still in flight from other shards are discarded when they arrive,
+ * since the connection id is no longer registered.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
  */
-KQueueServer::~KQueueServer()
+void KQueueServer::closeClient(Worker &worker, int fd)
+{
+    auto it = worker.clients.find(fd);
+    if (it != worker.clients.end())
+    {
+        dropSubscriptions(worker, it->second);
+        worker.clientFds.erase(it->second.id);
+        worker.clients.erase(it);
+    }
+    worker.loop->remove(fd);
+    close(fd);
+}
+
+/**
+ * @brief Creates a worker's listening socket and event loop.
+ *
+ * Every worker binds its own listener to the port; with more than one worker
+ * SO_REUSEPORT is set so the kernel load-balances incoming connections.
+ *
+ * @param worker Worker to initialize.
+ * @return True on success.
+ */
+bool KQueueServer::setupWorker(Worker &worker)
 {
-    if (server_fd >= 0)
+    // Create socket
+    worker.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (worker.listen_fd < 0)
+    {
+        std::cerr << "Failed to create socket" << std::endl;
+        return false;
+    }
+
+    int opt = 1;
+    if (setsockopt(worker.listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int)) < 0)
     {
-        close(server_fd);
+        std::cerr << "Failed to set socket options" << std::endl;
+        return false;
+    }
+
+    if (workers.size() > 1 && setsockopt(worker.listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(int)) < 0)
+    {
+        std::cerr << "Failed to set SO_REUSEPORT" << std::endl;
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(worker.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        std::cerr << "Failed to bind socket" << std::endl;
+        return false;
+    }
+
+    if (listen(worker.listen_fd, SOMAXCONN) < 0)
+    {
+        std::cerr << "Failed to listen on socket" << std::endl;
+        return false;
+    }
+
+    if (!worker.mailbox.init())
+    {
+        std::cerr << "Failed to create worker mailbox" << std::endl;
+        return false;
     }
-    if (kq >= 0)
+
+    // io_uring polls internally, so its sockets stay in blocking mode; the
+    // ring itself is created by the worker thread (see runUringWorker)
+    if (backend == IoBackend::IO_URING)
+        return true;
+
+    if (!setNonBlocking(worker.listen_fd))
+    {
+        std::cerr << "Failed to make server socket non-blocking" << std::endl;
+        return false;
+    }
+
+    worker.loop = EventLoop::create();
+    if (!worker.loop->init())
+    {
+        std::cerr << "Failed to create " << worker.loop->name() << " instance" << std::endl;
+        return false;
+    }
+
+    if (!worker.loop->add(worker.listen_fd, EVENT_READABLE))
     {
-        close(kq);
+        std::cerr << "Failed to add server socket to " << worker.loop->name() << std::endl;
+        return false;
     }
+
+    if (!worker.loop->add(worker.mailbox.fd(), EVENT_READABLE))
+    {
+        std::cerr << "Failed to add worker mailbox to " << worker.loop->name() << std::endl;
+        return false;
+    }
+
+    return true;
 }
 
-void KQueueServer::sendUpdateNotification()
+/**
+ * @brief Event loop of one worker thread.
+ * @param worker Worker to run.
+ */
+void KQueueServer::runWorker(Worker &worker)
 {
-    const std::string message = "UPDATE";
+#if defined(__linux__)
+    if (workers.size() > 1)
+    {
+        // Shard-per-core: keep each worker (and its shard's memtable) on one CPU
+        unsigned cpus = std::thread::hardware_concurrency();
+        if (cpus > 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(worker.index % cpus, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+    }
+#endif
+
+#ifdef HAVE_IO_URING
+    if (backend == IoBackend::IO_URING)
+    {
+        runUringWorker(worker);
+        return;
+    }
+#endif
 
-    if (subscriptions.size() > 0)
+    std::vector<IoEvent> events(MAX_EVENTS);
+    while (true)
     {
-        // This is the message format subscribers will receive
-        // Format: ["message", "channel_name", "the_message"]
-        std::string message_to_send = RespParser::createResponseForSubscriber(message, channel_name);
+        int nev = worker.loop->wait(events.data(), MAX_EVENTS, -1);
+
+        if (nev < 0)
+        {
+            std::cerr << worker.loop->name() << " wait error" << std::endl;
+            break;
+        }
 
-        for (const int &fd : subscriptions)
+        for (int i = 0; i < nev; i++)
         {
-            send(fd, message_to_send.c_str(), message_to_send.length(), 0);
+            int fd = events[i].fd;
+
+            if (fd == worker.listen_fd)
+            {
+                acceptClients(worker);
+                continue;
+            }
+
+            if (fd == worker.mailbox.fd())
+            {
+                handleMailbox(worker);
+                continue;
+            }
+
+            // An earlier event of this batch may have closed the connection
+            if (worker.clients.find(fd) == worker.clients.end())
+                continue;
+
+            bool open = true;
+
+            if (events[i].flags & (EVENT_READABLE | EVENT_HANGUP))
+            {
+                open = handleClient(worker, fd);
+            }
+            else if (events[i].flags & EVENT_WRITABLE)
+            {
+                open = onWritable(worker, fd);
+            }
+
+            if (!open || (events[i].flags & (EVENT_HANGUP | EVENT_ERROR)))
+            {
+                closeClient(worker, fd);
+            }
         }
     }
 }
 
+#ifdef HAVE_IO_URING
 /**
- * @brief Processes a client command and generates a response.
- * @param args Parsed command arguments.
- * @param rn Random index for benchmark data access.
- * @return A RESP-formatted response string.
+ * @brief Queues a multishot accept on the worker's listener.
+ *
+ * One SQE keeps producing a completion per accepted connection until the
+ * kernel drops the CQE_F_MORE flag.
+ *
+ * @param worker Worker that owns the listener.
  */
-std::string KQueueServer::processCommand(const std::vector<std::string> &args, int rn, int fd)
+void KQueueServer::uringArmAccept(Worker &worker)
 {
-    if (args.empty())
-        return RespParser::createError("no command");
+    struct io_uring_sqe *sqe = worker.ring->getSqe();
+    worker.acceptArmPending = sqe == nullptr;
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = worker.listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = uringTag(0, URING_OP_ACCEPT);
+}
 
-    std::string cmd = args[0];
-    std::transform(cmd.begin(), cmd.end(), cmd.begin(), ::tolower);
-    std::cout << "Command: " << cmd << std::endl;
+/**
+ * @brief Queues a multishot poll on the worker's mailbox descriptor.
+ * @param worker Worker that owns the mailbox.
+ */
+void KQueueServer::uringArmMailbox(Worker &worker)
+{
+    struct io_uring_sqe *sqe = worker.ring->getSqe();
+    worker.mailboxArmPending = sqe == nullptr;
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = worker.mailbox.fd();
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = uringTag(0, URING_OP_MAILBOX);
+}
 
-    try
+/**
+ * @brief Queues a multishot receive that picks buffers from the provided ring.
+ *
+ * The kernel selects a buffer per completion, so no memory is pinned for idle
+ * connections.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
+ * @param client Connection state.
+ */
+void KQueueServer::uringArmRecv(Worker &worker, int fd, Client &client)
+{
+    if (client.recvArmed || client.closing)
+        return;
+
+    struct io_uring_sqe *sqe = worker.ring->getSqe();
+    if (!sqe)
+    {
+        uringDeferArm(worker, client);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = worker.ring->bufferGroup();
+    sqe->user_data = uringTag(client.id, URING_OP_RECV);
+
+    client.recvArmed = true;
+    client.inflight++;
+}
+
+/**
+ * @brief Queues a writev of the buffered replies.
+ *
+ * At most one write is in flight per connection; the iovecs point into the
+ * output buffer's chunks, which stay put until consume() releases them.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
+ * @param client Connection state.
+ */
+void KQueueServer::uringPumpOutput(Worker &worker, int fd, Client &client)
+{
+    if (client.sendInFlight || client.output.empty())
+        return;
+
+    struct io_uring_sqe *sqe = worker.ring->getSqe();
+    if (!sqe)
+    {
+        uringDeferArm(worker, client);
+        return;
+    }
+
+    client.sendIov.resize(OUTPUT_MAX_IOV);
+    int count = client.output.gather(client.sendIov.data(), OUTPUT_MAX_IOV);
+
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)client.sendIov.data();
+    sqe->len = (unsigned)count;
+    sqe->user_data = uringTag(client.id, URING_OP_SEND);
+
+    client.sendInFlight = true;
+    client.inflight++;
+}
+
+/**
+ * @brief Shuts a connection down and releases it once no operation is pending.
+ *
+ * A graceful close only stops reading, so replies already produced are still
+ * written. Otherwise the socket is shut down in both directions, which makes
+ * any in-flight receive or write complete. The descriptor itself is closed
+ * only when the last operation referencing it has completed, so it cannot be
+ * reused by a new connection underneath a pending request.
+ *
+ * @param worker Worker that owns the connection.
+ * @param fd Client socket file descriptor.
+ * @param client Connection state.
+ * @param graceful Deliver buffered replies before closing.
+ */
+void KQueueServer::uringCloseClient(Worker &worker, int fd, Client &client, bool graceful)
+{
+    if (!client.closing)
     {
-        if (cmd == "subscribe")
+        client.closing = true;
+        dropSubscriptions(worker, client);
+        if (client.recvArmed)
         {
-            // SUBSCRIBE channel1 [channel2 ...]
-            for (size_t i = 1; i < args.size(); ++i)
+            struct io_uring_sqe *sqe = worker.ring->getSqe();
+            if (sqe)
             {
-                subscriptions.push_back(fd);
-
-                // IMPORTANT: Send confirmation back to the client in RESP format
-                // This is what Redis clients like ioredis expect.
-                // Format: ["subscribe", "channel_name", 1]
-                std::string response = "*3\r\n$9\r\nsubscribe\r\n$" +
-                                       std::to_string(channel_name.length()) + "\r\n" + channel_name + "\r\n" +
-                                       ":1\r\n";
-                return response;
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = uringTag(client.id, URING_OP_RECV);
+                sqe->user_data = uringTag(client.id, URING_OP_CANCEL);
+                client.inflight++;
             }
         }
-        else if (cmd == "publish" && args.size() >= 2)
-        {
-            const std::string &message = args[1];
+    }
 
-            int subscribers_count = 0;
-            if (subscriptions.size() > 0)
-            {
-                // This is the message format subscribers will receive
-                // Format: ["message", "channel_name", "the_message"]
-                std::string message_to_send = RespParser::createResponseForSubscriber(message, channel_name);
+    if (graceful)
+    {
+        shutdown(fd, SHUT_RD);
+        uringPumpOutput(worker, fd, client);
+    }
+    else
+    {
+        // An in-flight writev still references the buffer; it fails after shutdown
+        if (!client.sendInFlight)
+            client.output.clear();
+        shutdown(fd, SHUT_RDWR);
+    }
 
-                for (const int &fd : subscriptions)
-                {
-                    send(fd, message_to_send.c_str(), message_to_send.length(), 0);
-                    subscribers_count++;
-                }
-            }
-            // Respond to the publisher with the count of subscribers reached
-            std::string response = ":" + std::to_string(subscribers_count) + "\r\n";
-            return response;
+    // A deferred writev still has replies to deliver
+    if (client.inflight == 0 && !client.armPending)
+    {
+        worker.clientFds.erase(client.id);
+        worker.clients.erase(fd);
+        close(fd);
+    }
+}
+
+/**
+ * @brief Records that a connection's recv or writev must be queued again.
+ *
+ * Dropping the request instead would leave the connection without a pending
+ * operation, so it would never be served again.
+ *
+ * @param worker Worker that owns the connection.
+ * @param client Connection state.
+ */
+void KQueueServer::uringDeferArm(Worker &worker, Client &client)
+{
+    if (client.armPending)
+        return;
+    client.armPending = true;
+    worker.armPending.push_back(client.id);
+}
+
+/**
+ * @brief Queues again the operations that found the submission queue full.
+ *
+ * Runs before every submission. getSqe() submits a full queue to make room,
+ * so a retry succeeds as soon as the kernel has consumed some entries.
+ *
+ * @param worker Worker to serve.
+ * @return True if no operation is left pending.
+ */
+bool KQueueServer::uringRetryArms(Worker &worker)
+{
+    if (worker.acceptArmPending)
+        uringArmAccept(worker);
+    if (worker.mailboxArmPending)
+        uringArmMailbox(worker);
+
+    std::vector<uint64_t> ids;
+    ids.swap(worker.armPending);
+    for (uint64_t id : ids)
+    {
+        auto idIt = worker.clientFds.find(id);
+        if (idIt == worker.clientFds.end())
+            continue;
+        int fd = idIt->second;
+        Client &client = worker.clients[fd];
+        client.armPending = false;
+        if (client.closing)
+        {
+            uringCloseClient(worker, fd, client, !client.output.empty());
+            continue;
         }
-        if (cmd == "getall" && args.size() == 1)
+        if (!client.readPaused)
+            uringArmRecv(worker, fd, client);
+        uringPumpOutput(worker, fd, client);
+    }
+    return !worker.acceptArmPending && !worker.mailboxArmPending && worker.armPending.empty();
+}
+
+/**
+ * @brief Handles one completion that belongs to a connection.
+ * @param worker Worker that owns the connection.
+ * @param op Operation tag.
+ * @param cqe Completion entry.
+ */
+void KQueueServer::uringHandleClient(Worker &worker, unsigned op, struct io_uring_cqe *cqe)
+{
+    uint64_t id = cqe->user_data >> 8;
+    int res = cqe->res;
+    uint32_t flags = cqe->flags;
+    IoUring &ring = *worker.ring;
+
+    auto idIt = worker.clientFds.find(id);
+    if (idIt == worker.clientFds.end())
+    {
+        if (flags & IORING_CQE_F_BUFFER)
+            ring.recycleBuffer((unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT));
+        return;
+    }
+    int fd = idIt->second;
+    Client &client = worker.clients[fd];
+
+    if (op == URING_OP_RECV)
+    {
+        bool wasPaused = client.readPaused;
+        if (flags & IORING_CQE_F_BUFFER)
         {
-            std::vector<std::string> arrVals = store.getAllKeyValuePairs();
-            return RespParser::serializeArray(arrVals);
+            unsigned short bid = (unsigned short)(flags >> IORING_CQE_BUFFER_SHIFT);
+            if (res > 0)
+                client.input.append(ring.buffer(bid), (size_t)res);
+            ring.recycleBuffer(bid);
         }
-        else if (cmd == "set" && args.size() == 3)
+        if (!(flags & IORING_CQE_F_MORE))
         {
-            // store.set(data.keys[rn], data.values[rn]); // For benchmark
-            store.set(args[1], args[2]);
-            sendUpdateNotification();
-            return RespParser::createSimpleString("OK");
+            client.recvArmed = false;
+            client.inflight--;
         }
-        else if (cmd == "get" && args.size() == 2)
+
+        if (client.closing)
         {
-            // std::string value = store.get(data.keys[rn]); // For benchmark
-            std::string value = store.get(args[1]);
-            return RespParser::serializeBulkString(value.length() ? value : "NULL");
+            // Wait for the remaining operations before releasing the connection
         }
-        else if (cmd == "del" && args.size() == 2)
+        else if (res > 0)
         {
-            store.remove(args[1]);
-            sendUpdateNotification();
-            return RespParser::createSimpleString("OK");
+            // While paused, received bytes are only buffered
+            if (!client.readPaused && !processInput(worker, fd, client))
+            {
+                uringCloseClient(worker, fd, client, true);
+                return;
+            }
+            if (!client.readPaused)
+                uringArmRecv(worker, fd, client);
         }
-        else if (cmd == "ping")
+        else if (res == 0)
         {
-            if (args.size() == 1)
-                return RespParser::createSimpleString(args[0]); // PING msg
-            else
-                return RespParser::createSimpleString("PONG"); // Default PING
+            uringCloseClient(worker, fd, client, true);
+            return;
         }
-        else if (cmd == "echo" && args.size() == 1)
+        else if (res == -ENOBUFS)
         {
-            return RespParser::serializeBulkString(args[0]);
+            // Buffers are republished before the next submission
+            if (!client.readPaused)
+                uringArmRecv(worker, fd, client);
         }
-        else if (cmd == "command")
+        else if (res != -ECANCELED)
         {
-            return "*0\r\n"; // Respond with empty array
+            uringCloseClient(worker, fd, client, false);
+            return;
         }
-        else if (cmd == "select" && args.size() == 1)
+
+        // Stop reading a client whose replies pile up; the rest stays in the socket
+        if (!wasPaused && client.readPaused && client.recvArmed && !client.closing)
         {
-            return RespParser::createSimpleString("OK"); // Stubbed; no DB switching
+            struct io_uring_sqe *sqe = ring.getSqe();
+            if (sqe)
+            {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = uringTag(client.id, URING_OP_RECV);
+                sqe->user_data = uringTag(client.id, URING_OP_CANCEL);
+                client.inflight++;
+            }
         }
-        else if (cmd == "client")
+    }
+    else if (op == URING_OP_SEND)
+    {
+        client.sendInFlight = false;
+        client.inflight--;
+
+        if (res < 0)
         {
-            return RespParser::createSimpleString("OK"); // Ignore subcommands
+            uringCloseClient(worker, fd, client, false);
+            return;
         }
-        else if (cmd == "info")
+        client.output.consume((size_t)res);
+
+        if (!client.closing && client.readPaused && client.output.size() <= outputHighWaterMark / 2)
         {
-            return RespParser::serializeBulkString("redis_version: 6.0.0\r\n");
+            client.readPaused = false;
+            if (!processInput(worker, fd, client))
+            {
+                uringCloseClient(worker, fd, client, true);
+                return;
+            }
+            if (!client.readPaused)
+                uringArmRecv(worker, fd, client);
         }
-        else
-            return RespParser::createError("unknown command");
     }
-    catch (const std::exception &e)
+    else
     {
-        std::cerr << "Unknown command received: " << cmd << std::endl;
-        return RespParser::createError(e.what());
+        client.inflight--;
     }
+
+    if (client.closing)
+    {
+        uringCloseClient(worker, fd, client, !client.output.empty());
+        return;
+    }
+
+    uringPumpOutput(worker, fd, client);
 }
 
 /**
- * @brief Handles client requests.
- * @param fd Client socket file descriptor.
- * @param rn Random index for benchmark data access.
+ * @brief Completion loop of one worker using io_uring.
+ *
+ * Each iteration submits every SQE queued while handling the previous batch
+ * and waits for at least one completion in a single io_uring_enter() call;
+ * while operations still wait for a free SQE it only submits, so they are
+ * retried without waiting. Each completion is copied and released before it
+ * is handled, so the completion queue never stays full while handlers submit,
+ * and a batch only handles the completions present when it starts.
+ * Receive buffers consumed by the batch are handed back to the kernel in one
+ * store before the next submission.
+ *
+ * @param worker Worker to run.
  */
-void KQueueServer::handleClient(int fd, int rn)
+void KQueueServer::runUringWorker(Worker &worker)
 {
-    char buffer[BUFFER_SIZE] = {0};
-    ssize_t bytes_read = recv(fd, buffer, BUFFER_SIZE, 0);
+    // Created here so the ring's single issuer is the thread that drives it
+    worker.ring.reset(new IoUring());
+    if (!worker.ring->init(URING_SQ_ENTRIES, URING_CQ_ENTRIES) ||
+        !worker.ring->setupBufferRing(URING_BUFFER_GROUP, URING_BUFFER_COUNT, URING_BUFFER_SIZE))
+    {
+        std::cerr << "Failed to create io_uring instance for worker " << worker.index << std::endl;
+        return;
+    }
+    IoUring &ring = *worker.ring;
 
-    if (bytes_read > 0)
+    uringArmAccept(worker);
+    uringArmMailbox(worker);
+
+    while (true)
     {
-        // std::cout << "RAW CLIENT INPUT:\n"
-        //           << buffer << std::endl;
-        auto args = RespParser::parseArray(std::string(buffer, bytes_read));
-        std::string response = processCommand(args, rn, fd);
-        send(fd, response.c_str(), response.size(), 0);
+        ring.publishBuffers();
+        bool settled = uringRetryArms(worker) && !ring.buffersPending();
+        int ret = ring.submitAndWait(settled ? 1 : 0);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY)
+        {
+            std::cerr << "io_uring_enter error: " << std::strerror(-ret) << std::endl;
+            break;
+        }
+
+        // Completions posted by submissions made while handling are left for the next batch
+        for (unsigned ready = ring.readyCqes(); ready > 0; --ready)
+        {
+            struct io_uring_cqe completion = *ring.peekCqe(0);
+            struct io_uring_cqe *cqe = &completion;
+            ring.advanceCq(1);
+            if (cqe->user_data == URING_INTERNAL_USER_DATA)
+                continue;
+            unsigned op = (unsigned)(cqe->user_data & 0xff);
+
+            if (op == URING_OP_ACCEPT)
+            {
+                if (cqe->res >= 0)
+                {
+                    int client_fd = cqe->res;
+                    int nodelay = 1;
+                    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                    Client &client = registerClient(worker, client_fd);
+                    uringArmRecv(worker, client_fd, client);
+                }
+                else if (cqe->res != -EINTR && cqe->res != -ECONNABORTED)
+                {
+                    std::cerr << "Failed to accept connection: " << std::strerror(-cqe->res) << std::endl;
+                }
+                if (!(cqe->flags & IORING_CQE_F_MORE))
+                    uringArmAccept(worker);
+            }
+            else if (op == URING_OP_MAILBOX)
+            {
+                handleMailbox(worker);
+                if (!(cqe->flags & IORING_CQE_F_MORE))
+                    uringArmMailbox(worker);
+            }
+            else
+            {
+                uringHandleClient(worker, op, cqe);
+            }
+        }
     }
 }
+#endif
 
 /**
- * @brief Runs the KQueue-based event-driven server.
+ * @brief Runs the event-driven server.
+ *
+ * Starts one worker per shard; worker 0 runs on the calling thread.
+ *
  * @return 0 on successful execution, 1 on error.
  */
 int KQueueServer::run()
 {
-    // Create socket
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0)
-    {
-        std::cerr << "Failed to create socket" << std::endl;
-        return 1;
-    }
-
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(int)) < 0)
+    if (shards.empty() || shards.size() > MAX_WORKER_THREADS)
     {
-        std::cerr << "Failed to set socket options" << std::endl;
+        std::cerr << "Invalid shard count: " << shards.size() << std::endl;
         return 1;
     }
 
-    struct sockaddr_in addr = {
-        .sin_family = AF_INET,
-        .sin_port = htons(PORT),
-        .sin_addr.s_addr = INADDR_ANY};
+    // A peer that disconnects mid-write must surface as EPIPE, not kill the server
+    signal(SIGPIPE, SIG_IGN);
 
-    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    for (size_t i = 0; i < shards.size(); ++i)
     {
-        std::cerr << "Failed to bind socket" << std::endl;
-        return 1;
+        std::unique_ptr<Worker> worker(new Worker());
+        worker->index = i;
+        worker->store = shards[i];
+        workers.push_back(std::move(worker));
     }
 
-    if (listen(server_fd, SOMAXCONN) < 0)
+    for (auto &worker : workers)
     {
-        std::cerr << "Failed to listen on socket" << std::endl;
-        return 1;
+        if (!setupWorker(*worker))
+        {
+            return 1;
+        }
     }
 
-    kq = kqueue();
-    if (kq < 0)
+#ifdef HAVE_IO_URING
+    if (backend == IoBackend::IO_URING)
     {
-        std::cerr << "Failed to create kqueue" << std::endl;
-        return 1;
+        // Fail at startup rather than in the worker threads if io_uring is unavailable
+        IoUring check;
+        if (!check.init(URING_SQ_ENTRIES, URING_CQ_ENTRIES))
+        {
+            std::cerr << "Failed to create io_uring instance: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
     }
+#endif
+
+    const char *ioName = backend == IoBackend::IO_URING ? "io_uring" : workers[0]->loop->name();
+    std::cout << ioName << " server listening on port " << port
+              << " with " << workers.size() << " worker thread(s)" << std::endl;
 
-    struct kevent changes[1];
-    EV_SET(&changes[0], server_fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
-    if (kevent(kq, changes, 1, NULL, 0, NULL) < 0)
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers.size(); ++i)
     {
-        std::cerr << "Failed to add server socket to kqueue" << std::endl;
-        return 1;
+        threads.emplace_back(&KQueueServer::runWorker, this, std::ref(*workers[i]));
     }
 
-    std::cout << "kqueue server listening on port " << PORT << std::endl;
+    runWorker(*workers[0]);
 
-    while (true)
+    for (auto &thread : threads)
     {
-        struct kevent events[MAX_EVENTS];
-        int nev = kevent(kq, NULL, 0, events, MAX_EVENTS, NULL);
-
-        if (nev < 0)
-        {
-            std::cerr << "kevent error" << std::endl;
-            break;
-        }
-
-        for (int i = 0; i < nev; i++)
-        {
-            int fd = (int)events[i].ident;
-
-            std::random_device rd;
-            std::mt19937 gen(rd());
-            std::uniform_int_distribution<int> distrib(0, 100000);
-            int random_number = distrib(gen);
-
-            if (fd == server_fd)
-            {
-                struct sockaddr_in client_addr;
-                socklen_t len = sizeof(client_addr);
-                int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &len);
-
-                if (client_fd < 0)
-                {
-                    std::cerr << "Failed to accept connection" << std::endl;
-                    continue;
-                }
-
-                struct kevent event;
-                EV_SET(&event, client_fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
-                kevent(kq, &event, 1, NULL, 0, NULL);
-            }
-            else
-            {
-                handleClient(fd, random_number);
-
-                if (events[i].flags & EV_EOF)
-                {
-                    close(fd);
-                }
-            }
-        }
+        thread.join();
     }
 
     return 0;
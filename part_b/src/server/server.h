@@ -1,68 +1,533 @@
 /**
  * @file server.h
- * @brief KQueue-based server for LSM Tree storage engine
+ * @brief Event-driven server for LSM Tree storage engine
  */
 
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "event_loop.h"
+#include "mailbox.h"
+#include "output_buffer.h"
+#include "pubsub.h"
+#include "uring_loop.h"
+#include <sys/uio.h>
 #include "../../part_a/src/StorageEngine/lsmtree.h"
 #include "../benchmarkdata/benchmarkdata.h"
 
+/**
+ * @brief Default listening port (see --port)
+ */
 #define PORT 9002
 #define MAX_EVENTS 1024
-#define BUFFER_SIZE 1024
+
+/**
+ * @brief Bytes requested per recv() when filling a connection's input buffer
+ */
+#define BUFFER_SIZE 16384
+
+/**
+ * @brief Default buffered reply bytes per connection at which reading from it pauses
+ */
+#define OUTPUT_HIGH_WATER_MARK (1024 * 1024)
+
+/**
+ * @brief Upper bound on the number of event-loop threads / shards
+ */
+#define MAX_WORKER_THREADS 256
+
+/**
+ * @brief File in the data directory recording the shard count it was created with
+ */
+#define SHARD_COUNT_FILE_NAME "SHARDS"
+
+/**
+ * @brief Keys returned per SCAN or RANGE page when the client gives no COUNT
+ */
+#define SCAN_DEFAULT_COUNT 10
+
+/**
+ * @brief Largest COUNT accepted by SCAN and RANGE
+ */
+#define SCAN_MAX_COUNT 100000
+
+/**
+ * @brief Longest key prefix a SCAN cursor carries; longer resume keys are truncated to it
+ */
+#define SCAN_CURSOR_MAX_KEY_LENGTH 4096
+
+/**
+ * @brief Longest expiry in seconds accepted by SETEX and EXPIRE (about 100 years)
+ */
+#define EXPIRE_MAX_SECONDS 3153600000LL
+
+/**
+ * @brief Buffered output bytes of a subscriber beyond which it is disconnected instead of sent a message
+ */
+#define PUBSUB_OUTPUT_LIMIT (32 * 1024 * 1024)
+
+/**
+ * @brief Channel on which writes are announced with the message UPDATE
+ */
+#define UPDATE_CHANNEL "db_changes"
+
+/**
+ * @brief Returned by shardFor() for multi-key commands whose keys span several shards
+ */
+#define MULTI_SHARD -2
+
+/**
+ * @brief Networking backend used by the worker threads
+ */
+enum class IoBackend
+{
+    EVENT_LOOP, ///< Readiness notification: epoll on Linux, kqueue on macOS
+    IO_URING    ///< Completion based io_uring with multishot accept/recv (Linux only)
+};
 
 /**
  * @class KQueueServer
- * @brief Server implementation using kqueue for I/O multiplexing
+ * @brief Server implementation using an edge-triggered event loop for I/O multiplexing
  *
  * Handles client connections and processes Redis-compatible commands
- * using the LSM Tree storage engine.
+ * using the LSM Tree storage engine. The readiness backend is epoll on Linux
+ * and kqueue on macOS (see EventLoop).
+ *
+ * The server runs one worker per storage shard. Each worker is a thread with
+ * its own event loop and its own listening socket on the port (SO_REUSEPORT lets
+ * the kernel spread connections across them), and exclusively owns one LSMTree.
+ * Keys are hash-partitioned across shards; a command whose key belongs to
+ * another shard is forwarded through that worker's Mailbox and the reply is
+ * routed back, preserving per-connection reply order. With a single shard the
+ * server behaves as the original single-threaded loop.
+ *
+ * With IoBackend::IO_URING each worker instead drives an io_uring instance:
+ * one multishot accept, one multishot recv per connection feeding a provided
+ * buffer ring, and writev SQEs for replies, all submitted in one
+ * io_uring_enter() per completion batch. Command handling is shared with the
+ * readiness backend.
+ *
+ * Pub/sub messages never block the publisher: they are posted to the mailbox
+ * of every worker with subscribers of the channel, which appends them to its
+ * subscribers' output buffers and writes them as the sockets accept them. A
+ * subscriber whose buffer exceeds PUBSUB_OUTPUT_LIMIT is disconnected. Writes
+ * announce themselves on UPDATE_CHANNEL; while a worker has an UPDATE not yet
+ * delivered, further writes are folded into it, so a burst of writes costs
+ * one message per worker and a write only pays an atomic check.
  */
 class KQueueServer
 {
 private:
-    int server_fd;
-    int kq;
-    LSMTree &store;
+    /**
+     * @brief A page request of SCAN or RANGE
+     */
+    struct RangeQuery
+    {
+        bool keysOnly = false; ///< SCAN returns keys, RANGE keys and values
+        std::string start;     ///< First key of the page
+        std::string end;       ///< Key at which the range ends (exclusive), empty for none
+        size_t count = SCAN_DEFAULT_COUNT;
+    };
+
+    /**
+     * @brief A reply slot on a connection, filled in order of command arrival
+     */
+    struct PendingReply
+    {
+        uint64_t seq;
+        bool ready;
+        size_t partsRemaining;
+        OutputBuffer response;
+        std::vector<std::string> parts;
+        bool rangeQuery = false; ///< The parts are pages of query, merged once all arrived
+        RangeQuery query;
+        bool batch = false;      ///< The parts are shares of an MGET, MSET or multi-key DEL
+        size_t batchKeys = 0;    ///< Number of MGET keys; the parts are (position, value) pairs. 0 for writes
+        bool failed = false;     ///< A shard could not log its share of the writes
+    };
+
+    /**
+     * @brief Per-connection state owned by the worker that accepted it
+     */
+    struct Client
+    {
+        uint64_t id;
+        uint64_t nextSeq;
+        std::deque<PendingReply> replies;
+        std::string input;  ///< Received bytes not yet parsed (may end in a partial command)
+        OutputBuffer output; ///< Serialized replies not yet written to the socket
+        bool readPaused;     ///< Output reached the high-water mark; input is not read
+        std::vector<std::string> channels; ///< Channels the connection is subscribed to
+
+        // io_uring backend state
+        int inflight;          ///< Operations that still reference this connection
+        bool recvArmed;        ///< A multishot recv is active
+        bool sendInFlight;     ///< A writev of output is in flight
+        bool closing;          ///< Socket is shut down; close once inflight drops to zero
+        bool armPending;       ///< A recv or writev found the submission queue full and awaits a retry
+        std::vector<struct iovec> sendIov;
+    };
+
+    /**
+     * @brief An event-loop thread and the shard it owns
+     */
+    struct Worker
+    {
+        size_t index;
+        int listen_fd = -1;
+        LSMTree *store = nullptr;
+        std::unique_ptr<EventLoop> loop;
+        Mailbox mailbox;
+        std::unordered_map<int, Client> clients;
+        std::unordered_map<uint64_t, int> clientFds;
+        uint64_t nextClientId = 1;
+        std::vector<std::string_view> args; ///< Reused argument vector for parsed commands
+        std::unordered_map<std::string, std::vector<uint64_t>> channels; ///< Subscribed connection ids per channel
+        std::atomic<size_t> updateSubscribers{0}; ///< Subscribers of UPDATE_CHANNEL among its connections
+        std::atomic<bool> updatePending{false};   ///< An UPDATE message is posted and not yet delivered
+#ifdef HAVE_IO_URING
+        std::unique_ptr<IoUring> ring;
+        bool acceptArmPending = false;     ///< The accept could not be queued and awaits a retry
+        bool mailboxArmPending = false;    ///< The mailbox poll could not be queued and awaits a retry
+        std::vector<uint64_t> armPending;  ///< Connections whose recv or writev awaits a retry
+#endif
+    };
+
+    std::vector<LSMTree *> shards;
     BenchmarkData &data;
-    std::vector<int> subscriptions;
-    const std::string channel_name = "db_changes";
+    std::vector<std::unique_ptr<Worker>> workers;
+    ChannelRegistry channels;
+    std::atomic<size_t> updateSubscribers{0}; ///< Subscribers of UPDATE_CHANNEL on all workers
+    size_t outputHighWaterMark;
+    IoBackend backend;
+    int port = PORT;
 
     /**
      * @brief Processes a command from a client
+     *
+     * Arguments are borrowed views; bytes are copied only where the storage
+     * engine takes ownership of a key or value.
+     *
+     * @param store Shard the command executes against
      * @param args Command arguments
-     * @param rn Random number for benchmark data access
+     * @param out Buffer the response is serialized into
+     */
+    void processCommand(LSMTree &store, const std::vector<std::string_view> &args, OutputBuffer &out);
+
+    /**
+     * @brief Executes SUBSCRIBE, UNSUBSCRIBE or PUBLISH for a connection
+     * @param worker Worker owning the connection
+     * @param client Connection state
+     * @param args Command arguments
+     * @param out Buffer the response is serialized into
+     */
+    void processPubSubCommand(Worker &worker, Client &client, const std::vector<std::string_view> &args,
+                              OutputBuffer &out);
+
+    /**
+     * @brief Subscribes a connection to a channel unless it already is
+     * @param worker Worker owning the connection
+     * @param client Connection state
+     * @param channel Channel name
+     */
+    void subscribe(Worker &worker, Client &client, const std::string &channel);
+
+    /**
+     * @brief Unsubscribes a connection from a channel
+     * @param worker Worker owning the connection
+     * @param client Connection state
+     * @param channel Channel name
+     * @return False if the connection was not subscribed to it
+     */
+    bool unsubscribe(Worker &worker, Client &client, const std::string &channel);
+
+    /**
+     * @brief Unsubscribes a closing connection from all its channels
+     * @param worker Worker owning the connection
+     * @param client Connection state
+     */
+    void dropSubscriptions(Worker &worker, Client &client);
+
+    /**
+     * @brief Hands a message to every worker with subscribers of a channel
+     * @param channel Channel name
+     * @param message Message to deliver
+     * @return Number of subscribers of the channel
+     */
+    size_t publish(const std::string &channel, const std::string &message);
+
+    /**
+     * @brief Appends a message to the output of a worker's subscribers of a channel
+     * @param worker Delivering worker
+     * @param channel Channel name
+     * @param message Message to deliver
+     */
+    void deliverMessage(Worker &worker, const std::string &channel, std::string_view message);
+
+    /**
+     * @brief Handles a readable client connection
+     *
+     * Reads until the socket would block, as required by edge-triggered
+     * notification, executes every complete (possibly pipelined) command in the
+     * input buffer and writes all resulting replies with one writev().
+     *
+     * @param worker Worker owning the connection
+     * @param fd Client socket file descriptor
+     * @return False if the peer closed the connection or an error occurred
+     */
+    bool handleClient(Worker &worker, int fd);
+
+    /**
+     * @brief Executes the complete commands in the input buffer, pausing at the output high-water mark
+     * @param worker Worker owning the connection
+     * @param fd Client socket file descriptor
+     * @param client Connection state
+     * @return False on a protocol error
+     */
+    bool processInput(Worker &worker, int fd, Client &client);
+
+    /**
+     * @brief Executes a command locally or forwards it to the owning shard
+     * @param worker Worker owning the connection
+     * @param client Connection state
+     * @param args Command arguments (views into the connection's input buffer)
+     */
+    void dispatchCommand(Worker &worker, Client &client, const std::vector<std::string_view> &args);
+
+    /**
+     * @brief Returns the buffer the next reply is serialized into, respecting reply order
+     * @param client Connection state
+     * @return The output buffer, or a new ready slot behind in-flight replies
+     */
+    OutputBuffer &replyBuffer(Client &client);
+
+    /**
+     * @brief Moves replies from the front of the queue to the output buffer until one is still pending
+     * @param client Connection state
+     */
+    void flushReplies(Client &client);
+
+    /**
+     * @brief Flushes the output buffer and resumes reading once it drained below the low-water mark
+     * @param worker Worker owning the connection
      * @param fd Client socket file descriptor
-     * @return Response to send to client
+     * @return False if the connection failed
+     */
+    bool onWritable(Worker &worker, int fd);
+
+    /**
+     * @brief Processes messages posted to a worker's mailbox
+     * @param worker Receiving worker
+     */
+    void handleMailbox(Worker &worker);
+
+    /**
+     * @brief Accepts every pending connection on the worker's listening socket
+     * @param worker Worker owning the listener
+     */
+    void acceptClients(Worker &worker);
+
+    /**
+     * @brief Deregisters and closes a client socket
+     * @param worker Worker owning the connection
+     * @param fd Client socket file descriptor
+     */
+    void closeClient(Worker &worker, int fd);
+
+    /**
+     * @brief Creates the worker's listener, event loop and mailbox registration
+     * @param worker Worker to initialize
+     * @return True on success
+     */
+    bool setupWorker(Worker &worker);
+
+    /**
+     * @brief Event loop of a single worker thread
+     * @param worker Worker to run
+     */
+    void runWorker(Worker &worker);
+
+    /**
+     * @brief Registers a freshly accepted connection with a worker
+     * @param worker Accepting worker
+     * @param client_fd Connected socket
+     * @return Connection state
+     */
+    Client &registerClient(Worker &worker, int client_fd);
+
+#ifdef HAVE_IO_URING
+    /**
+     * @brief Completion loop of a worker using the io_uring backend
+     * @param worker Worker to run
+     */
+    void runUringWorker(Worker &worker);
+
+    /**
+     * @brief Queues a multishot accept on the worker's listener
+     */
+    void uringArmAccept(Worker &worker);
+
+    /**
+     * @brief Queues a multishot poll on the worker's mailbox descriptor
+     */
+    void uringArmMailbox(Worker &worker);
+
+    /**
+     * @brief Queues a multishot buffer-select recv for a connection
+     */
+    void uringArmRecv(Worker &worker, int fd, Client &client);
+
+    /**
+     * @brief Queues a writev of the connection's output if none is in flight
+     */
+    void uringPumpOutput(Worker &worker, int fd, Client &client);
+
+    /**
+     * @brief Records that a connection's recv or writev must be queued again
+     */
+    void uringDeferArm(Worker &worker, Client &client);
+
+    /**
+     * @brief Queues again the operations that found the submission queue full
+     * @return True if none is left pending
      */
-    std::string processCommand(const std::vector<std::string> &args, int rn, int fd);
+    bool uringRetryArms(Worker &worker);
 
     /**
-     * @brief Handles a client connection
+     * @brief Handles one completion for a connection
+     * @param worker Owning worker
+     * @param op Operation tag from the completion's user_data
+     * @param cqe Completion entry
+     */
+    void uringHandleClient(Worker &worker, unsigned op, struct io_uring_cqe *cqe);
+
+    /**
+     * @brief Shuts a connection down and closes it once no operation references it
+     * @param worker Owning worker
      * @param fd Client socket file descriptor
-     * @param rn Random number for benchmark data access
+     * @param client Connection state
+     * @param graceful Only stop reading, so queued replies are still delivered
+     */
+    void uringCloseClient(Worker &worker, int fd, Client &client, bool graceful);
+#endif
+
+    /**
+     * @brief Parses the arguments of SCAN or RANGE
+     * @param args Command arguments
+     * @param query Receives the page request
+     * @param error Receives the error reply on failure
+     * @return True if the arguments are valid
+     */
+    static bool parseRangeQuery(const std::vector<std::string_view> &args, RangeQuery &query, std::string &error);
+
+    /**
+     * @brief Serializes a SCAN or RANGE page from the matching entries of one or more shards
+     * @param out Buffer the response is appended to
+     * @param query Page request
+     * @param values Up to count + 1 entries per shard, each shard's in key order
+     */
+    static void writeRangeReply(OutputBuffer &out, const RangeQuery &query, const std::vector<std::string> &values);
+
+    /**
+     * @brief Serializes the reply of a multi-key command from the parts of all its shards
+     * @param slot Reply slot holding the parts
+     */
+    void writeBatchReply(PendingReply &slot);
+
+    /**
+     * @brief Executes a shard's share of a command gathered from several shards
+     * @param worker Worker owning the shard
+     * @param args Command arguments; empty for GETALL
+     * @param values Receives the entries the shard contributes to the reply
+     * @return False if the shard could not log its writes
+     */
+    bool processGatherPart(Worker &worker, const std::vector<std::string_view> &args, std::vector<std::string> &values);
+
+    /**
+     * @brief Adds a shard's share to a gathered reply and serializes the reply once all shares arrived
+     * @param slot Reply slot of the gathered command
+     * @param values Entries the shard contributed
+     * @param ok False if the shard could not log its writes
+     */
+    void addGatherPart(PendingReply &slot, std::vector<std::string> &&values, bool ok);
+
+    /**
+     * @brief Executes the share of an MGET, MSET or multi-key DEL whose keys a shard owns
+     * @param store Storage of the shard
+     * @param shard Index of the shard
+     * @param args Command arguments
+     * @param values Receives (position, value) pairs for MGET
+     * @return False if the writes could not be logged
      */
-    void handleClient(int fd, int rn);
+    bool processBatchPart(LSMTree &store, size_t shard, const std::vector<std::string_view> &args,
+                          std::vector<std::string> &values);
 
+    /**
+     * @brief Returns the shard owning a key
+     * @param key Key of a command
+     * @return Shard index
+     */
+    size_t shardOf(std::string_view key) const;
+
+    /**
+     * @brief Returns the shard owning the command's keys
+     * @param args Command arguments
+     * @return Shard index, -1 if the command is not keyed, or MULTI_SHARD if its keys span several shards
+     */
+    int shardFor(const std::vector<std::string_view> &args) const;
+
+    /**
+     * @brief Announces a write on UPDATE_CHANNEL without blocking, folding it into an undelivered UPDATE
+     */
     void sendUpdateNotification();
 
 public:
     /**
-     * @brief Constructor
+     * @brief Constructor for a single-shard server
      * @param store LSM Tree storage engine
      * @param data Benchmark data
      */
     KQueueServer(LSMTree &store, BenchmarkData &data);
 
+    /**
+     * @brief Constructor for a sharded server, one worker thread per shard
+     * @param shards Storage shards (each with its own SSTable directory)
+     * @param data Benchmark data
+     */
+    KQueueServer(const std::vector<LSMTree *> &shards, BenchmarkData &data);
+
     /**
      * @brief Destructor
      */
     ~KQueueServer();
 
+    /**
+     * @brief Sets the per-connection output high-water mark
+     * @param bytes Buffered reply bytes at which reading from a client pauses
+     */
+    void setOutputHighWaterMark(size_t bytes);
+
+    /**
+     * @brief Sets the TCP port the workers listen on (before run())
+     * @param tcpPort Port number
+     */
+    void setPort(int tcpPort);
+
+    /**
+     * @brief Selects the networking backend (before run())
+     * @param io Backend to use
+     * @return False if the backend is not available on this platform
+     */
+    bool setIoBackend(IoBackend io);
+
     /**
      * @brief Initializes and starts the server
      * @return 0 on success, error code otherwise
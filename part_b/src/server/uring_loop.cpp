@@ -0,0 +1,402 @@
+/**
+ * @file uring_loop.cpp
+ * @brief io_uring setup, submission and completion handling.
+ */
+
+#include "uring_loop.h"
+
+#ifdef HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+/**
+ * @brief Thin wrapper around the io_uring_enter system call.
+ */
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    int ret = (int)syscall(__NR_io_uring_enter, ring_fd, toSubmit, minComplete, flags, nullptr, 0);
+    return ret < 0 ? -errno : ret;
+}
+
+/**
+ * @brief Releases the ring mappings and descriptor.
+ */
+IoUring::~IoUring()
+{
+    if (bufRing)
+        munmap(bufRing, bufRingSize);
+    if (bufBase)
+        munmap(bufBase, (size_t)bufCount * bufSize);
+    if (sqes)
+        munmap(sqes, sqesSize);
+    if (cqRingPtr && cqRingPtr != sqRingPtr)
+        munmap(cqRingPtr, cqRingSize);
+    if (sqRingPtr)
+        munmap(sqRingPtr, sqRingSize);
+    if (ring_fd >= 0)
+        close(ring_fd);
+}
+
+/**
+ * @brief Creates the ring and maps the submission and completion queues.
+ *
+ * The ring is owned by a single worker thread, which lets the kernel skip
+ * cross-thread task_work signalling (SINGLE_ISSUER / COOP_TASKRUN) when the
+ * running kernel supports it; older kernels are retried without those flags.
+ *
+ * @param entries Submission queue depth.
+ * @param cqEntries Completion queue depth.
+ * @return True on success.
+ */
+bool IoUring::init(unsigned entries, unsigned cqEntries)
+{
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    params.cq_entries = cqEntries;
+
+    ring_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd < 0 && errno == EINVAL)
+    {
+        std::memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = cqEntries;
+        ring_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if (ring_fd < 0)
+        return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+    {
+        if (cqRingSize > sqRingSize)
+            sqRingSize = cqRingSize;
+        cqRingSize = sqRingSize;
+    }
+
+    sqRingPtr = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sqRingPtr == MAP_FAILED)
+    {
+        sqRingPtr = nullptr;
+        return false;
+    }
+
+    if (single)
+    {
+        cqRingPtr = sqRingPtr;
+    }
+    else
+    {
+        cqRingPtr = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cqRingPtr == MAP_FAILED)
+        {
+            cqRingPtr = nullptr;
+            return false;
+        }
+    }
+
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqePtr = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqePtr == MAP_FAILED)
+        return false;
+    sqes = static_cast<struct io_uring_sqe *>(sqePtr);
+
+    char *sq = static_cast<char *>(sqRingPtr);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+    unsigned *array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i)
+        array[i] = i;
+    sqLocalTail = *sqTail;
+
+    char *cq = static_cast<char *>(cqRingPtr);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+/**
+ * @brief Maps the receive buffers.
+ * @param group Buffer group id.
+ * @param count Number of buffers.
+ * @param size Size of each buffer.
+ * @return True on success.
+ */
+bool IoUring::mapBuffers(unsigned short group, unsigned count, unsigned size)
+{
+    void *bufMem = mmap(nullptr, (size_t)count * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufMem == MAP_FAILED)
+        return false;
+    bufBase = static_cast<char *>(bufMem);
+    bufCount = count;
+    bufSize = size;
+    bufGroup = group;
+    return true;
+}
+
+/**
+ * @brief Registers a provided buffer ring over the mapped buffers and fills it.
+ * @return True on success.
+ */
+bool IoUring::registerBufferRing()
+{
+    bufRingSize = bufCount * sizeof(struct io_uring_buf);
+    void *ringMem = mmap(nullptr, bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ringMem == MAP_FAILED)
+        return false;
+    bufRing = static_cast<struct io_uring_buf_ring *>(ringMem);
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)bufRing;
+    reg.ring_entries = bufCount;
+    reg.bgid = bufGroup;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return false;
+
+    bufTail = 0;
+    for (unsigned i = 0; i < bufCount; ++i)
+        recycleBuffer((unsigned short)i);
+    publishBuffers();
+    return true;
+}
+
+/**
+ * @brief Sets up the receive buffers, as a provided buffer ring if the kernel supports it.
+ *
+ * Support is probed on a scratch ring: kernels that accept the registration
+ * but never hand its buffers to receives have also been seen to corrupt the
+ * submission queue of the ring it was registered on, so this ring is only
+ * registered once the probe succeeded.
+ *
+ * @param group Buffer group id.
+ * @param count Number of buffers (power of two, at most 32768).
+ * @param size Size of each buffer.
+ * @return True on success.
+ */
+bool IoUring::setupBufferRing(unsigned short group, unsigned count, unsigned size)
+{
+    if (!mapBuffers(group, count, size))
+        return false;
+
+    IoUring scratch;
+    if (scratch.init(2, 2) && scratch.mapBuffers(group, 1, size) && scratch.registerBufferRing() &&
+        scratch.probeBufferRing())
+        return registerBufferRing();
+
+    // Fall back to classic provided buffers in the same group
+    legacyBuffers = true;
+    if (!provideBuffers(0, (unsigned short)count) || submitAndWait(1) < 0)
+        return false;
+    struct io_uring_cqe *cqe = peekCqe(0);
+    bool ok = cqe && cqe->res >= 0;
+    advanceCq(cqe ? 1 : 0);
+    return ok;
+}
+
+/**
+ * @brief Checks that a buffer-select receive actually draws from the ring.
+ *
+ * Runs before any other request is queued, so the only completion is the
+ * probe's own.
+ *
+ * @return True if the ring delivered a buffer.
+ */
+bool IoUring::probeBufferRing()
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        return true; // Cannot tell; assume the ring works
+
+    char byte = 0;
+    bool delivered = false;
+    struct io_uring_sqe *sqe = getSqe();
+    if (send(sv[1], &byte, 1, 0) == 1 && sqe)
+    {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sv[0];
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = bufGroup;
+        sqe->user_data = URING_INTERNAL_USER_DATA;
+        if (submitAndWait(1) >= 0)
+        {
+            struct io_uring_cqe *cqe = peekCqe(0);
+            if (cqe)
+            {
+                delivered = cqe->res != -ENOBUFS;
+                if (cqe->flags & IORING_CQE_F_BUFFER)
+                {
+                    recycleBuffer((unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+                    publishBuffers();
+                }
+                advanceCq(1);
+            }
+        }
+    }
+
+    close(sv[0]);
+    close(sv[1]);
+    return delivered;
+}
+
+/**
+ * @brief Queues one PROVIDE_BUFFERS request for a run of consecutive buffers.
+ * @param first First buffer id.
+ * @param count Number of buffers.
+ * @return False if no SQE was free.
+ */
+bool IoUring::provideBuffers(unsigned short first, unsigned short count)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    if (!sqe)
+        return false;
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = count;
+    sqe->addr = (uint64_t)(uintptr_t)buffer(first);
+    sqe->len = bufSize;
+    sqe->off = first;
+    sqe->buf_group = bufGroup;
+    sqe->user_data = URING_INTERNAL_USER_DATA;
+    return true;
+}
+
+/**
+ * @brief Returns a cleared SQE from the submission queue.
+ * @return SQE, or nullptr if the queue stayed full.
+ */
+struct io_uring_sqe *IoUring::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= sqEntries)
+    {
+        // Queue full: hand what we have to the kernel without waiting
+        submitAndWait(0);
+        head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (sqLocalTail - head >= sqEntries)
+            return nullptr;
+    }
+
+    struct io_uring_sqe *sqe = &sqes[sqLocalTail & sqMask];
+    sqLocalTail++;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/**
+ * @brief Publishes prepared SQEs and enters the kernel once.
+ *
+ * Every entry the kernel has not consumed yet is submitted, including those
+ * left over when an earlier call failed with EBUSY or EAGAIN, so a transient
+ * failure cannot strand entries in the queue.
+ *
+ * @param minComplete Completions to wait for.
+ * @return Number of SQEs consumed, or -errno.
+ */
+int IoUring::submitAndWait(unsigned minComplete)
+{
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    if (toSubmit == 0 && minComplete == 0)
+        return 0;
+
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    return enter(toSubmit, minComplete, flags);
+}
+
+/**
+ * @brief Returns the completion index entries past the current head.
+ * @param index Offset from the head.
+ * @return Completion, or nullptr.
+ */
+struct io_uring_cqe *IoUring::peekCqe(unsigned index)
+{
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    if (tail - head <= index)
+        return nullptr;
+    return &cqes[(head + index) & cqMask];
+}
+
+/**
+ * @brief Counts the completions posted and not yet consumed.
+ * @return Number of available completions.
+ */
+unsigned IoUring::readyCqes() const
+{
+    return __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) - *cqHead;
+}
+
+/**
+ * @brief Consumes completions.
+ * @param count Number of completions handled.
+ */
+void IoUring::advanceCq(unsigned count)
+{
+    __atomic_store_n(cqHead, *cqHead + count, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Adds a buffer back to the provided ring (not yet visible to the kernel).
+ * @param id Buffer id.
+ */
+void IoUring::recycleBuffer(unsigned short id)
+{
+    if (legacyBuffers)
+    {
+        recycled.push_back(id);
+        return;
+    }
+
+    struct io_uring_buf *buf = &bufRing->bufs[bufTail & (bufCount - 1)];
+    buf->addr = (uint64_t)(uintptr_t)buffer(id);
+    buf->len = bufSize;
+    buf->bid = id;
+    bufTail++;
+}
+
+/**
+ * @brief Publishes recycled buffers with a single tail store.
+ *
+ * In fallback mode, runs of consecutive ids are provided with one SQE each;
+ * runs that find the submission queue full stay queued for the next call.
+ */
+void IoUring::publishBuffers()
+{
+    if (!legacyBuffers)
+    {
+        __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+        return;
+    }
+
+    if (recycled.empty())
+        return;
+
+    std::sort(recycled.begin(), recycled.end());
+    size_t start = 0;
+    for (size_t i = 1; i <= recycled.size(); ++i)
+    {
+        if (i == recycled.size() || recycled[i] != recycled[i - 1] + 1)
+        {
+            if (!provideBuffers(recycled[start], (unsigned short)(i - start)))
+                break;
+            start = i;
+        }
+    }
+    recycled.erase(recycled.begin(), recycled.begin() + start);
+}
+
+#endif // HAVE_IO_URING
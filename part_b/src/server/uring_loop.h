@@ -0,0 +1,188 @@
+/**
+ * @file uring_loop.h
+ * @brief Minimal io_uring ring wrapper (raw syscalls, no liburing dependency)
+ */
+
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Submission queue depth of a worker's ring
+ */
+#define URING_SQ_ENTRIES 1024
+
+/**
+ * @brief Completion queue depth (multishot requests can post many CQEs per SQE)
+ */
+#define URING_CQ_ENTRIES 8192
+
+/**
+ * @brief Number of receive buffers in the provided buffer ring (power of two)
+ */
+#define URING_BUFFER_COUNT 1024
+
+/**
+ * @brief Size of each provided receive buffer
+ */
+#define URING_BUFFER_SIZE 4096
+
+/**
+ * @brief user_data of SQEs the wrapper issues itself; their completions are ignored
+ */
+#define URING_INTERNAL_USER_DATA 0
+
+/**
+ * @class IoUring
+ * @brief One io_uring instance with a single provided-buffer ring
+ *
+ * SQEs obtained from getSqe() are only made visible to the kernel by
+ * submitAndWait(), so everything prepared while handling one batch of
+ * completions is submitted with a single io_uring_enter() call. Receive
+ * buffers handed back with recycleBuffer() are likewise published in one
+ * store by publishBuffers().
+ *
+ * Kernels that accept the buffer-ring registration but never hand its
+ * buffers to receives are detected at setup; the same buffers are then
+ * provided with IORING_OP_PROVIDE_BUFFERS SQEs instead.
+ */
+class IoUring
+{
+private:
+    int ring_fd = -1;
+
+    void *sqRingPtr = nullptr;
+    void *cqRingPtr = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned sqLocalTail = 0;
+
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    struct io_uring_cqe *cqes = nullptr;
+
+    struct io_uring_buf_ring *bufRing = nullptr;
+    size_t bufRingSize = 0;
+    char *bufBase = nullptr;
+    unsigned bufCount = 0;
+    unsigned bufSize = 0;
+    unsigned short bufTail = 0;
+    unsigned short bufGroup = 0;
+    bool legacyBuffers = false;
+    std::vector<unsigned short> recycled; ///< Buffers awaiting PROVIDE_BUFFERS (fallback only)
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+    bool mapBuffers(unsigned short group, unsigned count, unsigned size);
+    bool registerBufferRing();
+    bool provideBuffers(unsigned short first, unsigned short count);
+    bool probeBufferRing();
+
+public:
+    IoUring() = default;
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    /**
+     * @brief Unmaps the rings and closes the ring descriptor
+     */
+    ~IoUring();
+
+    /**
+     * @brief Creates and maps the ring
+     * @param entries Submission queue depth
+     * @param cqEntries Completion queue depth
+     * @return True on success
+     */
+    bool init(unsigned entries, unsigned cqEntries);
+
+    /**
+     * @brief Sets up the receive buffers, as a provided buffer ring where the kernel supports it
+     * @param group Buffer group id
+     * @param count Number of buffers (power of two)
+     * @param size Size of each buffer
+     * @return True on success
+     */
+    bool setupBufferRing(unsigned short group, unsigned count, unsigned size);
+
+    /**
+     * @brief Returns a zeroed SQE, submitting queued ones first if the queue is full
+     * @return SQE, or nullptr if the ring could not make room
+     */
+    struct io_uring_sqe *getSqe();
+
+    /**
+     * @brief Submits all prepared SQEs and waits for completions
+     * @param minComplete Number of completions to wait for (0 to not wait)
+     * @return Number of SQEs submitted, or -errno
+     */
+    int submitAndWait(unsigned minComplete);
+
+    /**
+     * @brief Returns the next unconsumed completion
+     * @param index Position relative to the current head
+     * @return Completion, or nullptr if fewer than index + 1 are available
+     */
+    struct io_uring_cqe *peekCqe(unsigned index);
+
+    /**
+     * @brief Number of completions available
+     */
+    unsigned readyCqes() const;
+
+    /**
+     * @brief Marks completions as consumed
+     * @param count Number of completions
+     */
+    void advanceCq(unsigned count);
+
+    /**
+     * @brief Returns the memory of a provided buffer
+     * @param id Buffer id reported in a completion
+     */
+    char *buffer(unsigned short id) const { return bufBase + (size_t)id * bufSize; }
+
+    /**
+     * @brief Queues a provided buffer for reuse (visible after publishBuffers())
+     * @param id Buffer id
+     */
+    void recycleBuffer(unsigned short id);
+
+    /**
+     * @brief Makes recycled buffers available to the kernel
+     */
+    void publishBuffers();
+
+    /**
+     * @brief True if recycled buffers still wait for a free SQE (fallback only)
+     */
+    bool buffersPending() const { return !recycled.empty(); }
+
+    /**
+     * @brief Buffer group id used for buffer-select receives
+     */
+    unsigned short bufferGroup() const { return bufGroup; }
+};
+
+#endif // HAVE_IO_URING
+
+#endif // URING_LOOP_H
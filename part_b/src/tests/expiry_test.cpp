@@ -0,0 +1,81 @@
+/**
+ * @file expiry_test.cpp
+ * @brief Tests of SETEX, EXPIRE, TTL and PERSIST.
+ */
+
+#include "server_harness.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(expiryCommands)
+{
+    for (const char *threads : {"1", "4"})
+    {
+        TestServer server({"--threads", threads});
+        TestClient client(server);
+
+        CHECK(client.command({"SETEX", "session", "100", "v"}).isStatus("OK"));
+        Reply ttl = client.command({"TTL", "session"});
+        CHECK(ttl.type == Reply::INTEGER && ttl.integer >= 99 && ttl.integer <= 100);
+        CHECK(client.command({"GET", "session"}).isBulk("v"));
+
+        CHECK(client.command({"PERSIST", "session"}).isInteger(1));
+        CHECK(client.command({"TTL", "session"}).isInteger(-1));
+        CHECK(client.command({"PERSIST", "session"}).isInteger(0));
+        CHECK(client.command({"EXPIRE", "session", "50"}).isInteger(1));
+        ttl = client.command({"TTL", "session"});
+        CHECK(ttl.type == Reply::INTEGER && ttl.integer >= 49 && ttl.integer <= 50);
+        CHECK(client.command({"GET", "session"}).isBulk("v"));
+
+        // A later SET keeps the key until overwritten
+        CHECK(client.command({"SET", "session", "w"}).isStatus("OK"));
+        CHECK(client.command({"TTL", "session"}).isInteger(-1));
+
+        CHECK(client.command({"EXPIRE", "missing", "10"}).isInteger(0));
+        CHECK(client.command({"PERSIST", "missing"}).isInteger(0));
+        CHECK(client.command({"TTL", "missing"}).isInteger(-2));
+
+        // A time that is not positive deletes the key right away
+        CHECK(client.command({"EXPIRE", "session", "0"}).isInteger(1));
+        CHECK(client.command({"GET", "session"}).isBulk("NOT_FOUND"));
+        CHECK(client.command({"TTL", "session"}).isInteger(-2));
+
+        CHECK(client.command({"SETEX", "bad", "soon", "v"}).isError());
+        CHECK(client.command({"SETEX", "bad", "0", "v"}).isError());
+        CHECK(client.command({"EXPIRE", "bad", "x"}).isError());
+    }
+}
+
+TEST(expiredKeysDisappear)
+{
+    TestServer server({"--threads", "2"});
+    TestClient client(server);
+
+    std::vector<std::vector<std::string>> commands;
+    for (int i = 0; i < 20; ++i)
+    {
+        commands.push_back({"SETEX", "short" + std::to_string(i), "1", "v"});
+        commands.push_back({"SETEX", "long" + std::to_string(i), "100", "v"});
+    }
+    REQUIRE(client.pipeline(commands));
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        REQUIRE(client.read().isStatus("OK"));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    int mismatches = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        mismatches += client.command({"GET", "short" + std::to_string(i)}).isBulk("NOT_FOUND") ? 0 : 1;
+        mismatches += client.command({"TTL", "short" + std::to_string(i)}).isInteger(-2) ? 0 : 1;
+        mismatches += client.command({"GET", "long" + std::to_string(i)}).isBulk("v") ? 0 : 1;
+    }
+    CHECK_EQ(mismatches, 0);
+    Reply values = client.command({"MGET", "short0", "long0"});
+    REQUIRE(values.type == Reply::ARRAY && values.elements.size() == 2);
+    CHECK(values.elements[0].type == Reply::NIL);
+    CHECK(values.elements[1].isBulk("v"));
+}
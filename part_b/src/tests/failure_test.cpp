@@ -0,0 +1,67 @@
+/**
+ * @file failure_test.cpp
+ * @brief Tests that commands whose writes cannot be logged reply with an error.
+ */
+
+#include "server_harness.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Writes to a key until its shard's write-ahead log reaches the file size limit
+ * @return False if the writes never failed
+ */
+static bool exhaustLog(TestClient &client, const std::string &key)
+{
+    std::string value(8192, 'x');
+    for (int i = 0; i < 100; ++i)
+    {
+        Reply reply = client.command({"SET", key, value});
+        if (reply.isError())
+            return true;
+        if (!reply.isStatus("OK"))
+            return false;
+    }
+    return false;
+}
+
+TEST(multiShardWritesReportLogFailures)
+{
+    TestServer server({"--threads", "2"}, 64 * 1024);
+    TestClient client(server);
+    REQUIRE(exhaustLog(client, "full"));
+
+    // Keys on the other shard still accept writes
+    std::vector<std::string> healthy;
+    for (int i = 0; i < 20; ++i)
+    {
+        std::string key = "key" + std::to_string(i);
+        if (client.command({"SET", key, "1"}).isStatus("OK"))
+            healthy.push_back(key);
+    }
+    REQUIRE(!healthy.empty() && healthy.size() < 20);
+
+    CHECK(client.command({"MSET", healthy[0], "2", "full", "2"}).isError());
+    CHECK(client.command({"DEL", healthy[0], "full"}).isError());
+    CHECK(client.command({"DELRANGE", "a", "z"}).isError());
+    CHECK(client.command({"MSET", healthy[0], "3", healthy.back(), "3"}).isStatus("OK"));
+    CHECK(client.command({"GET", healthy[0]}).isBulk("3"));
+}
+
+TEST(expiryCommandsReportLogFailures)
+{
+    TestServer server({}, 64 * 1024);
+    TestClient client(server);
+    REQUIRE(client.command({"SETEX", "session", "100", "v"}).isStatus("OK"));
+    REQUIRE(exhaustLog(client, "full"));
+
+    CHECK(client.command({"EXPIRE", "session", "10"}).isError());
+    CHECK(client.command({"PERSIST", "session"}).isError());
+    CHECK(client.command({"SETEX", "session", "10", "w"}).isError());
+
+    // Commands that need no write still succeed, and the failed ones changed nothing
+    CHECK(client.command({"EXPIRE", "missing", "10"}).isInteger(0));
+    Reply ttl = client.command({"TTL", "session"});
+    CHECK(ttl.type == Reply::INTEGER && ttl.integer > 10);
+    CHECK(client.command({"GET", "session"}).isBulk("v"));
+}
@@ -0,0 +1,114 @@
+/**
+ * @file multikey_test.cpp
+ * @brief Tests of MGET, MSET and multi-key DEL on one shard and across shards.
+ */
+
+#include "server_harness.h"
+#include <string>
+#include <vector>
+
+TEST(multiKeyCommandsAcrossShards)
+{
+    for (const char *threads : {"1", "4"})
+    {
+        TestServer server({"--threads", threads});
+        TestClient client(server);
+
+        std::vector<std::string> mset = {"MSET"};
+        std::vector<std::string> mget = {"MGET"};
+        for (int i = 0; i < 40; ++i)
+        {
+            mset.push_back("key" + std::to_string(i));
+            mset.push_back("value" + std::to_string(i));
+            mget.push_back("key" + std::to_string(i));
+            mget.push_back("missing" + std::to_string(i));
+        }
+        CHECK(client.command(mset).isStatus("OK"));
+
+        Reply values = client.command(mget);
+        REQUIRE(values.type == Reply::ARRAY && values.elements.size() == 80);
+        int mismatches = 0;
+        for (int i = 0; i < 40; ++i)
+        {
+            mismatches += values.elements[2 * i].isBulk("value" + std::to_string(i)) ? 0 : 1;
+            mismatches += values.elements[2 * i + 1].type == Reply::NIL ? 0 : 1;
+        }
+        CHECK_EQ(mismatches, 0);
+
+        std::vector<std::string> del = {"DEL"};
+        for (int i = 0; i < 40; i += 2)
+        {
+            del.push_back("key" + std::to_string(i));
+        }
+        CHECK(client.command(del).isStatus("OK"));
+        for (int i = 0; i < 40; ++i)
+        {
+            Reply value = client.command({"GET", "key" + std::to_string(i)});
+            mismatches += value.isBulk(i % 2 == 0 ? "NOT_FOUND" : "value" + std::to_string(i)) ? 0 : 1;
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+}
+
+TEST(multiGetTellsEmptyValuesFromMissingKeys)
+{
+    for (const char *threads : {"1", "4"})
+    {
+        TestServer server({"--threads", threads});
+        TestClient client(server);
+
+        CHECK(client.command({"SET", "empty", ""}).isStatus("OK"));
+        CHECK(client.command({"MSET", "blank0", "", "blank1", "", "full", "x"}).isStatus("OK"));
+        Reply values = client.command({"MGET", "empty", "missing", "blank0", "blank1", "full"});
+        REQUIRE(values.type == Reply::ARRAY && values.elements.size() == 5);
+        CHECK(values.elements[0].isBulk(""));
+        CHECK(values.elements[1].type == Reply::NIL);
+        CHECK(values.elements[2].isBulk(""));
+        CHECK(values.elements[3].isBulk(""));
+        CHECK(values.elements[4].isBulk("x"));
+    }
+}
+
+TEST(pipelinedCommandsFollowMultiShardWrites)
+{
+    TestServer server({"--threads", "2"});
+
+    // Connections land on either worker; each pipelines a multi-key write
+    // followed by single-key writes and reads of the same keys
+    for (int connection = 0; connection < 8; ++connection)
+    {
+        TestClient client(server);
+        std::vector<std::vector<std::string>> commands;
+        for (int i = 0; i < 100; ++i)
+        {
+            std::string c = "c" + std::to_string(connection) + "-" + std::to_string(i);
+            std::string d = "d" + std::to_string(connection) + "-" + std::to_string(i);
+            commands.push_back({"MSET", c, "old", d, "old"});
+            commands.push_back({"SET", c, "new"});
+            commands.push_back({"SET", d, "new"});
+            commands.push_back({"MGET", c, d});
+            commands.push_back({"DEL", c, d});
+            commands.push_back({"GET", c});
+            commands.push_back({"GET", d});
+        }
+        REQUIRE(client.pipeline(commands));
+
+        int mismatches = 0;
+        for (int i = 0; i < 100; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                mismatches += client.read().isStatus("OK") ? 0 : 1;
+            }
+            Reply values = client.read();
+            mismatches += values.type == Reply::ARRAY && values.elements.size() == 2 &&
+                                  values.elements[0].isBulk("new") && values.elements[1].isBulk("new")
+                              ? 0
+                              : 1;
+            mismatches += client.read().isStatus("OK") ? 0 : 1;
+            mismatches += client.read().isBulk("NOT_FOUND") ? 0 : 1;
+            mismatches += client.read().isBulk("NOT_FOUND") ? 0 : 1;
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * @file pipeline_test.cpp
+ * @brief Tests of pipelined commands and of requests split across reads.
+ */
+
+#include "server_harness.h"
+#include <string>
+#include <vector>
+
+TEST(pipelinedRepliesArriveInOrder)
+{
+    for (const char *threads : {"1", "4"})
+    {
+        TestServer server({"--threads", threads});
+        TestClient client(server);
+
+        // Every GET follows the SET of its key in the same write, on keys of all shards
+        std::vector<std::vector<std::string>> commands;
+        for (int i = 0; i < 500; ++i)
+        {
+            commands.push_back({"SET", "key" + std::to_string(i), "value" + std::to_string(i)});
+            commands.push_back({"GET", "key" + std::to_string(i)});
+            commands.push_back({"SET", "key" + std::to_string(i), "again" + std::to_string(i)});
+        }
+        for (int i = 0; i < 500; ++i)
+        {
+            commands.push_back({"GET", "key" + std::to_string(i)});
+        }
+        REQUIRE(client.pipeline(commands));
+
+        int mismatches = 0;
+        for (int i = 0; i < 500; ++i)
+        {
+            mismatches += client.read().isStatus("OK") ? 0 : 1;
+            mismatches += client.read().isBulk("value" + std::to_string(i)) ? 0 : 1;
+            mismatches += client.read().isStatus("OK") ? 0 : 1;
+        }
+        for (int i = 0; i < 500; ++i)
+        {
+            mismatches += client.read().isBulk("again" + std::to_string(i)) ? 0 : 1;
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+}
+
+TEST(commandsSplitAcrossReadsAreReassembled)
+{
+    TestServer server;
+    TestClient client(server);
+
+    std::string bytes = TestClient::encode({"SET", "split", std::string(40000, 's')}) +
+                        TestClient::encode({"GET", "split"}) + TestClient::encode({"PING"});
+    // One byte at a time through the headers, then larger pieces
+    for (size_t i = 0; i < bytes.size();)
+    {
+        size_t piece = i < 64 ? 1 : 4093;
+        REQUIRE(client.sendRaw(std::string_view(bytes).substr(i, piece)));
+        i += piece;
+    }
+    CHECK(client.read().isStatus("OK"));
+    CHECK(client.read().isBulk(std::string(40000, 's')));
+    CHECK(client.read().type == Reply::STATUS);
+}
+
+TEST(largePipelineRespectsOutputHighWaterMark)
+{
+    TestServer server({"--threads", "2", "--output-hwm", "4096"});
+    TestClient client(server);
+
+    std::string value(1000, 'v');
+    REQUIRE(client.command({"SET", "big", value}).isStatus("OK"));
+
+    // Far more reply bytes than the high-water mark; reading pauses and resumes
+    std::vector<std::vector<std::string>> commands(5000, {"GET", "big"});
+    REQUIRE(client.pipeline(commands));
+    int mismatches = 0;
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        mismatches += client.read().isBulk(value) ? 0 : 1;
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK(client.command({"GET", "big"}).isBulk(value));
+}
+
+TEST(protocolErrorClosesConnection)
+{
+    TestServer server;
+    TestClient client(server);
+
+    REQUIRE(client.pipeline({{"SET", "a", "1"}}));
+    REQUIRE(client.sendRaw("*1\r\n$x\r\n"));
+    CHECK(client.read().isStatus("OK"));
+    Reply error = client.read();
+    CHECK(error.isError());
+    CHECK(client.read().type == Reply::NONE);
+
+    // Other connections are unaffected
+    TestClient other(server);
+    CHECK(other.command({"GET", "a"}).isBulk("1"));
+}
@@ -0,0 +1,89 @@
+/**
+ * @file pubsub_test.cpp
+ * @brief Tests of SUBSCRIBE, UNSUBSCRIBE, PUBLISH and of the change channel.
+ */
+
+#include "server_harness.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Checks that a reply is a pub/sub push or confirmation
+ * @param reply Reply to check
+ * @param kind "message", "subscribe" or "unsubscribe"
+ * @param channel Expected channel
+ * @param last Expected message, or subscription count as text
+ */
+static bool isPush(const Reply &reply, const std::string &kind, const std::string &channel, const std::string &last)
+{
+    if (reply.type != Reply::ARRAY || reply.elements.size() != 3)
+        return false;
+    const Reply &tail = reply.elements[2];
+    bool lastMatches = tail.type == Reply::INTEGER ? std::to_string(tail.integer) == last : tail.isBulk(last);
+    return reply.elements[0].isBulk(kind) && reply.elements[1].isBulk(channel) && lastMatches;
+}
+
+TEST(publishReachesSubscribersOnAllWorkers)
+{
+    TestServer server({"--threads", "4"});
+
+    // Enough connections to land on several workers
+    std::vector<std::unique_ptr<TestClient>> subscribers;
+    for (int i = 0; i < 8; ++i)
+    {
+        subscribers.push_back(std::make_unique<TestClient>(server));
+        CHECK(isPush(subscribers.back()->command({"SUBSCRIBE", "news"}), "subscribe", "news", "1"));
+    }
+    TestClient publisher(server);
+    CHECK(publisher.command({"PUBLISH", "news", "first"}).isInteger(8));
+    CHECK(publisher.command({"PUBLISH", "other", "lost"}).isInteger(0));
+
+    std::vector<std::vector<std::string>> commands;
+    for (int i = 0; i < 50; ++i)
+    {
+        commands.push_back({"PUBLISH", "news", "message" + std::to_string(i)});
+    }
+    REQUIRE(publisher.pipeline(commands));
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        CHECK(publisher.read().isInteger(8));
+    }
+
+    // Every subscriber gets every message once, in publishing order
+    int mismatches = 0;
+    for (std::unique_ptr<TestClient> &subscriber : subscribers)
+    {
+        mismatches += isPush(subscriber->read(), "message", "news", "first") ? 0 : 1;
+        for (int i = 0; i < 50; ++i)
+        {
+            mismatches += isPush(subscriber->read(), "message", "news", "message" + std::to_string(i)) ? 0 : 1;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    CHECK(isPush(subscribers[0]->command({"UNSUBSCRIBE", "news"}), "unsubscribe", "news", "0"));
+    CHECK(publisher.command({"PUBLISH", "news", "last"}).isInteger(7));
+    CHECK(isPush(subscribers[1]->read(), "message", "news", "last"));
+}
+
+TEST(writesAreAnnouncedOnChangeChannel)
+{
+    TestServer server({"--threads", "2"});
+    TestClient subscriber(server);
+    TestClient writer(server);
+    REQUIRE(isPush(subscriber.command({"SUBSCRIBE", "db_changes"}), "subscribe", "db_changes", "1"));
+
+    CHECK(writer.command({"SET", "a", "1"}).isStatus("OK"));
+    CHECK(isPush(subscriber.read(), "message", "db_changes", "UPDATE"));
+    CHECK(writer.command({"MSET", "b", "1", "c", "1", "d", "1"}).isStatus("OK"));
+    CHECK(isPush(subscriber.read(), "message", "db_changes", "UPDATE"));
+
+    CHECK(writer.command({"DEL", "a"}).isStatus("OK"));
+    CHECK(isPush(subscriber.read(), "message", "db_changes", "UPDATE"));
+
+    // Reads announce nothing: the subscriber's next reply is its own
+    CHECK(writer.command({"GET", "b"}).isBulk("1"));
+    CHECK(writer.command({"MGET", "b", "c"}).type == Reply::ARRAY);
+    CHECK(subscriber.command({"PING"}).type == Reply::STATUS);
+}
@@ -0,0 +1,145 @@
+/**
+ * @file range_test.cpp
+ * @brief Tests of the range commands on one shard and across shards.
+ */
+
+#include "server_harness.h"
+#include <string>
+#include <vector>
+
+TEST(pipelinedCommandsFollowRangeDelete)
+{
+    for (const char *threads : {"1", "2"})
+    {
+        TestServer server({"--threads", threads});
+
+        // Connections land on either worker; each deletes the range and writes into it in one pipeline
+        for (int connection = 0; connection < 8; ++connection)
+        {
+            TestClient client(server);
+            std::vector<std::vector<std::string>> commands;
+            for (int i = 0; i < 20; ++i)
+            {
+                commands.push_back({"SET", "a" + std::to_string(i), "old"});
+            }
+            commands.push_back({"DELRANGE", "a", "b"});
+            for (int i = 0; i < 20; i += 2)
+            {
+                commands.push_back({"SET", "a" + std::to_string(i), "new"});
+            }
+            for (int i = 0; i < 20; ++i)
+            {
+                commands.push_back({"GET", "a" + std::to_string(i)});
+            }
+            REQUIRE(client.pipeline(commands));
+
+            int mismatches = 0;
+            for (int i = 0; i < 31; ++i)
+            {
+                mismatches += client.read().isStatus("OK") ? 0 : 1;
+            }
+            for (int i = 0; i < 20; ++i)
+            {
+                mismatches += client.read().isBulk(i % 2 == 0 ? "new" : "NOT_FOUND") ? 0 : 1;
+            }
+            CHECK_EQ(mismatches, 0);
+        }
+    }
+}
+
+TEST(scanAndRangePageThroughAllShards)
+{
+    for (const char *threads : {"1", "4"})
+    {
+        TestServer server({"--threads", threads});
+        TestClient client(server);
+
+        std::vector<std::vector<std::string>> commands;
+        for (int i = 100; i < 300; ++i)
+        {
+            commands.push_back({"SET", "key" + std::to_string(i), "value" + std::to_string(i)});
+        }
+        commands.push_back({"DELRANGE", "key150", "key160"});
+        REQUIRE(client.pipeline(commands));
+        for (size_t i = 0; i < commands.size(); ++i)
+        {
+            REQUIRE(client.read().isStatus("OK"));
+        }
+
+        std::vector<std::string> expected;
+        for (int i = 100; i < 300; ++i)
+        {
+            if (i < 150 || i >= 160)
+            {
+                expected.push_back("key" + std::to_string(i));
+            }
+        }
+
+        // SCAN pages through every key once, in key order
+        std::vector<std::string> scanned;
+        std::string cursor = "0";
+        for (int page = 0; page < 100; ++page)
+        {
+            Reply reply = client.command({"SCAN", cursor, "COUNT", "7"});
+            REQUIRE(reply.type == Reply::ARRAY && reply.elements.size() == 2);
+            REQUIRE(reply.elements[0].type == Reply::BULK && reply.elements[1].type == Reply::ARRAY);
+            CHECK(reply.elements[1].elements.size() <= 7);
+            for (const Reply &key : reply.elements[1].elements)
+            {
+                scanned.push_back(key.text);
+            }
+            cursor = reply.elements[0].text;
+            if (cursor == "0")
+            {
+                break;
+            }
+        }
+        CHECK(scanned == expected);
+
+        // RANGE returns the keys of [start, end) with their values
+        std::vector<std::string> ranged;
+        std::string start = "key120";
+        for (int page = 0; page < 100; ++page)
+        {
+            Reply reply = client.command({"RANGE", start, "key170", "COUNT", "5"});
+            REQUIRE(reply.type == Reply::ARRAY && reply.elements.size() == 2);
+            const std::vector<Reply> &entries = reply.elements[1].elements;
+            for (size_t i = 0; i + 1 < entries.size(); i += 2)
+            {
+                CHECK_EQ(entries[i + 1].text, "value" + entries[i].text.substr(3));
+                ranged.push_back(entries[i].text);
+            }
+            if (reply.elements[0].type == Reply::NIL)
+            {
+                break;
+            }
+            start = reply.elements[0].text;
+        }
+        CHECK(ranged == std::vector<std::string>(expected.begin() + 20, expected.begin() + 60));
+    }
+}
+
+TEST(pipelinedWritesStayOutOfEarlierScans)
+{
+    TestServer server({"--threads", "2"});
+
+    // Connections land on either worker; each scans, then writes keys of both shards
+    for (int connection = 0; connection < 8; ++connection)
+    {
+        TestClient client(server);
+        std::vector<std::vector<std::string>> commands = {{"SCAN", "0", "COUNT", "1000"}};
+        for (int i = 0; i < 20; ++i)
+        {
+            commands.push_back({"SET", "fresh" + std::to_string(connection) + "-" + std::to_string(i), "1"});
+        }
+        REQUIRE(client.pipeline(commands));
+
+        Reply scan = client.read();
+        REQUIRE(scan.type == Reply::ARRAY && scan.elements.size() == 2);
+        CHECK_EQ(scan.elements[1].elements.size(), (size_t)(20 * connection));
+        for (int i = 0; i < 20; ++i)
+        {
+            CHECK(client.read().isStatus("OK"));
+        }
+    }
+}
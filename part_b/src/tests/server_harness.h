@@ -0,0 +1,407 @@
+/**
+ * @file server_harness.h
+ * @brief Server process and RESP client used by the server tests
+ */
+
+#ifndef SERVER_HARNESS_H
+#define SERVER_HARNESS_H
+
+#include "../../../part_a/src/tests/test_harness.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Server binary started by the tests, relative to the directory make runs in
+ */
+#define TEST_SERVER_BINARY "benchmark"
+
+/**
+ * @brief Seconds to wait for a started server to accept connections, and for a reply
+ */
+#define TEST_SERVER_TIMEOUT_S 30
+
+/**
+ * @brief A parsed RESP reply
+ */
+struct Reply
+{
+    enum Type
+    {
+        STATUS,  ///< +simple string
+        ERROR,   ///< -error
+        INTEGER, ///< :integer
+        BULK,    ///< $bulk string
+        NIL,     ///< $-1 or *-1
+        ARRAY,   ///< *array of elements
+        NONE     ///< No reply: the connection closed or timed out
+    };
+
+    Type type = NONE;
+    std::string text;             ///< Status, error or bulk string
+    long long integer = 0;
+    std::vector<Reply> elements;
+
+    bool isStatus(std::string_view status) const { return type == STATUS && text == status; }
+    bool isBulk(std::string_view value) const { return type == BULK && text == value; }
+    bool isInteger(long long value) const { return type == INTEGER && integer == value; }
+    bool isError() const { return type == ERROR; }
+};
+
+/**
+ * @class TestServer
+ * @brief Server process running in a fresh data directory on a free port
+ *
+ * The server is killed, without a chance to clean up, when the object is
+ * destroyed. Its output goes to server.log in the data directory.
+ */
+class TestServer
+{
+private:
+    TempDirectory dir;
+    pid_t pid = -1;
+    int tcpPort = 0;
+
+    /**
+     * @brief Finds a port no socket is bound to
+     */
+    static int freePort()
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        int found = 0;
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+            getsockname(fd, (struct sockaddr *)&addr, &len) == 0)
+            found = ntohs(addr.sin_port);
+        if (fd >= 0)
+            close(fd);
+        return found;
+    }
+
+public:
+    /**
+     * @brief Starts the server and waits until it accepts connections
+     * @param options Command line options besides --port
+     * @param fileSizeLimit Largest file the server may write (RLIMIT_FSIZE), or 0 for no limit;
+     *                      writes beyond it fail instead of raising SIGXFSZ
+     */
+    explicit TestServer(const std::vector<std::string> &options = {}, rlim_t fileSizeLimit = 0)
+    {
+        std::string binary = std::filesystem::absolute(TEST_SERVER_BINARY).string();
+        tcpPort = freePort();
+        std::string portText = std::to_string(tcpPort);
+        std::vector<const char *> argv = {binary.c_str(), "--port", portText.c_str()};
+        for (const std::string &option : options)
+            argv.push_back(option.c_str());
+        argv.push_back(nullptr);
+
+        std::cout.flush();
+        std::cerr.flush();
+        pid = fork();
+        if (pid == 0)
+        {
+            int log = open(dir.file("server.log").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (log < 0 || chdir(dir.path().c_str()) != 0)
+                _exit(127);
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            if (fileSizeLimit != 0)
+            {
+                signal(SIGXFSZ, SIG_IGN);
+                struct rlimit limit = {fileSizeLimit, fileSizeLimit};
+                setrlimit(RLIMIT_FSIZE, &limit);
+            }
+            execv(binary.c_str(), (char *const *)argv.data());
+            _exit(127);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(TEST_SERVER_TIMEOUT_S);
+        while (pid > 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            int status = 0;
+            if (waitpid(pid, &status, WNOHANG) == pid)
+            {
+                pid = -1;
+                break;
+            }
+            int fd = connectTo(tcpPort);
+            if (fd >= 0)
+            {
+                close(fd);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (pid > 0)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        std::ifstream log(dir.file("server.log"));
+        std::string output((std::istreambuf_iterator<char>(log)), std::istreambuf_iterator<char>());
+        throw std::runtime_error("The server did not start: " + output);
+    }
+
+    TestServer(const TestServer &) = delete;
+    TestServer &operator=(const TestServer &) = delete;
+
+    ~TestServer()
+    {
+        if (pid > 0)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    /**
+     * @brief Port the server listens on
+     */
+    int port() const { return tcpPort; }
+
+    /**
+     * @brief Data directory the server runs in
+     */
+    const TempDirectory &directory() const { return dir; }
+
+    /**
+     * @brief Opens a blocking connection to 127.0.0.1
+     * @param port Port to connect to
+     * @return Socket, or -1 on failure
+     */
+    static int connectTo(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return -1;
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+};
+
+/**
+ * @class TestClient
+ * @brief Blocking RESP connection that can pipeline commands
+ */
+class TestClient
+{
+private:
+    int fd = -1;
+    std::string input;
+    size_t pos = 0;
+
+    /**
+     * @brief Reads until at least count unparsed bytes are buffered
+     */
+    bool fill(size_t count)
+    {
+        while (input.size() - pos < count)
+        {
+            char buffer[65536];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            input.append(buffer, (size_t)n);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads one CRLF-terminated line, without the CRLF
+     */
+    bool readLine(std::string &line)
+    {
+        size_t end;
+        while ((end = input.find("\r\n", pos)) == std::string::npos)
+        {
+            if (!fill(input.size() - pos + 1))
+                return false;
+        }
+        line = input.substr(pos, end - pos);
+        pos = end + 2;
+        return true;
+    }
+
+    /**
+     * @brief Parses the next reply, reading as needed
+     */
+    bool parse(Reply &reply)
+    {
+        std::string line;
+        if (!readLine(line) || line.empty())
+            return false;
+        std::string rest = line.substr(1);
+        switch (line[0])
+        {
+        case '+':
+            reply.type = Reply::STATUS;
+            reply.text = rest;
+            return true;
+        case '-':
+            reply.type = Reply::ERROR;
+            reply.text = rest;
+            return true;
+        case ':':
+            reply.type = Reply::INTEGER;
+            reply.integer = std::stoll(rest);
+            return true;
+        case '$':
+        {
+            long long length = std::stoll(rest);
+            if (length < 0)
+            {
+                reply.type = Reply::NIL;
+                return true;
+            }
+            if (!fill((size_t)length + 2))
+                return false;
+            reply.type = Reply::BULK;
+            reply.text = input.substr(pos, (size_t)length);
+            pos += (size_t)length + 2;
+            return true;
+        }
+        case '*':
+        {
+            long long count = std::stoll(rest);
+            if (count < 0)
+            {
+                reply.type = Reply::NIL;
+                return true;
+            }
+            reply.type = Reply::ARRAY;
+            reply.elements.resize((size_t)count);
+            for (Reply &element : reply.elements)
+            {
+                if (!parse(element))
+                    return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+public:
+    /**
+     * @brief Connects to a test server
+     * @param server Server to connect to
+     */
+    explicit TestClient(const TestServer &server) : fd(TestServer::connectTo(server.port()))
+    {
+        if (fd < 0)
+            throw std::runtime_error("Cannot connect to the test server");
+        struct timeval timeout = {TEST_SERVER_TIMEOUT_S, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+    TestClient(const TestClient &) = delete;
+    TestClient &operator=(const TestClient &) = delete;
+
+    ~TestClient()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    /**
+     * @brief Encodes a command as a RESP array of bulk strings
+     */
+    static std::string encode(const std::vector<std::string> &args)
+    {
+        std::string out = "*" + std::to_string(args.size()) + "\r\n";
+        for (const std::string &arg : args)
+            out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+        return out;
+    }
+
+    /**
+     * @brief Sends raw bytes, e.g. several encoded commands at once
+     * @return False if the connection failed
+     */
+    bool sendRaw(std::string_view bytes)
+    {
+        while (!bytes.empty())
+        {
+            ssize_t n = send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            bytes.remove_prefix((size_t)n);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Sends several commands in one write without waiting for replies
+     * @return False if the connection failed
+     */
+    bool pipeline(const std::vector<std::vector<std::string>> &commands)
+    {
+        std::string bytes;
+        for (const std::vector<std::string> &command : commands)
+            bytes += encode(command);
+        return sendRaw(bytes);
+    }
+
+    /**
+     * @brief Reads the next reply; Reply::NONE if the connection closed or timed out
+     */
+    Reply read()
+    {
+        Reply reply;
+        if (!parse(reply))
+            reply = Reply();
+        input.erase(0, pos);
+        pos = 0;
+        return reply;
+    }
+
+    /**
+     * @brief Sends one command and reads its reply
+     */
+    Reply command(const std::vector<std::string> &args)
+    {
+        if (!sendRaw(encode(args)))
+            return Reply();
+        return read();
+    }
+};
+
+#endif // SERVER_HARNESS_H